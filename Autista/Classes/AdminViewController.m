@@ -24,7 +24,7 @@
 #import "AutistaIAPHelper.h"
 #import <AVFoundation/AVFoundation.h>
 
-#import "../ZipArchive/ZipArchive.h"
+#import "ZipArchive.h"
 #import "UIDevice+IdentifierAddition.h"
 
 #define SYSTEM_VERSION_EQUAL_TO(v)                  ([[[UIDevice currentDevice] systemVersion] compare:v options:NSNumericSearch] == NSOrderedSame)
@@ -443,54 +443,68 @@
     conf.allowsCellularAccess = NO;
     
     _urlSession = [NSURLSession sessionWithConfiguration:conf delegate:self delegateQueue:[NSOperationQueue mainQueue]];
-    for (NSString *subPath in subPaths) {
-        NSMutableData *uploadData = [[NSMutableData alloc] initWithContentsOfFile:[[_logFolderPath stringByAppendingString:@"/" ] stringByAppendingString:subPath] options:nil error:&error];
-        NSURL *path= [NSURL fileURLWithPath:[[_logFolderPath stringByAppendingString:@"/" ] stringByAppendingString:subPath]];
-        uint64_t bytesTotalForThisFile = [[[NSFileManager defaultManager] attributesOfItemAtPath:[[_logFolderPath stringByAppendingString:@"/" ] stringByAppendingString:subPath] error:NULL] fileSize];
-        
-        //Get UDID
-        NSString *uniqueIDHash;
-        if (SYSTEM_VERSION_LESS_THAN(@"7.0")) {
-            uniqueIDHash = [[UIDevice currentDevice] uniqueGlobalDeviceIdentifier]; // save for later.
-        }
+    //Reading the logs and building the upload requests is done off the main thread,
+    //so the progress bar and cancel button show up at once
+    NSArray *uploadPaths = subPaths;
+    NSString *logFolderPath = _logFolderPath;
+    NSURLSession *urlSession = _urlSession;
+    
+    //Get UDID here, UIDevice is only used on the main thread
+    NSString *uniqueIDHash;
+    if (SYSTEM_VERSION_LESS_THAN(@"7.0")) {
+        uniqueIDHash = [[UIDevice currentDevice] uniqueGlobalDeviceIdentifier]; // save for later.
+    }
+    else {
+        uniqueIDHash = [[[UIDevice currentDevice] identifierForVendor] UUIDString];
+        NSLog(@"iOS 7");
+    }
+    
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        NSError *error = nil;
+        NSMutableArray *tasks = [NSMutableArray new];
+        for (NSString *subPath in uploadPaths) {
+            NSMutableData *uploadData = [[NSMutableData alloc] initWithContentsOfFile:[[logFolderPath stringByAppendingString:@"/" ] stringByAppendingString:subPath] options:nil error:&error];
+            NSURL *path= [NSURL fileURLWithPath:[[logFolderPath stringByAppendingString:@"/" ] stringByAppendingString:subPath]];
+            uint64_t bytesTotalForThisFile = [[[NSFileManager defaultManager] attributesOfItemAtPath:[[logFolderPath stringByAppendingString:@"/" ] stringByAppendingString:subPath] error:NULL] fileSize];
         
-        if (SYSTEM_VERSION_GREATER_THAN_OR_EQUAL_TO(@"7.0")) {
-            uniqueIDHash = [[[UIDevice currentDevice] identifierForVendor] UUIDString];
-            NSLog(@"iOS 7");
-        }
+            //Get current timestamp
+    //        NSTimeInterval timeStamp = [[NSDate date] timeIntervalSince1970];
+            int unixtime = [[NSNumber numberWithDouble: [[NSDate date] timeIntervalSince1970]] integerValue];
+    //        NSString * timestamp = [NSString stringWithFormat:@"%f",[[NSDate date] timeIntervalSince1970]] ;
         
-        //Get current timestamp
-//        NSTimeInterval timeStamp = [[NSDate date] timeIntervalSince1970];
-        int unixtime = [[NSNumber numberWithDouble: [[NSDate date] timeIntervalSince1970]] integerValue];
-//        NSString * timestamp = [NSString stringWithFormat:@"%f",[[NSDate date] timeIntervalSince1970]] ;
+    //        NSNumber *absoluteTime = [NSNumber numberWithDouble:[[NSDate date] timeIntervalSinceReferenceDate]*1000];
         
-//        NSNumber *absoluteTime = [NSNumber numberWithDouble:[[NSDate date] timeIntervalSinceReferenceDate]*1000];
+            NSURL *url = [NSURL URLWithString:[NSString stringWithFormat:@"http://www.autismcollaborative.org/autista/upload.php?udid=%@&timestamp=%i", uniqueIDHash, unixtime]];
+            NSMutableURLRequest *request = [[NSMutableURLRequest alloc] initWithURL:url];
+            NSString *boundary = @"---------------------------14737809831466499882746641449";
+            NSString *contentType = [NSString stringWithFormat:@"multipart/form-data; boundary=%@",boundary];
+            NSString *contentDisposition = [NSString stringWithFormat:@"Content-Disposition: form-data; name=\"fileUpload\"; filename=\"%@\"\r\n",subPath];
         
-        NSURL *url = [NSURL URLWithString:[NSString stringWithFormat:@"http://www.autismcollaborative.org/autista/upload.php?udid=%@&timestamp=%i", uniqueIDHash, unixtime]];
-        NSMutableURLRequest *request = [[NSMutableURLRequest alloc] initWithURL:url];
-        NSString *boundary = @"---------------------------14737809831466499882746641449";
-        NSString *contentType = [NSString stringWithFormat:@"multipart/form-data; boundary=%@",boundary];
-        NSString *contentDisposition = [NSString stringWithFormat:@"Content-Disposition: form-data; name=\"fileUpload\"; filename=\"%@\"\r\n",subPath];
+            [request setHTTPMethod:@"POST"];
+            [request addValue:contentType forHTTPHeaderField:@"Content-Type"];
+            [request addValue:[NSString stringWithFormat:@"%llu", bytesTotalForThisFile] forHTTPHeaderField:@"Content-Length"];
+            NSMutableData *body =[NSMutableData data];
+            [body appendData:[[NSString stringWithFormat:@"\r\n--%@\r\n",boundary] dataUsingEncoding:NSUTF8StringEncoding]];
+            [body appendData:[contentDisposition dataUsingEncoding:NSUTF8StringEncoding]];
+            [body appendData:[@"Content-Type:multipart/form-data\r\n\r\n" dataUsingEncoding:NSUTF8StringEncoding]];
+            [body appendData:[NSData dataWithData:uploadData]];
+            [body appendData:[[NSString stringWithFormat:@"\r\n--%@--\r\n",boundary] dataUsingEncoding:NSUTF8StringEncoding]];
+            [request setHTTPBody:body];
+
+            NSURLSessionTask *task = [urlSession uploadTaskWithRequest:request fromData:body];
+            [tasks addObject:task];
+        }
         
-        [request setHTTPMethod:@"POST"];
-        [request addValue:contentType forHTTPHeaderField:@"Content-Type"];
-        [request addValue:[NSString stringWithFormat:@"%llu", bytesTotalForThisFile] forHTTPHeaderField:@"Content-Length"];
-        NSMutableData *body =[NSMutableData data];
-        [body appendData:[[NSString stringWithFormat:@"\r\n--%@\r\n",boundary] dataUsingEncoding:NSUTF8StringEncoding]];
-        [body appendData:[contentDisposition dataUsingEncoding:NSUTF8StringEncoding]];
-        [body appendData:[@"Content-Type:multipart/form-data\r\n\r\n" dataUsingEncoding:NSUTF8StringEncoding]];
-        [body appendData:[NSData dataWithData:uploadData]];
-        [body appendData:[[NSString stringWithFormat:@"\r\n--%@--\r\n",boundary] dataUsingEncoding:NSUTF8StringEncoding]];
-        [request setHTTPBody:body];
-
-        NSURLSessionTask *task = [_urlSession uploadTaskWithRequest:request fromData:body];
-        [_tasks addObject:task];
-    }
-    
-    [[_tasks firstObject] resume];
-    self.taskNameLabel.alpha = 1;
-    self.taskNameLabel.text = [subPaths objectAtIndex:0];
-
+        dispatch_async(dispatch_get_main_queue(), ^{
+            //Cancelled, or started again, while the requests were being built
+            if (_urlSession != urlSession || _uploadCancelBtn.hidden)
+                return;
+            [_tasks addObjectsFromArray:tasks];
+            [[_tasks firstObject] resume];
+            self.taskNameLabel.alpha = 1;
+            self.taskNameLabel.text = [uploadPaths firstObject];
+        });
+    });
 }
 
 //- (IBAction)handleSendLogDataPressed:(id)sender
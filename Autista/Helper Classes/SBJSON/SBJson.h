@@ -28,6 +28,7 @@
  */
 
 #import "SBJsonParser.h"
+#import "SBJsonTapeParser.h"
 #import "SBJsonWriter.h"
 #import "SBJsonStreamParser.h"
 #import "SBJsonStreamParserAdapter.h"
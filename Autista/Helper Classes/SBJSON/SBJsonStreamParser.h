@@ -100,8 +100,10 @@ typedef enum {
  - object  -> NSMutableDictionary
  - true    -> NSNumber's -numberWithBool:YES
  - false   -> NSNumber's -numberWithBool:NO
- - integer up to 19 digits -> NSNumber's -numberWithLongLong:
- - all other numbers       -> NSDecimalNumber
+ - integer that fits a long long -> NSNumber's -numberWithLongLong:
+ - other number of up to 17 significant digits that a double keeps
+                                -> NSNumber's -numberWithDouble:
+ - all other numbers            -> NSDecimalNumber
 
  Since Objective-C doesn't have a dedicated class for boolean values,
  these turns into NSNumber instances. However, since these are
@@ -109,10 +111,12 @@ typedef enum {
  properly. In other words, they won't silently suddenly become 0 or 1;
  they'll be represented as 'true' and 'false' again.
 
- As an optimisation integers up to 19 digits in length (the max length
- for signed long long integers) turn into NSNumber instances, while
- complex ones turn into NSDecimalNumber instances. We can thus avoid any
- loss of precision as JSON allows ridiculously large numbers.
+ As an optimisation integers that fit a signed long long, and numbers
+ whose significant digits a double prints back unchanged (all of those of
+ up to 15 digits, and doubles written with 17), turn into NSNumber
+ instances, while complex ones turn into NSDecimalNumber instances. We can
+ thus avoid any loss of precision as JSON allows ridiculously large
+ numbers.
 
  See also SBJsonStreamParserAdapter for more information.
 
@@ -363,7 +363,14 @@ static const char *strForChar(int c) {
 				[state transitionState:self];
 				return YES;
 			}
-			len = snprintf(num, sizeof num, "%.17g", [number doubleValue]);
+			// The fewest digits that read back as the same double, so
+			// numbers parsed as doubles are written as they were read
+			double value = [number doubleValue];
+			for (int precision = 15; ; precision++) {
+				len = snprintf(num, sizeof num, "%.*g", precision, value);
+				if (precision == 17 || strtod(num, NULL) == value)
+					break;
+			}
 			break;
 	}
 	[delegate writer:self appendBytes:num length: len];
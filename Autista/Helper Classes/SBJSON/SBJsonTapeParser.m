@@ -0,0 +1,655 @@
+/*
+ Copyright (c) 2011, Stig Brautaset. All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are
+ met:
+ 
+ Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ 
+ Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ 
+ Neither the name of the the author nor the names of its contributors
+ may be used to endorse or promote products derived from this software
+ without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#if !__has_feature(objc_arc)
+#error "This source file must be compiled with ARC enabled!"
+#endif
+
+#import <libkern/OSAtomic.h>
+#import "SBJsonTapeParser.h"
+#import "SBJsonTokeniser.h"
+
+// Each value on the tape starts with an entry holding its type in the top
+// byte. Arrays and objects hold the index of the entry after their end and
+// are followed by their number of values (of pairs for objects); strings
+// without escapes hold their offset in the input and are followed by their
+// length; numbers and strings with escapes hold their index in the objects.
+typedef enum {
+    sbjson_tape_object = '{',
+    sbjson_tape_array = '[',
+    sbjson_tape_string = '"',
+    sbjson_tape_decoded = 'd',
+    sbjson_tape_true = 't',
+    sbjson_tape_false = 'f',
+    sbjson_tape_null = 'n',
+} sbjson_tape_t;
+
+#define SBJsonTapeEntry(type, payload) (((uint64_t)(type) << 56) | (uint64_t)(payload))
+#define SBJsonTapeType(entry) ((sbjson_tape_t)((entry) >> 56))
+#define SBJsonTapePayload(entry) ((NSUInteger)((entry) & 0x00FFFFFFFFFFFFFFULL))
+
+// Objects with more keys than this look them up in a dictionary of the keys
+static NSUInteger const SBJsonTapeLinearKeys = 8;
+
+
+@interface SBJsonTape : NSObject {
+@public
+    NSData *_data;
+    const char *_bytes;
+    uint64_t *_entries;
+    NSUInteger _count;
+    NSUInteger _capacity;
+    NSMutableArray *_objects;
+}
+
+- (id)initWithData:(NSData*)data;
+- (BOOL)append:(uint64_t)entry;
+- (NSUInteger)next:(NSUInteger)i;
+- (id)valueAt:(NSUInteger)i;
+
+@end
+
+@interface SBJsonTapeArray : NSArray {
+@private
+    SBJsonTape *_tape;
+    NSUInteger _start;
+    NSUInteger _count;
+    NSUInteger * volatile _children;
+    void ** volatile _values;
+}
+
+- (id)initWithTape:(SBJsonTape*)tape at:(NSUInteger)start;
+
+@end
+
+@interface SBJsonTapeDictionary : NSDictionary {
+@private
+    SBJsonTape *_tape;
+    NSUInteger _start;
+    NSUInteger _pairs;
+    NSUInteger * volatile _children;
+    void ** volatile _values;
+    void * volatile _keys;
+    void * volatile _lookup;
+}
+
+- (id)initWithTape:(SBJsonTape*)tape at:(NSUInteger)start;
+
+@end
+
+
+// The caches below are filled on first use from any thread. Each is built
+// aside and stored with a compare and swap; a thread that loses the race
+// frees its copy and uses the one stored.
+
+// The tape index of each value of the array or object at start, keys and
+// values in turn for objects, found once and kept in *children
+static NSUInteger *SBJsonTapeChildren(SBJsonTape *tape, NSUInteger * volatile *children, NSUInteger start, NSUInteger count) {
+    NSUInteger *found = *children;
+    if (!found) {
+        found = malloc(MAX(count, 1u) * sizeof(NSUInteger));
+        if (!found)
+            return NULL;
+        NSUInteger i = start + 2;
+        for (NSUInteger k = 0; k < count; k++) {
+            found[k] = i;
+            i = [tape next:i];
+        }
+        if (!OSAtomicCompareAndSwapPtrBarrier(NULL, found, (void * volatile *)children)) {
+            free(found);
+            found = *children;
+        }
+    }
+    return found;
+}
+
+// Decode the value at tape index i once, and keep it in slot of values
+static id SBJsonTapeCachedValue(SBJsonTape *tape, void ** volatile *values, NSUInteger count, NSUInteger slot, NSUInteger i) {
+    void **cache = *values;
+    if (!cache) {
+        cache = calloc(count, sizeof(void *));
+        if (!cache)
+            return [tape valueAt:i];
+        if (!OSAtomicCompareAndSwapPtrBarrier(NULL, cache, (void * volatile *)values)) {
+            free(cache);
+            cache = *values;
+        }
+    }
+
+    void *value = cache[slot];
+    if (!value) {
+        value = (__bridge_retained void *)[tape valueAt:i];
+        if (!OSAtomicCompareAndSwapPtrBarrier(NULL, value, (void * volatile *)&cache[slot])) {
+            CFRelease(value);
+            value = cache[slot];
+        }
+    }
+    return (__bridge id)value;
+}
+
+// Keep object in *slot, unless another thread kept one first, and return it
+static id SBJsonTapeCachedObject(void * volatile *slot, id object) {
+    void *value = (__bridge_retained void *)object;
+    if (!OSAtomicCompareAndSwapPtrBarrier(NULL, value, slot))
+        CFRelease(value);
+    return (__bridge id)*slot;
+}
+
+static void SBJsonTapeReleaseValues(void **values, NSUInteger count) {
+    if (values) {
+        for (NSUInteger i = 0; i < count; i++)
+            if (values[i])
+                CFRelease(values[i]);
+        free(values);
+    }
+}
+
+
+@implementation SBJsonTape
+
+- (id)initWithData:(NSData *)data {
+    self = [super init];
+    if (self) {
+        _data = [data copy];
+        _bytes = (const char*)[_data bytes];
+        _objects = [[NSMutableArray alloc] init];
+    }
+    return self;
+}
+
+- (void)dealloc {
+    free(_entries);
+}
+
+- (BOOL)append:(uint64_t)entry {
+    if (_count == _capacity) {
+        NSUInteger capacity = _capacity ? _capacity * 2 : [_data length] / 8 + 16;
+        uint64_t *entries = realloc(_entries, capacity * sizeof(uint64_t));
+        if (!entries)
+            return NO;
+        _entries = entries;
+        _capacity = capacity;
+    }
+    _entries[_count++] = entry;
+    return YES;
+}
+
+- (NSUInteger)next:(NSUInteger)i {
+    switch (SBJsonTapeType(_entries[i])) {
+        case sbjson_tape_object:
+        case sbjson_tape_array:
+            return SBJsonTapePayload(_entries[i]);
+            break;
+
+        case sbjson_tape_string:
+            return i + 2;
+            break;
+
+        default:
+            return i + 1;
+            break;
+    }
+}
+
+- (id)valueAt:(NSUInteger)i {
+    uint64_t entry = _entries[i];
+    switch (SBJsonTapeType(entry)) {
+        case sbjson_tape_object:
+            return [[SBJsonTapeDictionary alloc] initWithTape:self at:i];
+            break;
+
+        case sbjson_tape_array:
+            return [[SBJsonTapeArray alloc] initWithTape:self at:i];
+            break;
+
+        case sbjson_tape_string:
+            return [[NSString alloc] initWithBytes:_bytes + SBJsonTapePayload(entry)
+                                            length:(NSUInteger)_entries[i + 1]
+                                          encoding:NSUTF8StringEncoding];
+            break;
+
+        case sbjson_tape_decoded:
+            return [_objects objectAtIndex:SBJsonTapePayload(entry)];
+            break;
+
+        case sbjson_tape_true:
+            return [NSNumber numberWithBool:YES];
+            break;
+
+        case sbjson_tape_false:
+            return [NSNumber numberWithBool:NO];
+            break;
+
+        case sbjson_tape_null:
+            return [NSNull null];
+            break;
+    }
+    return nil;
+}
+
+@end
+
+
+@implementation SBJsonTapeArray
+
+- (id)initWithTape:(SBJsonTape *)tape at:(NSUInteger)start {
+    self = [super init];
+    if (self) {
+        _tape = tape;
+        _start = start;
+        _count = (NSUInteger)tape->_entries[start + 1];
+    }
+    return self;
+}
+
+- (void)dealloc {
+    SBJsonTapeReleaseValues(_values, _count);
+    free(_children);
+}
+
+- (NSUInteger)count {
+    return _count;
+}
+
+- (id)objectAtIndex:(NSUInteger)index {
+    if (index >= _count)
+        [NSException raise:NSRangeException format:@"index %lu beyond bounds for array of %lu values",
+            (unsigned long)index, (unsigned long)_count];
+
+    NSUInteger *children = SBJsonTapeChildren(_tape, &_children, _start, _count);
+    if (!children)
+        [NSException raise:NSMallocException format:@"Out of memory for array of %lu values", (unsigned long)_count];
+
+    return SBJsonTapeCachedValue(_tape, &_values, _count, index, children[index]);
+}
+
+@end
+
+
+@implementation SBJsonTapeDictionary
+
+- (id)initWithTape:(SBJsonTape *)tape at:(NSUInteger)start {
+    self = [super init];
+    if (self) {
+        _tape = tape;
+        _start = start;
+        _pairs = (NSUInteger)tape->_entries[start + 1];
+    }
+    return self;
+}
+
+- (void)dealloc {
+    SBJsonTapeReleaseValues(_values, _pairs);
+    free(_children);
+    if (_keys)
+        CFRelease(_keys);
+    if (_lookup)
+        CFRelease(_lookup);
+}
+
+- (NSUInteger *)children {
+    NSUInteger *children = SBJsonTapeChildren(_tape, &_children, _start, _pairs * 2);
+    if (!children)
+        [NSException raise:NSMallocException format:@"Out of memory for object of %lu keys", (unsigned long)_pairs];
+    return children;
+}
+
+- (NSUInteger)count {
+    return [[self keys] count];
+}
+
+// Each key once, where it was last, as the last of the same keys wins
+- (NSArray *)keys {
+    if (_keys)
+        return (__bridge NSArray *)_keys;
+
+    NSUInteger *children = [self children];
+    NSMutableArray *keys = [[NSMutableArray alloc] initWithCapacity:_pairs];
+    NSMutableSet *seen = [[NSMutableSet alloc] initWithCapacity:_pairs];
+    for (NSUInteger k = _pairs; k-- > 0;) {
+        NSString *key = [_tape valueAt:children[2 * k]];
+        if (![seen containsObject:key]) {
+            [seen addObject:key];
+            [keys addObject:key];
+        }
+    }
+    return SBJsonTapeCachedObject(&_keys, [[keys reverseObjectEnumerator] allObjects]);
+}
+
+- (NSUInteger)pairForKey:(NSString *)key {
+    NSUInteger *children = [self children];
+
+    if (_pairs > SBJsonTapeLinearKeys) {
+        NSDictionary *lookup = (__bridge NSDictionary *)_lookup;
+        if (!lookup) {
+            NSMutableDictionary *pairs = [[NSMutableDictionary alloc] initWithCapacity:_pairs];
+            for (NSUInteger k = 0; k < _pairs; k++)
+                [pairs setObject:[NSNumber numberWithUnsignedInteger:k] forKey:[_tape valueAt:children[2 * k]]];
+            lookup = SBJsonTapeCachedObject(&_lookup, pairs);
+        }
+        NSNumber *pair = [lookup objectForKey:key];
+        return pair ? [pair unsignedIntegerValue] : NSNotFound;
+    }
+
+    const char *utf8 = [key UTF8String];
+    NSUInteger length = [key lengthOfBytesUsingEncoding:NSUTF8StringEncoding];
+
+    // The last of the same keys wins, as in the dictionaries of SBJsonParser
+    for (NSUInteger k = _pairs; k-- > 0;) {
+        NSUInteger i = children[2 * k];
+        uint64_t entry = _tape->_entries[i];
+        if (SBJsonTapeType(entry) == sbjson_tape_string) {
+            if (utf8 && (NSUInteger)_tape->_entries[i + 1] == length &&
+                !memcmp(_tape->_bytes + SBJsonTapePayload(entry), utf8, length))
+                return k;
+        } else if ([key isEqualToString:[_tape valueAt:i]]) {
+            return k;
+        }
+    }
+    return NSNotFound;
+}
+
+- (id)objectForKey:(id)key {
+    if (![key isKindOfClass:[NSString class]])
+        return nil;
+
+    NSUInteger pair = [self pairForKey:key];
+    if (pair == NSNotFound)
+        return nil;
+    return SBJsonTapeCachedValue(_tape, &_values, _pairs, pair, [self children][2 * pair + 1]);
+}
+
+- (NSEnumerator *)keyEnumerator {
+    return [[self keys] objectEnumerator];
+}
+
+@end
+
+
+// The states of SBJsonStreamParser, with the same names in errors
+typedef enum {
+    sbjson_tape_state_start,
+    sbjson_tape_state_complete,
+    sbjson_tape_state_object_start,
+    sbjson_tape_state_object_got_key,
+    sbjson_tape_state_object_separator,
+    sbjson_tape_state_object_got_value,
+    sbjson_tape_state_object_need_key,
+    sbjson_tape_state_array_start,
+    sbjson_tape_state_array_got_value,
+    sbjson_tape_state_array_need_value,
+} sbjson_tape_state_t;
+
+static NSString *SBJsonTapeStateName(sbjson_tape_state_t state) {
+    switch (state) {
+        case sbjson_tape_state_start:               return @"before outer-most array or object";
+        case sbjson_tape_state_complete:            return @"after outer-most array or object";
+        case sbjson_tape_state_object_start:        return @"at beginning of object";
+        case sbjson_tape_state_object_got_key:      return @"after object key";
+        case sbjson_tape_state_object_separator:    return @"as object value";
+        case sbjson_tape_state_object_got_value:    return @"after object value";
+        case sbjson_tape_state_object_need_key:     return @"in place of object key";
+        case sbjson_tape_state_array_start:         return @"at array start";
+        case sbjson_tape_state_array_got_value:     return @"after array value";
+        case sbjson_tape_state_array_need_value:    return @"as array value";
+    }
+    return @"<aaiie!>";
+}
+
+static NSString *SBJsonTapeTokenName(sbjson_token_t token) {
+    switch (token) {
+        case sbjson_token_array_start:      return @"start of array";
+        case sbjson_token_array_end:        return @"end of array";
+        case sbjson_token_number:           return @"number";
+        case sbjson_token_string:           return @"string";
+        case sbjson_token_true:
+        case sbjson_token_false:            return @"boolean";
+        case sbjson_token_null:             return @"null";
+        case sbjson_token_keyval_separator: return @"key-value separator";
+        case sbjson_token_separator:        return @"value separator";
+        case sbjson_token_object_start:     return @"start of object";
+        case sbjson_token_object_end:       return @"end of object";
+        case sbjson_token_eof:
+        case sbjson_token_error:
+            break;
+    }
+    return @"<aaiiie!>";
+}
+
+static BOOL SBJsonTapeIsValue(sbjson_token_t token) {
+    switch (token) {
+        case sbjson_token_object_start:
+        case sbjson_token_array_start:
+        case sbjson_token_true:
+        case sbjson_token_false:
+        case sbjson_token_null:
+        case sbjson_token_number:
+        case sbjson_token_string:
+            return YES;
+            break;
+        default:
+            return NO;
+            break;
+    }
+}
+
+static BOOL SBJsonTapeAccepts(sbjson_tape_state_t state, sbjson_token_t token) {
+    switch (state) {
+        case sbjson_tape_state_start:
+            return token == sbjson_token_array_start || token == sbjson_token_object_start;
+        case sbjson_tape_state_complete:
+            return NO;
+        case sbjson_tape_state_object_start:
+            return token == sbjson_token_object_end || token == sbjson_token_string;
+        case sbjson_tape_state_object_got_key:
+            return token == sbjson_token_keyval_separator;
+        case sbjson_tape_state_object_separator:
+        case sbjson_tape_state_array_need_value:
+            return SBJsonTapeIsValue(token);
+        case sbjson_tape_state_object_got_value:
+            return token == sbjson_token_object_end || token == sbjson_token_separator;
+        case sbjson_tape_state_object_need_key:
+            return token == sbjson_token_string;
+        case sbjson_tape_state_array_start:
+            return token == sbjson_token_array_end || SBJsonTapeIsValue(token);
+        case sbjson_tape_state_array_got_value:
+            return token == sbjson_token_array_end || token == sbjson_token_separator;
+    }
+    return NO;
+}
+
+
+@implementation SBJsonTapeParser
+
+@synthesize maxDepth;
+@synthesize error;
+
+- (id)init {
+    self = [super init];
+    if (self)
+        self.maxDepth = 32u;
+    return self;
+}
+
+
+#pragma mark Private methods
+
+- (BOOL)parse:(SBJsonTape *)tape {
+    SBJsonTokeniser *tokeniser = [[SBJsonTokeniser alloc] init];
+    [tokeniser appendData:tape->_data];
+
+    // The tape index of each open array or object, and its values so far
+    NSMutableData *stack = [NSMutableData data];
+    NSUInteger depth = 0;
+    sbjson_tape_state_t state = sbjson_tape_state_start;
+
+    for (;;) {
+        NSObject *token = nil;
+        NSRange range;
+        sbjson_token_t tok = [tokeniser getToken:&token range:&range];
+
+        if (tok == sbjson_token_eof) {
+            if (state == sbjson_tape_state_complete)
+                return YES;
+            self.error = @"Unexpected end of input";
+            return NO;
+        }
+
+        if (tok == sbjson_token_error) {
+            self.error = tokeniser.error;
+            return NO;
+        }
+
+        if (!SBJsonTapeAccepts(state, tok)) {
+            self.error = [NSString stringWithFormat:@"Token '%@' not expected %@",
+                          SBJsonTapeTokenName(tok), SBJsonTapeStateName(state)];
+            return NO;
+        }
+
+        BOOL ok = YES;
+        BOOL value = YES;
+        switch (tok) {
+            case sbjson_token_object_start:
+            case sbjson_token_array_start:
+                if (maxDepth && depth >= maxDepth) {
+                    self.error = [NSString stringWithFormat:@"Input depth exceeds max depth of %lu", (unsigned long)maxDepth];
+                    return NO;
+                }
+                [stack setLength:(depth + 1) * 2 * sizeof(NSUInteger)];
+                ((NSUInteger *)[stack mutableBytes])[2 * depth] = tape->_count;
+                ((NSUInteger *)[stack mutableBytes])[2 * depth + 1] = 0;
+                depth++;
+
+                ok = [tape append:SBJsonTapeEntry(tok == sbjson_token_object_start ? sbjson_tape_object : sbjson_tape_array, 0)] &&
+                     [tape append:0];
+                state = tok == sbjson_token_object_start ? sbjson_tape_state_object_start : sbjson_tape_state_array_start;
+                value = NO;
+                break;
+
+            case sbjson_token_object_end:
+            case sbjson_token_array_end: {
+                depth--;
+                NSUInteger *open = (NSUInteger *)[stack mutableBytes] + 2 * depth;
+                tape->_entries[open[0]] |= tape->_count;
+                tape->_entries[open[0] + 1] = open[1];
+                break;
+            }
+
+            case sbjson_token_separator:
+                if (state == sbjson_tape_state_object_got_value)
+                    state = sbjson_tape_state_object_need_key;
+                else
+                    state = sbjson_tape_state_array_need_value;
+                value = NO;
+                break;
+
+            case sbjson_token_keyval_separator:
+                state = sbjson_tape_state_object_separator;
+                value = NO;
+                break;
+
+            case sbjson_token_string:
+                if (token) {
+                    ok = [tape append:SBJsonTapeEntry(sbjson_tape_decoded, tape->_objects.count)];
+                    [tape->_objects addObject:token];
+                } else {
+                    ok = [tape append:SBJsonTapeEntry(sbjson_tape_string, range.location)] &&
+                         [tape append:range.length];
+                }
+                if (state == sbjson_tape_state_object_start || state == sbjson_tape_state_object_need_key) {
+                    state = sbjson_tape_state_object_got_key;
+                    value = NO;
+                }
+                break;
+
+            case sbjson_token_number:
+                ok = [tape append:SBJsonTapeEntry(sbjson_tape_decoded, tape->_objects.count)];
+                [tape->_objects addObject:token];
+                break;
+
+            case sbjson_token_true:
+                ok = [tape append:SBJsonTapeEntry(sbjson_tape_true, 0)];
+                break;
+
+            case sbjson_token_false:
+                ok = [tape append:SBJsonTapeEntry(sbjson_tape_false, 0)];
+                break;
+
+            case sbjson_token_null:
+                ok = [tape append:SBJsonTapeEntry(sbjson_tape_null, 0)];
+                break;
+
+            default:
+                break;
+        }
+
+        if (!ok) {
+            self.error = @"Out of memory for the tape";
+            return NO;
+        }
+
+        if (value) {
+            if (!depth) {
+                state = sbjson_tape_state_complete;
+            } else {
+                NSUInteger *open = (NSUInteger *)[stack mutableBytes] + 2 * (depth - 1);
+                open[1]++;
+                if (SBJsonTapeType(tape->_entries[open[0]]) == sbjson_tape_object)
+                    state = sbjson_tape_state_object_got_value;
+                else
+                    state = sbjson_tape_state_array_got_value;
+            }
+        }
+    }
+}
+
+
+#pragma mark Methods
+
+- (id)objectWithData:(NSData *)data {
+
+    if (!data) {
+        self.error = @"Input was 'nil'";
+        return nil;
+    }
+
+    SBJsonTape *tape = [[SBJsonTape alloc] initWithData:data];
+    if (![self parse:tape])
+        return nil;
+
+    return [tape valueAt:0];
+}
+
+- (id)objectWithString:(NSString *)repr {
+	return [self objectWithData:[repr dataUsingEncoding:NSUTF8StringEncoding]];
+}
+
+@end
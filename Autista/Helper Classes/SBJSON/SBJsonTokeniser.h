@@ -64,4 +64,13 @@ typedef enum {
 
 - (sbjson_token_t)getToken:(NSObject**)token;
 
+/**
+ Get the next token, leaving strings without escapes in the stream
+
+ A string without escapes is checked for valid UTF-8 but not decoded:
+ token is set to nil and range to where its bytes are in the stream,
+ between the quotes. Other strings are decoded into token as usual.
+ */
+- (sbjson_token_t)getToken:(NSObject**)token range:(NSRange*)range;
+
 @end
@@ -35,6 +35,9 @@
 
 #import "SBJsonTokeniser.h"
 #import "SBJsonUTF8Stream.h"
+#include <float.h>
+#include <math.h>
+#include <xlocale.h>
 
 #define SBStringIsIllegalSurrogateHighCharacter(character) (((character) >= 0xD800UL) && ((character) <= 0xDFFFUL))
 #define SBStringIsSurrogateLowCharacter(character) ((character >= 0xDC00UL) && (character <= 0xDFFFUL))
@@ -44,8 +47,99 @@ static int const DECIMAL_MAX_PRECISION = 38;
 static int const DECIMAL_EXPONENT_MAX = 127;
 static short const DECIMAL_EXPONENT_MIN = -128;
 static int const LONG_LONG_DIGITS = 19;
+static int const DOUBLE_MAX_DIGITS = 17;
+
+#define SBJSON_SMALL_INTEGERS 256
+static NSNumber *kSmallIntegers[SBJSON_SMALL_INTEGERS];
+
+static double const kPowersOfTen[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+// The double nearest to the number text, which is mantissa * 10^exponent
+// with significant digits, if it keeps all of them. Up to DBL_DIG digits
+// always print back the same from a double. 16 or 17 digits, like doubles
+// written with %.17g, are printed back to check them. Others stay decimal.
+static BOOL SBJsonDoubleForNumber(const char *text, NSUInteger length, BOOL isNegative,
+                                  unsigned long long mantissa, int exponent, int significant,
+                                  double *value) {
+    if (significant > DOUBLE_MAX_DIGITS)
+        return NO;
+
+    int scientific = exponent + significant - 1;
+    if (scientific > DBL_MAX_10_EXP || scientific < DBL_MIN_10_EXP)
+        return NO;
+
+    if (mantissa <= (1ULL << 53) && exponent >= -22 && exponent <= 22) {
+        // Both are exact as doubles, so this rounds once, correctly
+        double d = (double)mantissa;
+        d = exponent < 0 ? d / kPowersOfTen[-exponent] : d * kPowersOfTen[exponent];
+        *value = isNegative ? -d : d;
+    } else {
+        char buffer[64];
+        if (length >= sizeof buffer)
+            return NO;
+        memcpy(buffer, text, length);
+        buffer[length] = 0;
+        *value = strtod_l(buffer, NULL, NULL);
+        if (isinf(*value))
+            return NO;
+    }
+
+    if (significant > DBL_DIG) {
+        char digits[24], printed[32];
+        snprintf_l(digits, sizeof digits, NULL, "%llu", mantissa);
+        snprintf_l(printed, sizeof printed, NULL, "%.*e", significant - 1, fabs(*value));
 
-static NSCharacterSet *kDecimalDigitCharacterSet;
+        // printed is "d.ddde+x", digits is "dddd"
+        if (printed[0] != digits[0] || memcmp(printed + 2, digits + 1, significant - 1) ||
+            atoi(printed + significant + 2) != scientific)
+            return NO;
+    }
+    return YES;
+}
+
+// Well-formed UTF-8 as in RFC 3629: no overlong forms, no surrogates and
+// nothing above U+10FFFF, like NSString wants it.
+static BOOL SBJsonIsValidUTF8(const unsigned char *bytes, NSUInteger length) {
+    NSUInteger i = 0;
+    while (i < length) {
+        unsigned char c = bytes[i];
+        if (c < 0x80) {
+            i++;
+            continue;
+        }
+
+        NSUInteger trailing;
+        unsigned char lo = 0x80, hi = 0xBF;
+        if (c >= 0xC2 && c <= 0xDF) {
+            trailing = 1;
+        } else if (c >= 0xE0 && c <= 0xEF) {
+            trailing = 2;
+            if (c == 0xE0)
+                lo = 0xA0;
+            else if (c == 0xED)
+                hi = 0x9F;
+        } else if (c >= 0xF0 && c <= 0xF4) {
+            trailing = 3;
+            if (c == 0xF0)
+                lo = 0x90;
+            else if (c == 0xF4)
+                hi = 0x8F;
+        } else {
+            return NO;
+        }
+
+        if (length - i <= trailing || bytes[i + 1] < lo || bytes[i + 1] > hi)
+            return NO;
+        for (NSUInteger k = 2; k <= trailing; k++)
+            if ((bytes[i + k] & 0xC0) != 0x80)
+                return NO;
+        i += trailing + 1;
+    }
+    return YES;
+}
 
 @implementation SBJsonTokeniser
 
@@ -53,7 +147,8 @@ static NSCharacterSet *kDecimalDigitCharacterSet;
 @synthesize stream = _stream;
 
 + (void)initialize {
-    kDecimalDigitCharacterSet = [NSCharacterSet decimalDigitCharacterSet];
+    for (int i = 0; i < SBJSON_SMALL_INTEGERS; i++)
+        kSmallIntegers[i] = [NSNumber numberWithLongLong:i];
 }
 
 - (id)init {
@@ -146,7 +241,31 @@ static NSCharacterSet *kDecimalDigitCharacterSet;
     return YES;
 }
 
-- (sbjson_token_t)getStringToken:(NSObject**)token {
+- (sbjson_token_t)getStringToken:(NSObject**)token range:(NSRange*)range {
+    if (range) {
+        NSUInteger start = _stream.index;
+        [_stream skip];
+
+        NSRange fragment;
+        unichar ch;
+        if (![_stream getStringFragmentRange:&fragment] || ![_stream getUnichar:&ch])
+            return sbjson_token_eof;
+
+        if (ch == '"') {
+            if (!SBJsonIsValidUTF8((const unsigned char *)[_stream bytes] + fragment.location, fragment.length)) {
+                self.error = @"Broken Unicode encoding";
+                return sbjson_token_error;
+            }
+            *token = nil;
+            *range = fragment;
+            [_stream skip];
+            return sbjson_token_string;
+        }
+
+        // Decode the escapes
+        _stream.index = start;
+    }
+
     NSMutableString *acc = nil;
 
     for (;;) {
@@ -225,12 +344,13 @@ static NSCharacterSet *kDecimalDigitCharacterSet;
                             return sbjson_token_error;
                         }
 
-                        [acc appendFormat:@"%C%C", hi, lo];
+                        unichar pair[2] = { hi, lo };
+                        CFStringAppendCharacters((__bridge CFMutableStringRef)acc, pair, 2);
                     } else if (SBStringIsIllegalSurrogateHighCharacter(hi)) {
                         self.error = @"Invalid high character in surrogate pair";
                         return sbjson_token_error;
                     } else {
-                        [acc appendFormat:@"%C", hi];
+                        CFStringAppendCharacters((__bridge CFMutableStringRef)acc, &hi, 1);
                     }
 
 
@@ -238,7 +358,7 @@ static NSCharacterSet *kDecimalDigitCharacterSet;
                     unichar decoded;
                     if (![self decodeEscape:ch into:&decoded])
                         return sbjson_token_error;
-                    [acc appendFormat:@"%C", decoded];
+                    CFStringAppendCharacters((__bridge CFMutableStringRef)acc, &decoded, 1);
                 }
 
                 break;
@@ -255,57 +375,63 @@ static NSCharacterSet *kDecimalDigitCharacterSet;
 
 - (sbjson_token_t)getNumberToken:(NSObject**)token {
 
+    // The number is read straight from the bytes. Running out of them means
+    // it may go on in the next chunk.
     NSUInteger numberStart = _stream.index;
-
-    unichar ch;
-    if (![_stream getUnichar:&ch])
-        return sbjson_token_eof;
+    const char *bytes = [_stream bytes];
+    NSUInteger length = [_stream length];
+    NSUInteger i = numberStart;
 
     BOOL isNegative = NO;
-    if (ch == '-') {
+    if (bytes[i] == '-') {
         isNegative = YES;
-        if (![_stream getNextUnichar:&ch])
+        if (++i >= length)
             return sbjson_token_eof;
     }
 
     unsigned long long mantissa = 0;
     int mantissa_length = 0;
+    int significant = 0;
     
-    if (ch == '0') {
+    if (bytes[i] == '0') {
         mantissa_length++;
-        if (![_stream getNextUnichar:&ch])
+        if (++i >= length)
             return sbjson_token_eof;
 
-        if ([kDecimalDigitCharacterSet characterIsMember:ch]) {
+        if (bytes[i] >= '0' && bytes[i] <= '9') {
             self.error = @"Leading zero is illegal in number";
             return sbjson_token_error;
         }
     }
 
-    while ([kDecimalDigitCharacterSet characterIsMember:ch]) {
+    while (bytes[i] >= '0' && bytes[i] <= '9') {
         mantissa *= 10;
-        mantissa += (ch - '0');
+        mantissa += (bytes[i] - '0');
         mantissa_length++;
+        if (significant || bytes[i] != '0')
+            significant++;
 
-        if (![_stream getNextUnichar:&ch])
+        if (++i >= length)
             return sbjson_token_eof;
     }
 
     short exponent = 0;
     BOOL isFloat = NO;
 
-    if (ch == '.') {
+    if (bytes[i] == '.') {
         isFloat = YES;
-        if (![_stream getNextUnichar:&ch])
+        if (++i >= length)
             return sbjson_token_eof;
 
-        while ([kDecimalDigitCharacterSet characterIsMember:ch]) {
+        while (bytes[i] >= '0' && bytes[i] <= '9') {
             mantissa *= 10;
-            mantissa += (ch - '0');
+            mantissa += (bytes[i] - '0');
             mantissa_length++;
+            if (significant || bytes[i] != '0')
+                significant++;
             exponent--;
 
-            if (![_stream getNextUnichar:&ch])
+            if (++i >= length)
                 return sbjson_token_eof;
         }
 
@@ -316,31 +442,31 @@ static NSCharacterSet *kDecimalDigitCharacterSet;
     }
 
     BOOL hasExponent = NO;
-    if (ch == 'e' || ch == 'E') {
+    if (bytes[i] == 'e' || bytes[i] == 'E') {
         hasExponent = YES;
 
-        if (![_stream getNextUnichar:&ch])
+        if (++i >= length)
             return sbjson_token_eof;
 
         BOOL expIsNegative = NO;
-        if (ch == '-') {
+        if (bytes[i] == '-') {
             expIsNegative = YES;
-            if (![_stream getNextUnichar:&ch])
+            if (++i >= length)
                 return sbjson_token_eof;
 
-        } else if (ch == '+') {
-            if (![_stream getNextUnichar:&ch])
+        } else if (bytes[i] == '+') {
+            if (++i >= length)
                 return sbjson_token_eof;
         }
 
         short explicit_exponent = 0;
         short explicit_exponent_length = 0;
-        while ([kDecimalDigitCharacterSet characterIsMember:ch]) {
+        while (bytes[i] >= '0' && bytes[i] <= '9') {
             explicit_exponent *= 10;
-            explicit_exponent += (ch - '0');
+            explicit_exponent += (bytes[i] - '0');
             explicit_exponent_length++;
 
-            if (![_stream getNextUnichar:&ch])
+            if (++i >= length)
                 return sbjson_token_eof;
         }
 
@@ -368,11 +494,24 @@ static NSCharacterSet *kDecimalDigitCharacterSet;
         return sbjson_token_error;
     }
 
+    _stream.index = i;
+
     if (mantissa_length <= LONG_LONG_DIGITS) {
+        double value;
         if (!isFloat && !hasExponent) {
-            *token = [NSNumber numberWithLongLong: isNegative ? -mantissa : mantissa];
+            if (!isNegative && mantissa < SBJSON_SMALL_INTEGERS)
+                *token = kSmallIntegers[mantissa];
+            else if (mantissa <= LLONG_MAX || (isNegative && mantissa == (unsigned long long)LLONG_MAX + 1))
+                *token = [NSNumber numberWithLongLong: isNegative ? -mantissa : mantissa];
+            else
+                *token = [NSDecimalNumber decimalNumberWithMantissa:mantissa
+                                                           exponent:0
+                                                         isNegative:isNegative];
         } else if (mantissa == 0) {
-            *token = [NSNumber numberWithFloat:-0.0f];
+            *token = [NSNumber numberWithDouble:isNegative ? -0.0 : 0.0];
+        } else if (SBJsonDoubleForNumber(bytes + numberStart, i - numberStart, isNegative,
+                                         mantissa, exponent, significant, &value)) {
+            *token = [NSNumber numberWithDouble:value];
         } else {
             *token = [NSDecimalNumber decimalNumberWithMantissa:mantissa
                                                        exponent:exponent
@@ -380,7 +519,7 @@ static NSCharacterSet *kDecimalDigitCharacterSet;
         }
 
     } else {
-        NSString *number = [_stream stringWithRange:NSMakeRange(numberStart, _stream.index - numberStart)];
+        NSString *number = [_stream stringWithRange:NSMakeRange(numberStart, i - numberStart)];
         *token = [NSDecimalNumber decimalNumberWithString:number];
 
     }
@@ -389,6 +528,10 @@ static NSCharacterSet *kDecimalDigitCharacterSet;
 }
 
 - (sbjson_token_t)getToken:(NSObject **)token {
+    return [self getToken:token range:NULL];
+}
+
+- (sbjson_token_t)getToken:(NSObject **)token range:(NSRange *)range {
 
     [_stream skipWhitespace];
 
@@ -443,7 +586,7 @@ static NSCharacterSet *kDecimalDigitCharacterSet;
             break;
 
         case '"':
-            tok = [self getStringToken:token];
+            tok = [self getStringToken:token range:range];
             break;
 
         case '0' ... '9':
@@ -31,12 +31,18 @@
 
 #import <Foundation/Foundation.h>
 
+struct SBJsonBlock;
 
 @interface SBJsonUTF8Stream : NSObject {
 @private
     const char *_bytes;
     NSMutableData *_data;
     NSUInteger _length;
+    struct SBJsonBlock *_blocks;
+    NSUInteger _blockCapacity;
+    NSUInteger _indexed;
+    NSUInteger _fragmentStart;
+    NSUInteger _fragmentEnd;
 }
 
 @property (assign) NSUInteger index;
@@ -52,7 +58,10 @@
 - (BOOL)getUnichar:(unichar*)ch;
 - (BOOL)getNextUnichar:(unichar*)ch;
 - (BOOL)getStringFragment:(NSString**)string;
+- (BOOL)getStringFragmentRange:(NSRange*)range;
 
 - (NSString*)stringWithRange:(NSRange)range;
+- (const char*)bytes;
+- (NSUInteger)length;
 
 @end
@@ -35,6 +35,105 @@
 
 #import "SBJsonUTF8Stream.h"
 
+// The stream keeps an index of the data it holds, a block of 64 bytes at a
+// time: a bit for each byte that isn't whitespace, and one for each byte that
+// ends a string fragment. Skipping whitespace and scanning strings jump from
+// one set bit to the next instead of looking at every byte. The bytes after
+// the last whole block are classified a vector at a time until more data
+// arrives, and the last few one by one.
+
+struct SBJsonBlock {
+    uint64_t nonspace;      // anything but ' ', '\t', '\r' and '\n'
+    uint64_t stringEnds;    // '"', '\\' and the control characters
+};
+typedef struct SBJsonBlock SBJsonBlock;
+
+static NSUInteger const SBJsonBlockSize = 64;
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SBJSON_VECTOR_SIZE 32
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define SBJSON_VECTOR_SIZE 16
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SBJSON_VECTOR_SIZE 16
+#else
+#define SBJSON_VECTOR_SIZE 16
+#endif
+
+// Classify SBJSON_VECTOR_SIZE bytes: a bit for each byte that isn't
+// whitespace, and one for each that ends a string fragment.
+static inline void SBJsonClassify(const unsigned char *bytes, uint32_t *nonspace, uint32_t *stringEnds) {
+#if defined(__AVX2__)
+    __m256i v = _mm256_loadu_si256((const __m256i *)bytes);
+    __m256i space = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')),
+                                                     _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t'))),
+                                    _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r')),
+                                                    _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n'))));
+    __m256i control = _mm256_cmpeq_epi8(_mm256_max_epu8(v, _mm256_set1_epi8(0x1f)), _mm256_set1_epi8(0x1f));
+    __m256i ends = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('"')),
+                                                   _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\'))),
+                                   control);
+    *nonspace = ~(uint32_t)_mm256_movemask_epi8(space);
+    *stringEnds = (uint32_t)_mm256_movemask_epi8(ends);
+#elif defined(__SSE2__)
+    __m128i v = _mm_loadu_si128((const __m128i *)bytes);
+    __m128i space = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+                                              _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))),
+                                 _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\r')),
+                                              _mm_cmpeq_epi8(v, _mm_set1_epi8('\n'))));
+    __m128i control = _mm_cmpeq_epi8(_mm_max_epu8(v, _mm_set1_epi8(0x1f)), _mm_set1_epi8(0x1f));
+    __m128i ends = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('"')),
+                                             _mm_cmpeq_epi8(v, _mm_set1_epi8('\\'))),
+                                control);
+    *nonspace = ~(uint32_t)_mm_movemask_epi8(space) & 0xffff;
+    *stringEnds = (uint32_t)_mm_movemask_epi8(ends);
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    static const uint8_t weights[16] = { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+    uint8x16_t v = vld1q_u8(bytes);
+    uint8x16_t space = vorrq_u8(vorrq_u8(vceqq_u8(v, vdupq_n_u8(' ')), vceqq_u8(v, vdupq_n_u8('\t'))),
+                                vorrq_u8(vceqq_u8(v, vdupq_n_u8('\r')), vceqq_u8(v, vdupq_n_u8('\n'))));
+    uint8x16_t ends = vorrq_u8(vorrq_u8(vceqq_u8(v, vdupq_n_u8('"')), vceqq_u8(v, vdupq_n_u8('\\'))),
+                               vcleq_u8(v, vdupq_n_u8(0x1f)));
+    // NEON has no movemask: keep a bit per lane and add the lanes up pairwise
+    uint8x16_t w = vld1q_u8(weights);
+    uint8x16_t s = vandq_u8(vmvnq_u8(space), w);
+    uint8x16_t e = vandq_u8(ends, w);
+    uint8x8_t sum = vpadd_u8(vpadd_u8(vget_low_u8(s), vget_high_u8(s)), vpadd_u8(vget_low_u8(e), vget_high_u8(e)));
+    sum = vpadd_u8(sum, sum);
+    *nonspace = vget_lane_u16(vreinterpret_u16_u8(sum), 0);
+    *stringEnds = vget_lane_u16(vreinterpret_u16_u8(sum), 1);
+#else
+    uint32_t space = 0, ends = 0;
+    for (int i = 0; i < SBJSON_VECTOR_SIZE; i++) {
+        switch (bytes[i]) {
+            case ' ':
+            case '\t':
+            case '\r':
+            case '\n':
+                space |= 1u << i;
+                break;
+        }
+        if (bytes[i] == '"' || bytes[i] == '\\' || bytes[i] < 0x20)
+            ends |= 1u << i;
+    }
+    *nonspace = ~space & 0xffff;
+    *stringEnds = ends;
+#endif
+}
+
+static void SBJsonIndexBlock(const unsigned char *bytes, SBJsonBlock *block) {
+    block->nonspace = block->stringEnds = 0;
+    for (NSUInteger i = 0; i < SBJsonBlockSize; i += SBJSON_VECTOR_SIZE) {
+        uint32_t nonspace, stringEnds;
+        SBJsonClassify(bytes + i, &nonspace, &stringEnds);
+        block->nonspace |= (uint64_t)nonspace << i;
+        block->stringEnds |= (uint64_t)stringEnds << i;
+    }
+}
+
 
 @implementation SBJsonUTF8Stream
 
@@ -44,19 +143,38 @@
     self = [super init];
     if (self) {
         _data = [[NSMutableData alloc] initWithCapacity:4096u];
+        _fragmentStart = NSNotFound;
     }
     return self;
 }
 
 
+- (void)dealloc {
+    free(_blocks);
+}
+
+
 - (void)appendData:(NSData *)data_ {
     
-    if (_index) {
-        // Discard data we've already parsed
-		[_data replaceBytesInRange:NSMakeRange(0, _index) withBytes:"" length:0];
+    if (_index >= SBJsonBlockSize && _index >= _length / 2) {
+        // Discard the whole blocks we've already parsed, with their index,
+        // once they are half the data: what is moved is never more than
+        // what was parsed, so small chunks don't move a long tail each time
+        NSUInteger discard = _index - _index % SBJsonBlockSize;
+		[_data replaceBytesInRange:NSMakeRange(0, discard) withBytes:"" length:0];
+        memmove(_blocks, _blocks + discard / SBJsonBlockSize,
+                (_indexed - discard) / SBJsonBlockSize * sizeof(SBJsonBlock));
+        _indexed -= discard;
         
         // Reset index to point to current position
-		_index = 0;
+		_index -= discard;
+
+        if (_fragmentStart != NSNotFound && _fragmentStart >= discard) {
+            _fragmentStart -= discard;
+            _fragmentEnd -= discard;
+        } else {
+            _fragmentStart = NSNotFound;
+        }
 	}
     
     [_data appendData:data_];
@@ -64,6 +182,25 @@
     // This is an optimisation. 
     _bytes = (const char*)[_data bytes];
     _length = [_data length];
+
+    [self indexBlocks];
+}
+
+
+- (void)indexBlocks {
+    NSUInteger count = _length / SBJsonBlockSize;
+    if (count > _blockCapacity) {
+        NSUInteger capacity = MAX(count, _blockCapacity * 2);
+        SBJsonBlock *blocks = realloc(_blocks, capacity * sizeof(SBJsonBlock));
+        if (!blocks)
+            return; // Look at the new bytes one by one
+        _blocks = blocks;
+        _blockCapacity = capacity;
+    }
+
+    for (NSUInteger i = _indexed / SBJsonBlockSize; i < count; i++)
+        SBJsonIndexBlock((const unsigned char *)_bytes + i * SBJsonBlockSize, _blocks + i);
+    _indexed = count * SBJsonBlockSize;
 }
 
 
@@ -84,15 +221,46 @@
 }
 
 - (BOOL)getStringFragment:(NSString **)string {
+    NSRange range;
+    if (![self getStringFragmentRange:&range])
+        return NO;
+    *string = [self stringWithRange:range];
+    return YES;
+}
+
+- (BOOL)getStringFragmentRange:(NSRange *)range {
     NSUInteger start = _index;
+
+    // A string cut by the end of a chunk is scanned again from its start
+    // when more data comes: carry on from where the last scan stopped
+    if (start == _fragmentStart)
+        _index = _fragmentEnd;
+
+    while (_index < _indexed) {
+        uint64_t ends = _blocks[_index / SBJsonBlockSize].stringEnds >> (_index % SBJsonBlockSize);
+        if (ends) {
+            _index += __builtin_ctzll(ends);
+            *range = NSMakeRange(start, _index - start);
+            return YES;
+        }
+        _index += SBJsonBlockSize - _index % SBJsonBlockSize;
+    }
+    while (_index + SBJSON_VECTOR_SIZE <= _length) {
+        uint32_t nonspace, ends;
+        SBJsonClassify((const unsigned char *)_bytes + _index, &nonspace, &ends);
+        if (ends) {
+            _index += __builtin_ctz(ends);
+            *range = NSMakeRange(start, _index - start);
+            return YES;
+        }
+        _index += SBJSON_VECTOR_SIZE;
+    }
     while (_index < _length) {
         switch (_bytes[_index]) {
             case '"':
             case '\\':
             case 0 ... 0x1f:
-                *string = [[NSString alloc] initWithBytes:(_bytes + start)
-                                                   length:(_index - start)
-                                                 encoding:NSUTF8StringEncoding];
+                *range = NSMakeRange(start, _index - start);
                 return YES;
                 break;
             default:
@@ -100,6 +268,8 @@
                 break;
         }
     }
+    _fragmentStart = start;
+    _fragmentEnd = _index;
     return NO;
 }
 
@@ -108,6 +278,23 @@
 }
 
 - (void)skipWhitespace {
+    while (_index < _indexed) {
+        uint64_t nonspace = _blocks[_index / SBJsonBlockSize].nonspace >> (_index % SBJsonBlockSize);
+        if (nonspace) {
+            _index += __builtin_ctzll(nonspace);
+            return;
+        }
+        _index += SBJsonBlockSize - _index % SBJsonBlockSize;
+    }
+    while (_index + SBJSON_VECTOR_SIZE <= _length) {
+        uint32_t nonspace, ends;
+        SBJsonClassify((const unsigned char *)_bytes + _index, &nonspace, &ends);
+        if (nonspace) {
+            _index += __builtin_ctz(nonspace);
+            return;
+        }
+        _index += SBJSON_VECTOR_SIZE;
+    }
     while (_index < _length) {
         switch (_bytes[_index]) {
             case ' ':
@@ -141,5 +328,13 @@
     
 }
 
+- (const char*)bytes {
+    return _bytes;
+}
+
+- (NSUInteger)length {
+    return _length;
+}
+
 
 @end
@@ -18,6 +18,23 @@
  total number of files in the archive is called after each file is processed.
  */
 typedef void(^ZipArchiveProgressUpdateBlock)(int percentage, int filesProcessed, unsigned long numFiles);
+
+/**
+ a block that is called on the main queue when CreateZipFile2Async:files:newnames:completion: is done,
+ with YES if the zip file was created with all the files.
+ */
+typedef void(^ZipArchiveCompletionBlock)(BOOL success);
+
+/**
+ how hard files are deflated, the level and strategy being picked for each file
+ from the kind of data its extension tells (text logs, recordings, images)
+ */
+typedef enum
+{
+	ZipArchiveCompressionBalanced = 0,  // close to the smallest size, at a good speed
+	ZipArchiveCompressionFast,          // the fastest, for a larger archive
+	ZipArchiveCompressionSmall          // the smallest archive, however long it takes
+} ZipArchiveCompressionProfile;
 	
 /**
     @protocol
@@ -67,6 +84,11 @@ typedef void(^ZipArchiveProgressUpdateBlock)(int percentage, int filesProcessed,
 @private
 	void*           _zipFile;
 	void*           _unzFile;
+	void*           _zipBuffer;     // memory buffer of a zip file created in memory
+	NSOutputStream* _zipStream;     // stream a zip file is written to by CreateZipStream:
+	void*           _unzBuffer;     // memory buffer of a zip file opened from NSData
+	NSData*         _unzData;
+	NSString*       _unzPath;
 	
     unsigned long   _numFiles;
 	NSString*       _password;
@@ -77,6 +99,11 @@ typedef void(^ZipArchiveProgressUpdateBlock)(int percentage, int filesProcessed,
     
     NSFileManager* _fileManager;
     NSStringEncoding _stringEncoding;
+    NSUInteger      _bufferSize;
+    ZipArchiveCompressionProfile _compressionProfile;
+    
+    NSCondition*    _asyncCondition;    // while CreateZipFile2Async: is running
+    BOOL            _asyncCancelled;
 }
 
 /** a delegate object conforming to ZipArchiveDelegate protocol */
@@ -89,6 +116,17 @@ typedef void(^ZipArchiveProgressUpdateBlock)(int percentage, int filesProcessed,
 */
 @property (nonatomic, assign) NSStringEncoding stringEncoding;
 
+/**
+    @brief      Size of the buffers files are read and written in, 256 KB by default.
+    Takes effect on the zip files created or opened afterwards.
+*/
+@property (nonatomic, assign) NSUInteger bufferSize;
+
+/**
+    @brief      How hard the files added are deflated, ZipArchiveCompressionBalanced by default.
+*/
+@property (nonatomic, assign) ZipArchiveCompressionProfile compressionProfile;
+
 /** an array of files that were successfully expanded. Available after calling UnzipFileTo:overWrite: */
 @property (nonatomic, readonly) NSArray* unzippedFiles;
 
@@ -97,11 +135,31 @@ typedef void(^ZipArchiveProgressUpdateBlock)(int percentage, int filesProcessed,
 -(BOOL) CreateZipFile2:(NSString*) zipFile;
 -(BOOL) CreateZipFile2:(NSString*) zipFile Password:(NSString*) password;
 -(BOOL) addFileToZip:(NSString*) file newname:(NSString*) newname;
+-(BOOL) addFilesToZip:(NSArray*) files newnames:(NSArray*) newnames;
 -(BOOL) CloseZipFile2;
 
+-(void) CreateZipFile2Async:(NSString*) zipFile files:(NSArray*) files newnames:(NSArray*) newnames completion:(ZipArchiveCompletionBlock) completion;
+-(void) CreateZipFile2Async:(NSString*) zipFile files:(NSArray*) files newnames:(NSArray*) newnames Password:(NSString*) password completion:(ZipArchiveCompletionBlock) completion;
+-(void) CancelAsync;
+
+-(BOOL) SyncZipFile2:(NSString*) zipFile files:(NSArray*) files newnames:(NSArray*) newnames;
+-(BOOL) SyncZipFile2:(NSString*) zipFile files:(NSArray*) files newnames:(NSArray*) newnames Password:(NSString*) password;
+
+-(BOOL) CreateZipInMemory;
+-(BOOL) CreateZipInMemoryWithPassword:(NSString*) password;
+-(BOOL) addDataToZip:(NSData*) data newname:(NSString*) newname;
+-(NSData*) CloseZipInMemory;
+
+-(BOOL) CreateZipStream:(NSOutputStream*) stream;
+-(BOOL) CreateZipStream:(NSOutputStream*) stream Password:(NSString*) password;
+
 -(BOOL) UnzipOpenFile:(NSString*) zipFile;
 -(BOOL) UnzipOpenFile:(NSString*) zipFile Password:(NSString*) password;
+-(BOOL) UnzipOpenData:(NSData*) zipData;
+-(BOOL) UnzipOpenData:(NSData*) zipData Password:(NSString*) password;
 -(BOOL) UnzipFileTo:(NSString*) path overWrite:(BOOL) overwrite;
+-(BOOL) UnzipFileTo:(NSString*) path overWrite:(BOOL) overwrite parallel:(BOOL) parallel;
+-(BOOL) UnzipVerify;
 -(BOOL) UnzipCloseFile;
 -(NSArray*) getZipFileContents;     // list the contents of the zip archive. must be called after UnzipOpenFile
 
@@ -13,6 +13,10 @@
 #import "zconf.h"
 #include "minizip/zip.h"
 #include "minizip/unzip.h"
+#include "minizip/unzpool.h"
+#include "minizip/fastcrc.h"
+#include "minizip/zipaes.h"
+#include "minizip/mztools.h"
 
 
 @interface NSFileManager(ZipArchive)
@@ -24,11 +28,104 @@
 -(void) OutputErrorMessage:(NSString*) msg;
 -(BOOL) OverWrite:(NSString*) file;
 -(NSDate*) Date1980;
+-(uLong) ZipDateForFile:(NSString*) file;
++(unzPool) UnzPool;
+-(void*) OpenUnzFile;
+-(int) CloseUnzFile:(void*) file;
+-(BOOL) CopyCurrentFileOf:(void*) file;
+-(int) UnzipCurrentFileOf:(void*) file toPath:(NSString*) fullPath date:(uLong) dosDate since:(NSDate*) date1980
+				  password:(const char*) password buffer:(unsigned char*) buffer;
 
 @property (nonatomic,copy) NSString* password;
 @end
 
 
+/**
+ * an entry of addFilesToZip:newnames: that is deflated on a worker queue
+ * into its own buffer, waiting to be written raw into the archive.
+ */
+typedef struct
+{
+	char*       path;
+	Bytef*      data;
+	uLong       size;
+	uLong       crc;
+	ZPOS64_T    uncompressedSize;
+	int         method;     // Z_DEFLATED, or 0 when the file is stored as it is
+	int         level;
+	int         strategy;
+	int         err;
+	int         done;
+} ZipArchiveDeflatedEntry;
+
+static int ZipArchiveDeflateFile( ZipArchiveDeflatedEntry* entry );
+static void ZipArchiveDeflateSettings( ZipArchiveCompressionProfile profile, NSString* name, int* level, int* strategy );
+static int ZipArchiveSampleCompresses( const Bytef* sample, uLong len );
+static int ZipArchiveFileCompresses( zlib_filefunc64_def* fileFunc, voidpf stream, ZPOS64_T fileSize );
+
+/**
+ * a piece of a file going through the stages of CreateZipFile2Async:, read
+ * from the file, then deflated (or passed on as it is when stored), then
+ * written to the archive.
+ */
+typedef struct ZipArchiveChunk
+{
+	struct ZipArchiveChunk* next;
+	NSUInteger  index;              // of the file in files
+	Bytef*      data;
+	uLong       size;
+	int         first;              // the first chunk of its file
+	int         last;               // the last chunk of its file
+	int         method;             // Z_DEFLATED, or 0 when the file is stored as it is
+	int         level;
+	int         strategy;
+	ZPOS64_T    fileSize;           // set in the first chunk
+	uLong       crc;                // set in the last chunk once deflated
+	ZPOS64_T    uncompressedSize;   // set in the last chunk once deflated
+} ZipArchiveChunk;
+
+/**
+ * the chunks waiting between two stages of CreateZipFile2Async:
+ */
+typedef struct
+{
+	ZipArchiveChunk*    head;
+	ZipArchiveChunk*    tail;
+	NSUInteger          count;
+} ZipArchiveChunkQueue;
+
+static ZipArchiveChunk* ZipArchiveNewChunk( NSUInteger index, uLong capacity );
+static void ZipArchiveFreeChunk( ZipArchiveChunk* chunk );
+static void ZipArchivePushChunk( ZipArchiveChunkQueue* queue, ZipArchiveChunk* chunk );
+static ZipArchiveChunk* ZipArchivePopChunk( ZipArchiveChunkQueue* queue );
+
+static void ZipArchiveFillStreamFunc( zlib_filefunc64_def* fileFunc, NSOutputStream* stream );
+
+// default size of the chunks files are read and written in
+#define ZIPARCHIVE_BUFSIZE (256*1024)
+
+// archives kept opened in the shared pool while no ZipArchive uses them
+#define ZIPARCHIVE_POOLSIZE 4
+
+// chunks each stage of CreateZipFile2Async: may be ahead of the next
+#define ZIPARCHIVE_PIPELINE_DEPTH 4
+
+// size of the sample deflated to tell whether a file is worth deflating,
+// and the percentage of it deflating must save for the file to be deflated.
+#define ZIPARCHIVE_SAMPLESIZE   (4096)
+#define ZIPARCHIVE_MINSAVING    (10)
+
+/**
+ * a file of the archive to be expanded by UnzipFileTo:overWrite:parallel:
+ */
+typedef struct
+{
+	unz64_file_pos  pos;
+	uLong           dosDate;
+	int             extract;    // 0 for directories, and files the delegate chose not to overwrite
+	int             result;     // UNZ_OK once expanded
+} ZipArchiveUnzipEntry;
+
 
 @implementation ZipArchive
 @synthesize delegate = _delegate;
@@ -37,6 +134,8 @@
 @synthesize unzippedFiles = _unzippedFiles;
 @synthesize progressBlock = _progressBlock;
 @synthesize stringEncoding = _stringEncoding;
+@synthesize bufferSize = _bufferSize;
+@synthesize compressionProfile = _compressionProfile;
 
 -(id) init
 {
@@ -50,10 +149,16 @@
 		_zipFile = NULL;
         _fileManager = fileManager;
         self.stringEncoding = NSUTF8StringEncoding;
+        _bufferSize = ZIPARCHIVE_BUFSIZE;
 	}
 	return self;
 }
 
+-(void) setBufferSize:(NSUInteger) bufferSize
+{
+	_bufferSize = bufferSize ? bufferSize : ZIPARCHIVE_BUFSIZE;
+}
+
 -(void) dealloc
 {
     // close any open file operations
@@ -75,6 +180,7 @@
 	_zipFile = zipOpen( (const char*)[zipFile UTF8String], 0 );
 	if( !_zipFile ) 
 		return NO;
+	zipSetBufferSize( _zipFile, _bufferSize );
 	return YES;
 }
 
@@ -82,7 +188,7 @@
  * Create a new zip file at the specified path, ready for new files to be added.
  *
  * @param zipFile     the path of the zip file to create
- * @param password    a password used to encrypt the zip file
+ * @param password    a password used to encrypt the files added, with AES-256
  * @returns BOOL YES on success
  */
 
@@ -104,75 +210,751 @@
 {
 	if( !_zipFile )
 		return NO;
-//	tm_zip filetime;
-	time_t current;
-	time( &current );
-	
 	zip_fileinfo zipInfo = {{0}};
-	zipInfo.dosDate = (unsigned long) current;
+	zipInfo.dosDate = [self ZipDateForFile:file];
 	
-    NSError* error = nil;
-	NSDictionary* attr = [_fileManager _attributesOfItemAtPath:file followingSymLinks:YES error:&error];
-	if( attr )
+	// the file is read in chunks through the same I/O layer minizip uses.
+	zlib_filefunc64_def fileFunc;
+	fill_fopen64_filefunc( &fileFunc );
+	voidpf stream = fileFunc.zopen64_file( fileFunc.opaque, [file fileSystemRepresentation],
+										  ZLIB_FILEFUNC_MODE_READ | ZLIB_FILEFUNC_MODE_EXISTING );
+	if( stream==NULL )
+		return NO;
+	ZPOS64_T fileSize = 0;
+	if( fileFunc.zseek64_file( fileFunc.opaque, stream, 0, ZLIB_FILEFUNC_SEEK_END )==0 )
+		fileSize = fileFunc.ztell64_file( fileFunc.opaque, stream );
+	fileFunc.zseek64_file( fileFunc.opaque, stream, 0, ZLIB_FILEFUNC_SEEK_SET );
+	
+	// files that barely deflate, like recordings, are stored as they are.
+	int method = ZipArchiveFileCompresses( &fileFunc, stream, fileSize ) ? Z_DEFLATED : 0;
+	int level, strategy;
+	ZipArchiveDeflateSettings( _compressionProfile, newname, &level, &strategy );
+	
+	// with a password the file is encrypted with AES-256, which doesn't need the crc
+	// before the data as the traditional encryption header did.
+	const char* password = [_password length]==0 ? NULL : [_password cStringUsingEncoding:NSASCIIStringEncoding];
+	int ret = zipOpenNewFileInZip5( _zipFile,
+									  (const char*) [newname cStringUsingEncoding:self.stringEncoding],
+									  &zipInfo,
+									  NULL,0,
+									  NULL,0,
+									  NULL,//comment
+									  method,
+									  method ? level : 0,
+									  0,
+									  15,
+									  8,
+									  strategy,
+									  password,
+									  0,
+									  0,
+									  0,
+									  fileSize>=0xffffffff,
+									  password ? ZIPAES_256 : 0 );
+	
+	unsigned char* buffer = (unsigned char*) malloc( _bufferSize );
+	if( buffer==NULL )
+		ret = ZIP_INTERNALERROR;
+	while( ret==ZIP_OK )
 	{
-		NSDate* fileDate = (NSDate*)[attr objectForKey:NSFileModificationDate];
-		if( fileDate )
+		uLong len = fileFunc.zread_file( fileFunc.opaque, stream, buffer, _bufferSize );
+		if( len==0 )
 		{
-			zipInfo.dosDate = [fileDate timeIntervalSinceDate:[self Date1980] ];
+			if( fileFunc.zerror_file( fileFunc.opaque, stream ) )
+				ret = ZIP_ERRNO;
+			break;
 		}
+		ret = zipWriteInFileInZip( _zipFile, buffer, (unsigned int)len );
 	}
+	free( buffer );
+	fileFunc.zclose_file( fileFunc.opaque, stream );
 	
-	int ret ;
-	NSData* data = nil;
-	if( [_password length] == 0 )
+	if( ret!=ZIP_OK )
 	{
-		ret = zipOpenNewFileInZip( _zipFile,
-								  (const char*) [newname cStringUsingEncoding:self.stringEncoding],
-								  &zipInfo,
-								  NULL,0,
-								  NULL,0,
-								  NULL,//comment
-								  Z_DEFLATED,
-								  Z_DEFAULT_COMPRESSION );
+		return NO;
 	}
-	else
+	ret = zipCloseFileInZip( _zipFile );
+	if( ret!=Z_OK )
+		return NO;
+	return YES;
+}
+
+/**
+ * add several existing files on disk to the zip archive, compressing them concurrently.
+ *
+ * Each file is deflated on a background queue into its own buffer, so the work is
+ * spread over all processors. Only writing the headers and the compressed bytes to
+ * the archive is done on the calling thread, in the order given. At most two entries
+ * per processor are held in memory at any time.
+ *
+ * @param files    an array of paths to the files to compress
+ * @param newnames an array of names of the files in the zip archive, in the same order as files.
+ * @returns BOOL YES on success
+ */
+
+-(BOOL) addFilesToZip:(NSArray*) files newnames:(NSArray*) newnames
+{
+	if( !_zipFile || [files count]!=[newnames count] )
+		return NO;
+	NSUInteger count = [files count];
+	if( count==0 )
+		return YES;
+	
+	ZipArchiveDeflatedEntry* entries = (ZipArchiveDeflatedEntry*) calloc( count, sizeof(ZipArchiveDeflatedEntry) );
+	if( entries==NULL )
+		return NO;
+	for( NSUInteger i=0; i<count; i++ )
 	{
-		data = [ NSData dataWithContentsOfFile:file];
-		uLong crcValue = crc32( 0L,NULL, 0L );
-		crcValue = crc32( crcValue, (const Bytef*)[data bytes], (unsigned int)[data length] );
-		ret = zipOpenNewFileInZip3( _zipFile,
-								  (const char*) [newname cStringUsingEncoding:self.stringEncoding],
-								  &zipInfo,
-								  NULL,0,
-								  NULL,0,
-								  NULL,//comment
-								  Z_DEFLATED,
-								  Z_DEFAULT_COMPRESSION,
-								  0,
-								  15,
-								  8,
-								  Z_DEFAULT_STRATEGY,
-								  [_password cStringUsingEncoding:NSASCIIStringEncoding],
-								  crcValue );
+		entries[i].path = strdup( [[files objectAtIndex:i] fileSystemRepresentation] );
+		if( entries[i].path==NULL )
+		{
+			while( i>0 )
+				free( entries[--i].path );
+			free( entries );
+			return NO;
+		}
+		ZipArchiveDeflateSettings( _compressionProfile, [newnames objectAtIndex:i], &entries[i].level, &entries[i].strategy );
 	}
-	if( ret!=Z_OK )
+	
+	// entries are compressed in order, no further ahead of the writer than the window.
+	NSUInteger window = 2*[[NSProcessInfo processInfo] activeProcessorCount];
+	NSCondition* condition = [[NSCondition alloc] init];
+	__block NSUInteger written = 0;
+	__block BOOL cancelled = NO;
+	dispatch_queue_t queue = dispatch_get_global_queue( DISPATCH_QUEUE_PRIORITY_DEFAULT, 0 );
+	
+	dispatch_async( queue, ^{
+		for( NSUInteger i=0; i<count; i++ )
+		{
+			[condition lock];
+			while( i>=written+window )
+				[condition wait];
+			[condition unlock];
+			
+			dispatch_async( queue, ^{
+				ZipArchiveDeflatedEntry* entry = &entries[i];
+				[condition lock];
+				BOOL skip = cancelled;
+				[condition unlock];
+				if( !skip )
+					entry->err = ZipArchiveDeflateFile( entry );
+				[condition lock];
+				entry->done = 1;
+				[condition broadcast];
+				[condition unlock];
+			});
+		}
+	});
+	
+	const char* password = [_password length]==0 ? NULL : [_password cStringUsingEncoding:NSASCIIStringEncoding];
+	BOOL success = YES;
+	for( NSUInteger i=0; i<count; i++ )
+	{
+		ZipArchiveDeflatedEntry* entry = &entries[i];
+		[condition lock];
+		while( !entry->done )
+			[condition wait];
+		[condition unlock];
+		
+		if( success && entry->err!=Z_OK )
+		{
+			[self OutputErrorMessage:[NSString stringWithFormat:@"Failed to compress %@", [files objectAtIndex:i]]];
+			success = NO;
+		}
+		if( success )
+		{
+			// the data is already deflated (or stored), so it is written raw with the crc we computed.
+			zip_fileinfo zipInfo = {{0}};
+			zipInfo.dosDate = [self ZipDateForFile:[files objectAtIndex:i]];
+			int ret = zipOpenNewFileInZip5( _zipFile,
+											  (const char*) [[newnames objectAtIndex:i] cStringUsingEncoding:self.stringEncoding],
+											  &zipInfo,
+											  NULL,0,
+											  NULL,0,
+											  NULL,//comment
+											  entry->method,
+											  entry->method ? entry->level : 0,
+											  1,
+											  15,
+											  8,
+											  entry->strategy,
+											  password,
+											  entry->crc,
+											  0,
+											  0,
+											  entry->uncompressedSize>=0xffffffff,
+											  password ? ZIPAES_256 : 0 );
+			uLong offset = 0;
+			while( ret==ZIP_OK && offset<entry->size )
+			{
+				unsigned int len = (unsigned int) MIN( entry->size-offset, 0x40000000 );
+				ret = zipWriteInFileInZip( _zipFile, entry->data+offset, len );
+				offset += len;
+			}
+			if( ret==ZIP_OK )
+				ret = zipCloseFileInZipRaw64( _zipFile, entry->uncompressedSize, entry->crc );
+			if( ret!=ZIP_OK )
+				success = NO;
+		}
+		free( entry->data );
+		free( entry->path );
+		
+		[condition lock];
+		written++;
+		if( !success )
+			cancelled = YES;
+		[condition broadcast];
+		[condition unlock];
+	}
+	
+	free( entries );
+	return success;
+}
+
+/**
+ * Create a zip file and add files to it in the background, then close it.
+ *
+ * The work is done in three stages running concurrently: reading the next chunk
+ * of a file, deflating the current one and writing the previous one to the
+ * archive. Each stage is at most ZIPARCHIVE_PIPELINE_DEPTH chunks ahead of the
+ * next, so memory stays bounded whatever the size of the files.
+ *
+ * progressBlock is called on the main queue after each file is written, and
+ * completion once the zip file is closed. A zip file that wasn't completed,
+ * because of an error or CancelAsync, is removed. No other method may be
+ * called until completion.
+ *
+ * @param zipFile     the path of the zip file to create
+ * @param files    an array of paths to the files to compress
+ * @param newnames an array of names of the files in the zip archive, in the same order as files.
+ * @param completion  a block called on the main queue with YES on success
+ */
+
+-(void) CreateZipFile2Async:(NSString*) zipFile files:(NSArray*) files newnames:(NSArray*) newnames completion:(ZipArchiveCompletionBlock) completion
+{
+	if( _asyncCondition || [files count]!=[newnames count] || ![self CreateZipFile2:zipFile] )
 	{
+		if( completion )
+			dispatch_async( dispatch_get_main_queue(), ^{ completion( NO ); } );
+		return;
+	}
+	
+	NSUInteger count = [files count];
+	NSUInteger bufferSize = _bufferSize;
+	ZipArchiveCompressionProfile profile = _compressionProfile;
+	NSCondition* condition = [[NSCondition alloc] init];
+	_asyncCondition = condition;
+	_asyncCancelled = NO;
+	__block ZipArchiveChunkQueue readQueue = {NULL, NULL, 0};
+	__block ZipArchiveChunkQueue deflatedQueue = {NULL, NULL, 0};
+	__block BOOL readerDone = NO;
+	__block BOOL deflaterDone = NO;
+	__block BOOL failed = NO;
+	dispatch_queue_t queue = dispatch_get_global_queue( DISPATCH_QUEUE_PRIORITY_DEFAULT, 0 );
+	
+	// read the files in chunks, deciding whether each is worth deflating from a sample.
+	dispatch_async( queue, ^{
+		zlib_filefunc64_def fileFunc;
+		fill_fopen64_filefunc( &fileFunc );
+		BOOL stop = NO;
+		for( NSUInteger i=0; i<count && !stop; i++ )
+		{
+			voidpf stream = fileFunc.zopen64_file( fileFunc.opaque, [[files objectAtIndex:i] fileSystemRepresentation],
+												  ZLIB_FILEFUNC_MODE_READ | ZLIB_FILEFUNC_MODE_EXISTING );
+			ZPOS64_T fileSize = 0;
+			int method = Z_DEFLATED;
+			int level, strategy;
+			ZipArchiveDeflateSettings( profile, [newnames objectAtIndex:i], &level, &strategy );
+			if( stream )
+			{
+				if( fileFunc.zseek64_file( fileFunc.opaque, stream, 0, ZLIB_FILEFUNC_SEEK_END )==0 )
+					fileSize = fileFunc.ztell64_file( fileFunc.opaque, stream );
+				fileFunc.zseek64_file( fileFunc.opaque, stream, 0, ZLIB_FILEFUNC_SEEK_SET );
+				method = ZipArchiveFileCompresses( &fileFunc, stream, fileSize ) ? Z_DEFLATED : 0;
+			}
+			
+			for( int first=1; !stop; first=0 )
+			{
+				ZipArchiveChunk* chunk = stream ? ZipArchiveNewChunk( i, bufferSize ) : NULL;
+				if( chunk )
+				{
+					chunk->size = fileFunc.zread_file( fileFunc.opaque, stream, chunk->data, bufferSize );
+					chunk->first = first;
+					chunk->last = chunk->size<bufferSize;
+					chunk->method = method;
+					chunk->level = level;
+					chunk->strategy = strategy;
+					chunk->fileSize = fileSize;
+					if( chunk->last && fileFunc.zerror_file( fileFunc.opaque, stream ) )
+					{
+						ZipArchiveFreeChunk( chunk );
+						chunk = NULL;
+					}
+				}
+				
+				[condition lock];
+				if( chunk==NULL )
+				{
+					failed = YES;
+					_asyncCancelled = YES;
+				}
+				while( readQueue.count>=ZIPARCHIVE_PIPELINE_DEPTH && !_asyncCancelled )
+					[condition wait];
+				stop = _asyncCancelled;
+				if( !stop )
+					ZipArchivePushChunk( &readQueue, chunk );
+				[condition broadcast];
+				[condition unlock];
+				
+				if( stop )
+					ZipArchiveFreeChunk( chunk );
+				else if( chunk->last )
+					break;
+			}
+			if( stream )
+				fileFunc.zclose_file( fileFunc.opaque, stream );
+		}
+		[condition lock];
+		readerDone = YES;
+		[condition broadcast];
+		[condition unlock];
+	});
+	
+	// deflate the chunks read into chunks of bufferSize, computing the crc of each file.
+	dispatch_async( queue, ^{
+		z_stream stream = {0};
+		BOOL initialised = NO;
+		BOOL first = NO;
+		uLong crc = 0;
+		ZPOS64_T uncompressedSize = 0;
+		ZipArchiveChunk* out = NULL;
+		for( ;; )
+		{
+			[condition lock];
+			while( readQueue.head==NULL && !readerDone && !_asyncCancelled )
+				[condition wait];
+			ZipArchiveChunk* in = _asyncCancelled ? NULL : ZipArchivePopChunk( &readQueue );
+			[condition broadcast];
+			[condition unlock];
+			if( in==NULL )
+				break;
+			
+			if( in->first )
+			{
+				crc = fastcrc32( 0L, NULL, 0L );
+				uncompressedSize = 0;
+				first = YES;
+			}
+			crc = fastcrc32( crc, in->data, (uInt)in->size );
+			uncompressedSize += in->size;
+			
+			ZipArchiveChunkQueue ready = {NULL, NULL, 0};
+			int err = Z_OK;
+			if( in->method==0 )
+			{
+				// stored: the chunk is passed on as it is.
+				in->crc = crc;
+				in->uncompressedSize = uncompressedSize;
+				ZipArchivePushChunk( &ready, in );
+				in = NULL;
+			}
+			else
+			{
+				if( !initialised )
+				{
+					err = deflateInit2( &stream, in->level, Z_DEFLATED, -MAX_WBITS, 8, in->strategy );
+					initialised = err==Z_OK;
+				}
+				else if( in->first )
+				{
+					err = deflateReset( &stream );
+					if( err==Z_OK )
+						err = deflateParams( &stream, in->level, in->strategy );
+				}
+				
+				int flush = in->last ? Z_FINISH : Z_NO_FLUSH;
+				stream.next_in = in->data;
+				stream.avail_in = (uInt)in->size;
+				while( err==Z_OK )
+				{
+					if( out==NULL )
+					{
+						out = ZipArchiveNewChunk( in->index, bufferSize );
+						if( out==NULL )
+						{
+							err = Z_MEM_ERROR;
+							break;
+						}
+						out->first = first;
+						out->method = Z_DEFLATED;
+						out->level = in->level;
+						out->fileSize = in->fileSize;
+						first = NO;
+					}
+					stream.next_out = out->data+out->size;
+					stream.avail_out = (uInt)(bufferSize-out->size);
+					int ret = deflate( &stream, flush );
+					out->size = bufferSize-stream.avail_out;
+					if( ret==Z_STREAM_END )
+					{
+						out->last = 1;
+						out->crc = crc;
+						out->uncompressedSize = uncompressedSize;
+					}
+					else if( ret!=Z_OK && ret!=Z_BUF_ERROR )
+						err = ret;
+					if( out->last || out->size==bufferSize )
+					{
+						ZipArchivePushChunk( &ready, out );
+						out = NULL;
+					}
+					if( ret==Z_STREAM_END || (stream.avail_in==0 && stream.avail_out>0 && flush!=Z_FINISH) )
+						break;
+				}
+				ZipArchiveFreeChunk( in );
+			}
+			
+			[condition lock];
+			if( err!=Z_OK )
+			{
+				failed = YES;
+				_asyncCancelled = YES;
+			}
+			while( ready.head && !_asyncCancelled )
+			{
+				while( deflatedQueue.count>=ZIPARCHIVE_PIPELINE_DEPTH && !_asyncCancelled )
+					[condition wait];
+				if( !_asyncCancelled )
+					ZipArchivePushChunk( &deflatedQueue, ZipArchivePopChunk( &ready ) );
+				[condition broadcast];
+			}
+			[condition unlock];
+			while( ready.head )
+				ZipArchiveFreeChunk( ZipArchivePopChunk( &ready ) );
+		}
+		if( initialised )
+			deflateEnd( &stream );
+		ZipArchiveFreeChunk( out );
+		[condition lock];
+		deflaterDone = YES;
+		[condition broadcast];
+		[condition unlock];
+	});
+	
+	// write the deflated chunks raw into the archive, with the crc computed.
+	const char* password = [_password length]==0 ? NULL : strdup( [_password cStringUsingEncoding:NSASCIIStringEncoding] );
+	dispatch_async( queue, ^{
+		NSUInteger written = 0;
+		int ret = ZIP_OK;
+		for( ;; )
+		{
+			[condition lock];
+			while( deflatedQueue.head==NULL && !deflaterDone && !_asyncCancelled )
+				[condition wait];
+			ZipArchiveChunk* chunk = _asyncCancelled ? NULL : ZipArchivePopChunk( &deflatedQueue );
+			[condition broadcast];
+			[condition unlock];
+			if( chunk==NULL )
+				break;
+			
+			@autoreleasepool {
+				if( chunk->first )
+				{
+					// with a password the file is encrypted with AES-256, so the crc isn't needed before the data.
+					zip_fileinfo zipInfo = {{0}};
+					zipInfo.dosDate = [self ZipDateForFile:[files objectAtIndex:chunk->index]];
+					ret = zipOpenNewFileInZip5( _zipFile,
+												  (const char*) [[newnames objectAtIndex:chunk->index] cStringUsingEncoding:self.stringEncoding],
+												  &zipInfo,
+												  NULL,0,
+												  NULL,0,
+												  NULL,//comment
+												  chunk->method,
+												  chunk->method ? chunk->level : 0,
+												  1,
+												  15,
+												  8,
+												  Z_DEFAULT_STRATEGY,
+												  password,
+												  0,
+												  0,
+												  0,
+												  chunk->fileSize>=0xffffffff,
+												  password ? ZIPAES_256 : 0 );
+				}
+				if( ret==ZIP_OK && chunk->size>0 )
+					ret = zipWriteInFileInZip( _zipFile, chunk->data, (unsigned int)chunk->size );
+				if( ret==ZIP_OK && chunk->last )
+				{
+					ret = zipCloseFileInZipRaw64( _zipFile, chunk->uncompressedSize, chunk->crc );
+					written++;
+					NSUInteger filesProcessed = written;
+					ZipArchiveProgressUpdateBlock progressBlock = _progressBlock;
+					if( ret==ZIP_OK && progressBlock )
+						dispatch_async( dispatch_get_main_queue(), ^{
+							progressBlock( (int)(filesProcessed*100/count), (int)filesProcessed, count );
+						});
+				}
+			}
+			ZipArchiveFreeChunk( chunk );
+			
+			if( ret!=ZIP_OK )
+			{
+				[condition lock];
+				failed = YES;
+				_asyncCancelled = YES;
+				[condition broadcast];
+				[condition unlock];
+			}
+		}
+		
+		// once the other stages are done, nothing else uses the queues.
+		[condition lock];
+		while( !readerDone || !deflaterDone )
+			[condition wait];
+		BOOL success = !failed && !_asyncCancelled && written==count;
+		[condition unlock];
+		while( readQueue.head )
+			ZipArchiveFreeChunk( ZipArchivePopChunk( &readQueue ) );
+		while( deflatedQueue.head )
+			ZipArchiveFreeChunk( ZipArchivePopChunk( &deflatedQueue ) );
+		free( (void*)password );
+		
+		if( zipClose( _zipFile, NULL )!=ZIP_OK )
+			success = NO;
+		_zipFile = NULL;
+		if( !success )
+			remove( [zipFile fileSystemRepresentation] );
+		
+		dispatch_async( dispatch_get_main_queue(), ^{
+			self.password = nil;
+			_asyncCondition = nil;
+			if( completion )
+				completion( success );
+		});
+	});
+}
+
+/**
+ * Create a zip file protected by a password and add files to it in the background,
+ * then close it. See CreateZipFile2Async:files:newnames:completion:.
+ *
+ * @param zipFile     the path of the zip file to create
+ * @param files    an array of paths to the files to compress
+ * @param newnames an array of names of the files in the zip archive, in the same order as files.
+ * @param password    a password used to encrypt the zip file
+ * @param completion  a block called on the main queue with YES on success
+ */
+
+-(void) CreateZipFile2Async:(NSString*) zipFile files:(NSArray*) files newnames:(NSArray*) newnames Password:(NSString*) password completion:(ZipArchiveCompletionBlock) completion
+{
+	if( _asyncCondition==nil )
+		self.password = password;
+	[self CreateZipFile2Async:zipFile files:files newnames:newnames completion:completion];
+}
+
+/**
+ * Stop the work of CreateZipFile2Async: as soon as possible. Its completion is
+ * still called, with NO, once the zip file is removed.
+ */
+
+-(void) CancelAsync
+{
+	NSCondition* condition = _asyncCondition;
+	[condition lock];
+	_asyncCancelled = YES;
+	[condition broadcast];
+	[condition unlock];
+}
+
+/**
+ * Bring the zip file at the specified path up to date with files on disk,
+ * creating it if it doesn't exist yet.
+ *
+ * Files whose name, size and modification date match an entry already in the
+ * zip file are skipped, and new files are appended to it in place, so the cost
+ * is that of the new data only. If a file changed since it was added, the zip
+ * file is rebuilt: the unchanged entries are copied as they are, without being
+ * expanded, and the changed files are compressed again. Entries with no file
+ * in files are kept. A file in files that isn't on disk is reported to the
+ * delegate and left out, its entry removed, without failing the others.
+ *
+ * @param zipFile     the path of the zip file to update
+ * @param files    an array of paths to the files to compress
+ * @param newnames an array of names of the files in the zip archive, in the same order as files.
+ * @returns BOOL YES on success
+ */
+
+-(BOOL) SyncZipFile2:(NSString*) zipFile files:(NSArray*) files newnames:(NSArray*) newnames
+{
+	if( [files count]!=[newnames count] )
 		return NO;
+	
+	// files gone from disk are left out.
+	NSMutableArray* syncFiles = [NSMutableArray arrayWithCapacity:[files count]];
+	NSMutableArray* syncNames = [NSMutableArray arrayWithCapacity:[files count]];
+	NSMutableArray* syncAttrs = [NSMutableArray arrayWithCapacity:[files count]];
+	NSMutableSet* missingNames = [NSMutableSet set];
+	for( NSUInteger i=0; i<[files count]; i++ )
+	{
+		NSString* file = [files objectAtIndex:i];
+		NSDictionary* attr = [_fileManager _attributesOfItemAtPath:file followingSymLinks:YES error:nil];
+		if( attr==nil )
+		{
+			[self OutputErrorMessage:[NSString stringWithFormat:@"File not found, left out of the zip file: %@", file]];
+			[missingNames addObject:[newnames objectAtIndex:i]];
+			continue;
+		}
+		[syncFiles addObject:file];
+		[syncNames addObject:[newnames objectAtIndex:i]];
+		[syncAttrs addObject:attr];
 	}
-	if( data==nil )
+	
+	if( ![_fileManager fileExistsAtPath:zipFile] )
 	{
-		data = [ NSData dataWithContentsOfFile:file];
+		if( ![self CreateZipFile2:zipFile] )
+			return NO;
+		BOOL success = [self addFilesToZip:syncFiles newnames:syncNames];
+		return [self CloseZipFile2] && success;
 	}
-	unsigned int dataLen = (unsigned int)[data length];
-	ret = zipWriteInFileInZip( _zipFile, (const void*)[data bytes], dataLen);
-	if( ret!=Z_OK )
+	
+	// list the entries already in the zip file, with their size and date.
+	void* unzFile = unzOpenMapped64( [zipFile fileSystemRepresentation] );
+	if( unzFile==NULL )
+		unzFile = unzOpen64( [zipFile fileSystemRepresentation] );
+	if( unzFile==NULL )
+		return NO;
+	NSMutableDictionary* existing = [NSMutableDictionary dictionary];
+	int ret = unzGoToFirstFile( unzFile );
+	while( ret==UNZ_OK )
+	{
+		unz_file_info64 fileInfo = {0};
+		ret = unzGetCurrentFileInfo64( unzFile, &fileInfo, NULL, 0, NULL, 0, NULL, 0 );
+		if( ret!=UNZ_OK )
+			break;
+		char* filename = (char*) malloc( fileInfo.size_filename +1 );
+		unzGetCurrentFileInfo64( unzFile, &fileInfo, filename, fileInfo.size_filename + 1, NULL, 0, NULL, 0 );
+		filename[fileInfo.size_filename] = '\0';
+		NSString* name = [NSString stringWithCString:filename encoding:self.stringEncoding];
+		free( filename );
+		if( name )
+			[existing setObject:[NSArray arrayWithObjects:[NSNumber numberWithUnsignedLongLong:fileInfo.uncompressed_size],
+								 [NSNumber numberWithUnsignedLong:fileInfo.dosDate], nil]
+						 forKey:name];
+		ret = unzGoToNextFile( unzFile );
+	}
+	if( ret!=UNZ_END_OF_LIST_OF_FILE )
 	{
+		unzClose( unzFile );
+		[self OutputErrorMessage:@"Failed to read zip file"];
 		return NO;
 	}
-	ret = zipCloseFileInZip( _zipFile );
-	if( ret!=Z_OK )
+	
+	// sort the files out: unchanged ones are skipped, the others added, and
+	// the entries of missing ones dropped.
+	NSMutableArray* addFiles = [NSMutableArray array];
+	NSMutableArray* addNames = [NSMutableArray array];
+	NSMutableSet* changedNames = [NSMutableSet set];
+	for( NSString* name in missingNames )
+		if( [existing objectForKey:name] )
+			[changedNames addObject:name];
+	for( NSUInteger i=0; i<[syncFiles count]; i++ )
+	{
+		NSString* file = [syncFiles objectAtIndex:i];
+		NSString* newname = [syncNames objectAtIndex:i];
+		NSArray* entry = [existing objectForKey:newname];
+		if( entry )
+		{
+			NSDictionary* attr = [syncAttrs objectAtIndex:i];
+			if( [[entry objectAtIndex:0] unsignedLongLongValue]==[attr fileSize] &&
+			    [[entry objectAtIndex:1] unsignedLongValue]==[self ZipDateForFile:file] )
+				continue;
+			[changedNames addObject:newname];
+		}
+		[addFiles addObject:file];
+		[addNames addObject:newname];
+	}
+	if( [addFiles count]==0 && [changedNames count]==0 )
+	{
+		unzClose( unzFile );
+		return YES;
+	}
+	
+	BOOL success = YES;
+	if( [changedNames count]==0 )
+	{
+		// only new files: append them after the existing entries.
+		unzClose( unzFile );
+		_zipFile = zipOpen64( [zipFile fileSystemRepresentation], APPEND_STATUS_ADDINZIP );
+		if( !_zipFile )
+			return NO;
+		zipSetBufferSize( _zipFile, _bufferSize );
+		success = [self addFilesToZip:addFiles newnames:addNames];
+		return [self CloseZipFile2] && success;
+	}
+	
+	// some files changed: rebuild the zip file next to the old one, then replace it.
+	NSString* syncFile = [zipFile stringByAppendingString:@".sync"];
+	if( ![self CreateZipFile2:syncFile] )
+	{
+		unzClose( unzFile );
 		return NO;
-	return YES;
+	}
+	ret = unzGoToFirstFile( unzFile );
+	while( success && ret==UNZ_OK )
+	{
+		unz_file_info64 fileInfo = {0};
+		ret = unzGetCurrentFileInfo64( unzFile, &fileInfo, NULL, 0, NULL, 0, NULL, 0 );
+		if( ret!=UNZ_OK )
+			break;
+		char* filename = (char*) malloc( fileInfo.size_filename +1 );
+		if( filename==NULL )
+		{
+			success = NO;
+			break;
+		}
+		unzGetCurrentFileInfo64( unzFile, &fileInfo, filename, fileInfo.size_filename + 1, NULL, 0, NULL, 0 );
+		filename[fileInfo.size_filename] = '\0';
+		NSString* name = [NSString stringWithCString:filename encoding:self.stringEncoding];
+		free( filename );
+		if( ![changedNames containsObject:name] )
+			success = [self CopyCurrentFileOf:unzFile];
+		ret = unzGoToNextFile( unzFile );
+	}
+	unzClose( unzFile );
+	if( success && ret!=UNZ_END_OF_LIST_OF_FILE )
+	{
+		[self OutputErrorMessage:@"Failed to read zip file"];
+		success = NO;
+	}
+	if( success )
+		success = [self addFilesToZip:addFiles newnames:addNames];
+	success = [self CloseZipFile2] && success;
+	
+	if( success && rename( [syncFile fileSystemRepresentation], [zipFile fileSystemRepresentation] )!=0 )
+		success = NO;
+	if( !success )
+		[_fileManager removeItemAtPath:syncFile error:nil];
+	return success;
+}
+
+/**
+ * Bring the zip file at the specified path up to date with files on disk,
+ * encrypting the files added with a password.
+ *
+ * @param zipFile     the path of the zip file to update
+ * @param files    an array of paths to the files to compress
+ * @param newnames an array of names of the files in the zip archive, in the same order as files.
+ * @param password    a password used to encrypt the files added
+ * @returns BOOL YES on success
+ */
+
+-(BOOL) SyncZipFile2:(NSString*) zipFile files:(NSArray*) files newnames:(NSArray*) newnames Password:(NSString*) password
+{
+	self.password = password;
+	BOOL success = [self SyncZipFile2:zipFile files:files newnames:newnames];
+	self.password = nil;
+	return success;
 }
 
 /**
@@ -188,9 +970,183 @@
 		return NO;
 	BOOL ret =  zipClose( _zipFile,NULL )==Z_OK?YES:NO;
 	_zipFile = NULL;
+	_zipStream = nil;
+	if( _zipBuffer )
+	{
+		// the zip file was created in memory, and nobody asked for the data.
+		free( ((zlib_memory_buffer*)_zipBuffer)->base );
+		free( _zipBuffer );
+		_zipBuffer = NULL;
+	}
 	return ret;
 }
 
+/**
+ * Create a new zip file written straight to a stream, ready for new files to be added.
+ *
+ * The zip file is written from front to back as the files are added, the crc and
+ * sizes of each file following its data, so the stream may be a socket, a pipe or
+ * the body of an upload, and nothing but the central directory is kept in memory.
+ * The stream is opened if it isn't yet, and closed by CloseZipFile2. Writes block
+ * until the stream has room, so it must not be scheduled on the calling thread's
+ * run loop.
+ *
+ * @param stream      the stream the zip file is written to
+ * @returns BOOL YES on success
+ */
+
+-(BOOL) CreateZipStream:(NSOutputStream*) stream
+{
+	if( stream==nil )
+		return NO;
+	zlib_filefunc64_def fileFunc;
+	ZipArchiveFillStreamFunc( &fileFunc, stream );
+	_zipFile = zipOpen2_64( "", APPEND_STATUS_STREAM, NULL, &fileFunc );
+	if( !_zipFile )
+		return NO;
+	_zipStream = stream;
+	zipSetBufferSize( _zipFile, _bufferSize );
+	return YES;
+}
+
+/**
+ * Create a new zip file written straight to a stream, ready for new files to be added.
+ *
+ * @param stream      the stream the zip file is written to
+ * @param password    a password used to encrypt the files added, with AES-256
+ * @returns BOOL YES on success
+ */
+
+-(BOOL) CreateZipStream:(NSOutputStream*) stream Password:(NSString*) password
+{
+	self.password = password;
+	return [self CreateZipStream:stream];
+}
+
+/**
+ * Create a new zip file in memory, ready for new files to be added.
+ * The zip data is returned by CloseZipInMemory.
+ *
+ * @returns BOOL YES on success
+ */
+
+-(BOOL) CreateZipInMemory
+{
+	zlib_memory_buffer* buffer = (zlib_memory_buffer*) calloc( 1, sizeof(zlib_memory_buffer) );
+	if( buffer==NULL )
+		return NO;
+	buffer->growable = 1;
+	
+	zlib_filefunc64_def fileFunc;
+	fill_memory_filefunc64( &fileFunc, buffer );
+	_zipFile = zipOpen2_64( "", APPEND_STATUS_CREATE, NULL, &fileFunc );
+	if( !_zipFile )
+	{
+		free( buffer );
+		return NO;
+	}
+	_zipBuffer = buffer;
+	zipSetBufferSize( _zipFile, _bufferSize );
+	return YES;
+}
+
+/**
+ * Create a new zip file in memory, ready for new files to be added.
+ * The zip data is returned by CloseZipInMemory.
+ *
+ * @param password    a password used to encrypt the files added, with AES-256
+ * @returns BOOL YES on success
+ */
+
+-(BOOL) CreateZipInMemoryWithPassword:(NSString*) password
+{
+	self.password = password;
+	return [self CreateZipInMemory];
+}
+
+/**
+ * add data in memory to the zip archive as a file, compressing it.
+ * The current time is used as the modification date of the file.
+ *
+ * @param data    the contents of the file
+ * @param newname the name of the file in the zip archive, ie: path relative to the zip archive root.
+ * @returns BOOL YES on success
+ */
+
+-(BOOL) addDataToZip:(NSData*) data newname:(NSString*) newname
+{
+	if( !_zipFile )
+		return NO;
+	zip_fileinfo zipInfo = {{0}};
+	zipInfo.dosDate = [[NSDate date] timeIntervalSinceDate:[self Date1980]];
+	
+	// sample the middle of the data, headers are seldom representative.
+	uLong sampleLength = (uLong) MIN( [data length], ZIPARCHIVE_SAMPLESIZE );
+	const Bytef* sample = (const Bytef*)[data bytes] + ([data length]-sampleLength)/2;
+	int method = ZipArchiveSampleCompresses( sample, sampleLength ) ? Z_DEFLATED : 0;
+	int level, strategy;
+	ZipArchiveDeflateSettings( _compressionProfile, newname, &level, &strategy );
+	
+	const char* password = [_password length]==0 ? NULL : [_password cStringUsingEncoding:NSASCIIStringEncoding];
+	int ret = zipOpenNewFileInZip5( _zipFile,
+									  (const char*) [newname cStringUsingEncoding:self.stringEncoding],
+									  &zipInfo,
+									  NULL,0,
+									  NULL,0,
+									  NULL,//comment
+									  method,
+									  method ? level : 0,
+									  0,
+									  15,
+									  8,
+									  strategy,
+									  password,
+									  0,
+									  0,
+									  0,
+									  [data length]>=0xffffffff,
+									  password ? ZIPAES_256 : 0 );
+	NSUInteger offset = 0;
+	while( ret==ZIP_OK && offset<[data length] )
+	{
+		unsigned int len = (unsigned int) MIN( [data length]-offset, 0x40000000 );
+		ret = zipWriteInFileInZip( _zipFile, (const char*)[data bytes]+offset, len );
+		offset += len;
+	}
+	if( ret!=ZIP_OK )
+		return NO;
+	ret = zipCloseFileInZip( _zipFile );
+	if( ret!=Z_OK )
+		return NO;
+	return YES;
+}
+
+/**
+ * Close a zip file created with CreateZipInMemory, and return its contents.
+ * The data is handed over without being copied.
+ *
+ * @returns NSData the zip file, or nil if it could not be closed.
+ */
+
+-(NSData*) CloseZipInMemory
+{
+	self.password = nil;
+	if( _zipFile==NULL || _zipBuffer==NULL )
+		return nil;
+	zlib_memory_buffer* buffer = (zlib_memory_buffer*)_zipBuffer;
+	int ret = zipClose( _zipFile, NULL );
+	_zipFile = NULL;
+	_zipBuffer = NULL;
+	
+	NSData* data = nil;
+	if( ret==ZIP_OK )
+		data = [NSData dataWithBytesNoCopy:buffer->base length:(NSUInteger)buffer->size freeWhenDone:YES];
+	else
+		free( buffer->base );
+	free( buffer );
+	return data;
+}
+
 /**
  * open an existing zip file ready for expanding.
  *
@@ -204,7 +1160,8 @@
 
     _unzippedFiles = [[NSMutableArray alloc] initWithCapacity:1];
     
-	_unzFile = unzOpen( (const char*)[zipFile UTF8String] );
+	_unzPath = [zipFile copy];
+	_unzFile = [self OpenUnzFile];
 	if( _unzFile )
 	{
 		unz_global_info  globalInfo = {0};
@@ -221,7 +1178,7 @@
  * open an existing zip file with a password ready for expanding.
  *
  * @param zipFile     the path to a zip file to be opened.
- * @param password    the password to use decrpyting the file.
+ * @param password    the password to use decrpyting the file, AES or traditional encryption.
  * @returns BOOL YES on success
  */
 
@@ -231,6 +1188,58 @@
 	return [self UnzipOpenFile:zipFile];
 }
 
+/**
+ * open a zip file held in memory ready for expanding.
+ * The data is read in place, it is kept until UnzipCloseFile. Mutable data
+ * is copied first, so changing it afterwards doesn't change what is read.
+ *
+ * @param zipData     the contents of a zip file.
+ * @returns BOOL YES on success
+ */
+
+-(BOOL) UnzipOpenData:(NSData*) zipData
+{
+    _unzippedFiles = [[NSMutableArray alloc] initWithCapacity:1];
+    
+	NSData* data = [zipData copy];
+	zlib_memory_buffer* buffer = (zlib_memory_buffer*) calloc( 1, sizeof(zlib_memory_buffer) );
+	if( buffer==NULL )
+		return NO;
+	buffer->base = (char*)[data bytes];
+	buffer->size = buffer->capacity = [data length];
+	
+	_unzBuffer = buffer;
+	_unzFile = [self OpenUnzFile];
+	if( _unzFile==NULL )
+	{
+		free( buffer );
+		_unzBuffer = NULL;
+		return NO;
+	}
+	_unzData = data;
+	
+	unz_global_info  globalInfo = {0};
+	if( unzGetGlobalInfo(_unzFile, &globalInfo )==UNZ_OK )
+	{
+		_numFiles = globalInfo.number_entry;
+	}
+	return YES;
+}
+
+/**
+ * open a zip file held in memory with a password ready for expanding.
+ *
+ * @param zipData     the contents of a zip file.
+ * @param password    the password to use decrpyting the file.
+ * @returns BOOL YES on success
+ */
+
+-(BOOL) UnzipOpenData:(NSData*) zipData Password:(NSString*) password
+{
+	self.password = password;
+	return [self UnzipOpenData:zipData];
+}
+
 /**
  * Expand all files in the zip archive into the specified directory.
  *
@@ -251,7 +1260,8 @@
     int index = 0;
     int progress = -1;
 	int ret = unzGoToFirstFile( _unzFile );
-	unsigned char		buffer[4096] = {0};
+	NSMutableData* bufferData = [NSMutableData dataWithLength:_bufferSize];
+	unsigned char* buffer = (unsigned char*) [bufferData mutableBytes];
 	if( ret!=UNZ_OK )
 	{
 		[self OutputErrorMessage:@"Failed"];
@@ -267,7 +1277,7 @@
                 ret = unzOpenCurrentFilePassword( _unzFile, password );
             if( ret!=UNZ_OK )
             {
-                [self OutputErrorMessage:@"Error occurs"];
+                [self OutputErrorMessage:ret==UNZ_BADPASSWORD ? @"Wrong password" : @"Error occurs"];
                 success = NO;
                 break;
             }
@@ -306,7 +1316,7 @@
             FILE* fp = NULL;
             do
             {
-                read = unzReadCurrentFile(_unzFile, buffer, 4096);
+                read = unzReadCurrentFile(_unzFile, buffer, (unsigned)_bufferSize);
                 if (read >= 0)
                 {
                     if (fp == NULL) {
@@ -390,6 +1400,177 @@
 	return success;
 }
 
+/**
+ * Expand all files in the zip archive into the specified directory, optionally
+ * expanding several files at once.
+ *
+ * In parallel, the files in the archive are listed first: the directories are
+ * created once, and the delegate is asked about overwriting each existing file,
+ * all on the calling thread. Then one worker per processor opens the archive
+ * again and expands the next file not yet taken, jumping to it with
+ * unzGoToFilePos64. progressBlock is called on the calling thread as each file
+ * is completed, and errors are sent to the delegate once all are done.
+ *
+ * @param path    the directory where expanded files will be created
+ * @param overwrite    should existing files be overwritten
+ * @param parallel    should files be expanded on several threads at once
+ * @returns BOOL YES on success
+ */
+
+-(BOOL) UnzipFileTo:(NSString*) path overWrite:(BOOL) overwrite parallel:(BOOL) parallel
+{
+	if( !parallel || _numFiles<2 )
+		return [self UnzipFileTo:path overWrite:overwrite];
+	
+	// list the files, and decide what is to be done with each.
+	NSMutableData* entryData = [NSMutableData dataWithCapacity:_numFiles*sizeof(ZipArchiveUnzipEntry)];
+	NSMutableArray* fullPaths = [NSMutableArray arrayWithCapacity:_numFiles];
+	NSMutableSet* directories = [NSMutableSet set];
+	int ret = unzGoToFirstFile( _unzFile );
+	if( ret!=UNZ_OK )
+	{
+		[self OutputErrorMessage:@"Failed"];
+		return NO;
+	}
+	while( ret==UNZ_OK )
+	{
+		ZipArchiveUnzipEntry entry = {{0}};
+		unz_file_info64 fileInfo = {0};
+		ret = unzGetCurrentFileInfo64( _unzFile, &fileInfo, NULL, 0, NULL, 0, NULL, 0 );
+		if( ret==UNZ_OK )
+			ret = unzGetFilePos64( _unzFile, &entry.pos );
+		if( ret!=UNZ_OK )
+		{
+			[self OutputErrorMessage:@"Error occurs while getting file info"];
+			return NO;
+		}
+		char* filename = (char*) malloc( fileInfo.size_filename +1 );
+		unzGetCurrentFileInfo64( _unzFile, &fileInfo, filename, fileInfo.size_filename + 1, NULL, 0, NULL, 0 );
+		filename[fileInfo.size_filename] = '\0';
+		
+		NSString * strPath = [NSString stringWithCString:filename encoding:self.stringEncoding];
+		BOOL isDirectory = NO;
+		if( fileInfo.size_filename>0 && (filename[fileInfo.size_filename-1]=='/' || filename[fileInfo.size_filename-1]=='\\') )
+			isDirectory = YES;
+		free( filename );
+		strPath = [strPath stringByReplacingOccurrencesOfString:@"\\" withString:@"/"];
+		NSString* fullPath = [path stringByAppendingPathComponent:strPath];
+		
+		if( isDirectory )
+			[directories addObject:fullPath];
+		else
+		{
+			[directories addObject:[fullPath stringByDeletingLastPathComponent]];
+			entry.extract = 1;
+			if( [_fileManager fileExistsAtPath:fullPath] && !overwrite && ![self OverWrite:fullPath] )
+				entry.extract = 0;
+		}
+		entry.dosDate = fileInfo.dosDate;
+		[entryData appendBytes:&entry length:sizeof(entry)];
+		[fullPaths addObject:fullPath];
+		
+		ret = unzGoToNextFile( _unzFile );
+	}
+	if( ret!=UNZ_END_OF_LIST_OF_FILE )
+	{
+		[self OutputErrorMessage:@"Failed to read zip file"];
+		return NO;
+	}
+	
+	for( NSString* directory in directories )
+		[_fileManager createDirectoryAtPath:directory withIntermediateDirectories:YES attributes:nil error:nil];
+	
+	// expand the files on the workers.
+	ZipArchiveUnzipEntry* entries = (ZipArchiveUnzipEntry*) [entryData mutableBytes];
+	NSUInteger count = [fullPaths count];
+	NSUInteger workers = MIN( [[NSProcessInfo processInfo] activeProcessorCount], count );
+	NSCondition* condition = [[NSCondition alloc] init];
+	__block NSUInteger next = 0;
+	__block NSUInteger completed = 0;
+	__block NSUInteger finished = 0;
+	char* password = [_password length]==0 ? NULL : strdup( [_password cStringUsingEncoding:NSASCIIStringEncoding] );
+	NSDate* date1980 = [self Date1980];
+	
+	void (^worker)(void) = ^{
+		void* file = [self OpenUnzFile];
+		unsigned char* buffer = (unsigned char*) malloc( _bufferSize );
+		for( ;; )
+		{
+			[condition lock];
+			NSUInteger index = next++;
+			[condition unlock];
+			if( index>=count )
+				break;
+			
+			ZipArchiveUnzipEntry* entry = &entries[index];
+			if( entry->extract )
+			{
+				@autoreleasepool {
+					if( file==NULL || buffer==NULL )
+						entry->result = UNZ_INTERNALERROR;
+					else
+						entry->result = unzGoToFilePos64( file, &entry->pos );
+					if( entry->result==UNZ_OK )
+						entry->result = [self UnzipCurrentFileOf:file toPath:[fullPaths objectAtIndex:index] date:entry->dosDate
+														   since:date1980 password:password buffer:buffer];
+				}
+			}
+			[condition lock];
+			completed++;
+			[condition broadcast];
+			[condition unlock];
+		}
+		free( buffer );
+		if( file )
+			[self CloseUnzFile:file];
+		[condition lock];
+		finished++;
+		[condition broadcast];
+		[condition unlock];
+	};
+	dispatch_queue_t queue = dispatch_get_global_queue( DISPATCH_QUEUE_PRIORITY_DEFAULT, 0 );
+	for( NSUInteger i=0; i<workers; i++ )
+		dispatch_async( queue, worker );
+	
+	// report progress here, as the workers complete files.
+	NSUInteger reported = 0;
+	[condition lock];
+	while( reported<count || finished<workers )
+	{
+		if( reported<completed )
+		{
+			int index = (int) ++reported;
+			[condition unlock];
+			if( _progressBlock && _numFiles )
+				_progressBlock( (int)(index*100/_numFiles), index, _numFiles );
+			[condition lock];
+		}
+		else
+			[condition wait];
+	}
+	[condition unlock];
+	free( password );
+	
+	BOOL success = YES;
+	for( NSUInteger i=0; i<count; i++ )
+	{
+		if( !entries[i].extract )
+			continue;
+		NSString* fullPath = [fullPaths objectAtIndex:i];
+		if( entries[i].result==UNZ_OK )
+			[(NSMutableArray*)_unzippedFiles addObject:fullPath];
+		else
+		{
+			success = NO;
+			if( entries[i].result==UNZ_CRCERROR )
+				[self OutputErrorMessage:@"file was unzipped but failed crc check"];
+			else
+				[self OutputErrorMessage:[NSString stringWithFormat:@"Failed to unzip %@", fullPath]];
+		}
+	}
+	return success;
+}
+
 /**
  * Close the zip file.
  *
@@ -400,14 +1581,57 @@
 {
 	self.password = nil;
 	if( _unzFile ) {
-		int err = unzClose( _unzFile );
+		int err = [self CloseUnzFile:_unzFile];
         _unzFile = nil;
+		free( _unzBuffer );
+		_unzBuffer = NULL;
+		_unzData = nil;
+		_unzPath = nil;
         return err ==UNZ_OK;
     }
 	return YES;
 }
 
 
+/**
+ * the callback of unzVerify, collecting the messages for the damaged files.
+ */
+static void ZipArchiveVerifyReport( void* opaque, uLong number_file, const char* filename, ZPOS64_T uncompressed_size, int err )
+{
+	if( err==UNZ_OK )
+		return;
+	// called on the threads of unzVerify, one call at a time.
+	@autoreleasepool {
+		NSMutableArray* messages = (__bridge NSMutableArray*) opaque;
+		[messages addObject:[NSString stringWithFormat:@"%s is damaged (%d)", filename, err]];
+	}
+}
+
+/**
+ * check every file of the zip file opened with UnzipOpenFile: without
+ * expanding it, decompressing the files on all the processors at once.
+ * Each damaged file is reported to the delegate.
+ *
+ * @returns BOOL YES if every file is good
+ */
+
+-(BOOL) UnzipVerify
+{
+	if( !_unzFile || !_unzPath )
+		return NO;
+	const char* password = [_password length]==0 ? NULL : [_password cStringUsingEncoding:NSASCIIStringEncoding];
+	NSMutableArray* messages = [NSMutableArray array];
+	unz_verify_info info = {0};
+	int ret = unzVerify( [_unzPath fileSystemRepresentation], password, 0, NULL, NULL,
+						 ZipArchiveVerifyReport, (__bridge void*) messages, &info );
+	for( NSString* message in messages )
+		[self OutputErrorMessage:message];
+	if( ret==UNZ_BADZIPFILE )
+		[self OutputErrorMessage:@"Failed to read the central directory"];
+	return ret==UNZ_OK;
+}
+
+
 /**
  * Return a list of filenames that are in the zip archive. 
  * No path information is available as this can be called before the zip is expanded.
@@ -425,26 +1649,15 @@
         [self OutputErrorMessage:@"Failed"];
     }
     
-    const char* password = [_password cStringUsingEncoding:NSASCIIStringEncoding];
-    
-    do{
-        if( [_password length]==0 )
-            ret = unzOpenCurrentFile( _unzFile );
-        else
-            ret = unzOpenCurrentFilePassword( _unzFile, password );
-        if( ret!=UNZ_OK )
-        {
-            [self OutputErrorMessage:@"Error occured"];
-            break;
-        }
-        
-        // reading data and write to file
+    // the names are in the central directory, the files don't need to be opened:
+    // an AES encrypted one couldn't be without the right password.
+    while( ret==UNZ_OK )
+    {
         unz_file_info   fileInfo ={0};
         ret = unzGetCurrentFileInfo(_unzFile, &fileInfo, NULL, 0, NULL, 0, NULL, 0);
         if( ret!=UNZ_OK )
         {
             [self OutputErrorMessage:@"Error occurs while getting file info"];
-            unzCloseCurrentFile( _unzFile );
             break;
         }
         char* filename = (char*) malloc( fileInfo.size_filename +1 );
@@ -462,15 +1675,211 @@
         // Copy name to array
         [allFilenames addObject:strPath];
         
-        unzCloseCurrentFile( _unzFile );
         ret = unzGoToNextFile( _unzFile );
-    }  while( ret==UNZ_OK && UNZ_OK!=UNZ_END_OF_LIST_OF_FILE );
+    }
     
     // return an immutable array.
     return [NSArray arrayWithArray:allFilenames];
 }
 
 
+#pragma mark expanding one file
+
+/**
+ * the archives opened from a path, shared by all the ZipArchives so
+ * opening an archive again reuses its central directory and inflate state.
+ * They are mapped in memory so reading them avoids stdio, unless they can't be mapped.
+ * They are opened without UNZ_OPEN_INDEX: ZipArchive goes through the files in
+ * order and never calls unzLocateFile, so an index of the names would only cost
+ * another pass over the central directory. Add it once a lookup by name uses the pool.
+ */
+
++(unzPool) UnzPool
+{
+	static unzPool pool = NULL;
+	static dispatch_once_t once;
+	dispatch_once( &once, ^{
+		zlib_filefunc64_def fileFunc;
+		fill_mmap_filefunc64( &fileFunc );
+		pool = unzPoolCreate( ZIPARCHIVE_POOLSIZE, &fileFunc, 0 );
+	});
+	return pool;
+}
+
+/**
+ * open the archive again, from the file or the data it was opened with,
+ * giving an unzFile handle with its own current file and position.
+ * It is given back with CloseUnzFile:.
+ */
+
+-(void*) OpenUnzFile
+{
+	void* file;
+	if( _unzBuffer )
+	{
+		zlib_filefunc64_def fileFunc;
+		fill_memory_filefunc64( &fileFunc, (zlib_memory_buffer*)_unzBuffer );
+		file = unzOpen2_64( "", &fileFunc );
+	}
+	else
+	{
+		file = unzPoolOpen( [ZipArchive UnzPool], [_unzPath fileSystemRepresentation] );
+	}
+	if( file )
+		unzSetBufferSize( file, _bufferSize );
+	return file;
+}
+
+/**
+ * close an unzFile handle of OpenUnzFile, leaving it in the pool when it
+ * was opened from a path.
+ */
+
+-(int) CloseUnzFile:(void*) file
+{
+	if( _unzBuffer )
+		return unzClose( file );
+	return unzPoolRelease( [ZipArchive UnzPool], file );
+}
+
+/**
+ * expand the current file of an unzFile handle to fullPath, and set its
+ * modification date. Safe to call on several threads with different handles.
+ *
+ * @returns int UNZ_OK on success, or the minizip error code.
+ */
+
+-(int) UnzipCurrentFileOf:(void*) file toPath:(NSString*) fullPath date:(uLong) dosDate since:(NSDate*) date1980
+				  password:(const char*) password buffer:(unsigned char*) buffer
+{
+	int ret = password ? unzOpenCurrentFilePassword( file, password ) : unzOpenCurrentFile( file );
+	if( ret!=UNZ_OK )
+		return ret;
+	
+	FILE* fp = fopen( [fullPath fileSystemRepresentation], "wb" );
+	if( fp==NULL )
+	{
+		unzCloseCurrentFile( file );
+		return UNZ_ERRNO;
+	}
+	int read;
+	while( (read = unzReadCurrentFile( file, buffer, (unsigned)_bufferSize ))>0 )
+	{
+		if( fwrite( buffer, read, 1, fp )!=1 )
+		{
+			read = UNZ_ERRNO;
+			break;
+		}
+	}
+	fclose( fp );
+	ret = unzCloseCurrentFile( file );
+	if( read<0 )
+		return read;
+	if( ret!=UNZ_OK )
+		return ret;
+	
+	// set the orignal datetime property
+	if( dosDate!=0 )
+	{
+		NSDate* orgDate = [[NSDate alloc] initWithTimeInterval:(NSTimeInterval)dosDate sinceDate:date1980];
+		NSDictionary* attr = [NSDictionary dictionaryWithObject:orgDate forKey:NSFileModificationDate];
+		if( ![_fileManager setAttributes:attr ofItemAtPath:fullPath error:nil] )
+			NSLog(@"Failed to set attributes");
+	}
+	return UNZ_OK;
+}
+
+
+#pragma mark copying one file
+
+/**
+ * copy the current file of an unzFile handle into the zip file being created,
+ * as it is: its compressed (and possibly encrypted) data is neither expanded
+ * nor compressed again.
+ *
+ * @returns BOOL YES on success
+ */
+
+-(BOOL) CopyCurrentFileOf:(void*) file
+{
+	unz_file_info64 fileInfo = {0};
+	int ret = unzGetCurrentFileInfo64( file, &fileInfo, NULL, 0, NULL, 0, NULL, 0 );
+	if( ret!=UNZ_OK )
+		return NO;
+	char* filename = (char*) malloc( fileInfo.size_filename +1 );
+	char* extraGlobal = (char*) malloc( fileInfo.size_file_extra +1 );
+	unzGetCurrentFileInfo64( file, &fileInfo, filename, fileInfo.size_filename + 1, extraGlobal, fileInfo.size_file_extra, NULL, 0 );
+	filename[fileInfo.size_filename] = '\0';
+	
+	int method = 0;
+	int level = 0;
+	ret = unzOpenCurrentFile2( file, &method, &level, 1 );
+	if( ret!=UNZ_OK )
+	{
+		free( filename );
+		free( extraGlobal );
+		return NO;
+	}
+	
+	// the extra fields are copied too, AES encrypted files keep their real method in one of them.
+	// the zip64 ones are dropped, minizip writes its own.
+	int sizeExtraLocal = unzGetLocalExtrafield( file, NULL, 0 );
+	char* extraLocal = (char*) malloc( MAX( sizeExtraLocal, 0 ) +1 );
+	sizeExtraLocal = sizeExtraLocal>0 ? unzGetLocalExtrafield( file, extraLocal, sizeExtraLocal ) : 0;
+	int sizeExtraGlobal = (int) fileInfo.size_file_extra;
+	zipRemoveExtraInfoBlock( extraLocal, &sizeExtraLocal, 0x0001 );
+	zipRemoveExtraInfoBlock( extraGlobal, &sizeExtraGlobal, 0x0001 );
+	
+	// the encryption header, if any, is part of the raw data, so no password is
+	// given: the encrypted flag and the data descriptor flag are carried over instead.
+	zip_fileinfo zipInfo = {{0}};
+	zipInfo.dosDate = fileInfo.dosDate;
+	zipInfo.internal_fa = fileInfo.internal_fa;
+	zipInfo.external_fa = fileInfo.external_fa;
+	ret = zipOpenNewFileInZip4_64( _zipFile,
+								  filename,
+								  &zipInfo,
+								  extraLocal,sizeExtraLocal,
+								  extraGlobal,sizeExtraGlobal,
+								  NULL,//comment
+								  method,
+								  level,
+								  1,
+								  15,
+								  8,
+								  Z_DEFAULT_STRATEGY,
+								  NULL,
+								  0,
+								  fileInfo.version,
+								  fileInfo.flag & (1|8),
+								  fileInfo.compressed_size>=0xffffffff || fileInfo.uncompressed_size>=0xffffffff );
+	free( filename );
+	free( extraLocal );
+	free( extraGlobal );
+	
+	unsigned char* buffer = (unsigned char*) malloc( _bufferSize );
+	if( buffer==NULL )
+		ret = ZIP_INTERNALERROR;
+	while( ret==ZIP_OK )
+	{
+		int read = unzReadCurrentFile( file, buffer, (unsigned)_bufferSize );
+		if( read<=0 )
+		{
+			if( read<0 )
+				ret = ZIP_ERRNO;
+			break;
+		}
+		ret = zipWriteInFileInZip( _zipFile, buffer, read );
+	}
+	free( buffer );
+	unzCloseCurrentFile( file );
+	
+	if( ret==ZIP_OK )
+		ret = zipCloseFileInZipRaw64( _zipFile, fileInfo.uncompressed_size, fileInfo.crc );
+	return ret==ZIP_OK;
+}
+
+
 #pragma mark wrapper for delegate
 
 /**
@@ -494,6 +1903,32 @@
 	return YES;
 }
 
+#pragma mark get the date stored in the zip file for a file on disk
+
+/**
+ * the modification date of the file as seconds since 1980-01-01, as it is
+ * stored in the zip file. The current time is used if the file has no date.
+ */
+
+-(uLong) ZipDateForFile:(NSString*) file
+{
+	time_t current;
+	time( &current );
+	uLong zipDate = (uLong) current;
+	
+    NSError* error = nil;
+	NSDictionary* attr = [_fileManager _attributesOfItemAtPath:file followingSymLinks:YES error:&error];
+	if( attr )
+	{
+		NSDate* fileDate = (NSDate*)[attr objectForKey:NSFileModificationDate];
+		if( fileDate )
+		{
+			zipDate = [fileDate timeIntervalSinceDate:[self Date1980] ];
+		}
+	}
+	return zipDate;
+}
+
 #pragma mark get NSDate object for 1980-01-01
 -(NSDate*) Date1980
 {
@@ -512,6 +1947,316 @@
 @end
 
 
+#pragma mark deflate a file into memory
+
+/**
+ * deflate the file at entry->path into a raw deflate stream in entry->data,
+ * computing the crc and the uncompressed size as it is read. Files that
+ * barely deflate are copied as they are, and entry->method is set to 0.
+ *
+ * @returns Z_OK on success, or a zlib error code.
+ */
+
+static int ZipArchiveDeflateFile( ZipArchiveDeflatedEntry* entry )
+{
+	unsigned char buffer[16384];
+	z_stream stream = {0};
+	uLong capacity = 0;
+	int flush;
+	int err = Z_OK;
+	
+	zlib_filefunc64_def fileFunc;
+	fill_fopen64_filefunc( &fileFunc );
+	voidpf fp = fileFunc.zopen64_file( fileFunc.opaque, entry->path,
+									  ZLIB_FILEFUNC_MODE_READ | ZLIB_FILEFUNC_MODE_EXISTING );
+	if( fp==NULL )
+		return Z_ERRNO;
+	
+	ZPOS64_T fileSize = 0;
+	if( fileFunc.zseek64_file( fileFunc.opaque, fp, 0, ZLIB_FILEFUNC_SEEK_END )==0 )
+		fileSize = fileFunc.ztell64_file( fileFunc.opaque, fp );
+	fileFunc.zseek64_file( fileFunc.opaque, fp, 0, ZLIB_FILEFUNC_SEEK_SET );
+	entry->method = ZipArchiveFileCompresses( &fileFunc, fp, fileSize ) ? Z_DEFLATED : 0;
+	
+	if( entry->method==Z_DEFLATED )
+		err = deflateInit2( &stream, entry->level, Z_DEFLATED, -MAX_WBITS, 8, entry->strategy );
+	if( err!=Z_OK )
+	{
+		fileFunc.zclose_file( fileFunc.opaque, fp );
+		return err;
+	}
+	
+	entry->crc = fastcrc32( 0L, NULL, 0L );
+	do
+	{
+		uLong len = fileFunc.zread_file( fileFunc.opaque, fp, buffer, sizeof(buffer) );
+		if( len==0 && fileFunc.zerror_file( fileFunc.opaque, fp ) )
+		{
+			err = Z_ERRNO;
+			break;
+		}
+		flush = len==0 ? Z_FINISH : Z_NO_FLUSH;
+		entry->crc = fastcrc32( entry->crc, buffer, (uInt)len );
+		entry->uncompressedSize += len;
+		
+		stream.next_in = buffer;
+		stream.avail_in = (uInt)len;
+		do
+		{
+			if( entry->size==capacity )
+			{
+				uLong newCapacity = capacity==0 ? sizeof(buffer) : capacity*2;
+				Bytef* data = (Bytef*) realloc( entry->data, newCapacity );
+				if( data==NULL )
+				{
+					err = Z_MEM_ERROR;
+					break;
+				}
+				entry->data = data;
+				capacity = newCapacity;
+			}
+			stream.next_out = entry->data+entry->size;
+			stream.avail_out = (uInt) MIN( capacity-entry->size, 0x40000000 );
+			uInt avail = stream.avail_out;
+			if( entry->method==Z_DEFLATED )
+				deflate( &stream, flush );
+			else
+			{
+				// stored: the file is copied as it is.
+				uInt copy = MIN( stream.avail_in, stream.avail_out );
+				memcpy( stream.next_out, stream.next_in, copy );
+				stream.next_in += copy;
+				stream.avail_in -= copy;
+				stream.avail_out -= copy;
+			}
+			entry->size += avail-stream.avail_out;
+		} while( stream.avail_out==0 && (entry->method==Z_DEFLATED || stream.avail_in>0) );
+	} while( err==Z_OK && flush!=Z_FINISH );
+	
+	if( entry->method==Z_DEFLATED )
+		deflateEnd( &stream );
+	fileFunc.zclose_file( fileFunc.opaque, fp );
+	return err;
+}
+
+/**
+ * pick the deflate level and strategy for a file of the archive, from the
+ * kind of data its extension tells and the profile. These are the sweet spots
+ * minibench -t measured on Logs.csv, the .caf prompts and the .png images:
+ * balanced is the fastest setting within 10% of the smallest output.
+ * Smaller windows and memLevels were never worth it, they stay at 15 and 8.
+ */
+
+static void ZipArchiveDeflateSettings( ZipArchiveCompressionProfile profile, NSString* name, int* level, int* strategy )
+{
+	// level and strategy for the balanced, fast and small profiles.
+	static const int text[3][2]  = { {5, Z_DEFAULT_STRATEGY}, {1, Z_DEFAULT_STRATEGY}, {9, Z_DEFAULT_STRATEGY} };
+	static const int audio[3][2] = { {1, Z_DEFAULT_STRATEGY}, {1, Z_RLE}, {9, Z_DEFAULT_STRATEGY} };
+	static const int image[3][2] = { {1, Z_HUFFMAN_ONLY}, {1, Z_HUFFMAN_ONLY}, {3, Z_DEFAULT_STRATEGY} };
+	static const int other[3][2] = { {Z_DEFAULT_COMPRESSION, Z_DEFAULT_STRATEGY}, {1, Z_DEFAULT_STRATEGY}, {9, Z_DEFAULT_STRATEGY} };
+	
+	NSString* extension = [[name pathExtension] lowercaseString];
+	const int (*settings)[2] = other;
+	if( [extension isEqualToString:@"csv"] || [extension isEqualToString:@"txt"] || [extension isEqualToString:@"log"] )
+		settings = text;
+	else if( [extension isEqualToString:@"caf"] )
+		settings = audio;
+	else if( [extension isEqualToString:@"png"] )
+		settings = image;
+	
+	if( profile>ZipArchiveCompressionSmall )
+		profile = ZipArchiveCompressionBalanced;
+	*level = settings[profile][0];
+	*strategy = settings[profile][1];
+}
+
+/**
+ * tell whether deflating a sample of a file saves enough for the whole file
+ * to be worth deflating. Samples too small to tell are always deflated.
+ *
+ * @returns 1 to deflate, 0 to store.
+ */
+
+static int ZipArchiveSampleCompresses( const Bytef* sample, uLong len )
+{
+	Bytef out[ZIPARCHIVE_SAMPLESIZE+64];
+	z_stream stream = {0};
+	
+	if( len<ZIPARCHIVE_SAMPLESIZE/8 )
+		return 1;
+	if( len>ZIPARCHIVE_SAMPLESIZE )
+		len = ZIPARCHIVE_SAMPLESIZE;
+	// the fastest level and a window just large enough for the sample keep this cheap.
+	if( deflateInit2( &stream, 1, Z_DEFLATED, -12, 5, Z_DEFAULT_STRATEGY )!=Z_OK )
+		return 1;
+	stream.next_in = (Bytef*)sample;
+	stream.avail_in = (uInt)len;
+	stream.next_out = out;
+	stream.avail_out = sizeof(out);
+	int err = deflate( &stream, Z_FINISH );
+	uLong compressed = stream.total_out;
+	deflateEnd( &stream );
+	if( err!=Z_STREAM_END )
+		return 0;
+	return compressed*100 <= len*(100-ZIPARCHIVE_MINSAVING);
+}
+
+/**
+ * sample a file being added and tell whether it is worth deflating. The
+ * sample is taken from the middle of the file, as headers are seldom
+ * representative: CAF recordings start with a chunk of zero padding.
+ * The file is left positioned at its beginning.
+ *
+ * @returns 1 to deflate, 0 to store.
+ */
+
+static int ZipArchiveFileCompresses( zlib_filefunc64_def* fileFunc, voidpf stream, ZPOS64_T fileSize )
+{
+	Bytef sample[ZIPARCHIVE_SAMPLESIZE];
+	ZPOS64_T offset = fileSize>ZIPARCHIVE_SAMPLESIZE ? (fileSize-ZIPARCHIVE_SAMPLESIZE)/2 : 0;
+	uLong len = 0;
+	
+	if( fileFunc->zseek64_file( fileFunc->opaque, stream, offset, ZLIB_FILEFUNC_SEEK_SET )==0 )
+		len = fileFunc->zread_file( fileFunc->opaque, stream, sample, sizeof(sample) );
+	fileFunc->zseek64_file( fileFunc->opaque, stream, 0, ZLIB_FILEFUNC_SEEK_SET );
+	return ZipArchiveSampleCompresses( sample, len );
+}
+
+#pragma mark chunks of CreateZipFile2Async:
+
+/**
+ * allocate a chunk with room for capacity bytes of data.
+ *
+ * @returns the chunk, or NULL if there is not enough memory.
+ */
+
+static ZipArchiveChunk* ZipArchiveNewChunk( NSUInteger index, uLong capacity )
+{
+	ZipArchiveChunk* chunk = (ZipArchiveChunk*) calloc( 1, sizeof(ZipArchiveChunk) );
+	if( chunk==NULL )
+		return NULL;
+	chunk->data = (Bytef*) malloc( capacity );
+	if( chunk->data==NULL )
+	{
+		free( chunk );
+		return NULL;
+	}
+	chunk->index = index;
+	return chunk;
+}
+
+static void ZipArchiveFreeChunk( ZipArchiveChunk* chunk )
+{
+	if( chunk==NULL )
+		return;
+	free( chunk->data );
+	free( chunk );
+}
+
+static void ZipArchivePushChunk( ZipArchiveChunkQueue* queue, ZipArchiveChunk* chunk )
+{
+	chunk->next = NULL;
+	if( queue->tail )
+		queue->tail->next = chunk;
+	else
+		queue->head = chunk;
+	queue->tail = chunk;
+	queue->count++;
+}
+
+/**
+ * @returns the oldest chunk of the queue, or NULL if it is empty.
+ */
+
+static ZipArchiveChunk* ZipArchivePopChunk( ZipArchiveChunkQueue* queue )
+{
+	ZipArchiveChunk* chunk = queue->head;
+	if( chunk==NULL )
+		return NULL;
+	queue->head = chunk->next;
+	if( queue->head==NULL )
+		queue->tail = NULL;
+	queue->count--;
+	return chunk;
+}
+
+#pragma mark writing to an NSOutputStream
+
+/**
+ * the functions of minizip's I/O layer writing to the stream given as opaque,
+ * for CreateZipStream:. minizip never reads, seeks or asks where a zip file
+ * opened with APPEND_STATUS_STREAM is.
+ */
+
+static voidpf ZCALLBACK ZipArchiveStreamOpen( voidpf opaque, const void* filename, int mode )
+{
+	NSOutputStream* stream = (__bridge NSOutputStream*)opaque;
+	if( mode & ZLIB_FILEFUNC_MODE_READ )
+		return NULL;
+	if( [stream streamStatus]==NSStreamStatusNotOpen )
+		[stream open];
+	if( [stream streamStatus]==NSStreamStatusError || [stream streamStatus]==NSStreamStatusClosed )
+		return NULL;
+	return opaque;
+}
+
+static uLong ZCALLBACK ZipArchiveStreamRead( voidpf opaque, voidpf stream, void* buf, uLong size )
+{
+	return 0;
+}
+
+static uLong ZCALLBACK ZipArchiveStreamWrite( voidpf opaque, voidpf stream, const void* buf, uLong size )
+{
+	NSOutputStream* outputStream = (__bridge NSOutputStream*)stream;
+	uLong written = 0;
+	while( written<size )
+	{
+		NSInteger len = [outputStream write:(const uint8_t*)buf+written maxLength:(NSUInteger)(size-written)];
+		if( len<=0 )
+			break;
+		written += (uLong)len;
+	}
+	return written;
+}
+
+static ZPOS64_T ZCALLBACK ZipArchiveStreamTell( voidpf opaque, voidpf stream )
+{
+	return (ZPOS64_T)-1;
+}
+
+static long ZCALLBACK ZipArchiveStreamSeek( voidpf opaque, voidpf stream, ZPOS64_T offset, int origin )
+{
+	return -1;
+}
+
+static int ZCALLBACK ZipArchiveStreamClose( voidpf opaque, voidpf stream )
+{
+	[(__bridge NSOutputStream*)stream close];
+	return 0;
+}
+
+static int ZCALLBACK ZipArchiveStreamError( voidpf opaque, voidpf stream )
+{
+	return [(__bridge NSOutputStream*)stream streamStatus]==NSStreamStatusError;
+}
+
+/**
+ * fill fileFunc to write to stream, which must be retained while it is used.
+ */
+
+static void ZipArchiveFillStreamFunc( zlib_filefunc64_def* fileFunc, NSOutputStream* stream )
+{
+	fileFunc->zopen64_file = ZipArchiveStreamOpen;
+	fileFunc->zread_file = ZipArchiveStreamRead;
+	fileFunc->zwrite_file = ZipArchiveStreamWrite;
+	fileFunc->ztell64_file = ZipArchiveStreamTell;
+	fileFunc->zseek64_file = ZipArchiveStreamSeek;
+	fileFunc->zclose_file = ZipArchiveStreamClose;
+	fileFunc->zerror_file = ZipArchiveStreamError;
+	fileFunc->opaque = (__bridge voidpf)stream;
+}
+
+
 @implementation NSFileManager(ZipArchive)
 
 - (NSDictionary *)_attributesOfItemAtPath:(NSString *)path followingSymLinks:(BOOL)followingSymLinks error:(NSError **)error
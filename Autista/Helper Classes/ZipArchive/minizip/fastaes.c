@@ -0,0 +1,401 @@
+/*
+  fastaes.c -- AES encryption for Minizip using the processor's AES
+  instructions (x86-64 AES-NI or ARMv8 cryptography extensions) when
+  available, CommonCrypto on Apple systems otherwise, and lookup tables
+  elsewhere
+  License: Same as ZLIB (www.gzip.org)
+
+  Only encryption is needed: zip files are encrypted with AES in counter
+  mode, where decrypting is encrypting the counter again.
+*/
+
+#include <stddef.h>
+#include <string.h>
+#include "zlib.h"
+#include "fastaes.h"
+
+#ifndef local
+#  define local static
+#endif
+
+#include "fastaes_tables.h"
+
+#if (defined(__x86_64__) || defined(_M_X64)) && (defined(__GNUC__) || defined(__clang__))
+#  define FASTAES_HAVE_AESNI
+#  include <cpuid.h>
+#  include <emmintrin.h>
+#  include <wmmintrin.h>
+#endif
+
+#if defined(__aarch64__) && (defined(__GNUC__) || defined(__clang__))
+#  define FASTAES_HAVE_ARMV8
+#  include <arm_neon.h>
+#  if defined(__linux__)
+#    include <sys/auxv.h>
+#    ifndef HWCAP_AES
+#      define HWCAP_AES (1 << 3)
+#    endif
+#  endif
+#endif
+
+#if defined(__APPLE__) && !defined(NOCOMMONCRYPTO)
+#  define FASTAES_HAVE_COMMONCRYPTO
+#  include <CommonCrypto/CommonCryptor.h>
+#endif
+
+
+local unsigned int fastaes_load32(const unsigned char* p)
+{
+    return ((unsigned int)p[0] << 24) | ((unsigned int)p[1] << 16) |
+           ((unsigned int)p[2] << 8) | (unsigned int)p[3];
+}
+
+local void fastaes_store32(unsigned char* p, unsigned int v)
+{
+    p[0] = (unsigned char)(v >> 24);
+    p[1] = (unsigned char)(v >> 16);
+    p[2] = (unsigned char)(v >> 8);
+    p[3] = (unsigned char)v;
+}
+
+local unsigned int fastaes_subword(unsigned int w)
+{
+    return ((unsigned int)fastaes_sbox[w >> 24] << 24) |
+           ((unsigned int)fastaes_sbox[(w >> 16) & 0xff] << 16) |
+           ((unsigned int)fastaes_sbox[(w >> 8) & 0xff] << 8) |
+           (unsigned int)fastaes_sbox[w & 0xff];
+}
+
+extern int ZEXPORT fastaes_set_key (fastaes_key* key, const unsigned char* k, int bits)
+{
+    static const unsigned char rcon[10] = { 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1b, 0x36 };
+    int nk, words, i;
+
+    if ((bits != 128) && (bits != 192) && (bits != 256))
+        return -1;
+    nk = bits / 32;
+    key->rounds = nk + 6;
+    words = 4 * (key->rounds + 1);
+
+    for (i=0;i<nk;i++)
+        key->rk[i] = fastaes_load32(k + 4*i);
+    for (i=nk;i<words;i++)
+    {
+        unsigned int t = key->rk[i-1];
+        if (i % nk == 0)
+            t = fastaes_subword((t << 8) | (t >> 24)) ^ ((unsigned int)rcon[i/nk - 1] << 24);
+        else if ((nk > 6) && (i % nk == 4))
+            t = fastaes_subword(t);
+        key->rk[i] = key->rk[i-nk] ^ t;
+    }
+    for (i=0;i<words;i++)
+        fastaes_store32(key->rk_bytes + 4*i, key->rk[i]);
+    return 0;
+}
+
+
+/***********************************************************************
+ * lookup tables, for any processor
+ */
+
+local void fastaes_table_encrypt(const fastaes_key* key, const unsigned char* in,
+                                 unsigned char* out, uInt blocks)
+{
+    while (blocks-- > 0)
+    {
+        const unsigned int* rk = key->rk;
+        unsigned int s0, s1, s2, s3, t0, t1, t2, t3;
+        int r;
+
+        s0 = fastaes_load32(in)      ^ rk[0];
+        s1 = fastaes_load32(in + 4)  ^ rk[1];
+        s2 = fastaes_load32(in + 8)  ^ rk[2];
+        s3 = fastaes_load32(in + 12) ^ rk[3];
+        for (r=1;r<key->rounds;r++)
+        {
+            rk += 4;
+            t0 = fastaes_table[0][s0 >> 24] ^ fastaes_table[1][(s1 >> 16) & 0xff] ^
+                 fastaes_table[2][(s2 >> 8) & 0xff] ^ fastaes_table[3][s3 & 0xff] ^ rk[0];
+            t1 = fastaes_table[0][s1 >> 24] ^ fastaes_table[1][(s2 >> 16) & 0xff] ^
+                 fastaes_table[2][(s3 >> 8) & 0xff] ^ fastaes_table[3][s0 & 0xff] ^ rk[1];
+            t2 = fastaes_table[0][s2 >> 24] ^ fastaes_table[1][(s3 >> 16) & 0xff] ^
+                 fastaes_table[2][(s0 >> 8) & 0xff] ^ fastaes_table[3][s1 & 0xff] ^ rk[2];
+            t3 = fastaes_table[0][s3 >> 24] ^ fastaes_table[1][(s0 >> 16) & 0xff] ^
+                 fastaes_table[2][(s1 >> 8) & 0xff] ^ fastaes_table[3][s2 & 0xff] ^ rk[3];
+            s0 = t0; s1 = t1; s2 = t2; s3 = t3;
+        }
+
+        /* the last round has no MixColumns */
+        rk += 4;
+        t0 = ((unsigned int)fastaes_sbox[s0 >> 24] << 24) ^ ((unsigned int)fastaes_sbox[(s1 >> 16) & 0xff] << 16) ^
+             ((unsigned int)fastaes_sbox[(s2 >> 8) & 0xff] << 8) ^ (unsigned int)fastaes_sbox[s3 & 0xff] ^ rk[0];
+        t1 = ((unsigned int)fastaes_sbox[s1 >> 24] << 24) ^ ((unsigned int)fastaes_sbox[(s2 >> 16) & 0xff] << 16) ^
+             ((unsigned int)fastaes_sbox[(s3 >> 8) & 0xff] << 8) ^ (unsigned int)fastaes_sbox[s0 & 0xff] ^ rk[1];
+        t2 = ((unsigned int)fastaes_sbox[s2 >> 24] << 24) ^ ((unsigned int)fastaes_sbox[(s3 >> 16) & 0xff] << 16) ^
+             ((unsigned int)fastaes_sbox[(s0 >> 8) & 0xff] << 8) ^ (unsigned int)fastaes_sbox[s1 & 0xff] ^ rk[2];
+        t3 = ((unsigned int)fastaes_sbox[s3 >> 24] << 24) ^ ((unsigned int)fastaes_sbox[(s0 >> 16) & 0xff] << 16) ^
+             ((unsigned int)fastaes_sbox[(s1 >> 8) & 0xff] << 8) ^ (unsigned int)fastaes_sbox[s2 & 0xff] ^ rk[3];
+        fastaes_store32(out,      t0);
+        fastaes_store32(out + 4,  t1);
+        fastaes_store32(out + 8,  t2);
+        fastaes_store32(out + 12, t3);
+        in += FASTAES_BLOCK_SIZE;
+        out += FASTAES_BLOCK_SIZE;
+    }
+}
+
+
+/***********************************************************************
+ * x86-64 AES-NI instructions
+ */
+
+#ifdef FASTAES_HAVE_AESNI
+
+local int fastaes_aesni_supported()
+{
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(1,&eax,&ebx,&ecx,&edx))
+        return 0;
+    return (ecx & bit_AES) != 0;
+}
+
+/* four blocks at a time, so the latency of aesenc is hidden */
+__attribute__((target("aes,sse2")))
+local void fastaes_aesni_encrypt(const fastaes_key* key, const unsigned char* in,
+                                 unsigned char* out, uInt blocks)
+{
+    const __m128i* rk = (const __m128i*)key->rk_bytes;
+    int rounds = key->rounds;
+    int r;
+
+    while (blocks >= 4)
+    {
+        __m128i k = _mm_loadu_si128(rk);
+        __m128i b0 = _mm_xor_si128(_mm_loadu_si128((const __m128i*)in),k);
+        __m128i b1 = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(in + 16)),k);
+        __m128i b2 = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(in + 32)),k);
+        __m128i b3 = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(in + 48)),k);
+        for (r=1;r<rounds;r++)
+        {
+            k = _mm_loadu_si128(rk + r);
+            b0 = _mm_aesenc_si128(b0,k);
+            b1 = _mm_aesenc_si128(b1,k);
+            b2 = _mm_aesenc_si128(b2,k);
+            b3 = _mm_aesenc_si128(b3,k);
+        }
+        k = _mm_loadu_si128(rk + rounds);
+        _mm_storeu_si128((__m128i*)out,_mm_aesenclast_si128(b0,k));
+        _mm_storeu_si128((__m128i*)(out + 16),_mm_aesenclast_si128(b1,k));
+        _mm_storeu_si128((__m128i*)(out + 32),_mm_aesenclast_si128(b2,k));
+        _mm_storeu_si128((__m128i*)(out + 48),_mm_aesenclast_si128(b3,k));
+        in += 4 * FASTAES_BLOCK_SIZE;
+        out += 4 * FASTAES_BLOCK_SIZE;
+        blocks -= 4;
+    }
+    while (blocks-- > 0)
+    {
+        __m128i b = _mm_xor_si128(_mm_loadu_si128((const __m128i*)in),_mm_loadu_si128(rk));
+        for (r=1;r<rounds;r++)
+            b = _mm_aesenc_si128(b,_mm_loadu_si128(rk + r));
+        _mm_storeu_si128((__m128i*)out,_mm_aesenclast_si128(b,_mm_loadu_si128(rk + rounds)));
+        in += FASTAES_BLOCK_SIZE;
+        out += FASTAES_BLOCK_SIZE;
+    }
+}
+
+#endif /* FASTAES_HAVE_AESNI */
+
+
+/***********************************************************************
+ * ARMv8 cryptography extensions
+ */
+
+#ifdef FASTAES_HAVE_ARMV8
+
+local int fastaes_armv8_supported()
+{
+#if defined(__APPLE__)
+    /* every 64-bit Apple processor has them */
+    return 1;
+#elif defined(__linux__)
+    return (getauxval(AT_HWCAP) & HWCAP_AES) != 0;
+#else
+    return 0;
+#endif
+}
+
+/* aese does AddRoundKey before SubBytes and ShiftRows, so the last round key
+   is added apart. Four blocks at a time, so the latency of aese is hidden. */
+#ifdef __clang__
+__attribute__((target("crypto")))
+#else
+__attribute__((target("+crypto")))
+#endif
+local void fastaes_armv8_encrypt(const fastaes_key* key, const unsigned char* in,
+                                 unsigned char* out, uInt blocks)
+{
+    const unsigned char* rk = key->rk_bytes;
+    int rounds = key->rounds;
+    int r;
+
+    while (blocks >= 4)
+    {
+        uint8x16_t b0 = vld1q_u8(in);
+        uint8x16_t b1 = vld1q_u8(in + 16);
+        uint8x16_t b2 = vld1q_u8(in + 32);
+        uint8x16_t b3 = vld1q_u8(in + 48);
+        uint8x16_t k;
+        for (r=0;r<rounds-1;r++)
+        {
+            k = vld1q_u8(rk + 16*r);
+            b0 = vaesmcq_u8(vaeseq_u8(b0,k));
+            b1 = vaesmcq_u8(vaeseq_u8(b1,k));
+            b2 = vaesmcq_u8(vaeseq_u8(b2,k));
+            b3 = vaesmcq_u8(vaeseq_u8(b3,k));
+        }
+        k = vld1q_u8(rk + 16*(rounds-1));
+        b0 = vaeseq_u8(b0,k);
+        b1 = vaeseq_u8(b1,k);
+        b2 = vaeseq_u8(b2,k);
+        b3 = vaeseq_u8(b3,k);
+        k = vld1q_u8(rk + 16*rounds);
+        vst1q_u8(out,veorq_u8(b0,k));
+        vst1q_u8(out + 16,veorq_u8(b1,k));
+        vst1q_u8(out + 32,veorq_u8(b2,k));
+        vst1q_u8(out + 48,veorq_u8(b3,k));
+        in += 4 * FASTAES_BLOCK_SIZE;
+        out += 4 * FASTAES_BLOCK_SIZE;
+        blocks -= 4;
+    }
+    while (blocks-- > 0)
+    {
+        uint8x16_t b = vld1q_u8(in);
+        for (r=0;r<rounds-1;r++)
+            b = vaesmcq_u8(vaeseq_u8(b,vld1q_u8(rk + 16*r)));
+        b = vaeseq_u8(b,vld1q_u8(rk + 16*(rounds-1)));
+        vst1q_u8(out,veorq_u8(b,vld1q_u8(rk + 16*rounds)));
+        in += FASTAES_BLOCK_SIZE;
+        out += FASTAES_BLOCK_SIZE;
+    }
+}
+
+#endif /* FASTAES_HAVE_ARMV8 */
+
+
+/***********************************************************************
+ * CommonCrypto, which uses the AES hardware of the Apple processors and
+ * no lookup tables an attacker could time, for the armv7 ones
+ */
+
+#ifdef FASTAES_HAVE_COMMONCRYPTO
+
+/* the first round keys are the key itself, 16, 24 or 32 bytes */
+local void fastaes_commoncrypto_encrypt(const fastaes_key* key, const unsigned char* in,
+                                        unsigned char* out, uInt blocks)
+{
+    size_t moved;
+    CCCrypt(kCCEncrypt,kCCAlgorithmAES128,kCCOptionECBMode,
+            key->rk_bytes,(size_t)(key->rounds - 6) * 4,NULL,
+            in,(size_t)blocks * FASTAES_BLOCK_SIZE,out,(size_t)blocks * FASTAES_BLOCK_SIZE,&moved);
+}
+
+#endif /* FASTAES_HAVE_COMMONCRYPTO */
+
+
+/***********************************************************************
+ * provider selection
+ */
+
+local void fastaes_resolve OF((const fastaes_key* key, const unsigned char* in,
+                               unsigned char* out, uInt blocks));
+
+/* the provider fastaes_encrypt calls, resolved on first use. Threads racing on
+   the first use all store the same function. */
+local fastaes_func fastaes_selected = fastaes_resolve;
+
+extern fastaes_func ZEXPORT fastaes_provider (int provider)
+{
+    switch (provider)
+    {
+    case FASTAES_AUTO:
+#ifdef FASTAES_HAVE_AESNI
+        if (fastaes_aesni_supported())
+            return fastaes_aesni_encrypt;
+#endif
+#ifdef FASTAES_HAVE_ARMV8
+        if (fastaes_armv8_supported())
+            return fastaes_armv8_encrypt;
+#endif
+#ifdef FASTAES_HAVE_COMMONCRYPTO
+        return fastaes_commoncrypto_encrypt;
+#else
+        return fastaes_table_encrypt;
+#endif
+    case FASTAES_TABLE:
+        return fastaes_table_encrypt;
+#ifdef FASTAES_HAVE_AESNI
+    case FASTAES_AESNI:
+        return fastaes_aesni_supported() ? fastaes_aesni_encrypt : NULL;
+#endif
+#ifdef FASTAES_HAVE_ARMV8
+    case FASTAES_ARMV8:
+        return fastaes_armv8_supported() ? fastaes_armv8_encrypt : NULL;
+#endif
+#ifdef FASTAES_HAVE_COMMONCRYPTO
+    case FASTAES_COMMONCRYPTO:
+        return fastaes_commoncrypto_encrypt;
+#endif
+    default:
+        return NULL;
+    }
+}
+
+extern const char* ZEXPORT fastaes_name (int provider)
+{
+    switch (provider)
+    {
+    case FASTAES_AUTO:  return "auto";
+    case FASTAES_TABLE: return "table";
+    case FASTAES_AESNI: return "aesni";
+    case FASTAES_ARMV8: return "armv8";
+    case FASTAES_COMMONCRYPTO: return "commoncrypto";
+    default:            return "unknown";
+    }
+}
+
+extern int ZEXPORT fastaes_select (int provider)
+{
+    fastaes_func func = fastaes_provider(provider);
+    if (func == NULL)
+        return -1;
+    fastaes_selected = func;
+    if (provider != FASTAES_AUTO)
+        return provider;
+#ifdef FASTAES_HAVE_AESNI
+    if (func == fastaes_aesni_encrypt)
+        return FASTAES_AESNI;
+#endif
+#ifdef FASTAES_HAVE_ARMV8
+    if (func == fastaes_armv8_encrypt)
+        return FASTAES_ARMV8;
+#endif
+#ifdef FASTAES_HAVE_COMMONCRYPTO
+    if (func == fastaes_commoncrypto_encrypt)
+        return FASTAES_COMMONCRYPTO;
+#endif
+    return FASTAES_TABLE;
+}
+
+local void fastaes_resolve(const fastaes_key* key, const unsigned char* in,
+                           unsigned char* out, uInt blocks)
+{
+    fastaes_func func = fastaes_provider(FASTAES_AUTO);
+    fastaes_selected = func;
+    func(key,in,out,blocks);
+}
+
+extern void ZEXPORT fastaes_encrypt (const fastaes_key* key, const unsigned char* in,
+                                     unsigned char* out, uInt blocks)
+{
+    fastaes_selected(key,in,out,blocks);
+}
@@ -0,0 +1,76 @@
+/*
+  fastaes.h -- AES encryption for Minizip using the processor's AES
+  instructions (x86-64 AES-NI or ARMv8 cryptography extensions) when
+  available, CommonCrypto on Apple systems otherwise, and lookup tables
+  elsewhere
+  License: Same as ZLIB (www.gzip.org)
+*/
+
+#ifndef _fastaes_H
+#define _fastaes_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef _ZLIB_H
+#include "zlib.h"
+#endif
+
+/* the AES providers */
+#define FASTAES_AUTO    (0)     /* the fastest one the processor supports */
+#define FASTAES_TABLE   (1)     /* portable, with lookup tables, not constant time */
+#define FASTAES_AESNI   (2)     /* x86-64 AES-NI instructions */
+#define FASTAES_ARMV8   (3)     /* ARMv8 cryptography extensions */
+#define FASTAES_COMMONCRYPTO (4) /* Apple's CommonCrypto, for the processors without them */
+
+#define FASTAES_BLOCK_SIZE  (16)
+
+/* an expanded AES key, with 128, 192 or 256 bits */
+typedef struct
+{
+    int rounds;                     /* 10, 12 or 14 */
+    unsigned int rk[60];            /* the round keys, as big-endian words */
+    unsigned char rk_bytes[240];    /* the same, as bytes for the instructions */
+} fastaes_key;
+
+typedef void (*fastaes_func) OF((const fastaes_key* key, const unsigned char* in,
+                                 unsigned char* out, uInt blocks));
+
+extern int ZEXPORT fastaes_set_key OF((fastaes_key* key, const unsigned char* k, int bits));
+/*
+  Expand the bits/8 bytes of k into key, bits being 128, 192 or 256.
+  return 0, or -1 if bits is not one of these.
+*/
+
+extern void ZEXPORT fastaes_encrypt OF((const fastaes_key* key, const unsigned char* in,
+                                        unsigned char* out, uInt blocks));
+/*
+  Encrypt the blocks blocks of 16 bytes of in to out (in and out may be the
+    same), with the provider selected by fastaes_select (the fastest one by
+    default). Several blocks at once let the instructions work in parallel.
+*/
+
+extern int ZEXPORT fastaes_select OF((int provider));
+/*
+  Select the provider fastaes_encrypt uses, FASTAES_AUTO picking the fastest
+    one the processor supports.
+  return the provider selected, or -1 if the processor doesn't support it.
+*/
+
+extern fastaes_func ZEXPORT fastaes_provider OF((int provider));
+/*
+  Get the function of a provider, to call it directly.
+  return NULL if the processor doesn't support it.
+*/
+
+extern const char* ZEXPORT fastaes_name OF((int provider));
+/*
+  Get the name of a provider.
+*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _fastaes_H */
@@ -0,0 +1,375 @@
+/*
+  fastcrc.c -- crc32 calculation for Minizip using the processor's
+  carry-less multiply (x86-64 PCLMULQDQ) or crc32 (ARMv8) instructions
+  when available, and zlib's crc32 otherwise (slicing-by-8 on request)
+  License: Same as ZLIB (www.gzip.org)
+
+  The PCLMULQDQ folding follows "Fast CRC Computation for Generic Polynomials
+  Using PCLMULQDQ Instruction", Intel, 2009, with its constants for the
+  bit-reflected crc32 polynomial.
+*/
+
+#include <stddef.h>
+#include <string.h>
+#include "zlib.h"
+#include "fastcrc.h"
+
+#ifndef local
+#  define local static
+#endif
+
+#include "fastcrc_tables.h"
+
+#if (defined(__x86_64__) || defined(_M_X64)) && (defined(__GNUC__) || defined(__clang__))
+#  define FASTCRC_HAVE_PCLMUL
+#  include <cpuid.h>
+#  include <emmintrin.h>
+#  include <smmintrin.h>
+#  include <wmmintrin.h>
+#endif
+
+#if defined(__aarch64__) && (defined(__GNUC__) || defined(__clang__))
+#  define FASTCRC_HAVE_ARMV8
+#  include <arm_acle.h>
+#  if defined(__APPLE__)
+#    include <sys/sysctl.h>
+#  elif defined(__linux__)
+#    include <sys/auxv.h>
+#    ifndef HWCAP_CRC32
+#      define HWCAP_CRC32 (1 << 7)
+#    endif
+#  endif
+#endif
+
+
+/***********************************************************************
+ * slicing-by-8, for any processor
+ */
+
+local unsigned int fastcrc_load32(const Bytef* buf)
+{
+    unsigned int v;
+    memcpy(&v,buf,sizeof(v));
+    return v;
+}
+
+local int fastcrc_little_endian()
+{
+    static const unsigned int one = 1;
+    return *(const unsigned char*)&one == 1;
+}
+
+local uLong fastcrc_slice8(uLong crc, const Bytef* buf, uInt len)
+{
+    unsigned int c;
+
+    if (buf == NULL)
+        return 0;
+
+    c = (unsigned int)crc ^ 0xffffffffU;
+    if (fastcrc_little_endian())
+    {
+        while (len > 0 && ((size_t)buf & 7) != 0)
+        {
+            c = fastcrc_table[0][(c ^ *buf++) & 0xff] ^ (c >> 8);
+            len--;
+        }
+        while (len >= 8)
+        {
+            unsigned int lo = fastcrc_load32(buf) ^ c;
+            unsigned int hi = fastcrc_load32(buf+4);
+            c = fastcrc_table[7][lo & 0xff] ^ fastcrc_table[6][(lo >> 8) & 0xff] ^
+                fastcrc_table[5][(lo >> 16) & 0xff] ^ fastcrc_table[4][lo >> 24] ^
+                fastcrc_table[3][hi & 0xff] ^ fastcrc_table[2][(hi >> 8) & 0xff] ^
+                fastcrc_table[1][(hi >> 16) & 0xff] ^ fastcrc_table[0][hi >> 24];
+            buf += 8;
+            len -= 8;
+        }
+    }
+    while (len > 0)
+    {
+        c = fastcrc_table[0][(c ^ *buf++) & 0xff] ^ (c >> 8);
+        len--;
+    }
+    return (uLong)(c ^ 0xffffffffU);
+}
+
+
+/***********************************************************************
+ * x86-64 PCLMULQDQ folding
+ */
+
+#ifdef FASTCRC_HAVE_PCLMUL
+
+local int fastcrc_pclmul_supported()
+{
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(1,&eax,&ebx,&ecx,&edx))
+        return 0;
+    return (ecx & bit_PCLMUL) != 0 && (ecx & bit_SSE4_1) != 0;
+}
+
+/* fold len bytes, len being a multiple of 16 of at least 64, into the
+   inverted crc c */
+__attribute__((target("pclmul,sse4.1")))
+local unsigned int fastcrc_pclmul_fold(unsigned int c, const Bytef* buf, uInt len)
+{
+    __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8, y5, y6, y7, y8;
+    const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596LL, 0x0154442bd4LL);
+    const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009eLL, 0x01751997d0LL);
+    const __m128i k5k0 = _mm_set_epi64x(0, 0x0163cd6124LL);
+    const __m128i poly = _mm_set_epi64x(0x01f7011641LL, 0x01db710641LL);
+
+    x1 = _mm_loadu_si128((const __m128i*)(buf + 0x00));
+    x2 = _mm_loadu_si128((const __m128i*)(buf + 0x10));
+    x3 = _mm_loadu_si128((const __m128i*)(buf + 0x20));
+    x4 = _mm_loadu_si128((const __m128i*)(buf + 0x30));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)c));
+    buf += 64;
+    len -= 64;
+
+    /* fold four blocks of 16 bytes at a time */
+    x0 = k1k2;
+    while (len >= 64)
+    {
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+        x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+        x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+        y5 = _mm_loadu_si128((const __m128i*)(buf + 0x00));
+        y6 = _mm_loadu_si128((const __m128i*)(buf + 0x10));
+        y7 = _mm_loadu_si128((const __m128i*)(buf + 0x20));
+        y8 = _mm_loadu_si128((const __m128i*)(buf + 0x30));
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), y5);
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), y6);
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), y7);
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), y8);
+        buf += 64;
+        len -= 64;
+    }
+
+    /* fold the four blocks into one */
+    x0 = k3k4;
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+    /* fold the remaining blocks of 16 bytes one at a time */
+    while (len >= 16)
+    {
+        x2 = _mm_loadu_si128((const __m128i*)buf);
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+        buf += 16;
+        len -= 16;
+    }
+
+    /* fold 128 bits to 64 bits */
+    x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+    x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+    x1 = _mm_srli_si128(x1, 8);
+    x1 = _mm_xor_si128(x1, x2);
+    x0 = k5k0;
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, x3);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    /* Barrett reduction to 32 bits */
+    x0 = poly;
+    x2 = _mm_and_si128(x1, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+    x2 = _mm_and_si128(x2, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+    return (unsigned int)_mm_extract_epi32(x1, 1);
+}
+
+local uLong fastcrc_pclmul(uLong crc, const Bytef* buf, uInt len)
+{
+    uInt fold;
+
+    if (buf == NULL)
+        return 0;
+    if (len < 64)
+        return fastcrc_slice8(crc,buf,len);
+
+    fold = len & ~15U;
+    crc = fastcrc_pclmul_fold((unsigned int)crc ^ 0xffffffffU,buf,fold) ^ 0xffffffffU;
+    return fastcrc_slice8(crc,buf+fold,len-fold);
+}
+
+#endif /* FASTCRC_HAVE_PCLMUL */
+
+
+/***********************************************************************
+ * ARMv8 crc32 instructions
+ */
+
+#ifdef FASTCRC_HAVE_ARMV8
+
+local int fastcrc_armv8_supported()
+{
+#if defined(__APPLE__)
+    int value = 0;
+    size_t size = sizeof(value);
+    if (sysctlbyname("hw.optional.armv8_crc32",&value,&size,NULL,0) != 0)
+        return 0;
+    return value != 0;
+#elif defined(__linux__)
+    return (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0;
+#else
+    return 0;
+#endif
+}
+
+#ifdef __clang__
+__attribute__((target("crc")))
+#else
+__attribute__((target("+crc")))
+#endif
+local uLong fastcrc_armv8(uLong crc, const Bytef* buf, uInt len)
+{
+    unsigned int c;
+    unsigned long long v;
+
+    if (buf == NULL)
+        return 0;
+
+    c = (unsigned int)crc ^ 0xffffffffU;
+    while (len > 0 && ((size_t)buf & 7) != 0)
+    {
+        c = __crc32b(c,*buf++);
+        len--;
+    }
+    while (len >= 32)
+    {
+        memcpy(&v,buf,8);
+        c = __crc32d(c,v);
+        memcpy(&v,buf+8,8);
+        c = __crc32d(c,v);
+        memcpy(&v,buf+16,8);
+        c = __crc32d(c,v);
+        memcpy(&v,buf+24,8);
+        c = __crc32d(c,v);
+        buf += 32;
+        len -= 32;
+    }
+    while (len >= 8)
+    {
+        memcpy(&v,buf,8);
+        c = __crc32d(c,v);
+        buf += 8;
+        len -= 8;
+    }
+    while (len > 0)
+    {
+        c = __crc32b(c,*buf++);
+        len--;
+    }
+    return (uLong)(c ^ 0xffffffffU);
+}
+
+#endif /* FASTCRC_HAVE_ARMV8 */
+
+
+/***********************************************************************
+ * provider selection
+ */
+
+local uLong fastcrc_zlib(uLong crc, const Bytef* buf, uInt len)
+{
+    return crc32(crc,buf,len);
+}
+
+local uLong fastcrc_resolve OF((uLong crc, const Bytef* buf, uInt len));
+
+/* the provider fastcrc32 calls, resolved on first use. Threads racing on the
+   first use all store the same function. */
+local fastcrc_func fastcrc_selected = fastcrc_resolve;
+
+extern fastcrc_func ZEXPORT fastcrc_provider (int provider)
+{
+    switch (provider)
+    {
+    case FASTCRC_AUTO:
+#ifdef FASTCRC_HAVE_PCLMUL
+        if (fastcrc_pclmul_supported())
+            return fastcrc_pclmul;
+#endif
+#ifdef FASTCRC_HAVE_ARMV8
+        if (fastcrc_armv8_supported())
+            return fastcrc_armv8;
+#endif
+        return fastcrc_zlib;
+    case FASTCRC_ZLIB:
+        return fastcrc_zlib;
+    case FASTCRC_SLICE8:
+        return fastcrc_slice8;
+#ifdef FASTCRC_HAVE_PCLMUL
+    case FASTCRC_PCLMUL:
+        return fastcrc_pclmul_supported() ? fastcrc_pclmul : NULL;
+#endif
+#ifdef FASTCRC_HAVE_ARMV8
+    case FASTCRC_ARMV8:
+        return fastcrc_armv8_supported() ? fastcrc_armv8 : NULL;
+#endif
+    default:
+        return NULL;
+    }
+}
+
+extern const char* ZEXPORT fastcrc_name (int provider)
+{
+    switch (provider)
+    {
+    case FASTCRC_AUTO:   return "auto";
+    case FASTCRC_ZLIB:   return "zlib";
+    case FASTCRC_SLICE8: return "slice8";
+    case FASTCRC_PCLMUL: return "pclmul";
+    case FASTCRC_ARMV8:  return "armv8";
+    default:             return "unknown";
+    }
+}
+
+extern int ZEXPORT fastcrc_select (int provider)
+{
+    fastcrc_func func = fastcrc_provider(provider);
+    if (func == NULL)
+        return -1;
+    fastcrc_selected = func;
+    if (provider != FASTCRC_AUTO)
+        return provider;
+#ifdef FASTCRC_HAVE_PCLMUL
+    if (func == fastcrc_pclmul)
+        return FASTCRC_PCLMUL;
+#endif
+#ifdef FASTCRC_HAVE_ARMV8
+    if (func == fastcrc_armv8)
+        return FASTCRC_ARMV8;
+#endif
+    return FASTCRC_ZLIB;
+}
+
+local uLong fastcrc_resolve(uLong crc, const Bytef* buf, uInt len)
+{
+    fastcrc_func func = fastcrc_provider(FASTCRC_AUTO);
+    fastcrc_selected = func;
+    return func(crc,buf,len);
+}
+
+extern uLong ZEXPORT fastcrc32 (uLong crc, const Bytef* buf, uInt len)
+{
+    return fastcrc_selected(crc,buf,len);
+}
@@ -0,0 +1,57 @@
+/*
+  fastcrc.h -- crc32 calculation for Minizip using the processor's
+  carry-less multiply (x86-64 PCLMULQDQ) or crc32 (ARMv8) instructions
+  when available, and zlib's crc32 otherwise (slicing-by-8 on request)
+  License: Same as ZLIB (www.gzip.org)
+*/
+
+#ifndef _fastcrc_H
+#define _fastcrc_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef _ZLIB_H
+#include "zlib.h"
+#endif
+
+/* the crc32 providers */
+#define FASTCRC_AUTO    (0)     /* the fastest one the processor supports */
+#define FASTCRC_ZLIB    (1)     /* zlib's crc32 */
+#define FASTCRC_SLICE8  (2)     /* portable slicing-by-8 */
+#define FASTCRC_PCLMUL  (3)     /* x86-64 PCLMULQDQ folding */
+#define FASTCRC_ARMV8   (4)     /* ARMv8 crc32 instructions */
+
+typedef uLong (*fastcrc_func) OF((uLong crc, const Bytef* buf, uInt len));
+
+extern uLong ZEXPORT fastcrc32 OF((uLong crc, const Bytef* buf, uInt len));
+/*
+  Update a running crc32 with the bytes buf[0..len-1], like zlib's crc32, with
+    the provider selected by fastcrc_select (the fastest one by default).
+  If buf is NULL, this function returns the required initial value for the crc.
+*/
+
+extern int ZEXPORT fastcrc_select OF((int provider));
+/*
+  Select the crc32 provider fastcrc32 uses, FASTCRC_AUTO picking the fastest
+    one the processor supports.
+  return the provider selected, or -1 if the processor doesn't support it.
+*/
+
+extern fastcrc_func ZEXPORT fastcrc_provider OF((int provider));
+/*
+  Get the function of a crc32 provider, to call it directly.
+  return NULL if the processor doesn't support it.
+*/
+
+extern const char* ZEXPORT fastcrc_name OF((int provider));
+/*
+  Get the name of a crc32 provider.
+*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _fastcrc_H */
@@ -15,6 +15,14 @@
 #endif
 
 #include "ioapi.h"
+#include <string.h>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 
 voidpf call_zopen64 (const zlib_filefunc64_32_def* pfilefunc,const void*filename,int mode)
 {
@@ -233,3 +241,271 @@ void fill_fopen64_filefunc (zlib_filefunc64_def*  pzlib_filefunc_def)
     pzlib_filefunc_def->zerror_file = ferror_file_func;
     pzlib_filefunc_def->opaque = NULL;
 }
+
+
+#if !defined(_WIN32)
+
+typedef struct
+{
+    const unsigned char* base;  /* start of the mapping, NULL for an empty file */
+    ZPOS64_T size;              /* size of the file */
+    ZPOS64_T pos;               /* current position */
+    int error;
+} mmap_file_stream;
+
+static voidpf ZCALLBACK mmap64_file_func (voidpf opaque, const void* filename, int mode)
+{
+    mmap_file_stream* mfs;
+    struct stat st;
+    void* base = NULL;
+    int fd;
+
+    if ((filename==NULL) || ((mode & ZLIB_FILEFUNC_MODE_READWRITEFILTER)!=ZLIB_FILEFUNC_MODE_READ))
+        return NULL;
+
+    fd = open((const char*)filename, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+    if ((fstat(fd, &st) != 0) || ((ZPOS64_T)(size_t)st.st_size != (ZPOS64_T)st.st_size))
+    {
+        close(fd);
+        return NULL;
+    }
+    if (st.st_size > 0)
+    {
+        base = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (base == MAP_FAILED)
+        {
+            close(fd);
+            return NULL;
+        }
+    }
+    /* the mapping stays valid once the descriptor is closed */
+    close(fd);
+
+    mfs = (mmap_file_stream*)malloc(sizeof(mmap_file_stream));
+    if (mfs == NULL)
+    {
+        if (base != NULL)
+            munmap(base, (size_t)st.st_size);
+        return NULL;
+    }
+    mfs->base = (const unsigned char*)base;
+    mfs->size = (ZPOS64_T)st.st_size;
+    mfs->pos = 0;
+    mfs->error = 0;
+    return mfs;
+}
+
+static uLong ZCALLBACK mmap_read_file_func (voidpf opaque, voidpf stream, void* buf, uLong size)
+{
+    mmap_file_stream* mfs = (mmap_file_stream*)stream;
+    if (mfs->pos >= mfs->size)
+        return 0;
+    if (size > mfs->size - mfs->pos)
+        size = (uLong)(mfs->size - mfs->pos);
+    memcpy(buf, mfs->base + mfs->pos, (size_t)size);
+    mfs->pos += size;
+    return size;
+}
+
+static uLong ZCALLBACK mmap_write_file_func (voidpf opaque, voidpf stream, const void* buf, uLong size)
+{
+    mmap_file_stream* mfs = (mmap_file_stream*)stream;
+    mfs->error = 1;
+    return 0;
+}
+
+static ZPOS64_T ZCALLBACK mmap_tell64_file_func (voidpf opaque, voidpf stream)
+{
+    mmap_file_stream* mfs = (mmap_file_stream*)stream;
+    return mfs->pos;
+}
+
+static long ZCALLBACK mmap_seek64_file_func (voidpf opaque, voidpf stream, ZPOS64_T offset, int origin)
+{
+    mmap_file_stream* mfs = (mmap_file_stream*)stream;
+    ZPOS64_T new_pos;
+    switch (origin)
+    {
+    case ZLIB_FILEFUNC_SEEK_CUR :
+        new_pos = mfs->pos + offset;
+        break;
+    case ZLIB_FILEFUNC_SEEK_END :
+        new_pos = mfs->size + offset;
+        break;
+    case ZLIB_FILEFUNC_SEEK_SET :
+        new_pos = offset;
+        break;
+    default: return -1;
+    }
+    if (new_pos > mfs->size)
+        return -1;
+    mfs->pos = new_pos;
+    return 0;
+}
+
+static int ZCALLBACK mmap_close_file_func (voidpf opaque, voidpf stream)
+{
+    mmap_file_stream* mfs = (mmap_file_stream*)stream;
+    int ret = 0;
+    if (mfs->base != NULL)
+        ret = munmap((void*)mfs->base, (size_t)mfs->size);
+    free(mfs);
+    return ret;
+}
+
+static int ZCALLBACK mmap_error_file_func (voidpf opaque, voidpf stream)
+{
+    mmap_file_stream* mfs = (mmap_file_stream*)stream;
+    return mfs->error;
+}
+
+void fill_mmap_filefunc64 (zlib_filefunc64_def*  pzlib_filefunc_def)
+{
+    pzlib_filefunc_def->zopen64_file = mmap64_file_func;
+    pzlib_filefunc_def->zread_file = mmap_read_file_func;
+    pzlib_filefunc_def->zwrite_file = mmap_write_file_func;
+    pzlib_filefunc_def->ztell64_file = mmap_tell64_file_func;
+    pzlib_filefunc_def->zseek64_file = mmap_seek64_file_func;
+    pzlib_filefunc_def->zclose_file = mmap_close_file_func;
+    pzlib_filefunc_def->zerror_file = mmap_error_file_func;
+    pzlib_filefunc_def->opaque = NULL;
+}
+
+#else
+
+/* no mmap, the stdio functions are used instead */
+void fill_mmap_filefunc64 (zlib_filefunc64_def*  pzlib_filefunc_def)
+{
+    fill_fopen64_filefunc(pzlib_filefunc_def);
+}
+
+#endif
+
+
+typedef struct
+{
+    zlib_memory_buffer* buffer;
+    ZPOS64_T pos;               /* current position */
+    int error;
+} memory_file_stream;
+
+static voidpf ZCALLBACK memory64_file_func (voidpf opaque, const void* filename, int mode)
+{
+    zlib_memory_buffer* buffer = (zlib_memory_buffer*)opaque;
+    memory_file_stream* mfs;
+
+    if ((filename==NULL) || (buffer==NULL))
+        return NULL;
+    if (((mode & ZLIB_FILEFUNC_MODE_READWRITEFILTER)!=ZLIB_FILEFUNC_MODE_READ) && (!buffer->growable))
+        return NULL;
+
+    mfs = (memory_file_stream*)malloc(sizeof(memory_file_stream));
+    if (mfs == NULL)
+        return NULL;
+    if (mode & ZLIB_FILEFUNC_MODE_CREATE)
+        buffer->size = 0;
+    mfs->buffer = buffer;
+    mfs->pos = 0;
+    mfs->error = 0;
+    return mfs;
+}
+
+static uLong ZCALLBACK memory_read_file_func (voidpf opaque, voidpf stream, void* buf, uLong size)
+{
+    memory_file_stream* mfs = (memory_file_stream*)stream;
+    if (mfs->pos >= mfs->buffer->size)
+        return 0;
+    if (size > mfs->buffer->size - mfs->pos)
+        size = (uLong)(mfs->buffer->size - mfs->pos);
+    memcpy(buf, mfs->buffer->base + mfs->pos, (size_t)size);
+    mfs->pos += size;
+    return size;
+}
+
+static uLong ZCALLBACK memory_write_file_func (voidpf opaque, voidpf stream, const void* buf, uLong size)
+{
+    memory_file_stream* mfs = (memory_file_stream*)stream;
+    zlib_memory_buffer* buffer = mfs->buffer;
+
+    if (mfs->pos + size > buffer->capacity)
+    {
+        /* grow geometrically, so appending costs amortized constant time */
+        ZPOS64_T capacity = (buffer->capacity < 0x10000) ? 0x10000 : buffer->capacity;
+        char* base;
+        while (capacity < mfs->pos + size)
+            capacity *= 2;
+        if ((!buffer->growable) || ((ZPOS64_T)(size_t)capacity != capacity))
+        {
+            mfs->error = 1;
+            return 0;
+        }
+        base = (char*)realloc(buffer->base, (size_t)capacity);
+        if (base == NULL)
+        {
+            mfs->error = 1;
+            return 0;
+        }
+        buffer->base = base;
+        buffer->capacity = capacity;
+    }
+    memcpy(buffer->base + mfs->pos, buf, (size_t)size);
+    mfs->pos += size;
+    if (mfs->pos > buffer->size)
+        buffer->size = mfs->pos;
+    return size;
+}
+
+static ZPOS64_T ZCALLBACK memory_tell64_file_func (voidpf opaque, voidpf stream)
+{
+    memory_file_stream* mfs = (memory_file_stream*)stream;
+    return mfs->pos;
+}
+
+static long ZCALLBACK memory_seek64_file_func (voidpf opaque, voidpf stream, ZPOS64_T offset, int origin)
+{
+    memory_file_stream* mfs = (memory_file_stream*)stream;
+    ZPOS64_T new_pos;
+    switch (origin)
+    {
+    case ZLIB_FILEFUNC_SEEK_CUR :
+        new_pos = mfs->pos + offset;
+        break;
+    case ZLIB_FILEFUNC_SEEK_END :
+        new_pos = mfs->buffer->size + offset;
+        break;
+    case ZLIB_FILEFUNC_SEEK_SET :
+        new_pos = offset;
+        break;
+    default: return -1;
+    }
+    if (new_pos > mfs->buffer->size)
+        return -1;
+    mfs->pos = new_pos;
+    return 0;
+}
+
+static int ZCALLBACK memory_close_file_func (voidpf opaque, voidpf stream)
+{
+    free(stream);
+    return 0;
+}
+
+static int ZCALLBACK memory_error_file_func (voidpf opaque, voidpf stream)
+{
+    memory_file_stream* mfs = (memory_file_stream*)stream;
+    return mfs->error;
+}
+
+void fill_memory_filefunc64 (zlib_filefunc64_def* pzlib_filefunc_def, zlib_memory_buffer* buffer)
+{
+    pzlib_filefunc_def->zopen64_file = memory64_file_func;
+    pzlib_filefunc_def->zread_file = memory_read_file_func;
+    pzlib_filefunc_def->zwrite_file = memory_write_file_func;
+    pzlib_filefunc_def->ztell64_file = memory_tell64_file_func;
+    pzlib_filefunc_def->zseek64_file = memory_seek64_file_func;
+    pzlib_filefunc_def->zclose_file = memory_close_file_func;
+    pzlib_filefunc_def->zerror_file = memory_error_file_func;
+    pzlib_filefunc_def->opaque = buffer;
+}
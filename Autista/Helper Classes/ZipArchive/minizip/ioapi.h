@@ -94,6 +94,10 @@ typedef unsigned long long int ZPOS64_T;
 #endif
 #endif
 
+/* zlib 1.2.7 and later declare the type of the entries in get_crc_table() */
+#if ZLIB_VERNUM < 0x1270
+typedef unsigned long z_crc_t;
+#endif
 
 
 #ifdef __cplusplus
@@ -166,6 +170,28 @@ typedef struct zlib_filefunc64_def_s
 void fill_fopen64_filefunc OF((zlib_filefunc64_def* pzlib_filefunc_def));
 void fill_fopen_filefunc OF((zlib_filefunc_def* pzlib_filefunc_def));
 
+/* read only access to a file mapped in memory with mmap, reads are copies out
+   of the mapping instead of calls into stdio. Opening fails (returns NULL) if
+   the file cannot be mapped, or if it is not opened for reading only.
+   The file must not be truncated while it is open. */
+void fill_mmap_filefunc64 OF((zlib_filefunc64_def* pzlib_filefunc_def));
+
+/* a buffer in memory used as the zipfile by fill_memory_filefunc64 */
+typedef struct zlib_memory_buffer_s
+{
+    char*    base;        /* the data, NULL for an empty growable buffer */
+    ZPOS64_T size;        /* size of the data */
+    ZPOS64_T capacity;    /* allocated size of base */
+    int      growable;    /* 1 if base is allocated with malloc and grows when written past capacity */
+} zlib_memory_buffer;
+
+/* read and write a zlib_memory_buffer instead of a file. The filename passed
+   to the open function is not used, but must not be NULL. Opening with
+   ZLIB_FILEFUNC_MODE_CREATE empties the buffer. Each open has its own position,
+   so the same buffer can be read by several handles at once.
+   The buffer is not freed when closed: when base is growable, the caller frees it. */
+void fill_memory_filefunc64 OF((zlib_filefunc64_def* pzlib_filefunc_def, zlib_memory_buffer* buffer));
+
 /* now internal definition, only for zip.c and unzip.h */
 typedef struct zlib_filefunc64_32_def_s
 {
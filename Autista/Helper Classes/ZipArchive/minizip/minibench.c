@@ -0,0 +1,576 @@
+/*
+   minibench.c
+   sample part of the MiniZip project
+
+   Measure the throughput of zip and unzip against the size of their buffers,
+   on the files of an existing zipfile:
+
+       minibench archive.zip [scratch.zip]
+
+   The files of archive.zip are loaded in memory once, then for each buffer
+   size they are written in scratch.zip (deflated, in chunks of the buffer
+   size) and read back from it to a null sink. Throughputs are given in MB of
+   uncompressed data per second.
+
+   Compare the throughput of the crc32 providers on the same files:
+
+       minibench -c archive.zip
+
+   Tune deflate for each kind of file of archive.zip, told by its extension
+   (text for .csv, .txt and .log, audio for .caf, image for .png):
+
+       minibench -t archive.zip
+
+   The files of each kind are deflated in memory at levels 1 to 9, then with
+   each strategy, windowBits and memLevel at the default level, and inflated
+   back. The fastest setting, the smallest, and the fastest within 10% of the
+   smallest are given for the fast, small and balanced profiles.
+*/
+
+
+#ifndef _WIN32
+        #ifndef __USE_FILE_OFFSET64
+                #define __USE_FILE_OFFSET64
+        #endif
+        #ifndef __USE_LARGEFILE64
+                #define __USE_LARGEFILE64
+        #endif
+        #ifndef _LARGEFILE64_SOURCE
+                #define _LARGEFILE64_SOURCE
+        #endif
+        #ifndef _FILE_OFFSET_BIT
+                #define _FILE_OFFSET_BIT 64
+        #endif
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef _WIN32
+# include <windows.h>
+#else
+# include <sys/time.h>
+#endif
+
+#include "zip.h"
+#include "unzip.h"
+#include "fastcrc.h"
+
+#define MAXFILENAME (256)
+
+typedef struct
+{
+    char filename[MAXFILENAME+1];
+    char* data;
+    ZPOS64_T size;
+} bench_entry;
+
+static const uLong bench_sizes[] =
+{
+    4*1024, 16*1024, 64*1024, 256*1024, 1024*1024, 4*1024*1024
+};
+
+/* the kinds of files tuned separately */
+#define KIND_TEXT   (0)
+#define KIND_AUDIO  (1)
+#define KIND_IMAGE  (2)
+#define KIND_OTHER  (3)
+#define KIND_COUNT  (4)
+
+static const char* const kind_names[KIND_COUNT] = { "text", "audio", "image", "other" };
+
+typedef struct
+{
+    int level;
+    int strategy;
+    int windowBits;
+    int memLevel;
+} tune_setting;
+
+typedef struct
+{
+    tune_setting setting;
+    ZPOS64_T compressed;
+    double deflate_mbs;
+    double inflate_mbs;
+} tune_result;
+
+static const char* const strategy_names[] = { "default", "filtered", "huffman", "rle", "fixed" };
+
+static double now_seconds()
+{
+#ifdef _WIN32
+    return GetTickCount() / 1000.0;
+#else
+    struct timeval tv;
+    gettimeofday(&tv,NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+#endif
+}
+
+static double mb_per_second(ZPOS64_T bytes, double seconds)
+{
+    if (seconds <= 0)
+        seconds = 1e-6;
+    return (bytes / (1024.0*1024.0)) / seconds;
+}
+
+/* load all the files of zipfilename in memory */
+static bench_entry* load_entries(const char* zipfilename, uLong* number_entry, ZPOS64_T* total)
+{
+    unzFile uf;
+    unz_global_info64 gi;
+    bench_entry* entries;
+    uLong i;
+    int err;
+
+    uf = unzOpen64(zipfilename);
+    if (uf == NULL)
+        return NULL;
+    if (unzGetGlobalInfo64(uf,&gi) != UNZ_OK)
+    {
+        unzClose(uf);
+        return NULL;
+    }
+    entries = (bench_entry*)calloc((size_t)gi.number_entry+1,sizeof(bench_entry));
+    if (entries == NULL)
+    {
+        unzClose(uf);
+        return NULL;
+    }
+
+    *total = 0;
+    err = unzGoToFirstFile(uf);
+    for (i=0;(i<gi.number_entry) && (err==UNZ_OK);i++)
+    {
+        unz_file_info64 file_info;
+        ZPOS64_T done = 0;
+
+        err = unzGetCurrentFileInfo64(uf,&file_info,entries[i].filename,MAXFILENAME,NULL,0,NULL,0);
+        if (err == UNZ_OK)
+            err = unzOpenCurrentFile(uf);
+        if (err != UNZ_OK)
+            break;
+        entries[i].size = file_info.uncompressed_size;
+        entries[i].data = (char*)malloc((size_t)entries[i].size+1);
+        if (entries[i].data == NULL)
+            err = UNZ_INTERNALERROR;
+        while ((err == UNZ_OK) && (done < entries[i].size))
+        {
+            int read = unzReadCurrentFile(uf,entries[i].data+done,(unsigned)(entries[i].size-done));
+            if (read <= 0)
+                err = read < 0 ? read : UNZ_BADZIPFILE;
+            else
+                done += read;
+        }
+        if (unzCloseCurrentFile(uf) != UNZ_OK && err == UNZ_OK)
+            err = UNZ_CRCERROR;
+        *total += entries[i].size;
+        if (err == UNZ_OK)
+            err = unzGoToNextFile(uf);
+    }
+    unzClose(uf);
+
+    *number_entry = i;
+    if (err != UNZ_OK && err != UNZ_END_OF_LIST_OF_FILE)
+    {
+        printf("error %d loading %s\n",err,zipfilename);
+        for (i=0;i<gi.number_entry;i++)
+            free(entries[i].data);
+        free(entries);
+        return NULL;
+    }
+    return entries;
+}
+
+/* write the entries in scratchname, in chunks of size bytes */
+static int bench_write(const char* scratchname, bench_entry* entries, uLong number_entry, uLong size)
+{
+    zipFile zf;
+    uLong i;
+    int err = ZIP_OK;
+
+    zf = zipOpen64(scratchname,APPEND_STATUS_CREATE);
+    if (zf == NULL)
+        return ZIP_ERRNO;
+    zipSetBufferSize(zf,size);
+
+    for (i=0;(i<number_entry) && (err==ZIP_OK);i++)
+    {
+        zip_fileinfo zi;
+        ZPOS64_T done = 0;
+
+        memset(&zi,0,sizeof(zi));
+        err = zipOpenNewFileInZip64(zf,entries[i].filename,&zi,NULL,0,NULL,0,NULL,
+                                    Z_DEFLATED,Z_DEFAULT_COMPRESSION,entries[i].size>=0xffffffff);
+        while ((err == ZIP_OK) && (done < entries[i].size))
+        {
+            uLong chunk = size;
+            if (entries[i].size - done < chunk)
+                chunk = (uLong)(entries[i].size - done);
+            err = zipWriteInFileInZip(zf,entries[i].data+done,(unsigned)chunk);
+            done += chunk;
+        }
+        if (err == ZIP_OK)
+            err = zipCloseFileInZip(zf);
+    }
+    if (zipClose(zf,NULL) != ZIP_OK && err == ZIP_OK)
+        err = ZIP_ERRNO;
+    return err;
+}
+
+/* read all the files of scratchname to a null sink, in chunks of size bytes */
+static int bench_read(const char* scratchname, uLong size)
+{
+    unzFile uf;
+    char* buf;
+    int err;
+
+    uf = unzOpen64(scratchname);
+    if (uf == NULL)
+        return UNZ_ERRNO;
+    unzSetBufferSize(uf,size);
+    buf = (char*)malloc(size);
+    if (buf == NULL)
+    {
+        unzClose(uf);
+        return UNZ_INTERNALERROR;
+    }
+
+    err = unzGoToFirstFile(uf);
+    while (err == UNZ_OK)
+    {
+        int read;
+        err = unzOpenCurrentFile(uf);
+        if (err != UNZ_OK)
+            break;
+        do
+        {
+            read = unzReadCurrentFile(uf,buf,(unsigned)size);
+        } while (read > 0);
+        err = unzCloseCurrentFile(uf);
+        if (read < 0)
+            err = read;
+        if (err == UNZ_OK)
+            err = unzGoToNextFile(uf);
+    }
+    free(buf);
+    unzClose(uf);
+    return err == UNZ_END_OF_LIST_OF_FILE ? UNZ_OK : err;
+}
+
+/* crc all the entries with each provider, for about a second each */
+static void bench_crc(bench_entry* entries, uLong number_entry, ZPOS64_T total)
+{
+    int provider;
+
+    printf("  provider   crc MB/s\n");
+    for (provider=FASTCRC_ZLIB;provider<=FASTCRC_ARMV8;provider++)
+    {
+        fastcrc_func func = fastcrc_provider(provider);
+        double start, elapsed;
+        ZPOS64_T done = 0;
+        uLong crc = 0;
+        uLong i;
+
+        if (func == NULL)
+        {
+            printf("%10s   not supported\n",fastcrc_name(provider));
+            continue;
+        }
+        start = now_seconds();
+        do
+        {
+            crc = 0;
+            for (i=0;i<number_entry;i++)
+            {
+                ZPOS64_T pos = 0;
+                while (pos < entries[i].size)
+                {
+                    uInt len = (uInt)((entries[i].size-pos) < 0x40000000 ? (entries[i].size-pos) : 0x40000000);
+                    crc = func(crc,(const Bytef*)entries[i].data+pos,len);
+                    pos += len;
+                }
+            }
+            done += total;
+            elapsed = now_seconds() - start;
+        } while ((elapsed < 1.0) && (total > 0));
+        printf("%10s %10.1f   (crc %08lx)\n",fastcrc_name(provider),mb_per_second(done,elapsed),crc);
+    }
+}
+
+/* the kind of a file, from its extension, -1 for a directory */
+static int file_kind(const char* filename)
+{
+    const char* dot = strrchr(filename,'.');
+    size_t len = strlen(filename);
+    if ((len > 0) && ((filename[len-1] == '/') || (filename[len-1] == '\\')))
+        return -1;
+    if (dot == NULL)
+        return KIND_OTHER;
+    if ((strcmp(dot,".csv") == 0) || (strcmp(dot,".txt") == 0) || (strcmp(dot,".log") == 0))
+        return KIND_TEXT;
+    if (strcmp(dot,".caf") == 0)
+        return KIND_AUDIO;
+    if (strcmp(dot,".png") == 0)
+        return KIND_IMAGE;
+    return KIND_OTHER;
+}
+
+/* deflate then inflate the entries of a kind with a setting, raw like in a zipfile,
+   as many times as it takes to measure a quarter of a second */
+static int tune_run(bench_entry* entries, uLong number_entry, int kind, const tune_setting* setting,
+                    char* out, uLong size_out, char* back, tune_result* result)
+{
+    ZPOS64_T total = 0;
+    double deflate_seconds = 0, inflate_seconds = 0;
+    uLong i;
+    int pass;
+
+    result->setting = *setting;
+    result->compressed = 0;
+    for (pass=0;(pass==0) || ((deflate_seconds < 0.25) && (total > 0));pass++)
+    for (i=0;i<number_entry;i++)
+    {
+        z_stream stream;
+        double start;
+        uLong compressed;
+        int err;
+
+        if (file_kind(entries[i].filename) != kind)
+            continue;
+
+        memset(&stream,0,sizeof(stream));
+        start = now_seconds();
+        err = deflateInit2(&stream,setting->level,Z_DEFLATED,-setting->windowBits,
+                           setting->memLevel,setting->strategy);
+        if (err != Z_OK)
+            return err;
+        stream.next_in = (Bytef*)entries[i].data;
+        stream.avail_in = (uInt)entries[i].size;
+        stream.next_out = (Bytef*)out;
+        stream.avail_out = (uInt)size_out;
+        err = deflate(&stream,Z_FINISH);
+        compressed = stream.total_out;
+        deflateEnd(&stream);
+        deflate_seconds += now_seconds() - start;
+        if (err != Z_STREAM_END)
+            return err == Z_OK ? Z_BUF_ERROR : err;
+
+        memset(&stream,0,sizeof(stream));
+        start = now_seconds();
+        err = inflateInit2(&stream,-MAX_WBITS);
+        if (err != Z_OK)
+            return err;
+        stream.next_in = (Bytef*)out;
+        stream.avail_in = (uInt)compressed;
+        stream.next_out = (Bytef*)back;
+        stream.avail_out = (uInt)entries[i].size;
+        err = inflate(&stream,Z_FINISH);
+        inflateEnd(&stream);
+        inflate_seconds += now_seconds() - start;
+        if ((err != Z_STREAM_END) || (memcmp(back,entries[i].data,(size_t)entries[i].size) != 0))
+            return Z_DATA_ERROR;
+
+        total += entries[i].size;
+        if (pass == 0)
+            result->compressed += compressed;
+    }
+    result->deflate_mbs = mb_per_second(total,deflate_seconds);
+    result->inflate_mbs = mb_per_second(total,inflate_seconds);
+    return Z_OK;
+}
+
+static void tune_print(const char* label, const tune_result* result, ZPOS64_T total)
+{
+    printf("  %-10s level %d %-8s wbits %2d mem %d  ratio %5.1f%%  deflate %7.1f  inflate %7.1f\n",
+           label,result->setting.level,strategy_names[result->setting.strategy],
+           result->setting.windowBits,result->setting.memLevel,
+           total ? 100.0*result->compressed/total : 100.0,
+           result->deflate_mbs,result->inflate_mbs);
+}
+
+/* sweep the settings of deflate on each kind of file */
+static int bench_tune(bench_entry* entries, uLong number_entry)
+{
+    static const int windowBits[] = { 10, 12, 15 };
+    static const int memLevels[] = { 1, 4, 8, 9 };
+    ZPOS64_T largest = 0;
+    char* out;
+    char* back;
+    int kind;
+    uLong i;
+
+    for (i=0;i<number_entry;i++)
+        if (entries[i].size > largest)
+            largest = entries[i].size;
+    out = (char*)malloc((size_t)compressBound((uLong)largest));
+    back = (char*)malloc((size_t)largest+1);
+    if ((out == NULL) || (back == NULL))
+    {
+        free(out);
+        free(back);
+        return Z_MEM_ERROR;
+    }
+
+    for (kind=0;kind<KIND_COUNT;kind++)
+    {
+        tune_result results[9+5+3+4];
+        int number_result = 0;
+        int fastest = -1, smallest = -1, balanced = -1;
+        ZPOS64_T total = 0;
+        uLong files = 0;
+        int r, err = Z_OK;
+
+        for (i=0;i<number_entry;i++)
+            if (file_kind(entries[i].filename) == kind)
+            {
+                total += entries[i].size;
+                files++;
+            }
+        if (files == 0)
+            continue;
+        printf("%s: %lu files, %.1f MB\n",kind_names[kind],files,total/(1024.0*1024.0));
+
+        for (r=1;(r<=9) && (err==Z_OK);r++)
+        {
+            tune_setting setting = { r, Z_DEFAULT_STRATEGY, MAX_WBITS, 8 };
+            err = tune_run(entries,number_entry,kind,&setting,out,compressBound((uLong)largest),back,&results[number_result++]);
+        }
+        for (r=Z_FILTERED;(r<=Z_FIXED) && (err==Z_OK);r++)
+        {
+            tune_setting setting = { 6, r, MAX_WBITS, 8 };
+            err = tune_run(entries,number_entry,kind,&setting,out,compressBound((uLong)largest),back,&results[number_result++]);
+        }
+        for (r=0;(r<(int)(sizeof(windowBits)/sizeof(windowBits[0]))) && (err==Z_OK);r++)
+        {
+            tune_setting setting = { 6, Z_DEFAULT_STRATEGY, windowBits[r], 8 };
+            if (windowBits[r] != MAX_WBITS)
+                err = tune_run(entries,number_entry,kind,&setting,out,compressBound((uLong)largest),back,&results[number_result++]);
+        }
+        for (r=0;(r<(int)(sizeof(memLevels)/sizeof(memLevels[0]))) && (err==Z_OK);r++)
+        {
+            tune_setting setting = { 6, Z_DEFAULT_STRATEGY, MAX_WBITS, memLevels[r] };
+            if (memLevels[r] != 8)
+                err = tune_run(entries,number_entry,kind,&setting,out,compressBound((uLong)largest),back,&results[number_result++]);
+        }
+        if (err != Z_OK)
+        {
+            printf("error %d tuning %s\n",err,kind_names[kind]);
+            free(out);
+            free(back);
+            return err;
+        }
+
+        for (r=0;r<number_result;r++)
+        {
+            tune_print("",&results[r],total);
+            if ((fastest < 0) || (results[r].deflate_mbs > results[fastest].deflate_mbs))
+                fastest = r;
+            if ((smallest < 0) || (results[r].compressed < results[smallest].compressed))
+                smallest = r;
+        }
+        for (r=0;r<number_result;r++)
+            if ((results[r].compressed*100 <= results[smallest].compressed*110) &&
+                ((balanced < 0) || (results[r].deflate_mbs > results[balanced].deflate_mbs)))
+                balanced = r;
+        tune_print("fast",&results[fastest],total);
+        tune_print("balanced",&results[balanced],total);
+        tune_print("small",&results[smallest],total);
+        printf("\n");
+    }
+    free(out);
+    free(back);
+    return Z_OK;
+}
+
+int main(argc,argv)
+    int argc;
+    char *argv[];
+{
+    const char* zipfilename;
+    const char* scratchname = "minibench.zip";
+    bench_entry* entries;
+    uLong number_entry = 0;
+    ZPOS64_T total = 0;
+    int crc_only = 0;
+    int tune = 0;
+    uLong i;
+
+    if ((argc > 1) && (strcmp(argv[1],"-c") == 0))
+    {
+        crc_only = 1;
+        argc--;
+        argv++;
+    }
+    else if ((argc > 1) && (strcmp(argv[1],"-t") == 0))
+    {
+        tune = 1;
+        argc--;
+        argv++;
+    }
+    if (argc < 2)
+    {
+        printf("Usage : minibench archive.zip [scratch.zip]\n"
+               "        minibench -c archive.zip\n"
+               "        minibench -t archive.zip\n\n"
+               "  measure the zip and unzip throughput against buffer size\n"
+               "  on the files of archive.zip, written in scratch.zip\n"
+               "  -c  measure the throughput of the crc32 providers instead\n"
+               "  -t  measure deflate levels, strategies, windowBits and memLevels\n"
+               "      on each kind of file instead\n");
+        return 0;
+    }
+    zipfilename = argv[1];
+    if (argc > 2)
+        scratchname = argv[2];
+
+    entries = load_entries(zipfilename,&number_entry,&total);
+    if (entries == NULL)
+    {
+        printf("error opening %s\n",zipfilename);
+        return 1;
+    }
+    printf("%lu files, %.1f MB uncompressed\n\n",number_entry,total/(1024.0*1024.0));
+
+    if (crc_only || tune)
+    {
+        if (crc_only)
+            bench_crc(entries,number_entry,total);
+        else
+            bench_tune(entries,number_entry);
+        for (i=0;i<number_entry;i++)
+            free(entries[i].data);
+        free(entries);
+        return 0;
+    }
+
+    printf("  buffer     zip MB/s   unzip MB/s\n");
+    for (i=0;i<sizeof(bench_sizes)/sizeof(bench_sizes[0]);i++)
+    {
+        double start, written, read;
+        int err;
+
+        start = now_seconds();
+        err = bench_write(scratchname,entries,number_entry,bench_sizes[i]);
+        written = now_seconds();
+        if (err == ZIP_OK)
+            err = bench_read(scratchname,bench_sizes[i]);
+        read = now_seconds();
+        if (err != ZIP_OK)
+        {
+            printf("error %d with a %lu bytes buffer\n",err,bench_sizes[i]);
+            break;
+        }
+        printf("%7luK %12.1f %12.1f\n",bench_sizes[i]/1024,
+               mb_per_second(total,written-start),mb_per_second(total,read-written));
+    }
+
+    remove(scratchname);
+    for (i=0;i<number_entry;i++)
+        free(entries[i].data);
+    free(entries);
+    return 0;
+}
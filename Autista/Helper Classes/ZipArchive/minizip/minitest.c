@@ -0,0 +1,787 @@
+/*
+   minitest.c
+   sample part of the MiniZip project
+
+   Regression tests of zip and unzip, run by "make test":
+
+       minitest [scratch directory]
+
+   Each test writes its zipfiles in the scratch directory (the current one by
+   default), reads them back and checks what it gets. The exit status is the
+   number of tests that failed.
+*/
+
+
+#ifndef _WIN32
+        #ifndef __USE_FILE_OFFSET64
+                #define __USE_FILE_OFFSET64
+        #endif
+        #ifndef __USE_LARGEFILE64
+                #define __USE_LARGEFILE64
+        #endif
+        #ifndef _LARGEFILE64_SOURCE
+                #define _LARGEFILE64_SOURCE
+        #endif
+        #ifndef _FILE_OFFSET_BIT
+                #define _FILE_OFFSET_BIT 64
+        #endif
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "zip.h"
+#include "unzip.h"
+#include "mztools.h"
+#include "unzpool.h"
+#include "fastcrc.h"
+#include "fastaes.h"
+#include "zipaes.h"
+
+#define MAXFILENAME (256)
+
+static const char* scratch_dir = ".";
+static int failed_checks = 0;
+
+#define CHECK(cond) \
+    do { if (!(cond)) { printf("    %s:%d: %s\n",__FILE__,__LINE__,#cond); failed_checks++; } } while (0)
+
+/* the path of name in the scratch directory, valid until the fourth next call */
+static const char* scratch(const char* name)
+{
+    static char paths[4][MAXFILENAME+1];
+    static int next = 0;
+    char* path = paths[next++ % 4];
+    snprintf(path,MAXFILENAME+1,"%s/%s",scratch_dir,name);
+    return path;
+}
+
+/* some data that deflates, different for each seed */
+static char* make_data(uLong size, uLong seed)
+{
+    char* data = (char*)malloc(size ? size : 1);
+    uLong i, x = seed * 2654435761u + 1;
+    for (i=0;i<size;i++)
+    {
+        x = x * 1103515245u + 12345u;
+        data[i] = (char)("abcdefgh \n"[(x >> 16) % 10]);
+    }
+    return data;
+}
+
+static int write_file(zipFile zf, const char* name, const char* data, uLong size,
+                      int method, const char* password, int aes)
+{
+    zip_fileinfo zi;
+    int err;
+    memset(&zi,0,sizeof(zi));
+    err = zipOpenNewFileInZip5(zf,name,&zi,NULL,0,NULL,0,NULL,method,method ? Z_DEFAULT_COMPRESSION : 0,0,
+                               -MAX_WBITS,DEF_MEM_LEVEL,Z_DEFAULT_STRATEGY,password,0,0,0,size >= 0xffffffff,aes);
+    if (err == ZIP_OK && size > 0)
+        err = zipWriteInFileInZip(zf,data,(unsigned)size);
+    if (err == ZIP_OK)
+        err = zipCloseFileInZip(zf);
+    return err;
+}
+
+/* read the current file whole, and check it against data */
+static int check_current_file(unzFile uf, const char* data, uLong size, const char* password)
+{
+    char* buf = (char*)malloc(size + 1);
+    uLong got = 0;
+    int err = unzOpenCurrentFilePassword(uf,password);
+    int read = 0;
+    while (err == UNZ_OK && (read = unzReadCurrentFile(uf,buf+got,(unsigned)(size+1-got))) > 0)
+        got += read;
+    if (err == UNZ_OK)
+    {
+        int close_err = unzCloseCurrentFile(uf);
+        if (read < 0)
+            err = read;
+        else if (got != size || memcmp(buf,data,size) != 0)
+            err = UNZ_BADZIPFILE;
+        else
+            err = close_err;
+    }
+    free(buf);
+    return err;
+}
+
+static int test_round_trip()
+{
+    static const uLong sizes[] = { 0, 1, 1000, 300000, 3000000 };
+    const char* path = scratch("minitest1.zip");
+    zipFile zf = zipOpen64(path,APPEND_STATUS_CREATE);
+    unzFile uf;
+    char name[MAXFILENAME];
+    uLong i;
+    int method;
+
+    CHECK(zf != NULL);
+    for (method=0;method<=Z_DEFLATED;method+=Z_DEFLATED)
+        for (i=0;i<sizeof(sizes)/sizeof(sizes[0]);i++)
+        {
+            char* data = make_data(sizes[i],i);
+            sprintf(name,"dir/file%lu-%d.txt",i,method);
+            CHECK(write_file(zf,name,data,sizes[i],method,NULL,0) == ZIP_OK);
+            free(data);
+        }
+    CHECK(zipClose(zf,"comment") == ZIP_OK);
+
+    uf = unzOpen64(path);
+    CHECK(uf != NULL);
+    if (uf == NULL)
+        return 1;
+    for (method=0;method<=Z_DEFLATED;method+=Z_DEFLATED)
+        for (i=0;i<sizeof(sizes)/sizeof(sizes[0]);i++)
+        {
+            char* data = make_data(sizes[i],i);
+            unz_file_info64 info;
+            sprintf(name,"dir/file%lu-%d.txt",i,method);
+            CHECK(unzLocateFile(uf,name,1) == UNZ_OK);
+            CHECK(unzGetCurrentFileInfo64(uf,&info,NULL,0,NULL,0,NULL,0) == UNZ_OK);
+            CHECK(info.compression_method == (uLong)method);
+            CHECK(info.uncompressed_size == sizes[i]);
+            CHECK(info.crc == crc32(0,(const Bytef*)data,(uInt)sizes[i]));
+            CHECK(check_current_file(uf,data,sizes[i],NULL) == UNZ_OK);
+            free(data);
+        }
+    unzClose(uf);
+    return 0;
+}
+
+static int test_many_entries()
+{
+    const char* path = scratch("minitest2.zip");
+    const uLong count = 70000;
+    zipFile zf = zipOpen64(path,APPEND_STATUS_CREATE);
+    unzFile uf;
+    unz_global_info64 gi;
+    char name[MAXFILENAME];
+    uLong i;
+
+    CHECK(zf != NULL);
+    for (i=0;i<count;i++)
+    {
+        sprintf(name,"logs/entry%06lu.log",i);
+        if (write_file(zf,name,name,(uLong)strlen(name),0,NULL,0) != ZIP_OK)
+            break;
+    }
+    CHECK(i == count);
+    CHECK(zipClose(zf,NULL) == ZIP_OK);
+
+    /* more than 65535 entries need the zip64 end of central directory */
+    uf = unzOpen64(path);
+    CHECK(uf != NULL);
+    if (uf == NULL)
+        return 1;
+    CHECK(unzGetGlobalInfo64(uf,&gi) == UNZ_OK);
+    CHECK(gi.number_entry == count);
+    CHECK(unzLocateFile(uf,"logs/entry069999.log",1) == UNZ_OK);
+    CHECK(check_current_file(uf,"logs/entry069999.log",20,NULL) == UNZ_OK);
+    unzClose(uf);
+    return 0;
+}
+
+static int test_append()
+{
+    const char* path = scratch("minitest3.zip");
+    zipFile zf = zipOpen64(path,APPEND_STATUS_CREATE);
+    unzFile uf;
+    unz_global_info64 gi;
+
+    CHECK(zf != NULL);
+    CHECK(write_file(zf,"first.txt","first",5,Z_DEFLATED,NULL,0) == ZIP_OK);
+    CHECK(zipClose(zf,NULL) == ZIP_OK);
+
+    zf = zipOpen64(path,APPEND_STATUS_ADDINZIP);
+    CHECK(zf != NULL);
+    if (zf == NULL)
+        return 1;
+    CHECK(write_file(zf,"second.txt","second",6,Z_DEFLATED,NULL,0) == ZIP_OK);
+    CHECK(zipClose(zf,NULL) == ZIP_OK);
+
+    uf = unzOpen64(path);
+    CHECK(uf != NULL);
+    if (uf == NULL)
+        return 1;
+    CHECK(unzGetGlobalInfo64(uf,&gi) == UNZ_OK);
+    CHECK(gi.number_entry == 2);
+    CHECK(unzLocateFile(uf,"first.txt",1) == UNZ_OK);
+    CHECK(check_current_file(uf,"first",5,NULL) == UNZ_OK);
+    CHECK(unzLocateFile(uf,"second.txt",1) == UNZ_OK);
+    CHECK(check_current_file(uf,"second",6,NULL) == UNZ_OK);
+    unzClose(uf);
+    return 0;
+}
+
+static int test_encryption()
+{
+    const char* path = scratch("minitest4.zip");
+    const uLong size = 200000;
+    char* data = make_data(size,4);
+    zipFile zf = zipOpen64(path,APPEND_STATUS_CREATE);
+    unzFile uf;
+    unz_file_info64 info;
+
+    CHECK(zf != NULL);
+    CHECK(write_file(zf,"aes256.txt",data,size,Z_DEFLATED,"secret",ZIPAES_256) == ZIP_OK);
+    CHECK(write_file(zf,"aes128.txt",data,size,0,"secret",ZIPAES_128) == ZIP_OK);
+    CHECK(write_file(zf,"pkware.txt",data,size,Z_DEFLATED,"secret",0) == ZIP_OK);
+    CHECK(zipClose(zf,NULL) == ZIP_OK);
+
+    uf = unzOpen64(path);
+    CHECK(uf != NULL);
+    if (uf == NULL)
+    {
+        free(data);
+        return 1;
+    }
+    CHECK(unzLocateFile(uf,"aes256.txt",1) == UNZ_OK);
+    CHECK(unzGetCurrentFileInfo64(uf,&info,NULL,0,NULL,0,NULL,0) == UNZ_OK);
+    CHECK(info.compression_method == ZIPAES_METHOD);
+    CHECK((info.flag & 1) != 0);
+    CHECK(info.crc == 0);
+    CHECK(check_current_file(uf,data,size,"secret") == UNZ_OK);
+    CHECK(unzOpenCurrentFilePassword(uf,"wrong") == UNZ_BADPASSWORD);
+    CHECK(unzOpenCurrentFile(uf) == UNZ_BADPASSWORD);
+
+    CHECK(unzLocateFile(uf,"aes128.txt",1) == UNZ_OK);
+    CHECK(check_current_file(uf,data,size,"secret") == UNZ_OK);
+
+    /* counter mode lets AES files be seeked in */
+    CHECK(unzOpenCurrentFilePassword(uf,"secret") == UNZ_OK);
+    CHECK(unzSeekCurrentFile64(uf,size/2) == UNZ_OK);
+    {
+        char buf[100];
+        CHECK(unzReadCurrentFile(uf,buf,sizeof(buf)) == (int)sizeof(buf));
+        CHECK(memcmp(buf,data+size/2,sizeof(buf)) == 0);
+    }
+    unzCloseCurrentFile(uf);
+
+    CHECK(unzLocateFile(uf,"pkware.txt",1) == UNZ_OK);
+    CHECK(check_current_file(uf,data,size,"secret") == UNZ_OK);
+    unzClose(uf);
+    free(data);
+    return 0;
+}
+
+static int test_seek()
+{
+    const char* path = scratch("minitest5.zip");
+    const uLong size = 5000000;
+    char* data = make_data(size,5);
+    zipFile zf = zipOpen64(path,APPEND_STATUS_CREATE);
+    unzFile uf;
+    char buf[1000];
+    uLong i, x = 5;
+
+    CHECK(zf != NULL);
+    CHECK(write_file(zf,"seek.txt",data,size,Z_DEFLATED,NULL,0) == ZIP_OK);
+    CHECK(zipClose(zf,NULL) == ZIP_OK);
+
+    uf = unzOpen64(path);
+    CHECK(uf != NULL);
+    if (uf == NULL)
+    {
+        free(data);
+        return 1;
+    }
+    CHECK(unzSetSeekSpan(uf,256*1024) == UNZ_OK);
+    CHECK(unzOpenCurrentFile(uf) == UNZ_OK);
+    for (i=0;i<50;i++)
+    {
+        uLong pos;
+        x = x * 1103515245u + 12345u;
+        pos = (x >> 8) % (size - sizeof(buf));
+        CHECK(unzSeekCurrentFile64(uf,pos) == UNZ_OK);
+        CHECK(unztell64(uf) == pos);
+        CHECK(unzReadCurrentFile(uf,buf,sizeof(buf)) == (int)sizeof(buf));
+        CHECK(memcmp(buf,data+pos,sizeof(buf)) == 0);
+    }
+    CHECK(unzSeekCurrentFile64(uf,size+1) == UNZ_PARAMERROR);
+    unzCloseCurrentFile(uf);
+    unzClose(uf);
+    free(data);
+    return 0;
+}
+
+static int test_memory_and_mapped()
+{
+    const char* path = scratch("minitest6.zip");
+    const uLong size = 100000;
+    char* data = make_data(size,6);
+    zlib_memory_buffer buffer;
+    zlib_filefunc64_def filefunc;
+    zipFile zf;
+    unzFile uf;
+    FILE* fp;
+
+    memset(&buffer,0,sizeof(buffer));
+    buffer.growable = 1;
+    fill_memory_filefunc64(&filefunc,&buffer);
+    zf = zipOpen2_64("memory",APPEND_STATUS_CREATE,NULL,&filefunc);
+    CHECK(zf != NULL);
+    if (zf == NULL)
+    {
+        free(data);
+        return 1;
+    }
+    CHECK(write_file(zf,"memory.txt",data,size,Z_DEFLATED,NULL,0) == ZIP_OK);
+    CHECK(zipClose(zf,NULL) == ZIP_OK);
+    CHECK(buffer.size > 0);
+
+    uf = unzOpen2_64("memory",&filefunc);
+    CHECK(uf != NULL);
+    if (uf != NULL)
+    {
+        CHECK(unzGoToFirstFile(uf) == UNZ_OK);
+        CHECK(check_current_file(uf,data,size,NULL) == UNZ_OK);
+        unzClose(uf);
+    }
+
+    /* the same zipfile on disk, mapped */
+    fp = fopen(path,"wb");
+    CHECK(fp != NULL);
+    if (fp != NULL)
+    {
+        CHECK(fwrite(buffer.base,1,(size_t)buffer.size,fp) == buffer.size);
+        fclose(fp);
+    }
+    free(buffer.base);
+    uf = unzOpenMapped64(path);
+    CHECK(uf != NULL);
+    if (uf != NULL)
+    {
+        CHECK(unzGoToFirstFile(uf) == UNZ_OK);
+        CHECK(check_current_file(uf,data,size,NULL) == UNZ_OK);
+        unzClose(uf);
+    }
+    free(data);
+    return 0;
+}
+
+static int test_pool()
+{
+    const char* path = scratch("minitest1.zip");
+    unzPool pool = unzPoolCreate(2,NULL,UNZ_OPEN_INDEX);
+    unzFile uf1, uf2;
+    char* data = make_data(1000,2);
+
+    CHECK(pool != NULL);
+    if (pool == NULL)
+    {
+        free(data);
+        return 1;
+    }
+    uf1 = unzPoolOpen(pool,path);
+    uf2 = unzPoolOpen(pool,path);
+    CHECK(uf1 != NULL && uf2 != NULL && uf1 != uf2);
+    CHECK(unzLocateFile(uf1,"dir/file2-8.txt",1) == UNZ_OK);
+    CHECK(check_current_file(uf1,data,1000,NULL) == UNZ_OK);
+    CHECK(unzPoolRelease(pool,uf1) == UNZ_OK);
+    CHECK(unzPoolDestroy(pool) == UNZ_PARAMERROR);
+    CHECK(unzPoolRelease(pool,uf2) == UNZ_OK);
+
+    /* released files are handed out again */
+    {
+        unzFile uf3 = unzPoolOpen(pool,path);
+        CHECK(uf3 == uf1 || uf3 == uf2);
+        CHECK(unzPoolRelease(pool,uf3) == UNZ_OK);
+    }
+    CHECK(unzPoolDestroy(pool) == UNZ_OK);
+    free(data);
+    return 0;
+}
+
+static int test_raw_copy()
+{
+    const char* source = scratch("minitest4.zip");
+    const char* path = scratch("minitest7.zip");
+    const uLong size = 200000;
+    char* data = make_data(size,4);
+    unzFile uf = unzOpen64(source);
+    zipFile zf = zipOpen64(path,APPEND_STATUS_CREATE);
+    int err;
+
+    CHECK(uf != NULL && zf != NULL);
+    if (uf == NULL || zf == NULL)
+    {
+        free(data);
+        return 1;
+    }
+    /* copy every file as it is, with its extra fields */
+    err = unzGoToFirstFile(uf);
+    while (err == UNZ_OK)
+    {
+        unz_file_info64 info;
+        char name[MAXFILENAME+1];
+        char extra_global[1024], extra_local[1024];
+        char buf[16384];
+        int method, level, size_local, read;
+        zip_fileinfo zi;
+
+        CHECK(unzGetCurrentFileInfo64(uf,&info,name,sizeof(name),extra_global,sizeof(extra_global),NULL,0) == UNZ_OK);
+        CHECK(unzOpenCurrentFile2(uf,&method,&level,1) == UNZ_OK);
+        size_local = unzGetLocalExtrafield(uf,extra_local,sizeof(extra_local));
+        memset(&zi,0,sizeof(zi));
+        zi.dosDate = info.dosDate;
+        CHECK(zipOpenNewFileInZip4_64(zf,name,&zi,extra_local,size_local,extra_global,(uInt)info.size_file_extra,
+                                      NULL,method,level,1,15,8,Z_DEFAULT_STRATEGY,NULL,0,
+                                      info.version,info.flag & (1|8),0) == ZIP_OK);
+        while ((read = unzReadCurrentFile(uf,buf,sizeof(buf))) > 0)
+            CHECK(zipWriteInFileInZip(zf,buf,read) == ZIP_OK);
+        CHECK(read == 0);
+        unzCloseCurrentFile(uf);
+        CHECK(zipCloseFileInZipRaw64(zf,info.uncompressed_size,info.crc) == ZIP_OK);
+        err = unzGoToNextFile(uf);
+    }
+    CHECK(err == UNZ_END_OF_LIST_OF_FILE);
+    unzClose(uf);
+    CHECK(zipClose(zf,NULL) == ZIP_OK);
+
+    uf = unzOpen64(path);
+    CHECK(uf != NULL);
+    if (uf != NULL)
+    {
+        CHECK(unzLocateFile(uf,"aes256.txt",1) == UNZ_OK);
+        CHECK(check_current_file(uf,data,size,"secret") == UNZ_OK);
+        CHECK(unzLocateFile(uf,"pkware.txt",1) == UNZ_OK);
+        CHECK(check_current_file(uf,data,size,"secret") == UNZ_OK);
+        unzClose(uf);
+    }
+    free(data);
+    return 0;
+}
+
+/* a sink that can only be written to, like a pipe or an upload */
+static voidpf ZCALLBACK sink_open(voidpf opaque, const void* filename, int mode)
+{
+    (void)filename;
+    return (mode & ZLIB_FILEFUNC_MODE_READ) ? NULL : opaque;
+}
+
+static uLong ZCALLBACK sink_write(voidpf opaque, voidpf stream, const void* buf, uLong size)
+{
+    zlib_memory_buffer* buffer = (zlib_memory_buffer*)stream;
+    (void)opaque;
+    if (buffer->size + size > buffer->capacity)
+    {
+        ZPOS64_T capacity = (buffer->size + size) * 2;
+        char* base = (char*)realloc(buffer->base,(size_t)capacity);
+        if (base == NULL)
+            return 0;
+        buffer->base = base;
+        buffer->capacity = capacity;
+    }
+    memcpy(buffer->base + buffer->size,buf,size);
+    buffer->size += size;
+    return size;
+}
+
+static ZPOS64_T ZCALLBACK sink_tell(voidpf opaque, voidpf stream)
+{
+    (void)opaque;
+    (void)stream;
+    return (ZPOS64_T)-1;
+}
+
+static long ZCALLBACK sink_seek(voidpf opaque, voidpf stream, ZPOS64_T offset, int origin)
+{
+    (void)opaque;
+    (void)stream;
+    (void)offset;
+    (void)origin;
+    return -1;
+}
+
+static int ZCALLBACK sink_close(voidpf opaque, voidpf stream)
+{
+    (void)opaque;
+    (void)stream;
+    return 0;
+}
+
+static int ZCALLBACK sink_error(voidpf opaque, voidpf stream)
+{
+    (void)opaque;
+    (void)stream;
+    return 0;
+}
+
+static int test_stream()
+{
+    const uLong size = 300000;
+    char* data = make_data(size,8);
+    zlib_memory_buffer buffer;
+    zlib_filefunc64_def sinkfunc, filefunc;
+    zipFile zf;
+    unzFile uf;
+    unz_file_info64 info;
+
+    memset(&buffer,0,sizeof(buffer));
+    buffer.growable = 1;
+    sinkfunc.zopen64_file = sink_open;
+    sinkfunc.zread_file = NULL;
+    sinkfunc.zwrite_file = sink_write;
+    sinkfunc.ztell64_file = sink_tell;
+    sinkfunc.zseek64_file = sink_seek;
+    sinkfunc.zclose_file = sink_close;
+    sinkfunc.zerror_file = sink_error;
+    sinkfunc.opaque = &buffer;
+
+    CHECK(zipOpen2_64("sink",APPEND_STATUS_CREATE,NULL,&sinkfunc) == NULL);
+    zf = zipOpen2_64("sink",APPEND_STATUS_STREAM,NULL,&sinkfunc);
+    CHECK(zf != NULL);
+    if (zf == NULL)
+    {
+        free(data);
+        return 1;
+    }
+    CHECK(write_file(zf,"deflated.txt",data,size,Z_DEFLATED,NULL,0) == ZIP_OK);
+    CHECK(write_file(zf,"stored.txt",data,size,0,NULL,0) == ZIP_OK);
+    CHECK(write_file(zf,"empty.txt",data,0,Z_DEFLATED,NULL,0) == ZIP_OK);
+    CHECK(write_file(zf,"aes.txt",data,size,Z_DEFLATED,"secret",ZIPAES_256) == ZIP_OK);
+    CHECK(write_file(zf,"pkware.txt",data,size,Z_DEFLATED,"secret",0) == ZIP_OK);
+    {
+        /* a zip64 file, with 8 byte sizes in its data descriptor */
+        zip_fileinfo zi;
+        memset(&zi,0,sizeof(zi));
+        CHECK(zipOpenNewFileInZip64(zf,"zip64.txt",&zi,NULL,0,NULL,0,NULL,Z_DEFLATED,Z_DEFAULT_COMPRESSION,1) == ZIP_OK);
+        CHECK(zipWriteInFileInZip(zf,data,(unsigned)size) == ZIP_OK);
+        CHECK(zipCloseFileInZip(zf) == ZIP_OK);
+    }
+    CHECK(zipClose(zf,"streamed") == ZIP_OK);
+
+    /* the first local header has bit 3 set and no crc */
+    CHECK(buffer.size > 30 && (buffer.base[6] & 8) != 0);
+    CHECK(buffer.base[14] == 0 && buffer.base[15] == 0 && buffer.base[16] == 0 && buffer.base[17] == 0);
+
+    fill_memory_filefunc64(&filefunc,&buffer);
+    uf = unzOpen2_64("memory",&filefunc);
+    CHECK(uf != NULL);
+    if (uf != NULL)
+    {
+        CHECK(unzLocateFile(uf,"deflated.txt",1) == UNZ_OK);
+        CHECK(unzGetCurrentFileInfo64(uf,&info,NULL,0,NULL,0,NULL,0) == UNZ_OK);
+        CHECK((info.flag & 8) != 0);
+        CHECK(info.crc == crc32(0,(const Bytef*)data,(uInt)size));
+        CHECK(check_current_file(uf,data,size,NULL) == UNZ_OK);
+        CHECK(unzLocateFile(uf,"stored.txt",1) == UNZ_OK);
+        CHECK(check_current_file(uf,data,size,NULL) == UNZ_OK);
+        CHECK(unzLocateFile(uf,"empty.txt",1) == UNZ_OK);
+        CHECK(check_current_file(uf,data,0,NULL) == UNZ_OK);
+        CHECK(unzLocateFile(uf,"aes.txt",1) == UNZ_OK);
+        CHECK(check_current_file(uf,data,size,"secret") == UNZ_OK);
+        CHECK(unzLocateFile(uf,"pkware.txt",1) == UNZ_OK);
+        CHECK(check_current_file(uf,data,size,"secret") == UNZ_OK);
+        CHECK(unzLocateFile(uf,"zip64.txt",1) == UNZ_OK);
+        CHECK(check_current_file(uf,data,size,NULL) == UNZ_OK);
+        unzClose(uf);
+    }
+
+    /* and the verifier finds every file good */
+    {
+        const char* path = scratch("minitest10.zip");
+        FILE* fp = fopen(path,"wb");
+        unz_verify_info verify;
+        CHECK(fp != NULL);
+        if (fp != NULL)
+        {
+            CHECK(fwrite(buffer.base,1,(size_t)buffer.size,fp) == buffer.size);
+            fclose(fp);
+        }
+        CHECK(unzVerify(path,"secret",2,NULL,NULL,NULL,NULL,&verify) == UNZ_OK);
+        CHECK(verify.number_entry == 6 && verify.number_bad == 0);
+    }
+    free(buffer.base);
+    free(data);
+    return 0;
+}
+
+static int test_verify()
+{
+    const char* path = scratch("minitest1.zip");
+    const char* damaged = scratch("minitest8.zip");
+    unz_verify_info info;
+    char* zip;
+    long size;
+    FILE* fp;
+
+    CHECK(unzVerify(path,NULL,4,NULL,NULL,NULL,NULL,&info) == UNZ_OK);
+    CHECK(info.number_entry == 10 && info.number_bad == 0 && !info.repaired);
+
+    /* the largest stored file is damaged, then the central directory */
+    fp = fopen(path,"rb");
+    CHECK(fp != NULL);
+    if (fp == NULL)
+        return 1;
+    fseek(fp,0,SEEK_END);
+    size = ftell(fp);
+    fseek(fp,0,SEEK_SET);
+    zip = (char*)malloc(size);
+    CHECK(fread(zip,1,size,fp) == (size_t)size);
+    fclose(fp);
+    {
+        char* data = make_data(3000000,4);
+        char* p = zip;
+        while (p + 64 < zip + size && memcmp(p,data,64) != 0)
+            p++;
+        CHECK(p + 64 < zip + size);
+        p[1000] ^= 1;
+        free(data);
+    }
+    fp = fopen(damaged,"wb");
+    CHECK(fp != NULL && fwrite(zip,1,size,fp) == (size_t)size);
+    if (fp != NULL)
+        fclose(fp);
+    CHECK(unzVerify(damaged,NULL,4,NULL,NULL,NULL,NULL,&info) == UNZ_CRCERROR);
+    CHECK(info.number_entry == 10 && info.number_bad == 1);
+
+    fp = fopen(damaged,"wb");
+    CHECK(fp != NULL && fwrite(zip,1,size-100,fp) == (size_t)(size-100));
+    if (fp != NULL)
+        fclose(fp);
+    CHECK(unzVerify(damaged,NULL,4,NULL,NULL,NULL,NULL,&info) == UNZ_BADZIPFILE);
+    CHECK(unzVerify(damaged,NULL,4,scratch("minitest9.zip"),scratch("minitest9.tmp"),NULL,NULL,&info) == UNZ_CRCERROR);
+    CHECK(info.repaired && info.number_entry == 10 && info.number_bad == 1);
+    free(zip);
+    return 0;
+}
+
+/* the end of central directory record says there are fewer or more files than there are */
+static int test_wrong_count()
+{
+    const char* path = scratch("minitest1.zip");
+    const char* wrong = scratch("minitest11.zip");
+    const char* repaired = scratch("minitest12.zip");
+    const char* repaired_tmp = scratch("minitest12.tmp");
+    unz_verify_info info;
+    char* zip;
+    char* eocd;
+    long size;
+    int count;
+    FILE* fp;
+
+    fp = fopen(path,"rb");
+    CHECK(fp != NULL);
+    if (fp == NULL)
+        return 1;
+    fseek(fp,0,SEEK_END);
+    size = ftell(fp);
+    fseek(fp,0,SEEK_SET);
+    zip = (char*)malloc(size);
+    CHECK(fread(zip,1,size,fp) == (size_t)size);
+    fclose(fp);
+
+    eocd = zip + size - 22;
+    while (eocd > zip && memcmp(eocd,"PK\5\6",4) != 0)
+        eocd--;
+    CHECK(eocd > zip && eocd[10] == 10 && eocd[11] == 0);
+
+    for (count = 9; count <= 11; count += 2)
+    {
+        /* the files on this disk and in all */
+        eocd[8] = eocd[10] = (char)count;
+        fp = fopen(wrong,"wb");
+        CHECK(fp != NULL && fwrite(zip,1,size,fp) == (size_t)size);
+        if (fp != NULL)
+            fclose(fp);
+        CHECK(unzVerify(wrong,NULL,4,NULL,NULL,NULL,NULL,&info) == UNZ_BADZIPFILE);
+        CHECK(unzVerify(wrong,NULL,4,repaired,repaired_tmp,NULL,NULL,&info) == UNZ_OK);
+        CHECK(info.repaired && info.number_entry == 10 && info.number_bad == 0);
+    }
+    free(zip);
+    return 0;
+}
+
+static int test_providers()
+{
+    static const unsigned char aes_key[16] =
+        { 0x00,0x01,0x02,0x03,0x04,0x05,0x06,0x07,0x08,0x09,0x0a,0x0b,0x0c,0x0d,0x0e,0x0f };
+    static const unsigned char aes_plain[16] =
+        { 0x00,0x11,0x22,0x33,0x44,0x55,0x66,0x77,0x88,0x99,0xaa,0xbb,0xcc,0xdd,0xee,0xff };
+    static const unsigned char aes_cipher[16] =
+        { 0x69,0xc4,0xe0,0xd8,0x6a,0x7b,0x04,0x30,0xd8,0xcd,0xb7,0x80,0x70,0xb4,0xc5,0x5a };
+    char* data = make_data(100000,7);
+    uLong expected = crc32(0,(const Bytef*)data,100000);
+    fastaes_key key;
+    int provider;
+
+    for (provider=FASTCRC_ZLIB;provider<=FASTCRC_ARMV8;provider++)
+    {
+        fastcrc_func func = fastcrc_provider(provider);
+        if (func != NULL)
+        {
+            CHECK(func(0,(const Bytef*)data,100000) == expected);
+            CHECK(func(func(0,(const Bytef*)data,3),(const Bytef*)data+3,99997) == expected);
+        }
+    }
+    CHECK(fastaes_set_key(&key,aes_key,128) == 0);
+    for (provider=FASTAES_TABLE;provider<=FASTAES_COMMONCRYPTO;provider++)
+    {
+        fastaes_func func = fastaes_provider(provider);
+        if (func != NULL)
+        {
+            unsigned char out[16];
+            func(&key,aes_plain,out,1);
+            CHECK(memcmp(out,aes_cipher,16) == 0);
+        }
+    }
+    free(data);
+    return 0;
+}
+
+typedef struct
+{
+    const char* name;
+    int (*run)();
+} minitest;
+
+static const minitest tests[] =
+{
+    { "round trip", test_round_trip },
+    { "many entries", test_many_entries },
+    { "append", test_append },
+    { "encryption", test_encryption },
+    { "seek", test_seek },
+    { "memory and mapped", test_memory_and_mapped },
+    { "pool", test_pool },
+    { "raw copy", test_raw_copy },
+    { "stream", test_stream },
+    { "verify", test_verify },
+    { "wrong count", test_wrong_count },
+    { "crc and aes providers", test_providers },
+};
+
+int main(argc,argv)
+    int argc;
+    char *argv[];
+{
+    int failed = 0;
+    uLong i;
+
+    if (argc > 1)
+        scratch_dir = argv[1];
+    for (i=0;i<sizeof(tests)/sizeof(tests[0]);i++)
+    {
+        int before = failed_checks;
+        int err = tests[i].run();
+        if (err != 0 || failed_checks != before)
+        {
+            printf("FAILED  %s\n",tests[i].name);
+            failed++;
+        }
+        else
+            printf("ok      %s\n",tests[i].name);
+    }
+    for (i=1;i<=12;i++)
+    {
+        char name[32];
+        sprintf(name,"minitest%lu.zip",i);
+        remove(scratch(name));
+    }
+    printf("%d of %lu tests failed\n",failed,(uLong)(sizeof(tests)/sizeof(tests[0])));
+    return failed;
+}
@@ -0,0 +1,148 @@
+/*
+   miniverify.c
+   sample part of the MiniZip project
+
+   Verify the files of a zipfile, decompressing them to a null sink on every
+   processor at once and checking their crc32 (or AES authentication code)
+   and their size:
+
+       miniverify [-j threads] [-p password] [-r repaired.zip] archive.zip
+
+   Each file is reported with its status, in the order of the central
+   directory. With -r, a zipfile whose central directory can't be read is
+   recovered from its local headers into repaired.zip, which is verified.
+   The exit status is 0 if every file is good, 1 otherwise.
+*/
+
+
+#ifndef _WIN32
+        #ifndef __USE_FILE_OFFSET64
+                #define __USE_FILE_OFFSET64
+        #endif
+        #ifndef __USE_LARGEFILE64
+                #define __USE_LARGEFILE64
+        #endif
+        #ifndef _LARGEFILE64_SOURCE
+                #define _LARGEFILE64_SOURCE
+        #endif
+        #ifndef _FILE_OFFSET_BIT
+                #define _FILE_OFFSET_BIT 64
+        #endif
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+# include <windows.h>
+#else
+# include <sys/time.h>
+#endif
+
+#include "unzip.h"
+#include "mztools.h"
+
+static double now_seconds()
+{
+#ifdef _WIN32
+    return GetTickCount() / 1000.0;
+#else
+    struct timeval tv;
+    gettimeofday(&tv,NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+#endif
+}
+
+static const char* status_name(int err)
+{
+    switch (err)
+    {
+    case UNZ_OK:            return "ok";
+    case UNZ_CRCERROR:      return "bad crc";
+    case UNZ_BADPASSWORD:   return "bad password";
+    case UNZ_BADZIPFILE:    return "bad size or header";
+    case Z_DATA_ERROR:      return "bad data";
+    case UNZ_ERRNO:         return "read error";
+    default:                return "error";
+    }
+}
+
+static void report(void* opaque, uLong number_file, const char* filename,
+                   ZPOS64_T uncompressed_size, int err)
+{
+    (void)opaque;
+    (void)number_file;
+    if (err == UNZ_OK)
+        printf("  %-12s %12llu  %s\n",status_name(err),(unsigned long long)uncompressed_size,filename);
+    else
+        printf("  %-12s %12llu  %s (%d)\n",status_name(err),(unsigned long long)uncompressed_size,filename,err);
+}
+
+int main(argc,argv)
+    int argc;
+    char *argv[];
+{
+    const char* zipfilename = NULL;
+    const char* password = NULL;
+    const char* repairedname = NULL;
+    char* repairedtmp = NULL;
+    int threads = 0;
+    unz_verify_info info;
+    double start, seconds;
+    int err;
+    int i;
+
+    for (i=1;i<argc;i++)
+    {
+        if ((strcmp(argv[i],"-j") == 0) && (i+1 < argc))
+            threads = atoi(argv[++i]);
+        else if ((strcmp(argv[i],"-p") == 0) && (i+1 < argc))
+            password = argv[++i];
+        else if ((strcmp(argv[i],"-r") == 0) && (i+1 < argc))
+            repairedname = argv[++i];
+        else if (argv[i][0] != '-')
+            zipfilename = argv[i];
+    }
+    if (zipfilename == NULL)
+    {
+        printf("Usage : miniverify [-j threads] [-p password] [-r repaired.zip] archive.zip\n\n"
+               "  decompress every file of archive.zip to nowhere, checking its crc and size\n"
+               "  -j  number of threads, one per processor by default\n"
+               "  -p  password of the encrypted files\n"
+               "  -r  if the central directory is damaged, recover the files\n"
+               "      in repaired.zip and verify it instead\n");
+        return 0;
+    }
+    if (repairedname != NULL)
+    {
+        repairedtmp = (char*)malloc(strlen(repairedname)+5);
+        if (repairedtmp == NULL)
+            return 1;
+        strcpy(repairedtmp,repairedname);
+        strcat(repairedtmp,".tmp");
+    }
+
+    start = now_seconds();
+    err = unzVerify(zipfilename,password,threads,repairedname,repairedtmp,report,NULL,&info);
+    seconds = now_seconds() - start;
+    if (seconds <= 0)
+        seconds = 1e-6;
+
+    if (err == UNZ_BADZIPFILE)
+        printf("error opening %s: the central directory can't be read%s\n",zipfilename,
+               repairedname != NULL ? " or recovered" : ", try -r");
+    else
+    {
+        if (info.repaired)
+            printf("the central directory of %s was damaged, %lu files recovered in %s\n",
+                   zipfilename,info.number_entry,repairedname);
+        printf("%lu files, %lu bad, %.1f MB in %.2f s, %.1f MB/s\n",
+               info.number_entry,info.number_bad,info.uncompressed_size/(1024.0*1024.0),
+               seconds,(info.uncompressed_size/(1024.0*1024.0))/seconds);
+    }
+
+    if (repairedtmp != NULL)
+        free(repairedtmp);
+    return (err == UNZ_OK) ? 0 : 1;
+}
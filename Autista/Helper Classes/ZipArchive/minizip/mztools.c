@@ -8,12 +8,25 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+
+#ifdef _WIN32
+#  include <windows.h>
+#else
+#  include <pthread.h>
+#  include <unistd.h>
+#endif
+
 #include "zlib.h"
 #include "unzip.h"
+#include "mztools.h"
+
+#ifndef local
+#  define local static
+#endif
 
 #define READ_8(adr)  ((unsigned char)*(adr))
 #define READ_16(adr) ( READ_8(adr) | (READ_8(adr+1) << 8) )
-#define READ_32(adr) ( READ_16(adr) | (READ_16((adr)+2) << 16) )
+#define READ_32(adr) ( (uLong)READ_16(adr) | ((uLong)READ_16((adr)+2) << 16) )
 
 #define WRITE_8(buff, n) do { \
   *((unsigned char*)(buff)) = (unsigned char) ((n) & 0xff); \
@@ -279,3 +292,376 @@ uLong* bytesRecovered;
   }
   return err;
 }
+
+
+/* Verify */
+
+#define VERIFY_BUFSIZE (1024*1024)
+#define VERIFY_ENTRIES (64*1024)      /* files listed before the list grows */
+#define VERIFY_CENTRALHEADER (46)     /* size of a central directory header, without its name, extra field and comment */
+
+/* a file of the zipfile to verify */
+typedef struct {
+  unz64_file_pos pos;
+  uLong filename;               /* offset of its name in the names */
+  ZPOS64_T uncompressed_size;
+  int encrypted;
+  int err;
+  int done;
+} unz_verify_entry;
+
+typedef struct {
+#ifdef _WIN32
+  CRITICAL_SECTION lock;
+#else
+  pthread_mutex_t lock;
+#endif
+  const char* path;
+  const char* password;
+  unz_verify_entry* entries;
+  uLong number_entry;
+  char* names;
+  uLong next;                   /* next file to verify */
+  uLong next_report;            /* next file to give to the callback */
+  unz_verify_callback callback;
+  void* opaque;
+  unz_verify_info info;
+} unz_verify_s;
+
+local void unzVerifyLock OF((unz_verify_s* v));
+local void unzVerifyLock (unz_verify_s* v) {
+#ifdef _WIN32
+  EnterCriticalSection(&v->lock);
+#else
+  pthread_mutex_lock(&v->lock);
+#endif
+}
+
+local void unzVerifyUnlock OF((unz_verify_s* v));
+local void unzVerifyUnlock (unz_verify_s* v) {
+#ifdef _WIN32
+  LeaveCriticalSection(&v->lock);
+#else
+  pthread_mutex_unlock(&v->lock);
+#endif
+}
+
+local unzFile unzVerifyOpen OF((const char* path));
+local unzFile unzVerifyOpen (const char* path) {
+  unzFile uf = unzOpenMapped64(path);
+  if (uf == NULL) {
+    uf = unzOpen64(path);
+  }
+  return uf;
+}
+
+/* List the files of the zipfile, without reading their data */
+local int unzVerifyList OF((unz_verify_s* v, unzFile uf));
+local int unzVerifyList (unz_verify_s* v, unzFile uf) {
+  unz_global_info64 gi;
+  uLong size_names = 0;
+  uLong size_alloc_names = 64*1024;
+  uLong size_alloc_entries;
+  ZPOS64_T end_of_list = 0;
+  uLong i;
+  int err = unzGetGlobalInfo64(uf, &gi);
+  if (err != UNZ_OK) {
+    return err;
+  }
+  /* the count can't be trusted before the files are listed: it is only a hint */
+  size_alloc_entries = (gi.number_entry > 0 && gi.number_entry < VERIFY_ENTRIES) ? (uLong)gi.number_entry : VERIFY_ENTRIES;
+  v->entries = (unz_verify_entry*)malloc(size_alloc_entries * sizeof(unz_verify_entry));
+  v->names = (char*)malloc(size_alloc_names);
+  if (v->entries == NULL || v->names == NULL) {
+    return UNZ_INTERNALERROR;
+  }
+  err = unzGoToFirstFile(uf);
+  for (i = 0; err == UNZ_OK; i++) {
+    unz_file_info64 file_info;
+    unz_verify_entry* entry;
+    if (i == size_alloc_entries) {
+      unz_verify_entry* entries;
+      if (size_alloc_entries > (uLong)-1 / 2 / sizeof(unz_verify_entry)) {
+        return UNZ_INTERNALERROR;
+      }
+      size_alloc_entries *= 2;
+      entries = (unz_verify_entry*)realloc(v->entries, size_alloc_entries * sizeof(unz_verify_entry));
+      if (entries == NULL) {
+        return UNZ_INTERNALERROR;
+      }
+      v->entries = entries;
+    }
+    entry = &v->entries[i];
+    err = unzGetCurrentFileInfo64(uf, &file_info, NULL, 0, NULL, 0, NULL, 0);
+    if (err == UNZ_OK && size_names + file_info.size_filename + 1 > size_alloc_names) {
+      char* names;
+      while (size_names + file_info.size_filename + 1 > size_alloc_names) {
+        size_alloc_names *= 2;
+      }
+      names = (char*)realloc(v->names, size_alloc_names);
+      if (names == NULL) {
+        return UNZ_INTERNALERROR;
+      }
+      v->names = names;
+    }
+    if (err == UNZ_OK) {
+      err = unzGetCurrentFileInfo64(uf, &file_info, v->names + size_names,
+                                    file_info.size_filename + 1, NULL, 0, NULL, 0);
+    }
+    if (err == UNZ_OK) {
+      err = unzGetFilePos64(uf, &entry->pos);
+    }
+    if (err == UNZ_OK) {
+      v->names[size_names + file_info.size_filename] = '\0';
+      entry->filename = size_names;
+      entry->uncompressed_size = file_info.uncompressed_size;
+      entry->encrypted = (file_info.flag & 1) != 0;
+      entry->err = UNZ_OK;
+      entry->done = 0;
+      size_names += file_info.size_filename + 1;
+      v->number_entry = i + 1;
+      end_of_list = entry->pos.pos_in_zip_directory + VERIFY_CENTRALHEADER +
+                    file_info.size_filename + file_info.size_file_extra + file_info.size_file_comment;
+      err = unzGoToNextFile(uf);
+    }
+  }
+  /* unzip stops at the count of the end of central directory record: another
+     file header after the last one means the count is wrong, and the files
+     past it would go unchecked */
+  if (err == UNZ_END_OF_LIST_OF_FILE) {
+    err = (v->number_entry > 0 && unzSetOffset64(uf, end_of_list) == UNZ_OK) ? UNZ_BADZIPFILE : UNZ_OK;
+  }
+  return err;
+}
+
+/* Decompress a file to nowhere */
+local int unzVerifyEntry OF((unz_verify_s* v, unzFile uf, unz_verify_entry* entry, void* buf));
+local int unzVerifyEntry (unz_verify_s* v, unzFile uf, unz_verify_entry* entry, void* buf) {
+  ZPOS64_T size = 0;
+  int err;
+  int read;
+  if (entry->encrypted && v->password == NULL) {
+    return UNZ_BADPASSWORD;
+  }
+  /* unzip would decrypt with the password even the files that are not encrypted */
+  err = unzGoToFilePos64(uf, &entry->pos);
+  if (err == UNZ_OK) {
+    err = unzOpenCurrentFilePassword(uf, entry->encrypted ? v->password : NULL);
+  }
+  if (err != UNZ_OK) {
+    return err;
+  }
+  while ((read = unzReadCurrentFile(uf, buf, VERIFY_BUFSIZE)) > 0) {
+    size += read;
+  }
+  /* the crc is checked when the file is closed */
+  err = unzCloseCurrentFile(uf);
+  if (read < 0) {
+    err = read;
+  } else if (err == UNZ_OK && size != entry->uncompressed_size) {
+    err = UNZ_BADZIPFILE;
+  }
+  return err;
+}
+
+/* Verify files until there are no more, on a thread */
+local void unzVerifyWork OF((unz_verify_s* v));
+local void unzVerifyWork (unz_verify_s* v) {
+  unzFile uf = unzVerifyOpen(v->path);
+  void* buf = malloc(VERIFY_BUFSIZE);
+  for (;;) {
+    unz_verify_entry* entry;
+    int err;
+    unzVerifyLock(v);
+    if (v->next == v->number_entry) {
+      unzVerifyUnlock(v);
+      break;
+    }
+    entry = &v->entries[v->next++];
+    unzVerifyUnlock(v);
+
+    err = (uf != NULL && buf != NULL) ? unzVerifyEntry(v, uf, entry, buf) : UNZ_INTERNALERROR;
+
+    /* the files done are reported in order, as soon as those before them are */
+    unzVerifyLock(v);
+    entry->err = err;
+    entry->done = 1;
+    while (v->next_report < v->number_entry && v->entries[v->next_report].done) {
+      unz_verify_entry* report = &v->entries[v->next_report++];
+      v->info.number_entry++;
+      if (report->err == UNZ_OK) {
+        v->info.uncompressed_size += report->uncompressed_size;
+      } else {
+        v->info.number_bad++;
+      }
+      if (v->callback != NULL) {
+        v->callback(v->opaque, v->next_report - 1, v->names + report->filename,
+                    report->uncompressed_size, report->err);
+      }
+    }
+    unzVerifyUnlock(v);
+  }
+  if (buf != NULL) {
+    free(buf);
+  }
+  if (uf != NULL) {
+    unzClose(uf);
+  }
+}
+
+#ifdef _WIN32
+local DWORD WINAPI unzVerifyThread OF((LPVOID arg));
+local DWORD WINAPI unzVerifyThread (LPVOID arg) {
+  unzVerifyWork((unz_verify_s*)arg);
+  return 0;
+}
+#else
+local void* unzVerifyThread OF((void* arg));
+local void* unzVerifyThread (void* arg) {
+  unzVerifyWork((unz_verify_s*)arg);
+  return NULL;
+}
+#endif
+
+local int unzVerifyProcessors OF((void));
+local int unzVerifyProcessors () {
+#ifdef _WIN32
+  SYSTEM_INFO si;
+  GetSystemInfo(&si);
+  return (int)si.dwNumberOfProcessors;
+#else
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  return n > 0 ? (int)n : 1;
+#endif
+}
+
+extern int ZEXPORT unzVerify(const char* file,
+                             const char* password,
+                             int threads,
+                             const char* fileOut,
+                             const char* fileOutTmp,
+                             unz_verify_callback callback,
+                             void* opaque,
+                             unz_verify_info* pverify_info) {
+  unz_verify_s v;
+  unzFile uf;
+  int err;
+  int i;
+#ifdef _WIN32
+  HANDLE* tids;
+#else
+  pthread_t* tids;
+#endif
+  int number_thread = 0;
+
+  memset(&v, 0, sizeof(v));
+  v.path = file;
+  v.password = password;
+  v.callback = callback;
+  v.opaque = opaque;
+
+  /* the scanner of unzRepair is only used when the central directory is damaged */
+  uf = unzVerifyOpen(file);
+  err = (uf != NULL) ? unzVerifyList(&v, uf) : UNZ_BADZIPFILE;
+  if (uf != NULL) {
+    unzClose(uf);
+  }
+  if (err != UNZ_OK && err != UNZ_INTERNALERROR && fileOut != NULL && fileOutTmp != NULL
+      && unzRepair(file, fileOut, fileOutTmp, NULL, NULL) == Z_OK) {
+    v.path = fileOut;
+    v.info.repaired = 1;
+    v.number_entry = 0;
+    if (v.entries != NULL) {
+      free(v.entries);
+      v.entries = NULL;
+    }
+    if (v.names != NULL) {
+      free(v.names);
+      v.names = NULL;
+    }
+    uf = unzVerifyOpen(fileOut);
+    err = (uf != NULL) ? unzVerifyList(&v, uf) : UNZ_BADZIPFILE;
+    if (uf != NULL) {
+      unzClose(uf);
+    }
+  }
+  if (err == UNZ_OK) {
+#ifdef _WIN32
+    InitializeCriticalSection(&v.lock);
+#else
+    if (pthread_mutex_init(&v.lock, NULL) != 0) {
+      err = UNZ_INTERNALERROR;
+    }
+#endif
+  }
+  if (err != UNZ_OK) {
+    if (v.entries != NULL) {
+      free(v.entries);
+    }
+    if (v.names != NULL) {
+      free(v.names);
+    }
+    if (pverify_info != NULL) {
+      *pverify_info = v.info;
+    }
+    return (err == UNZ_INTERNALERROR) ? err : UNZ_BADZIPFILE;
+  }
+
+  if (threads <= 0) {
+    threads = unzVerifyProcessors();
+  }
+  if ((uLong)threads > v.number_entry) {
+    threads = v.number_entry > 0 ? (int)v.number_entry : 1;
+  }
+#ifdef _WIN32
+  tids = (HANDLE*)malloc(threads * sizeof(HANDLE));
+#else
+  tids = (pthread_t*)malloc(threads * sizeof(pthread_t));
+#endif
+
+  /* this thread works too, the others are only a help if they can be started */
+  for (i = 1; tids != NULL && i < threads; i++) {
+#ifdef _WIN32
+    tids[number_thread] = CreateThread(NULL, 0, unzVerifyThread, &v, 0, NULL);
+    if (tids[number_thread] == NULL) {
+      break;
+    }
+#else
+    if (pthread_create(&tids[number_thread], NULL, unzVerifyThread, &v) != 0) {
+      break;
+    }
+#endif
+    number_thread++;
+  }
+  unzVerifyWork(&v);
+  for (i = 0; i < number_thread; i++) {
+#ifdef _WIN32
+    WaitForSingleObject(tids[i], INFINITE);
+    CloseHandle(tids[i]);
+#else
+    pthread_join(tids[i], NULL);
+#endif
+  }
+  if (v.info.number_bad > 0) {
+    err = UNZ_CRCERROR;
+  }
+
+#ifdef _WIN32
+  DeleteCriticalSection(&v.lock);
+#else
+  pthread_mutex_destroy(&v.lock);
+#endif
+  if (tids != NULL) {
+    free(tids);
+  }
+  if (v.entries != NULL) {
+    free(v.entries);
+  }
+  if (v.names != NULL) {
+    free(v.names);
+  }
+  if (pverify_info != NULL) {
+    *pverify_info = v.info;
+  }
+  return err;
+}
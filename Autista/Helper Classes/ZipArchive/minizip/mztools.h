@@ -28,4 +28,44 @@ extern int ZEXPORT unzRepair(const char* file,
                              uLong* nRecovered,
                              uLong* bytesRecovered);
 
+/* What unzVerify found */
+typedef struct unz_verify_info_s
+{
+  uLong number_entry;           /* files checked */
+  uLong number_bad;             /* files found damaged */
+  ZPOS64_T uncompressed_size;   /* bytes of data checked */
+  int repaired;                 /* 1 if the central directory was rebuilt */
+} unz_verify_info;
+
+/* Called for each file checked, in the order of the central directory,
+   with err UNZ_OK if the file is good */
+typedef void (*unz_verify_callback) OF((void* opaque, uLong number_file,
+                                        const char* filename,
+                                        ZPOS64_T uncompressed_size, int err));
+
+/* Verify a ZIP file: decompress every file to nowhere, checking its crc (or
+   AES authentication code) and its size, on several threads at once
+   file: file to verify
+   password: password of the encrypted files, or NULL
+   threads: number of threads, 0 for one per processor
+   fileOut, fileOutTmp: if the central directory can't be read and these are
+     not NULL, the file is recovered with unzRepair into fileOut and that is
+     verified instead
+   callback: called for each file, one call at a time, from any of the threads
+   Return UNZ_OK if every file is good, UNZ_CRCERROR if some are damaged,
+   UNZ_BADZIPFILE if the central directory can't be read or recovered
+*/
+extern int ZEXPORT unzVerify(const char* file,
+                             const char* password,
+                             int threads,
+                             const char* fileOut,
+                             const char* fileOutTmp,
+                             unz_verify_callback callback,
+                             void* opaque,
+                             unz_verify_info* pverify_info);
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif
@@ -79,6 +79,8 @@
 
 #include "zlib.h"
 #include "unzip.h"
+#include "fastcrc.h"
+#include "zipaes.h"
 
 #ifdef STDC
 #  include <stddef.h>
@@ -106,9 +108,21 @@
 
 
 #ifndef UNZ_BUFSIZE
-#define UNZ_BUFSIZE (16384)
+#define UNZ_BUFSIZE (256*1024)
 #endif
 
+/* the read buffer size is rounded up to a multiple of UNZ_BUFALIGN */
+#ifndef UNZ_BUFALIGN
+#define UNZ_BUFALIGN (4096)
+#endif
+
+/* unzSeekCurrentFile64 keeps a checkpoint every UNZ_SEEK_SPAN bytes of a
+   deflated file, with the UNZ_SEEK_WINDOW bytes inflate needs to restart there */
+#ifndef UNZ_SEEK_SPAN
+#define UNZ_SEEK_SPAN (1024*1024)
+#endif
+#define UNZ_SEEK_WINDOW (32768)
+
 #ifndef UNZ_MAXFILENAMEINZIP
 #define UNZ_MAXFILENAMEINZIP (256)
 #endif
@@ -131,6 +145,9 @@ const char unz_copyright[] =
 typedef struct unz_file_info64_internal_s
 {
     ZPOS64_T offset_curfile;/* relative offset of local header 8 bytes */
+    int aes_version;        /* of the WinZip AES extra field, 0 if none */
+    int aes_strength;
+    uLong aes_method;       /* the compression method of the data AES encrypts */
 } unz_file_info64_internal;
 
 
@@ -139,6 +156,7 @@ typedef struct unz_file_info64_internal_s
 typedef struct
 {
     char  *read_buffer;         /* internal buffer for compressed data */
+    uInt  size_read_buffer;     /* size of read_buffer */
     z_stream stream;            /* zLib stream structure for inflate */
 
 #ifdef HAVE_BZIP2
@@ -162,9 +180,61 @@ typedef struct
     uLong compression_method;   /* compression method (0==store) */
     ZPOS64_T byte_before_the_zipfile;/* byte before the zipfile, (>0 for sfx)*/
     int   raw;
+
+    ZPOS64_T pos_in_zipfile_data;  /* position of the data in the zipfile, after the encryption header */
+    ZPOS64_T rest_read_compressed_data; /* rest_read_compressed at the start of the data */
+    int   crc_unknown;          /* flag set once a seek jumped over data, so crc32 and the AES code can't be checked */
+    int   aes_version;          /* ZIPAES_AE2 if there is no crc32 to check */
+    int   aes;                  /* strength of the AES encryption being decrypted, 0 if none */
+#    ifndef NOUNCRYPT
+    unsigned long keys_data[3]; /* keys at the start of the data */
+#    endif
 } file_in_zip64_read_info_s;
 
 
+/* unz64_seek_index holds the checkpoints of unzSeekCurrentFile64 in a deflated
+   file: the state of inflate at deflate block boundaries, so it can restart
+   there instead of at the start of the file
+*/
+typedef struct
+{
+    ZPOS64_T out;                  /* position of the checkpoint in uncompressed data */
+    ZPOS64_T in;                   /* compressed bytes before it, from the start of the data */
+    int bits;                      /* bits of the byte before in that are still to inflate */
+    uInt size_window;              /* uncompressed bytes before it, up to UNZ_SEEK_WINDOW */
+    Bytef* window;
+} unz64_seek_point;
+
+typedef struct
+{
+    ZPOS64_T pos_in_zipfile_data;  /* position of the data of the file indexed */
+    unz64_seek_point* points;      /* sorted by out */
+    uLong number_point;
+    uLong size_points;
+} unz64_seek_index;
+
+
+/* unz64_index is a hash index of the file names in the central directory,
+   built when the zipfile is opened with UNZ_OPEN_INDEX
+*/
+typedef struct
+{
+    ZPOS64_T pos_in_central_dir;   /* pos of the file in the central dir */
+    ZPOS64_T num_file;             /* number of the file in the zipfile */
+    uLong name_offset;             /* offset of the file name in names */
+} unz64_index_entry;
+
+typedef struct
+{
+    unz64_index_entry* entries;    /* one entry per file, in central dir order */
+    ZPOS64_T number_entry;
+    char* names;                   /* the file names, each terminated by a nul */
+    uLong slot_mask;               /* number of slots - 1, a power of two - 1 */
+    uLong* slots;                  /* open addressing table, entry number + 1 or 0 */
+    uLong* slots_nocase;           /* same, hashed without case, built on first use */
+} unz64_index;
+
+
 /* unz64_s contain internal information about the zipfile
 */
 typedef struct
@@ -187,13 +257,22 @@ typedef struct
     unz_file_info64_internal cur_file_info_internal; /* private info about it*/
     file_in_zip64_read_info_s* pfile_in_zip_read; /* structure about the current
                                         file if we are decompressing it */
+    file_in_zip64_read_info_s* pfile_in_zip_read_cache; /* structure of the last file
+                                        closed, kept with its buffer and inflate state
+                                        for the next file opened */
     int encrypted;
 
     int isZip64;
 
+    unz64_index* index;            /* index of the file names, or NULL */
+    uInt size_read_buffer;         /* size of the read buffer of the files opened */
+    unz64_seek_index* seek_index;  /* checkpoints of the last file seeked in, or NULL */
+    ZPOS64_T seek_span;            /* bytes between checkpoints, 0 for none */
+
 #    ifndef NOUNCRYPT
     unsigned long keys[3];     /* keys defining the pseudo-random sequence */
-    const unsigned long* pcrc_32_tab;
+    const z_crc_t* pcrc_32_tab;
+    zipaes_ctx aes_ctx;        /* used instead with AES */
 #    endif
 } unz64_s;
 
@@ -203,26 +282,20 @@ typedef struct
 #endif
 
 /* ===========================================================================
-     Read a byte from a gz_stream; update next_in and avail_in. Return EOF
-   for end of file.
+   Read size bytes from a gz_stream at once, so a header field costs one call
+   to the read function. Return EOF for end of file.
    IN assertion: the stream s has been sucessfully opened for reading.
 */
-
-
-local int unz64local_getByte OF((
+local int unz64local_getBytes OF((
     const zlib_filefunc64_32_def* pzlib_filefunc_def,
     voidpf filestream,
-    int *pi));
+    unsigned char *buf,
+    uLong size));
 
-local int unz64local_getByte(const zlib_filefunc64_32_def* pzlib_filefunc_def, voidpf filestream, int *pi)
+local int unz64local_getBytes(const zlib_filefunc64_32_def* pzlib_filefunc_def, voidpf filestream, unsigned char *buf, uLong size)
 {
-    unsigned char c;
-    int err = (int)ZREAD64(*pzlib_filefunc_def,filestream,&c,1);
-    if (err==1)
-    {
-        *pi = (int)c;
+    if (ZREAD64(*pzlib_filefunc_def,filestream,buf,size)==size)
         return UNZ_OK;
-    }
     else
     {
         if (ZERROR64(*pzlib_filefunc_def,filestream))
@@ -245,19 +318,13 @@ local int unz64local_getShort (const zlib_filefunc64_32_def* pzlib_filefunc_def,
                              voidpf filestream,
                              uLong *pX)
 {
-    uLong x ;
-    int i = 0;
+    unsigned char c[2];
     int err;
 
-    err = unz64local_getByte(pzlib_filefunc_def,filestream,&i);
-    x = (uLong)i;
-
-    if (err==UNZ_OK)
-        err = unz64local_getByte(pzlib_filefunc_def,filestream,&i);
-    x |= ((uLong)i)<<8;
+    err = unz64local_getBytes(pzlib_filefunc_def,filestream,c,2);
 
     if (err==UNZ_OK)
-        *pX = x;
+        *pX = (uLong)c[0] | ((uLong)c[1])<<8;
     else
         *pX = 0;
     return err;
@@ -272,27 +339,13 @@ local int unz64local_getLong (const zlib_filefunc64_32_def* pzlib_filefunc_def,
                             voidpf filestream,
                             uLong *pX)
 {
-    uLong x ;
-    int i = 0;
+    unsigned char c[4];
     int err;
 
-    err = unz64local_getByte(pzlib_filefunc_def,filestream,&i);
-    x = (uLong)i;
-
-    if (err==UNZ_OK)
-        err = unz64local_getByte(pzlib_filefunc_def,filestream,&i);
-    x |= ((uLong)i)<<8;
-
-    if (err==UNZ_OK)
-        err = unz64local_getByte(pzlib_filefunc_def,filestream,&i);
-    x |= ((uLong)i)<<16;
-
-    if (err==UNZ_OK)
-        err = unz64local_getByte(pzlib_filefunc_def,filestream,&i);
-    x += ((uLong)i)<<24;
+    err = unz64local_getBytes(pzlib_filefunc_def,filestream,c,4);
 
     if (err==UNZ_OK)
-        *pX = x;
+        *pX = (uLong)c[0] | ((uLong)c[1])<<8 | ((uLong)c[2])<<16 | ((uLong)c[3])<<24;
     else
         *pX = 0;
     return err;
@@ -308,40 +361,15 @@ local int unz64local_getLong64 (const zlib_filefunc64_32_def* pzlib_filefunc_def
                             voidpf filestream,
                             ZPOS64_T *pX)
 {
-    ZPOS64_T x ;
-    int i = 0;
+    unsigned char c[8];
+    ZPOS64_T x = 0;
+    int i;
     int err;
 
-    err = unz64local_getByte(pzlib_filefunc_def,filestream,&i);
-    x = (ZPOS64_T)i;
-
-    if (err==UNZ_OK)
-        err = unz64local_getByte(pzlib_filefunc_def,filestream,&i);
-    x |= ((ZPOS64_T)i)<<8;
+    err = unz64local_getBytes(pzlib_filefunc_def,filestream,c,8);
 
-    if (err==UNZ_OK)
-        err = unz64local_getByte(pzlib_filefunc_def,filestream,&i);
-    x |= ((ZPOS64_T)i)<<16;
-
-    if (err==UNZ_OK)
-        err = unz64local_getByte(pzlib_filefunc_def,filestream,&i);
-    x |= ((ZPOS64_T)i)<<24;
-
-    if (err==UNZ_OK)
-        err = unz64local_getByte(pzlib_filefunc_def,filestream,&i);
-    x |= ((ZPOS64_T)i)<<32;
-
-    if (err==UNZ_OK)
-        err = unz64local_getByte(pzlib_filefunc_def,filestream,&i);
-    x |= ((ZPOS64_T)i)<<40;
-
-    if (err==UNZ_OK)
-        err = unz64local_getByte(pzlib_filefunc_def,filestream,&i);
-    x |= ((ZPOS64_T)i)<<48;
-
-    if (err==UNZ_OK)
-        err = unz64local_getByte(pzlib_filefunc_def,filestream,&i);
-    x |= ((ZPOS64_T)i)<<56;
+    for (i=7;i>=0;i--)
+        x = (x<<8) | (ZPOS64_T)c[i];
 
     if (err==UNZ_OK)
         *pX = x;
@@ -406,175 +434,278 @@ extern int ZEXPORT unzStringFileNameCompare (const char*  fileName1,
     return STRCMPCASENOSENTIVEFUNCTION(fileName1,fileName2);
 }
 
-#ifndef BUFREADCOMMENT
-#define BUFREADCOMMENT (0x400)
-#endif
+/* size of the end of central directory record, without the global comment,
+   and of the zip64 end of central directory locator that precedes it */
+#define SIZEENDOFCENTRALDIR (22)
+#define SIZEZIP64LOCATOR (20)
+
+local uLong unz64local_bufShort OF((const unsigned char* buf));
+local uLong unz64local_bufShort (const unsigned char* buf)
+{
+    return (uLong)buf[0] | ((uLong)buf[1]<<8);
+}
+
+local uLong unz64local_bufLong OF((const unsigned char* buf));
+local uLong unz64local_bufLong (const unsigned char* buf)
+{
+    return unz64local_bufShort(buf) | (unz64local_bufShort(buf+2)<<16);
+}
 
 /*
   Locate the Central directory of a zipfile (at the end, just before
-    the global comment)
+    the global comment), and the Central directory 64 if there is one.
+  The end of the file, as large as the largest global comment, is read at once,
+    and the signature searched in it with memchr; without a global comment,
+    it is found in the first place looked at.
+  return the position of the end of central directory record, or 0, and put
+    the position of the zip64 end of central directory record in *pos_zip64,
+    or 0.
 */
-local ZPOS64_T unz64local_SearchCentralDir OF((const zlib_filefunc64_32_def* pzlib_filefunc_def, voidpf filestream));
-local ZPOS64_T unz64local_SearchCentralDir(const zlib_filefunc64_32_def* pzlib_filefunc_def, voidpf filestream)
+local ZPOS64_T unz64local_SearchCentralDir OF((
+    const zlib_filefunc64_32_def* pzlib_filefunc_def,
+    voidpf filestream,
+    ZPOS64_T* pos_zip64));
+
+local ZPOS64_T unz64local_SearchCentralDir(const zlib_filefunc64_32_def* pzlib_filefunc_def,
+                                           voidpf filestream,
+                                           ZPOS64_T* pos_zip64)
 {
     unsigned char* buf;
+    const unsigned char* found = NULL;
     ZPOS64_T uSizeFile;
-    ZPOS64_T uBackRead;
-    ZPOS64_T uMaxBack=0xffff; /* maximum size of global comment */
-    ZPOS64_T uPosFound=0;
+    ZPOS64_T uReadPos;
+    uLong uReadSize;
+    uLong uLast;
 
+    *pos_zip64 = 0;
     if (ZSEEK64(*pzlib_filefunc_def,filestream,0,ZLIB_FILEFUNC_SEEK_END) != 0)
         return 0;
 
-
     uSizeFile = ZTELL64(*pzlib_filefunc_def,filestream);
+    if (uSizeFile < SIZEENDOFCENTRALDIR)
+        return 0;
 
-    if (uMaxBack>uSizeFile)
-        uMaxBack = uSizeFile;
+    uReadSize = 0xffff + SIZEENDOFCENTRALDIR + SIZEZIP64LOCATOR;
+    if (uReadSize > uSizeFile)
+        uReadSize = (uLong)uSizeFile;
+    uReadPos = uSizeFile - uReadSize;
 
-    buf = (unsigned char*)ALLOC(BUFREADCOMMENT+4);
+    buf = (unsigned char*)ALLOC(uReadSize);
     if (buf==NULL)
         return 0;
 
-    uBackRead = 4;
-    while (uBackRead<uMaxBack)
+    if ((ZSEEK64(*pzlib_filefunc_def,filestream,uReadPos,ZLIB_FILEFUNC_SEEK_SET)!=0) ||
+        (ZREAD64(*pzlib_filefunc_def,filestream,buf,uReadSize)!=uReadSize))
     {
-        uLong uReadSize;
-        ZPOS64_T uReadPos ;
-        int i;
-        if (uBackRead+BUFREADCOMMENT>uMaxBack)
-            uBackRead = uMaxBack;
-        else
-            uBackRead+=BUFREADCOMMENT;
-        uReadPos = uSizeFile-uBackRead ;
+        TRYFREE(buf);
+        return 0;
+    }
 
-        uReadSize = ((BUFREADCOMMENT+4) < (uSizeFile-uReadPos)) ?
-                     (BUFREADCOMMENT+4) : (uLong)(uSizeFile-uReadPos);
-        if (ZSEEK64(*pzlib_filefunc_def,filestream,uReadPos,ZLIB_FILEFUNC_SEEK_SET)!=0)
-            break;
+    /* the last place the record can start at, the only one without a global comment */
+    uLast = uReadSize - SIZEENDOFCENTRALDIR;
+    if (unz64local_bufLong(buf+uLast) == 0x06054b50)
+        found = buf+uLast;
+    else
+    {
+        /* the last signature before it */
+        const unsigned char* p = buf;
+        while ((p < buf+uLast) &&
+               ((p = (const unsigned char*)memchr(p,0x50,(size_t)(buf+uLast-p))) != NULL))
+        {
+            if (unz64local_bufLong(p) == 0x06054b50)
+                found = p;
+            p++;
+        }
+    }
 
-        if (ZREAD64(*pzlib_filefunc_def,filestream,buf,uReadSize)!=uReadSize)
-            break;
+    if (found == NULL)
+    {
+        TRYFREE(buf);
+        return 0;
+    }
 
-        for (i=(int)uReadSize-3; (i--)>0;)
-            if (((*(buf+i))==0x50) && ((*(buf+i+1))==0x4b) &&
-                ((*(buf+i+2))==0x05) && ((*(buf+i+3))==0x06))
-            {
-                uPosFound = uReadPos+i;
-                break;
-            }
+    /* Zip64 end of central directory locator, right before the record */
+    if ((found-buf >= SIZEZIP64LOCATOR) &&
+        (unz64local_bufLong(found-SIZEZIP64LOCATOR) == 0x07064b50))
+    {
+        const unsigned char* locator = found-SIZEZIP64LOCATOR;
+        ZPOS64_T relativeOffset = (ZPOS64_T)unz64local_bufLong(locator+8) |
+                                  ((ZPOS64_T)unz64local_bufLong(locator+12) << 32);
 
-        if (uPosFound!=0)
-            break;
+        /* number of the disk with the start of the zip64 end of central directory,
+           and total number of disks */
+        if ((unz64local_bufLong(locator+4) == 0) && (unz64local_bufLong(locator+16) == 1))
+        {
+            uLong uL = 0;
+
+            /* the signature of the zip64 end of central directory record */
+            if ((relativeOffset >= uReadPos) && (relativeOffset+4 <= uReadPos+uReadSize))
+                uL = unz64local_bufLong(buf+(relativeOffset-uReadPos));
+            else if ((ZSEEK64(*pzlib_filefunc_def,filestream,relativeOffset,ZLIB_FILEFUNC_SEEK_SET)!=0) ||
+                     (unz64local_getLong(pzlib_filefunc_def,filestream,&uL)!=UNZ_OK))
+                uL = 0;
+
+            if (uL == 0x06064b50)
+                *pos_zip64 = relativeOffset;
+        }
     }
+
+    uReadPos += found-buf;
     TRYFREE(buf);
-    return uPosFound;
+    return uReadPos;
 }
 
-
 /*
-  Locate the Central directory 64 of a zipfile (at the end, just before
-    the global comment)
+  Hash index of the file names in the central directory.
+  The names are hashed with FNV-1a, either as they are, or with ascii letters
+    folded to upper case like strcmpcasenosensitive_internal compares them.
 */
-local ZPOS64_T unz64local_SearchCentralDir64 OF((
-    const zlib_filefunc64_32_def* pzlib_filefunc_def,
-    voidpf filestream));
+local uLong unz64local_HashFileName OF((const char* fileName, int iCaseSensitivity));
 
-local ZPOS64_T unz64local_SearchCentralDir64(const zlib_filefunc64_32_def* pzlib_filefunc_def,
-                                      voidpf filestream)
+local uLong unz64local_HashFileName (const char* fileName, int iCaseSensitivity)
 {
-    unsigned char* buf;
-    ZPOS64_T uSizeFile;
-    ZPOS64_T uBackRead;
-    ZPOS64_T uMaxBack=0xffff; /* maximum size of global comment */
-    ZPOS64_T uPosFound=0;
-    uLong uL;
-                ZPOS64_T relativeOffset;
-
-    if (ZSEEK64(*pzlib_filefunc_def,filestream,0,ZLIB_FILEFUNC_SEEK_END) != 0)
-        return 0;
+    uLong hash = 2166136261UL;
+    for (; *fileName != '\0'; fileName++)
+    {
+        char c = *fileName;
+        if ((iCaseSensitivity != 1) && (c>='a') && (c<='z'))
+            c -= 0x20;
+        hash = ((hash ^ (unsigned char)c) * 16777619UL) & 0xffffffffUL;
+    }
+    return hash;
+}
 
+local uLong* unz64local_BuildIndexSlots OF((const unz64_index* index, int iCaseSensitivity));
 
-    uSizeFile = ZTELL64(*pzlib_filefunc_def,filestream);
-
-    if (uMaxBack>uSizeFile)
-        uMaxBack = uSizeFile;
+local uLong* unz64local_BuildIndexSlots (const unz64_index* index, int iCaseSensitivity)
+{
+    uLong* slots;
+    ZPOS64_T i;
 
-    buf = (unsigned char*)ALLOC(BUFREADCOMMENT+4);
-    if (buf==NULL)
-        return 0;
+    slots = (uLong*)ALLOC((index->slot_mask+1)*sizeof(uLong));
+    if (slots == NULL)
+        return NULL;
+    memset(slots, 0, (index->slot_mask+1)*sizeof(uLong));
 
-    uBackRead = 4;
-    while (uBackRead<uMaxBack)
+    /* in central dir order, so the first of duplicate names is found first */
+    for (i = 0; i < index->number_entry; i++)
     {
-        uLong uReadSize;
-        ZPOS64_T uReadPos;
-        int i;
-        if (uBackRead+BUFREADCOMMENT>uMaxBack)
-            uBackRead = uMaxBack;
-        else
-            uBackRead+=BUFREADCOMMENT;
-        uReadPos = uSizeFile-uBackRead ;
-
-        uReadSize = ((BUFREADCOMMENT+4) < (uSizeFile-uReadPos)) ?
-                     (BUFREADCOMMENT+4) : (uLong)(uSizeFile-uReadPos);
-        if (ZSEEK64(*pzlib_filefunc_def,filestream,uReadPos,ZLIB_FILEFUNC_SEEK_SET)!=0)
-            break;
-
-        if (ZREAD64(*pzlib_filefunc_def,filestream,buf,uReadSize)!=uReadSize)
-            break;
+        uLong slot = unz64local_HashFileName(index->names + index->entries[i].name_offset,
+                                             iCaseSensitivity) & index->slot_mask;
+        while (slots[slot] != 0)
+            slot = (slot + 1) & index->slot_mask;
+        slots[slot] = (uLong)i + 1;
+    }
+    return slots;
+}
 
-        for (i=(int)uReadSize-3; (i--)>0;)
-            if (((*(buf+i))==0x50) && ((*(buf+i+1))==0x4b) &&
-                ((*(buf+i+2))==0x06) && ((*(buf+i+3))==0x07))
-            {
-                uPosFound = uReadPos+i;
-                break;
-            }
+local void unz64local_FreeIndex OF((unz64_index* index));
 
-        if (uPosFound!=0)
-            break;
-    }
-    TRYFREE(buf);
-    if (uPosFound == 0)
-        return 0;
+local void unz64local_FreeIndex (unz64_index* index)
+{
+    if (index == NULL)
+        return;
+    TRYFREE(index->entries);
+    TRYFREE(index->names);
+    TRYFREE(index->slots);
+    TRYFREE(index->slots_nocase);
+    TRYFREE(index);
+}
 
-    /* Zip64 end of central directory locator */
-    if (ZSEEK64(*pzlib_filefunc_def,filestream, uPosFound,ZLIB_FILEFUNC_SEEK_SET)!=0)
-        return 0;
+/*
+  Read the whole central directory at once and index the file names.
+  Return NULL if the central directory cannot be read or is not coherent,
+    the zipfile is then searched without the index.
+*/
+local unz64_index* unz64local_BuildIndex OF((unz64_s* s));
 
-    /* the signature, already checked */
-    if (unz64local_getLong(pzlib_filefunc_def,filestream,&uL)!=UNZ_OK)
-        return 0;
+local unz64_index* unz64local_BuildIndex (unz64_s* s)
+{
+    unz64_index* index;
+    unsigned char* central_dir;
+    uLong size_central_dir;
+    uLong pos = 0;
+    uLong names_size = 0;
+    uLong slot_count = 1;
+    ZPOS64_T i;
+    int err = UNZ_OK;
+
+    size_central_dir = (uLong)s->size_central_dir;
+    if ((ZPOS64_T)size_central_dir != s->size_central_dir ||
+        (ZPOS64_T)(uLong)s->gi.number_entry != s->gi.number_entry)
+        return NULL;
 
-    /* number of the disk with the start of the zip64 end of  central directory */
-    if (unz64local_getLong(pzlib_filefunc_def,filestream,&uL)!=UNZ_OK)
-        return 0;
-    if (uL != 0)
-        return 0;
+    index = (unz64_index*)ALLOC(sizeof(unz64_index));
+    if (index == NULL)
+        return NULL;
+    memset(index, 0, sizeof(unz64_index));
+    index->number_entry = s->gi.number_entry;
+
+    central_dir = (unsigned char*)ALLOC(size_central_dir + 1);
+    index->entries = (unz64_index_entry*)ALLOC((uLong)index->number_entry*sizeof(unz64_index_entry) + 1);
+    /* a central header is at least 46 bytes, so the names take less than the central dir */
+    index->names = (char*)ALLOC(size_central_dir + 1);
+    if ((central_dir == NULL) || (index->entries == NULL) || (index->names == NULL))
+        err = UNZ_INTERNALERROR;
+
+    if ((err==UNZ_OK) &&
+        (ZSEEK64(s->z_filefunc, s->filestream,
+                 s->offset_central_dir + s->byte_before_the_zipfile, ZLIB_FILEFUNC_SEEK_SET)!=0))
+        err = UNZ_ERRNO;
+
+    if ((err==UNZ_OK) &&
+        (ZREAD64(s->z_filefunc, s->filestream, central_dir, size_central_dir)!=size_central_dir))
+        err = UNZ_ERRNO;
+
+    for (i = 0; (err==UNZ_OK) && (i < index->number_entry); i++)
+    {
+        const unsigned char* p = central_dir + pos;
+        uLong size_filename, size_file_extra, size_file_comment;
 
-    /* relative offset of the zip64 end of central directory record */
-    if (unz64local_getLong64(pzlib_filefunc_def,filestream,&relativeOffset)!=UNZ_OK)
-        return 0;
+        if ((size_central_dir - pos < SIZECENTRALDIRITEM) ||
+            (p[0]!=0x50) || (p[1]!=0x4b) || (p[2]!=0x01) || (p[3]!=0x02))
+        {
+            err = UNZ_BADZIPFILE;
+            break;
+        }
+        size_filename = (uLong)p[28] | ((uLong)p[29]<<8);
+        size_file_extra = (uLong)p[30] | ((uLong)p[31]<<8);
+        size_file_comment = (uLong)p[32] | ((uLong)p[33]<<8);
+        if (size_central_dir - pos - SIZECENTRALDIRITEM < size_filename + size_file_extra + size_file_comment)
+        {
+            err = UNZ_BADZIPFILE;
+            break;
+        }
 
-    /* total number of disks */
-    if (unz64local_getLong(pzlib_filefunc_def,filestream,&uL)!=UNZ_OK)
-        return 0;
-    if (uL != 1)
-        return 0;
+        index->entries[i].pos_in_central_dir = s->offset_central_dir + pos;
+        index->entries[i].num_file = i;
+        index->entries[i].name_offset = names_size;
+        memcpy(index->names + names_size, p + SIZECENTRALDIRITEM, size_filename);
+        names_size += size_filename;
+        index->names[names_size++] = '\0';
 
-    /* Goto end of central directory record */
-    if (ZSEEK64(*pzlib_filefunc_def,filestream, relativeOffset,ZLIB_FILEFUNC_SEEK_SET)!=0)
-        return 0;
+        pos += SIZECENTRALDIRITEM + size_filename + size_file_extra + size_file_comment;
+    }
 
-     /* the signature */
-    if (unz64local_getLong(pzlib_filefunc_def,filestream,&uL)!=UNZ_OK)
-        return 0;
+    TRYFREE(central_dir);
 
-    if (uL != 0x06064b50)
-        return 0;
+    if (err==UNZ_OK)
+    {
+        /* keep the table at most half full */
+        while (slot_count < 2*(uLong)index->number_entry)
+            slot_count <<= 1;
+        index->slot_mask = slot_count - 1;
+        index->slots = unz64local_BuildIndexSlots(index, 1);
+        if (index->slots == NULL)
+            err = UNZ_INTERNALERROR;
+    }
 
-    return relativeOffset;
+    if (err!=UNZ_OK)
+    {
+        unz64local_FreeIndex(index);
+        return NULL;
+    }
+    return index;
 }
 
 /*
@@ -588,11 +719,12 @@ local ZPOS64_T unz64local_SearchCentralDir64(const zlib_filefunc64_32_def* pzlib
 */
 local unzFile unzOpenInternal (const void *path,
                                zlib_filefunc64_32_def* pzlib_filefunc64_32_def,
-                               int is64bitOpenFunction)
+                               int is64bitOpenFunction, int flags)
 {
     unz64_s us;
     unz64_s *s;
     ZPOS64_T central_pos;
+    ZPOS64_T central_pos64;
     uLong   uL;
 
     uLong number_disk;          /* number of the current dist, used for
@@ -625,12 +757,13 @@ local unzFile unzOpenInternal (const void *path,
     if (us.filestream==NULL)
         return NULL;
 
-    central_pos = unz64local_SearchCentralDir64(&us.z_filefunc,us.filestream);
-    if (central_pos)
+    central_pos = unz64local_SearchCentralDir(&us.z_filefunc,us.filestream,&central_pos64);
+    if (central_pos64)
     {
         uLong uS;
         ZPOS64_T uL64;
 
+        central_pos = central_pos64;
         us.isZip64 = 1;
 
         if (ZSEEK64(us.z_filefunc, us.filestream,
@@ -687,7 +820,6 @@ local unzFile unzOpenInternal (const void *path,
     }
     else
     {
-        central_pos = unz64local_SearchCentralDir(&us.z_filefunc,us.filestream);
         if (central_pos==0)
             err=UNZ_ERRNO;
 
@@ -754,8 +886,15 @@ local unzFile unzOpenInternal (const void *path,
                             (us.offset_central_dir+us.size_central_dir);
     us.central_pos = central_pos;
     us.pfile_in_zip_read = NULL;
+    us.pfile_in_zip_read_cache = NULL;
     us.encrypted = 0;
+    us.index = NULL;
+    us.size_read_buffer = UNZ_BUFSIZE;
+    us.seek_index = NULL;
+    us.seek_span = UNZ_SEEK_SPAN;
 
+    if (flags & UNZ_OPEN_INDEX)
+        us.index = unz64local_BuildIndex(&us);
 
     s=(unz64_s*)ALLOC(sizeof(unz64_s));
     if( s != NULL)
@@ -774,10 +913,10 @@ extern unzFile ZEXPORT unzOpen2 (const char *path,
     {
         zlib_filefunc64_32_def zlib_filefunc64_32_def_fill;
         fill_zlib_filefunc64_32_def_from_filefunc32(&zlib_filefunc64_32_def_fill,pzlib_filefunc32_def);
-        return unzOpenInternal(path, &zlib_filefunc64_32_def_fill, 0);
+        return unzOpenInternal(path, &zlib_filefunc64_32_def_fill, 0, 0);
     }
     else
-        return unzOpenInternal(path, NULL, 0);
+        return unzOpenInternal(path, NULL, 0, 0);
 }
 
 extern unzFile ZEXPORT unzOpen2_64 (const void *path,
@@ -789,20 +928,83 @@ extern unzFile ZEXPORT unzOpen2_64 (const void *path,
         zlib_filefunc64_32_def_fill.zfile_func64 = *pzlib_filefunc_def;
         zlib_filefunc64_32_def_fill.ztell32_file = NULL;
         zlib_filefunc64_32_def_fill.zseek32_file = NULL;
-        return unzOpenInternal(path, &zlib_filefunc64_32_def_fill, 1);
+        return unzOpenInternal(path, &zlib_filefunc64_32_def_fill, 1, 0);
     }
     else
-        return unzOpenInternal(path, NULL, 1);
+        return unzOpenInternal(path, NULL, 1, 0);
 }
 
 extern unzFile ZEXPORT unzOpen (const char *path)
 {
-    return unzOpenInternal(path, NULL, 0);
+    return unzOpenInternal(path, NULL, 0, 0);
 }
 
 extern unzFile ZEXPORT unzOpen64 (const void *path)
 {
-    return unzOpenInternal(path, NULL, 1);
+    return unzOpenInternal(path, NULL, 1, 0);
+}
+
+extern unzFile ZEXPORT unzOpen3_64 (const void *path,
+                                     zlib_filefunc64_def* pzlib_filefunc_def,
+                                     int flags)
+{
+    if (pzlib_filefunc_def != NULL)
+    {
+        zlib_filefunc64_32_def zlib_filefunc64_32_def_fill;
+        zlib_filefunc64_32_def_fill.zfile_func64 = *pzlib_filefunc_def;
+        zlib_filefunc64_32_def_fill.ztell32_file = NULL;
+        zlib_filefunc64_32_def_fill.zseek32_file = NULL;
+        return unzOpenInternal(path, &zlib_filefunc64_32_def_fill, 1, flags);
+    }
+    else
+        return unzOpenInternal(path, NULL, 1, flags);
+}
+
+extern unzFile ZEXPORT unzOpenMapped (const char *path)
+{
+    return unzOpenMapped64(path);
+}
+
+extern unzFile ZEXPORT unzOpenMapped64 (const void *path)
+{
+    zlib_filefunc64_32_def zlib_filefunc64_32_def_fill;
+    fill_mmap_filefunc64(&zlib_filefunc64_32_def_fill.zfile_func64);
+    zlib_filefunc64_32_def_fill.ztell32_file = NULL;
+    zlib_filefunc64_32_def_fill.zseek32_file = NULL;
+    return unzOpenInternal(path, &zlib_filefunc64_32_def_fill, 1, 0);
+}
+
+/*
+  Free the structure about a file in the zipfile, its buffer and its decompression state.
+*/
+local void unz64local_FreeReadInfo OF((file_in_zip64_read_info_s* pfile_in_zip_read_info));
+local void unz64local_FreeReadInfo (file_in_zip64_read_info_s* pfile_in_zip_read_info)
+{
+    if (pfile_in_zip_read_info==NULL)
+        return;
+    TRYFREE(pfile_in_zip_read_info->read_buffer);
+    if (pfile_in_zip_read_info->stream_initialised == Z_DEFLATED)
+        inflateEnd(&pfile_in_zip_read_info->stream);
+#ifdef HAVE_BZIP2
+    else if (pfile_in_zip_read_info->stream_initialised == Z_BZIP2ED)
+        BZ2_bzDecompressEnd(&pfile_in_zip_read_info->bstream);
+#endif
+    TRYFREE(pfile_in_zip_read_info);
+}
+
+/*
+  Free the checkpoints of unzSeekCurrentFile64.
+*/
+local void unz64local_FreeSeekIndex OF((unz64_seek_index* seek_index));
+local void unz64local_FreeSeekIndex (unz64_seek_index* seek_index)
+{
+    uLong i;
+    if (seek_index==NULL)
+        return;
+    for (i=0;i<seek_index->number_point;i++)
+        TRYFREE(seek_index->points[i].window);
+    TRYFREE(seek_index->points);
+    TRYFREE(seek_index);
 }
 
 /*
@@ -819,12 +1021,47 @@ extern int ZEXPORT unzClose (unzFile file)
 
     if (s->pfile_in_zip_read!=NULL)
         unzCloseCurrentFile(file);
+    unz64local_FreeReadInfo(s->pfile_in_zip_read_cache);
 
     ZCLOSE64(s->z_filefunc, s->filestream);
+    unz64local_FreeIndex(s->index);
+    unz64local_FreeSeekIndex(s->seek_index);
     TRYFREE(s);
     return UNZ_OK;
 }
 
+/*
+  Set the size of the read buffer of the files opened from now on.
+  return UNZ_OK if there is no problem. */
+extern int ZEXPORT unzSetBufferSize (unzFile file, uLong size)
+{
+    unz64_s* s;
+    if (file==NULL)
+        return UNZ_PARAMERROR;
+    s=(unz64_s*)file;
+
+    if (size==0)
+        size = UNZ_BUFSIZE;
+    if (size>0x40000000)
+        size = 0x40000000;
+    s->size_read_buffer = (uInt)((size + UNZ_BUFALIGN - 1) & ~((uLong)UNZ_BUFALIGN - 1));
+    return UNZ_OK;
+}
+
+/*
+  Set the distance between the checkpoints unzSeekCurrentFile64 keeps.
+  return UNZ_OK if there is no problem. */
+extern int ZEXPORT unzSetSeekSpan (unzFile file, ZPOS64_T span)
+{
+    unz64_s* s;
+    if (file==NULL)
+        return UNZ_PARAMERROR;
+    s=(unz64_s*)file;
+
+    s->seek_span = span;
+    return UNZ_OK;
+}
+
 
 /*
   Write info about the ZipFile in the *pglobal_info structure.
@@ -908,6 +1145,10 @@ local int unz64local_GetCurrentFileInfoInternal (unzFile file,
               ZLIB_FILEFUNC_SEEK_SET)!=0)
         err=UNZ_ERRNO;
 
+    file_info_internal.aes_version = 0;
+    file_info_internal.aes_strength = 0;
+    file_info_internal.aes_method = 0;
+
 
     /* we check the magic */
     if (err==UNZ_OK)
@@ -1072,6 +1313,24 @@ local int unz64local_GetCurrentFileInfoInternal (unzFile file,
                                                                 }
 
             }
+            /* WinZip AES extra field */
+            else if ((headerId == ZIPAES_EXTRA_ID) && (dataSize >= ZIPAES_EXTRA_SIZE))
+            {
+                unsigned char aes[ZIPAES_EXTRA_SIZE];
+
+                if (unz64local_getBytes(&s->z_filefunc, s->filestream,aes,ZIPAES_EXTRA_SIZE) != UNZ_OK)
+                    err=UNZ_ERRNO;
+                else if (unz64local_bufShort(aes+2) == ZIPAES_VENDOR_ID)
+                {
+                    file_info_internal.aes_version = (int)unz64local_bufShort(aes);
+                    file_info_internal.aes_strength = aes[4];
+                    file_info_internal.aes_method = unz64local_bufShort(aes+5);
+                }
+
+                if (dataSize > ZIPAES_EXTRA_SIZE)
+                    if (ZSEEK64(s->z_filefunc, s->filestream,dataSize-ZIPAES_EXTRA_SIZE,ZLIB_FILEFUNC_SEEK_CUR)!=0)
+                        err=UNZ_ERRNO;
+            }
             else
             {
                 if (ZSEEK64(s->z_filefunc, s->filestream,dataSize,ZLIB_FILEFUNC_SEEK_CUR)!=0)
@@ -1226,6 +1485,49 @@ extern int ZEXPORT unzGoToNextFile (unzFile  file)
 }
 
 
+/*
+  Locate szFileName with the index of the file names, in constant time.
+  The current file is unchanged if the file is not found.
+*/
+local int unz64local_LocateFileInIndex OF((unz64_s* s, const char *szFileName, int iCaseSensitivity));
+
+local int unz64local_LocateFileInIndex (unz64_s* s, const char *szFileName, int iCaseSensitivity)
+{
+    unz64_index* index = s->index;
+    const uLong* slots;
+    uLong slot;
+    unz64_file_pos file_pos;
+
+    if (iCaseSensitivity==0)
+        iCaseSensitivity=CASESENSITIVITYDEFAULTVALUE;
+
+    if (iCaseSensitivity==1)
+        slots = index->slots;
+    else
+    {
+        if (index->slots_nocase == NULL)
+            index->slots_nocase = unz64local_BuildIndexSlots(index, iCaseSensitivity);
+        slots = index->slots_nocase;
+        if (slots == NULL)
+            return UNZ_INTERNALERROR;
+    }
+
+    slot = unz64local_HashFileName(szFileName, iCaseSensitivity) & index->slot_mask;
+    while (slots[slot] != 0)
+    {
+        const unz64_index_entry* entry = &index->entries[slots[slot] - 1];
+        if (unzStringFileNameCompare(index->names + entry->name_offset,
+                                     szFileName, iCaseSensitivity)==0)
+        {
+            file_pos.pos_in_zip_directory = entry->pos_in_central_dir;
+            file_pos.num_of_file = entry->num_file;
+            return unzGoToFilePos64((unzFile)s, &file_pos);
+        }
+        slot = (slot + 1) & index->slot_mask;
+    }
+    return UNZ_END_OF_LIST_OF_FILE;
+}
+
 /*
   Try locate the file szFileName in the zipfile.
   For the iCaseSensitivity signification, see unzipStringFileNameCompare
@@ -1258,6 +1560,9 @@ extern int ZEXPORT unzLocateFile (unzFile file, const char *szFileName, int iCas
     if (!s->current_file_ok)
         return UNZ_END_OF_LIST_OF_FILE;
 
+    if (s->index != NULL)
+        return unz64local_LocateFileInIndex(s, szFileName, iCaseSensitivity);
+
     /* Save the current state */
     num_fileSaved = s->num_file;
     pos_in_central_dirSaved = s->pos_in_central_dir;
@@ -1387,6 +1692,19 @@ extern int ZEXPORT unzGoToFilePos(
   store in *piSizeVar the size of extra info in local header
         (filename and size of extra field data)
 */
+/*
+  The compression method of the data of the current file, the one given in
+  the AES extra field when the data is encrypted with AES
+*/
+local uLong unz64local_DataMethod OF((const unz64_s* s));
+local uLong unz64local_DataMethod (const unz64_s* s)
+{
+    if ((s->cur_file_info.compression_method==ZIPAES_METHOD) &&
+        (s->cur_file_info_internal.aes_version!=0))
+        return s->cur_file_info_internal.aes_method;
+    return s->cur_file_info.compression_method;
+}
+
 local int unz64local_CheckCurrentFileCoherencyHeader (unz64_s* s, uInt* piSizeVar,
                                                     ZPOS64_T * poffset_local_extrafield,
                                                     uInt  * psize_local_extrafield)
@@ -1427,11 +1745,11 @@ local int unz64local_CheckCurrentFileCoherencyHeader (unz64_s* s, uInt* piSizeVa
     else if ((err==UNZ_OK) && (uData!=s->cur_file_info.compression_method))
         err=UNZ_BADZIPFILE;
 
-    if ((err==UNZ_OK) && (s->cur_file_info.compression_method!=0) &&
+    if ((err==UNZ_OK) && (unz64local_DataMethod(s)!=0) &&
 /* #ifdef HAVE_BZIP2 */
-                         (s->cur_file_info.compression_method!=Z_BZIP2ED) &&
+                         (unz64local_DataMethod(s)!=Z_BZIP2ED) &&
 /* #endif */
-                         (s->cur_file_info.compression_method!=Z_DEFLATED))
+                         (unz64local_DataMethod(s)!=Z_DEFLATED))
         err=UNZ_BADZIPFILE;
 
     if (unz64local_getLong(&s->z_filefunc, s->filestream,&uData) != UNZ_OK) /* date/time */
@@ -1483,6 +1801,8 @@ extern int ZEXPORT unzOpenCurrentFile3 (unzFile file, int* method,
     file_in_zip64_read_info_s* pfile_in_zip_read_info;
     ZPOS64_T offset_local_extrafield;  /* offset of the local extra field */
     uInt  size_local_extrafield;    /* size of the local extra field */
+    uInt  uSizeReadBuffer;
+    uLong data_method;
 #    ifndef NOUNCRYPT
     char source[12];
 #    else
@@ -1502,11 +1822,36 @@ extern int ZEXPORT unzOpenCurrentFile3 (unzFile file, int* method,
     if (unz64local_CheckCurrentFileCoherencyHeader(s,&iSizeVar, &offset_local_extrafield,&size_local_extrafield)!=UNZ_OK)
         return UNZ_BADZIPFILE;
 
-    pfile_in_zip_read_info = (file_in_zip64_read_info_s*)ALLOC(sizeof(file_in_zip64_read_info_s));
+    /* AES encrypted data can only be read as it is without the password */
+    data_method = unz64local_DataMethod(s);
+    if ((s->cur_file_info.compression_method==ZIPAES_METHOD) && (password==NULL) && (!raw))
+        return UNZ_BADPASSWORD;
+
+    /* reuse the structure of the last file closed, with its buffer and inflate state */
+    pfile_in_zip_read_info = s->pfile_in_zip_read_cache;
+    s->pfile_in_zip_read_cache = NULL;
     if (pfile_in_zip_read_info==NULL)
-        return UNZ_INTERNALERROR;
+    {
+        pfile_in_zip_read_info = (file_in_zip64_read_info_s*)ALLOC(sizeof(file_in_zip64_read_info_s));
+        if (pfile_in_zip_read_info==NULL)
+            return UNZ_INTERNALERROR;
+        pfile_in_zip_read_info->read_buffer = NULL;
+        pfile_in_zip_read_info->size_read_buffer = 0;
+        pfile_in_zip_read_info->stream_initialised = 0;
+    }
 
-    pfile_in_zip_read_info->read_buffer=(char*)ALLOC(UNZ_BUFSIZE);
+    /* no need for a buffer larger than the compressed data of the file */
+    uSizeReadBuffer = s->size_read_buffer;
+    if (s->cur_file_info.compressed_size < s->size_read_buffer)
+        uSizeReadBuffer = (uInt)((s->cur_file_info.compressed_size + UNZ_BUFALIGN) & ~((ZPOS64_T)UNZ_BUFALIGN - 1));
+    if ((pfile_in_zip_read_info->read_buffer==NULL) ||
+        (pfile_in_zip_read_info->size_read_buffer < uSizeReadBuffer) ||
+        (pfile_in_zip_read_info->size_read_buffer > s->size_read_buffer))
+    {
+        TRYFREE(pfile_in_zip_read_info->read_buffer);
+        pfile_in_zip_read_info->size_read_buffer = uSizeReadBuffer;
+        pfile_in_zip_read_info->read_buffer=(char*)ALLOC(uSizeReadBuffer);
+    }
     pfile_in_zip_read_info->offset_local_extrafield = offset_local_extrafield;
     pfile_in_zip_read_info->size_local_extrafield = size_local_extrafield;
     pfile_in_zip_read_info->pos_local_extrafield=0;
@@ -1514,14 +1859,13 @@ extern int ZEXPORT unzOpenCurrentFile3 (unzFile file, int* method,
 
     if (pfile_in_zip_read_info->read_buffer==NULL)
     {
-        TRYFREE(pfile_in_zip_read_info);
+        unz64local_FreeReadInfo(pfile_in_zip_read_info);
         return UNZ_INTERNALERROR;
     }
 
-    pfile_in_zip_read_info->stream_initialised=0;
-
+    /* data read raw keeps its AES encryption without the password */
     if (method!=NULL)
-        *method = (int)s->cur_file_info.compression_method;
+        *method = (int)((raw && (password==NULL)) ? s->cur_file_info.compression_method : data_method);
 
     if (level!=NULL)
     {
@@ -1534,25 +1878,29 @@ extern int ZEXPORT unzOpenCurrentFile3 (unzFile file, int* method,
         }
     }
 
-    if ((s->cur_file_info.compression_method!=0) &&
+    if ((data_method!=0) &&
 /* #ifdef HAVE_BZIP2 */
-        (s->cur_file_info.compression_method!=Z_BZIP2ED) &&
+        (data_method!=Z_BZIP2ED) &&
 /* #endif */
-        (s->cur_file_info.compression_method!=Z_DEFLATED))
+        (data_method!=Z_DEFLATED))
 
         err=UNZ_BADZIPFILE;
 
     pfile_in_zip_read_info->crc32_wait=s->cur_file_info.crc;
     pfile_in_zip_read_info->crc32=0;
     pfile_in_zip_read_info->total_out_64=0;
-    pfile_in_zip_read_info->compression_method = s->cur_file_info.compression_method;
+    pfile_in_zip_read_info->compression_method = data_method;
     pfile_in_zip_read_info->filestream=s->filestream;
     pfile_in_zip_read_info->z_filefunc=s->z_filefunc;
     pfile_in_zip_read_info->byte_before_the_zipfile=s->byte_before_the_zipfile;
 
     pfile_in_zip_read_info->stream.total_out = 0;
+    pfile_in_zip_read_info->crc_unknown = 0;
+    pfile_in_zip_read_info->aes_version = s->cur_file_info.compression_method==ZIPAES_METHOD ?
+                                              s->cur_file_info_internal.aes_version : 0;
+    pfile_in_zip_read_info->aes = 0;
 
-    if ((s->cur_file_info.compression_method==Z_BZIP2ED) && (!raw))
+    if ((data_method==Z_BZIP2ED) && (!raw))
     {
 #ifdef HAVE_BZIP2
       pfile_in_zip_read_info->bstream.bzalloc = (void *(*) (void *, int, int))0;
@@ -1566,32 +1914,47 @@ extern int ZEXPORT unzOpenCurrentFile3 (unzFile file, int* method,
       pfile_in_zip_read_info->stream.next_in = (voidpf)0;
       pfile_in_zip_read_info->stream.avail_in = 0;
 
+      if (pfile_in_zip_read_info->stream_initialised == Z_DEFLATED)
+        inflateEnd(&pfile_in_zip_read_info->stream);
+      pfile_in_zip_read_info->stream_initialised=0;
+
       err=BZ2_bzDecompressInit(&pfile_in_zip_read_info->bstream, 0, 0);
       if (err == Z_OK)
         pfile_in_zip_read_info->stream_initialised=Z_BZIP2ED;
       else
       {
-        TRYFREE(pfile_in_zip_read_info);
+        unz64local_FreeReadInfo(pfile_in_zip_read_info);
         return err;
       }
 #else
       pfile_in_zip_read_info->raw=1;
 #endif
     }
-    else if ((s->cur_file_info.compression_method==Z_DEFLATED) && (!raw))
+    else if ((data_method==Z_DEFLATED) && (!raw))
     {
-      pfile_in_zip_read_info->stream.zalloc = (alloc_func)0;
-      pfile_in_zip_read_info->stream.zfree = (free_func)0;
-      pfile_in_zip_read_info->stream.opaque = (voidpf)0;
-      pfile_in_zip_read_info->stream.next_in = 0;
-      pfile_in_zip_read_info->stream.avail_in = 0;
-
-      err=inflateInit2(&pfile_in_zip_read_info->stream, -MAX_WBITS);
+      /* an inflate state kept from a previous file only needs to be reset */
+      if (pfile_in_zip_read_info->stream_initialised == Z_DEFLATED)
+        err=inflateReset(&pfile_in_zip_read_info->stream);
+      else
+      {
+#ifdef HAVE_BZIP2
+        if (pfile_in_zip_read_info->stream_initialised == Z_BZIP2ED)
+          BZ2_bzDecompressEnd(&pfile_in_zip_read_info->bstream);
+#endif
+        pfile_in_zip_read_info->stream_initialised=0;
+        pfile_in_zip_read_info->stream.zalloc = (alloc_func)0;
+        pfile_in_zip_read_info->stream.zfree = (free_func)0;
+        pfile_in_zip_read_info->stream.opaque = (voidpf)0;
+        pfile_in_zip_read_info->stream.next_in = 0;
+        pfile_in_zip_read_info->stream.avail_in = 0;
+
+        err=inflateInit2(&pfile_in_zip_read_info->stream, -MAX_WBITS);
+      }
       if (err == Z_OK)
         pfile_in_zip_read_info->stream_initialised=Z_DEFLATED;
       else
       {
-        TRYFREE(pfile_in_zip_read_info);
+        unz64local_FreeReadInfo(pfile_in_zip_read_info);
         return err;
       }
         /* windowBits is passed < 0 to tell that there is no zlib header.
@@ -1618,7 +1981,47 @@ extern int ZEXPORT unzOpenCurrentFile3 (unzFile file, int* method,
                 s->encrypted = 0;
 
 #    ifndef NOUNCRYPT
-    if (password != NULL)
+    if ((password != NULL) && (s->cur_file_info.compression_method==ZIPAES_METHOD))
+    {
+        /* the salt and the password verification value, then the data and
+           its authentication code */
+        unsigned char header[ZIPAES_MAX_SALT_LEN + ZIPAES_VERIFY_LEN];
+        unsigned char verify[ZIPAES_VERIFY_LEN];
+        int strength = s->cur_file_info_internal.aes_strength;
+
+        if ((strength<ZIPAES_128) || (strength>ZIPAES_256) ||
+            (s->pfile_in_zip_read->rest_read_compressed < (ZPOS64_T)ZIPAES_OVERHEAD(strength)))
+        {
+            unzCloseCurrentFile(file);
+            return UNZ_BADZIPFILE;
+        }
+        if (ZSEEK64(s->z_filefunc, s->filestream,
+                  s->pfile_in_zip_read->pos_in_zipfile +
+                     s->pfile_in_zip_read->byte_before_the_zipfile,
+                  SEEK_SET)!=0)
+        {
+            unzCloseCurrentFile(file);
+            return UNZ_INTERNALERROR;
+        }
+        if(ZREAD64(s->z_filefunc, s->filestream,header,ZIPAES_HEADER_LEN(strength))<(uLong)ZIPAES_HEADER_LEN(strength))
+        {
+            unzCloseCurrentFile(file);
+            return UNZ_INTERNALERROR;
+        }
+
+        zipaes_init(&s->aes_ctx,strength,password,header,verify);
+        if (memcmp(verify,header+ZIPAES_SALT_LEN(strength),ZIPAES_VERIFY_LEN)!=0)
+        {
+            unzCloseCurrentFile(file);
+            return UNZ_BADPASSWORD;
+        }
+
+        s->pfile_in_zip_read->pos_in_zipfile+=ZIPAES_HEADER_LEN(strength);
+        s->pfile_in_zip_read->rest_read_compressed-=ZIPAES_OVERHEAD(strength);
+        s->pfile_in_zip_read->aes=strength;
+        s->encrypted=1;
+    }
+    else if (password != NULL)
     {
         int i;
         s->pcrc_32_tab = get_crc_table();
@@ -1637,8 +2040,13 @@ extern int ZEXPORT unzOpenCurrentFile3 (unzFile file, int* method,
         s->pfile_in_zip_read->pos_in_zipfile+=12;
         s->encrypted=1;
     }
+    s->pfile_in_zip_read->keys_data[0] = s->keys[0];
+    s->pfile_in_zip_read->keys_data[1] = s->keys[1];
+    s->pfile_in_zip_read->keys_data[2] = s->keys[2];
 #    endif
 
+    s->pfile_in_zip_read->pos_in_zipfile_data = s->pfile_in_zip_read->pos_in_zipfile;
+    s->pfile_in_zip_read->rest_read_compressed_data = s->pfile_in_zip_read->rest_read_compressed;
 
     return UNZ_OK;
 }
@@ -1676,6 +2084,60 @@ extern ZPOS64_T ZEXPORT unzGetCurrentFileZStreamPos64( unzFile file)
 
 /** Addition for GDAL : END */
 
+/*
+  Read the next compressed data of the current file in its read buffer.
+*/
+local int unz64local_FillReadBuffer OF((unz64_s* s, file_in_zip64_read_info_s* pfile_in_zip_read_info));
+local int unz64local_FillReadBuffer (unz64_s* s, file_in_zip64_read_info_s* pfile_in_zip_read_info)
+{
+    uInt uReadThis = pfile_in_zip_read_info->size_read_buffer;
+    if (pfile_in_zip_read_info->rest_read_compressed<uReadThis)
+        uReadThis = (uInt)pfile_in_zip_read_info->rest_read_compressed;
+    if (uReadThis == 0)
+        return UNZ_EOF;
+    if (ZSEEK64(pfile_in_zip_read_info->z_filefunc,
+              pfile_in_zip_read_info->filestream,
+              pfile_in_zip_read_info->pos_in_zipfile +
+                 pfile_in_zip_read_info->byte_before_the_zipfile,
+                 ZLIB_FILEFUNC_SEEK_SET)!=0)
+        return UNZ_ERRNO;
+    if (ZREAD64(pfile_in_zip_read_info->z_filefunc,
+              pfile_in_zip_read_info->filestream,
+              pfile_in_zip_read_info->read_buffer,
+              uReadThis)!=uReadThis)
+        return UNZ_ERRNO;
+
+
+#    ifndef NOUNCRYPT
+    if(s->encrypted && pfile_in_zip_read_info->aes)
+    {
+        /* counter mode decrypts from anywhere, after a seek too */
+        ZPOS64_T pos = pfile_in_zip_read_info->pos_in_zipfile - pfile_in_zip_read_info->pos_in_zipfile_data;
+        if (s->aes_ctx.pos != pos)
+            zipaes_seek(&s->aes_ctx,pos);
+        zipaes_decrypt(&s->aes_ctx,(unsigned char*)pfile_in_zip_read_info->read_buffer,uReadThis);
+    }
+    else if(s->encrypted)
+    {
+        uInt i;
+        for(i=0;i<uReadThis;i++)
+          pfile_in_zip_read_info->read_buffer[i] =
+              zdecode(s->keys,s->pcrc_32_tab,
+                      pfile_in_zip_read_info->read_buffer[i]);
+    }
+#    endif
+
+
+    pfile_in_zip_read_info->pos_in_zipfile += uReadThis;
+
+    pfile_in_zip_read_info->rest_read_compressed-=uReadThis;
+
+    pfile_in_zip_read_info->stream.next_in =
+        (Bytef*)pfile_in_zip_read_info->read_buffer;
+    pfile_in_zip_read_info->stream.avail_in = (uInt)uReadThis;
+    return UNZ_OK;
+}
+
 /*
   Read bytes from the current file.
   buf contain buffer where data must be copied
@@ -1726,43 +2188,9 @@ extern int ZEXPORT unzReadCurrentFile  (unzFile file, voidp buf, unsigned len)
         if ((pfile_in_zip_read_info->stream.avail_in==0) &&
             (pfile_in_zip_read_info->rest_read_compressed>0))
         {
-            uInt uReadThis = UNZ_BUFSIZE;
-            if (pfile_in_zip_read_info->rest_read_compressed<uReadThis)
-                uReadThis = (uInt)pfile_in_zip_read_info->rest_read_compressed;
-            if (uReadThis == 0)
-                return UNZ_EOF;
-            if (ZSEEK64(pfile_in_zip_read_info->z_filefunc,
-                      pfile_in_zip_read_info->filestream,
-                      pfile_in_zip_read_info->pos_in_zipfile +
-                         pfile_in_zip_read_info->byte_before_the_zipfile,
-                         ZLIB_FILEFUNC_SEEK_SET)!=0)
-                return UNZ_ERRNO;
-            if (ZREAD64(pfile_in_zip_read_info->z_filefunc,
-                      pfile_in_zip_read_info->filestream,
-                      pfile_in_zip_read_info->read_buffer,
-                      uReadThis)!=uReadThis)
-                return UNZ_ERRNO;
-
-
-#            ifndef NOUNCRYPT
-            if(s->encrypted)
-            {
-                uInt i;
-                for(i=0;i<uReadThis;i++)
-                  pfile_in_zip_read_info->read_buffer[i] =
-                      zdecode(s->keys,s->pcrc_32_tab,
-                              pfile_in_zip_read_info->read_buffer[i]);
-            }
-#            endif
-
-
-            pfile_in_zip_read_info->pos_in_zipfile += uReadThis;
-
-            pfile_in_zip_read_info->rest_read_compressed-=uReadThis;
-
-            pfile_in_zip_read_info->stream.next_in =
-                (Bytef*)pfile_in_zip_read_info->read_buffer;
-            pfile_in_zip_read_info->stream.avail_in = (uInt)uReadThis;
+            err = unz64local_FillReadBuffer(s,pfile_in_zip_read_info);
+            if (err!=UNZ_OK)
+                return err;
         }
 
         if ((pfile_in_zip_read_info->compression_method==0) || (pfile_in_zip_read_info->raw))
@@ -1785,7 +2213,7 @@ extern int ZEXPORT unzReadCurrentFile  (unzFile file, voidp buf, unsigned len)
 
             pfile_in_zip_read_info->total_out_64 = pfile_in_zip_read_info->total_out_64 + uDoCopy;
 
-            pfile_in_zip_read_info->crc32 = crc32(pfile_in_zip_read_info->crc32,
+            pfile_in_zip_read_info->crc32 = fastcrc32(pfile_in_zip_read_info->crc32,
                                 pfile_in_zip_read_info->stream.next_out,
                                 uDoCopy);
             pfile_in_zip_read_info->rest_read_uncompressed-=uDoCopy;
@@ -1822,7 +2250,7 @@ extern int ZEXPORT unzReadCurrentFile  (unzFile file, voidp buf, unsigned len)
 
             pfile_in_zip_read_info->total_out_64 = pfile_in_zip_read_info->total_out_64 + uOutThis;
 
-            pfile_in_zip_read_info->crc32 = crc32(pfile_in_zip_read_info->crc32,bufBefore, (uInt)(uOutThis));
+            pfile_in_zip_read_info->crc32 = fastcrc32(pfile_in_zip_read_info->crc32,bufBefore, (uInt)(uOutThis));
             pfile_in_zip_read_info->rest_read_uncompressed -= uOutThis;
             iRead += (uInt)(uTotalOutAfter - uTotalOutBefore);
 
@@ -1866,7 +2294,7 @@ extern int ZEXPORT unzReadCurrentFile  (unzFile file, voidp buf, unsigned len)
             pfile_in_zip_read_info->total_out_64 = pfile_in_zip_read_info->total_out_64 + uOutThis;
 
             pfile_in_zip_read_info->crc32 =
-                crc32(pfile_in_zip_read_info->crc32,bufBefore,
+                fastcrc32(pfile_in_zip_read_info->crc32,bufBefore,
                         (uInt)(uOutThis));
 
             pfile_in_zip_read_info->rest_read_uncompressed -=
@@ -1945,6 +2373,356 @@ extern int ZEXPORT unzeof (unzFile file)
 
 
 
+/*
+  Go back to the start of the data of the current file.
+*/
+local int unz64local_RestartCurrentFile OF((unz64_s* s, file_in_zip64_read_info_s* pfile_in_zip_read_info));
+local int unz64local_RestartCurrentFile (unz64_s* s, file_in_zip64_read_info_s* pfile_in_zip_read_info)
+{
+    if (pfile_in_zip_read_info->stream_initialised == Z_DEFLATED)
+    {
+        if (inflateReset(&pfile_in_zip_read_info->stream)!=Z_OK)
+            return UNZ_INTERNALERROR;
+    }
+    else if (pfile_in_zip_read_info->compression_method!=0)
+        return UNZ_PARAMERROR;
+
+#    ifndef NOUNCRYPT
+    s->keys[0] = pfile_in_zip_read_info->keys_data[0];
+    s->keys[1] = pfile_in_zip_read_info->keys_data[1];
+    s->keys[2] = pfile_in_zip_read_info->keys_data[2];
+#    endif
+    pfile_in_zip_read_info->rest_read_uncompressed += pfile_in_zip_read_info->total_out_64;
+    pfile_in_zip_read_info->total_out_64 = 0;
+    pfile_in_zip_read_info->pos_in_zipfile = pfile_in_zip_read_info->pos_in_zipfile_data;
+    pfile_in_zip_read_info->rest_read_compressed = pfile_in_zip_read_info->rest_read_compressed_data;
+    pfile_in_zip_read_info->stream.avail_in = 0;
+    pfile_in_zip_read_info->stream.total_out = 0;
+    pfile_in_zip_read_info->crc32 = 0;
+    pfile_in_zip_read_info->crc_unknown = 0;
+    return UNZ_OK;
+}
+
+/*
+  Restart inflating the current file at a checkpoint.
+*/
+local int unz64local_RestoreSeekPoint OF((unz64_s* s,
+                                          file_in_zip64_read_info_s* pfile_in_zip_read_info,
+                                          const unz64_seek_point* point));
+local int unz64local_RestoreSeekPoint (unz64_s* s,
+                                       file_in_zip64_read_info_s* pfile_in_zip_read_info,
+                                       const unz64_seek_point* point)
+{
+    ZPOS64_T in = point->in - (point->bits ? 1 : 0);
+    int err;
+
+    if (inflateReset(&pfile_in_zip_read_info->stream)!=Z_OK)
+        return UNZ_INTERNALERROR;
+    pfile_in_zip_read_info->pos_in_zipfile = pfile_in_zip_read_info->pos_in_zipfile_data + in;
+    pfile_in_zip_read_info->rest_read_compressed = pfile_in_zip_read_info->rest_read_compressed_data - in;
+    pfile_in_zip_read_info->stream.avail_in = 0;
+
+    /* the checkpoint may start in the middle of a byte */
+    if (point->bits)
+    {
+        int ch;
+        err = unz64local_FillReadBuffer(s,pfile_in_zip_read_info);
+        if (err!=UNZ_OK)
+            return err;
+        ch = *pfile_in_zip_read_info->stream.next_in++;
+        pfile_in_zip_read_info->stream.avail_in--;
+        if (inflatePrime(&pfile_in_zip_read_info->stream,point->bits,ch >> (8 - point->bits))!=Z_OK)
+            return UNZ_INTERNALERROR;
+    }
+    if (point->size_window>0)
+    {
+        if (inflateSetDictionary(&pfile_in_zip_read_info->stream,point->window,point->size_window)!=Z_OK)
+            return UNZ_INTERNALERROR;
+    }
+
+    pfile_in_zip_read_info->rest_read_uncompressed += pfile_in_zip_read_info->total_out_64;
+    pfile_in_zip_read_info->rest_read_uncompressed -= point->out;
+    pfile_in_zip_read_info->total_out_64 = point->out;
+    pfile_in_zip_read_info->stream.total_out = (uLong)point->out;
+    pfile_in_zip_read_info->crc_unknown = 1;
+    return UNZ_OK;
+}
+
+/*
+  Add a checkpoint at the current position of the current file, a deflate
+  block boundary, unless there is one less than seek_span bytes away.
+  window is a circular buffer of UNZ_SEEK_WINDOW bytes, holding the bytes just
+  inflated before pos_window. Checkpoints are optional, so errors are ignored.
+*/
+local void unz64local_AddSeekPoint OF((unz64_s* s,
+                                       file_in_zip64_read_info_s* pfile_in_zip_read_info,
+                                       const Bytef* window, uInt pos_window));
+local void unz64local_AddSeekPoint (unz64_s* s,
+                                    file_in_zip64_read_info_s* pfile_in_zip_read_info,
+                                    const Bytef* window, uInt pos_window)
+{
+    unz64_seek_index* seek_index = s->seek_index;
+    unz64_seek_point point;
+    ZPOS64_T out = pfile_in_zip_read_info->total_out_64;
+    uInt start;
+    uLong i;
+
+    /* only the checkpoints of the last file seeked in are kept */
+    if ((seek_index!=NULL) &&
+        (seek_index->pos_in_zipfile_data != pfile_in_zip_read_info->pos_in_zipfile_data))
+    {
+        unz64local_FreeSeekIndex(seek_index);
+        s->seek_index = seek_index = NULL;
+    }
+    if (seek_index==NULL)
+    {
+        seek_index = (unz64_seek_index*)ALLOC(sizeof(unz64_seek_index));
+        if (seek_index==NULL)
+            return;
+        memset(seek_index,0,sizeof(unz64_seek_index));
+        seek_index->pos_in_zipfile_data = pfile_in_zip_read_info->pos_in_zipfile_data;
+        s->seek_index = seek_index;
+    }
+
+    /* the start of the data is a checkpoint too */
+    for (i=seek_index->number_point;(i>0) && (seek_index->points[i-1].out > out);i--)
+        ;
+    if ((i>0 ? out - seek_index->points[i-1].out : out) < s->seek_span)
+        return;
+    if ((i<seek_index->number_point) && (seek_index->points[i].out - out < s->seek_span))
+        return;
+
+    if (seek_index->number_point == seek_index->size_points)
+    {
+        uLong size_points = seek_index->size_points == 0 ? 16 : seek_index->size_points*2;
+        unz64_seek_point* points = (unz64_seek_point*)realloc(seek_index->points,size_points*sizeof(unz64_seek_point));
+        if (points==NULL)
+            return;
+        seek_index->points = points;
+        seek_index->size_points = size_points;
+    }
+
+    point.out = out;
+    point.in = (pfile_in_zip_read_info->rest_read_compressed_data -
+                pfile_in_zip_read_info->rest_read_compressed) -
+               pfile_in_zip_read_info->stream.avail_in;
+    point.bits = pfile_in_zip_read_info->stream.data_type & 7;
+    point.size_window = out < UNZ_SEEK_WINDOW ? (uInt)out : UNZ_SEEK_WINDOW;
+    point.window = (Bytef*)ALLOC(point.size_window + 1);
+    if (point.window==NULL)
+        return;
+    start = (pos_window + UNZ_SEEK_WINDOW - point.size_window) % UNZ_SEEK_WINDOW;
+    if (start + point.size_window > UNZ_SEEK_WINDOW)
+    {
+        memcpy(point.window,window+start,UNZ_SEEK_WINDOW-start);
+        memcpy(point.window+(UNZ_SEEK_WINDOW-start),window,point.size_window-(UNZ_SEEK_WINDOW-start));
+    }
+    else
+        memcpy(point.window,window+start,point.size_window);
+
+    memmove(&seek_index->points[i+1],&seek_index->points[i],
+            (seek_index->number_point-i)*sizeof(unz64_seek_point));
+    seek_index->points[i] = point;
+    seek_index->number_point++;
+}
+
+/*
+  Inflate the current file up to pos to a window of its last UNZ_SEEK_WINDOW
+  bytes, adding checkpoints on the way. The window starts with the size_dict
+  bytes of dict, the bytes inflated just before the current position, if known.
+*/
+local int unz64local_InflateTo OF((unz64_s* s,
+                                   file_in_zip64_read_info_s* pfile_in_zip_read_info,
+                                   ZPOS64_T pos, const Bytef* dict, uInt size_dict));
+local int unz64local_InflateTo (unz64_s* s,
+                                file_in_zip64_read_info_s* pfile_in_zip_read_info,
+                                ZPOS64_T pos, const Bytef* dict, uInt size_dict)
+{
+    Bytef* window;
+    uInt pos_window = 0;
+    ZPOS64_T size_window;   /* bytes of the window inflated just before the current position */
+    int err=UNZ_OK;
+
+    window = (Bytef*)ALLOC(UNZ_SEEK_WINDOW);
+    if (window==NULL)
+        return UNZ_INTERNALERROR;
+    if (size_dict>0)
+        memcpy(window,dict,size_dict);
+    pos_window = size_dict % UNZ_SEEK_WINDOW;
+    size_window = size_dict;
+
+    while ((err==UNZ_OK) && (pfile_in_zip_read_info->total_out_64 < pos))
+    {
+        uInt uOutThis = UNZ_SEEK_WINDOW - pos_window;
+        int zerr;
+
+        if (pos - pfile_in_zip_read_info->total_out_64 < uOutThis)
+            uOutThis = (uInt)(pos - pfile_in_zip_read_info->total_out_64);
+        if ((pfile_in_zip_read_info->stream.avail_in==0) &&
+            (pfile_in_zip_read_info->rest_read_compressed>0))
+        {
+            err = unz64local_FillReadBuffer(s,pfile_in_zip_read_info);
+            if (err!=UNZ_OK)
+                break;
+        }
+
+        /* Z_BLOCK stops at the end of each deflate block, where checkpoints can be */
+        pfile_in_zip_read_info->stream.next_out = window + pos_window;
+        pfile_in_zip_read_info->stream.avail_out = uOutThis;
+        zerr = inflate(&pfile_in_zip_read_info->stream,Z_BLOCK);
+        if ((zerr>=0) && (pfile_in_zip_read_info->stream.msg!=NULL))
+            zerr = Z_DATA_ERROR;
+
+        uOutThis -= pfile_in_zip_read_info->stream.avail_out;
+        if (!pfile_in_zip_read_info->crc_unknown)
+            pfile_in_zip_read_info->crc32 = fastcrc32(pfile_in_zip_read_info->crc32,
+                                                      window + pos_window,uOutThis);
+        pfile_in_zip_read_info->total_out_64 += uOutThis;
+        pfile_in_zip_read_info->rest_read_uncompressed -= uOutThis;
+        pos_window = (pos_window + uOutThis) % UNZ_SEEK_WINDOW;
+        size_window += uOutThis;
+
+        if (zerr==Z_STREAM_END)
+            err = pfile_in_zip_read_info->total_out_64 < pos ? UNZ_BADZIPFILE : UNZ_OK;
+        else if ((zerr==Z_BUF_ERROR) && (uOutThis==0) &&
+                 (pfile_in_zip_read_info->stream.avail_in==0) &&
+                 (pfile_in_zip_read_info->rest_read_compressed==0))
+            err = UNZ_BADZIPFILE;
+        else if ((zerr!=Z_OK) && (zerr!=Z_BUF_ERROR))
+            err = zerr;
+        else if ((s->seek_span>0) &&
+                 (pfile_in_zip_read_info->stream.data_type & 128) &&
+                 !(pfile_in_zip_read_info->stream.data_type & 64) &&
+                 ((size_window >= UNZ_SEEK_WINDOW) ||
+                  (size_window >= pfile_in_zip_read_info->total_out_64)))
+            unz64local_AddSeekPoint(s,pfile_in_zip_read_info,window,pos_window);
+        if (zerr==Z_STREAM_END)
+            break;
+    }
+    TRYFREE(window);
+    return err;
+}
+
+/*
+  Read the current file up to pos, to a scratch buffer.
+*/
+local int unz64local_ReadTo OF((unzFile file, ZPOS64_T pos));
+local int unz64local_ReadTo (unzFile file, ZPOS64_T pos)
+{
+    unz64_s* s=(unz64_s*)file;
+    voidp buf;
+    int err=UNZ_OK;
+
+    buf = ALLOC(UNZ_SEEK_WINDOW);
+    if (buf==NULL)
+        return UNZ_INTERNALERROR;
+    while (s->pfile_in_zip_read->total_out_64 < pos)
+    {
+        unsigned len = UNZ_SEEK_WINDOW;
+        int read;
+        if (pos - s->pfile_in_zip_read->total_out_64 < len)
+            len = (unsigned)(pos - s->pfile_in_zip_read->total_out_64);
+        read = unzReadCurrentFile(file,buf,len);
+        if (read<=0)
+        {
+            err = read<0 ? read : UNZ_BADZIPFILE;
+            break;
+        }
+    }
+    TRYFREE(buf);
+    return err;
+}
+
+/*
+  Set the position in uncompressed data of the current file.
+  return UNZ_OK if there is no problem
+*/
+extern int ZEXPORT unzSeekCurrentFile64 (unzFile file, ZPOS64_T pos)
+{
+    unz64_s* s;
+    file_in_zip64_read_info_s* pfile_in_zip_read_info;
+    ZPOS64_T size;
+    int err;
+    if (file==NULL)
+        return UNZ_PARAMERROR;
+    s=(unz64_s*)file;
+    pfile_in_zip_read_info=s->pfile_in_zip_read;
+
+    if ((pfile_in_zip_read_info==NULL) || (pfile_in_zip_read_info->raw))
+        return UNZ_PARAMERROR;
+    size = pfile_in_zip_read_info->total_out_64 + pfile_in_zip_read_info->rest_read_uncompressed;
+    if (pos > size)
+        return UNZ_PARAMERROR;
+    if (pos == pfile_in_zip_read_info->total_out_64)
+        return UNZ_OK;
+
+    /* stored data is where it is in the zipfile, unless the traditional
+       encryption hides it: AES in counter mode decrypts from anywhere */
+    if ((pfile_in_zip_read_info->compression_method==0) &&
+        ((!s->encrypted) || (pfile_in_zip_read_info->aes)))
+    {
+        pfile_in_zip_read_info->pos_in_zipfile = pfile_in_zip_read_info->pos_in_zipfile_data + pos;
+        pfile_in_zip_read_info->rest_read_compressed = pfile_in_zip_read_info->rest_read_compressed_data - pos;
+        pfile_in_zip_read_info->rest_read_uncompressed = size - pos;
+        pfile_in_zip_read_info->total_out_64 = pos;
+        pfile_in_zip_read_info->stream.total_out = (uLong)pos;
+        pfile_in_zip_read_info->stream.avail_in = 0;
+        pfile_in_zip_read_info->crc_unknown = 1;
+        return UNZ_OK;
+    }
+
+    /* deflated data restarts at the last checkpoint before pos, when that is
+       closer than the current position */
+    if ((pfile_in_zip_read_info->stream_initialised==Z_DEFLATED) &&
+        ((!s->encrypted) || (pfile_in_zip_read_info->aes)))
+    {
+        const unz64_seek_point* point = NULL;
+        unz64_seek_index* seek_index = s->seek_index;
+        if ((seek_index!=NULL) &&
+            (seek_index->pos_in_zipfile_data == pfile_in_zip_read_info->pos_in_zipfile_data))
+        {
+            uLong low = 0, high = seek_index->number_point;
+            while (low < high)
+            {
+                uLong mid = (low + high) / 2;
+                if (seek_index->points[mid].out <= pos)
+                    low = mid + 1;
+                else
+                    high = mid;
+            }
+            if (low>0)
+                point = &seek_index->points[low-1];
+        }
+
+        if ((point!=NULL) &&
+            ((pos < pfile_in_zip_read_info->total_out_64) ||
+             (point->out > pfile_in_zip_read_info->total_out_64)))
+        {
+            err = unz64local_RestoreSeekPoint(s,pfile_in_zip_read_info,point);
+            if (err==UNZ_OK)
+                err = unz64local_InflateTo(s,pfile_in_zip_read_info,pos,point->window,point->size_window);
+            return err;
+        }
+        if (pos < pfile_in_zip_read_info->total_out_64)
+        {
+            err = unz64local_RestartCurrentFile(s,pfile_in_zip_read_info);
+            if (err!=UNZ_OK)
+                return err;
+        }
+        return unz64local_InflateTo(s,pfile_in_zip_read_info,pos,NULL,0);
+    }
+
+    /* otherwise read up to pos, from the start if it is behind */
+    if (pos < pfile_in_zip_read_info->total_out_64)
+    {
+        err = unz64local_RestartCurrentFile(s,pfile_in_zip_read_info);
+        if (err!=UNZ_OK)
+            return err;
+    }
+    return unz64local_ReadTo(file,pos);
+}
+
+
 /*
 Read extra field from the current file (opened by unzOpenCurrentFile)
 This is the local-header version of the extra field (sometimes, there is
@@ -2001,9 +2779,47 @@ extern int ZEXPORT unzGetLocalExtrafield (unzFile file, voidp buf, unsigned len)
     return (int)read_now;
 }
 
+#ifndef NOUNCRYPT
+/*
+  Check the authentication code after the AES encrypted data of the current
+  file, authenticating the data that was not read yet, if any.
+*/
+local int unz64local_CheckAesCode OF((unz64_s* s, file_in_zip64_read_info_s* pfile_in_zip_read_info));
+local int unz64local_CheckAesCode (unz64_s* s, file_in_zip64_read_info_s* pfile_in_zip_read_info)
+{
+    unsigned char mac[ZIPAES_MAC_LEN];
+    unsigned char mac_wait[ZIPAES_MAC_LEN];
+    int err=UNZ_OK;
+
+    while ((err==UNZ_OK) && (pfile_in_zip_read_info->rest_read_compressed>0))
+        err = unz64local_FillReadBuffer(s,pfile_in_zip_read_info);
+    pfile_in_zip_read_info->stream.avail_in = 0;
+    if (err!=UNZ_OK)
+        return err;
+
+    if (ZSEEK64(pfile_in_zip_read_info->z_filefunc,
+              pfile_in_zip_read_info->filestream,
+              pfile_in_zip_read_info->pos_in_zipfile +
+                 pfile_in_zip_read_info->byte_before_the_zipfile,
+                 ZLIB_FILEFUNC_SEEK_SET)!=0)
+        return UNZ_ERRNO;
+    if (ZREAD64(pfile_in_zip_read_info->z_filefunc,
+              pfile_in_zip_read_info->filestream,
+              mac_wait,ZIPAES_MAC_LEN)!=ZIPAES_MAC_LEN)
+        return UNZ_ERRNO;
+
+    zipaes_finish(&s->aes_ctx,mac);
+    if (memcmp(mac,mac_wait,ZIPAES_MAC_LEN)!=0)
+        return UNZ_CRCERROR;
+    return UNZ_OK;
+}
+#endif
+
 /*
   Close the file in zip opened with unzipOpenCurrentFile
-  Return UNZ_CRCERROR if all the file was read but the CRC is not good
+  Return UNZ_CRCERROR if all the file was read but the CRC, or the
+    authentication code of AES encrypted data, is not good
+  Neither is checked once a seek jumped over data of the file
 */
 extern int ZEXPORT unzCloseCurrentFile (unzFile file)
 {
@@ -2021,25 +2837,29 @@ extern int ZEXPORT unzCloseCurrentFile (unzFile file)
 
 
     if ((pfile_in_zip_read_info->rest_read_uncompressed == 0) &&
-        (!pfile_in_zip_read_info->raw))
+        (!pfile_in_zip_read_info->raw) &&
+        (!pfile_in_zip_read_info->crc_unknown))
     {
-        if (pfile_in_zip_read_info->crc32 != pfile_in_zip_read_info->crc32_wait)
+        if ((pfile_in_zip_read_info->aes_version != ZIPAES_AE2) &&
+            (pfile_in_zip_read_info->crc32 != pfile_in_zip_read_info->crc32_wait))
             err=UNZ_CRCERROR;
+#    ifndef NOUNCRYPT
+        if ((err==UNZ_OK) && (pfile_in_zip_read_info->aes))
+            err = unz64local_CheckAesCode(s,pfile_in_zip_read_info);
+#    endif
     }
 
 
-    TRYFREE(pfile_in_zip_read_info->read_buffer);
-    pfile_in_zip_read_info->read_buffer = NULL;
-    if (pfile_in_zip_read_info->stream_initialised == Z_DEFLATED)
-        inflateEnd(&pfile_in_zip_read_info->stream);
+    /* keep the structure, its buffer and its inflate state for the next file opened */
 #ifdef HAVE_BZIP2
-    else if (pfile_in_zip_read_info->stream_initialised == Z_BZIP2ED)
+    if (pfile_in_zip_read_info->stream_initialised == Z_BZIP2ED)
+    {
         BZ2_bzDecompressEnd(&pfile_in_zip_read_info->bstream);
+        pfile_in_zip_read_info->stream_initialised = 0;
+    }
 #endif
-
-
-    pfile_in_zip_read_info->stream_initialised = 0;
-    TRYFREE(pfile_in_zip_read_info);
+    unz64local_FreeReadInfo(s->pfile_in_zip_read_cache);
+    s->pfile_in_zip_read_cache = pfile_in_zip_read_info;
 
     s->pfile_in_zip_read=NULL;
 
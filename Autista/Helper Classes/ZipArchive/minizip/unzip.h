@@ -79,6 +79,7 @@ typedef voidp unzFile;
 #define UNZ_BADZIPFILE                  (-103)
 #define UNZ_INTERNALERROR               (-104)
 #define UNZ_CRCERROR                    (-105)
+#define UNZ_BADPASSWORD                 (-106)
 
 /* tm_unz contain date/time info */
 typedef struct tm_unz_s
@@ -195,6 +196,28 @@ extern unzFile ZEXPORT unzOpen2_64 OF((const void *path,
       for read/write the zip file (see ioapi.h)
 */
 
+#define UNZ_OPEN_INDEX (1)
+
+extern unzFile ZEXPORT unzOpen3_64 OF((const void *path,
+                                    zlib_filefunc64_def* pzlib_filefunc_def,
+                                    int flags));
+/*
+   Open a Zip file, like unzOpen2_64, with options in flags :
+     UNZ_OPEN_INDEX : read the whole central directory once and build a hash
+       index of the file names, so unzLocateFile takes constant time instead
+       of reading every file header. The index of names compared without case
+       is built the first time it is needed.
+*/
+
+extern unzFile ZEXPORT unzOpenMapped OF((const char *path));
+extern unzFile ZEXPORT unzOpenMapped64 OF((const void *path));
+/*
+   Open a Zip file, like unzOpen64, but map the whole file in memory
+      (see fill_mmap_filefunc64 in ioapi.h) so reading headers and data
+      does not go through stdio.
+   Return NULL if the file cannot be mapped; unzOpen64 can still be tried.
+*/
+
 extern int ZEXPORT unzClose OF((unzFile file));
 /*
   Close a ZipFile opened with unzipOpen.
@@ -202,6 +225,13 @@ extern int ZEXPORT unzClose OF((unzFile file));
     these files MUST be closed with unzipCloseCurrentFile before call unzipClose.
   return UNZ_OK if there is no problem. */
 
+extern int ZEXPORT unzSetBufferSize OF((unzFile file, uLong size));
+/*
+  Set the size of the buffer the compressed data of the files opened with
+    unzOpenCurrentFile from now on is read in, UNZ_BUFSIZE (256 KB) by default.
+  size is rounded up to a multiple of 4 KB; 0 restores the default.
+  return UNZ_OK if there is no problem. */
+
 extern int ZEXPORT unzGetGlobalInfo OF((unzFile file,
                                         unz_global_info *pglobal_info));
 
@@ -246,6 +276,9 @@ extern int ZEXPORT unzLocateFile OF((unzFile file,
   Try locate the file szFileName in the zipfile.
   For the iCaseSensitivity signification, see unzStringFileNameCompare
 
+  If the zipfile was opened with UNZ_OPEN_INDEX, the index of file names
+    is used instead of reading the central directory.
+
   return value :
   UNZ_OK if the file is found. It becomes the current file.
   UNZ_END_OF_LIST_OF_FILE if the file is not found
@@ -338,8 +371,10 @@ extern int ZEXPORT unzOpenCurrentFilePassword OF((unzFile file,
                                                   const char* password));
 /*
   Open for reading data the current file in the zipfile.
-  password is a crypting password
-  If there is no error, the return value is UNZ_OK.
+  password is a crypting password, for the traditional PKWARE encryption or
+    the WinZip AES one.
+  If there is no error, the return value is UNZ_OK. With AES, a wrong password
+    (or none) is told by UNZ_BADPASSWORD.
 */
 
 extern int ZEXPORT unzOpenCurrentFile2 OF((unzFile file,
@@ -373,7 +408,11 @@ extern int ZEXPORT unzOpenCurrentFile3 OF((unzFile file,
 extern int ZEXPORT unzCloseCurrentFile OF((unzFile file));
 /*
   Close the file in zip opened with unzOpenCurrentFile
-  Return UNZ_CRCERROR if all the file was read but the CRC is not good
+  Return UNZ_CRCERROR if all the file was read but the CRC, or the
+    authentication code of AES encrypted data, is not good
+  Neither is checked once unzSeekCurrentFile64 has jumped over data of the
+    file, or restarted it at a checkpoint: an AES encrypted file seeked in
+    is not authenticated, even if all of it was read
 */
 
 extern int ZEXPORT unzReadCurrentFile OF((unzFile file,
@@ -402,6 +441,32 @@ extern int ZEXPORT unzeof OF((unzFile file));
   return 1 if the end of file was reached, 0 elsewhere
 */
 
+extern int ZEXPORT unzSeekCurrentFile64 OF((unzFile file, ZPOS64_T pos));
+/*
+  Set the position in uncompressed data of the current file (opened by
+    unzOpenCurrentFile, not in raw mode) to pos, from its start.
+  A stored file is seeked in directly. A deflated file is inflated up to pos,
+    and checkpoints are kept on the way, every unzSetSeekSpan bytes, so
+    seeking in it again inflates from the last checkpoint before pos.
+    They are kept for the last file seeked in, until unzClose.
+  Files with the traditional encryption are read up to pos, from their start
+    if pos is behind; AES encrypted files are seeked in like the others.
+  Once data has been jumped over, or inflating restarted at a checkpoint,
+    unzCloseCurrentFile can't check the crc32, nor the authentication code
+    of an AES encrypted file: that is only checked when the file is read
+    from its start to its end without seeking, so open it again and read it
+    whole to authenticate it.
+  return UNZ_OK if there is no problem, UNZ_PARAMERROR if pos is beyond the
+    end of the file
+*/
+
+extern int ZEXPORT unzSetSeekSpan OF((unzFile file, ZPOS64_T span));
+/*
+  Set the distance between the checkpoints of unzSeekCurrentFile64 in
+    uncompressed data, UNZ_SEEK_SPAN (1 MB) by default; 0 keeps none.
+  Each checkpoint takes 32 KB of memory.
+  return UNZ_OK if there is no problem. */
+
 extern int ZEXPORT unzGetLocalExtrafield OF((unzFile file,
                                              voidp buf,
                                              unsigned len));
@@ -0,0 +1,277 @@
+/*
+  unzpool.c -- a pool of opened zipfiles for Minizip, so opening the same
+  zipfile again reuses its parsed central directory, its index of file names
+  and the read buffer and inflate state of its last file read
+  License: Same as ZLIB (www.gzip.org)
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#  include <windows.h>
+#else
+#  include <pthread.h>
+#endif
+
+#include "zlib.h"
+#include "unzpool.h"
+
+#ifndef local
+#  define local static
+#endif
+
+#ifndef ALLOC
+# define ALLOC(size) (malloc(size))
+#endif
+#ifndef TRYFREE
+# define TRYFREE(p) {if (p) free(p);}
+#endif
+
+/* an opened zipfile, used or waiting to be */
+typedef struct
+{
+    unzFile file;
+    char* path;
+    ZPOS64_T size;      /* size, modification time and inode of the file when opened */
+    time_t mtime;
+    ZPOS64_T ino;
+    int in_use;
+    uLong released;     /* when it was released, to close the oldest first */
+} unz_pool_slot;
+
+typedef struct
+{
+#ifdef _WIN32
+    CRITICAL_SECTION lock;
+#else
+    pthread_mutex_t lock;
+#endif
+    zlib_filefunc64_def filefunc;
+    int has_filefunc;
+    int flags;
+    int max_idle;
+    int number_idle;
+    unz_pool_slot* slots;
+    int number_slot;
+    int size_slots;
+    uLong clock;
+} unz_pool_s;
+
+
+local void unzPoolLock OF((unz_pool_s* p));
+local void unzPoolLock (unz_pool_s* p)
+{
+#ifdef _WIN32
+    EnterCriticalSection(&p->lock);
+#else
+    pthread_mutex_lock(&p->lock);
+#endif
+}
+
+local void unzPoolUnlock OF((unz_pool_s* p));
+local void unzPoolUnlock (unz_pool_s* p)
+{
+#ifdef _WIN32
+    LeaveCriticalSection(&p->lock);
+#else
+    pthread_mutex_unlock(&p->lock);
+#endif
+}
+
+/* the size, modification time and inode of a file, 0 if it doesn't exist.
+   The inode tells a file replaced by another in the same second apart. */
+local int unzPoolStat OF((const char* path, unz_pool_slot* slot));
+local int unzPoolStat (const char* path, unz_pool_slot* slot)
+{
+    struct stat st;
+    if (stat(path,&st) != 0)
+        return 0;
+    slot->size = (ZPOS64_T)st.st_size;
+    slot->mtime = st.st_mtime;
+    slot->ino = (ZPOS64_T)st.st_ino;
+    return 1;
+}
+
+/* close the zipfile of a slot, and remove the slot (the caller holds the lock) */
+local void unzPoolRemoveSlot OF((unz_pool_s* p, int i));
+local void unzPoolRemoveSlot (unz_pool_s* p, int i)
+{
+    unzClose(p->slots[i].file);
+    TRYFREE(p->slots[i].path);
+    if (!p->slots[i].in_use)
+        p->number_idle--;
+    p->slots[i] = p->slots[p->number_slot-1];
+    p->number_slot--;
+}
+
+
+extern unzPool ZEXPORT unzPoolCreate (int max_idle, zlib_filefunc64_def* pzlib_filefunc_def, int flags)
+{
+    unz_pool_s* p = (unz_pool_s*)ALLOC(sizeof(unz_pool_s));
+    if (p == NULL)
+        return NULL;
+    memset(p,0,sizeof(unz_pool_s));
+    if (pzlib_filefunc_def != NULL)
+    {
+        p->filefunc = *pzlib_filefunc_def;
+        p->has_filefunc = 1;
+    }
+    p->flags = flags;
+    p->max_idle = max_idle < 0 ? 0 : max_idle;
+#ifdef _WIN32
+    InitializeCriticalSection(&p->lock);
+#else
+    if (pthread_mutex_init(&p->lock,NULL) != 0)
+    {
+        TRYFREE(p);
+        return NULL;
+    }
+#endif
+    return (unzPool)p;
+}
+
+extern unzFile ZEXPORT unzPoolOpen (unzPool pool, const char* path)
+{
+    unz_pool_s* p = (unz_pool_s*)pool;
+    unz_pool_slot slot;
+    unzFile file = NULL;
+    int i;
+
+    if ((p == NULL) || (path == NULL))
+        return NULL;
+    memset(&slot,0,sizeof(slot));
+    if (!unzPoolStat(path,&slot))
+        return NULL;
+
+    /* an idle zipfile opened on the same file, if it is unchanged */
+    unzPoolLock(p);
+    for (i=0;i<p->number_slot;)
+    {
+        unz_pool_slot* s = &p->slots[i];
+        if (s->in_use || (strcmp(s->path,path) != 0))
+        {
+            i++;
+            continue;
+        }
+        if ((s->size != slot.size) || (s->mtime != slot.mtime) || (s->ino != slot.ino))
+        {
+            unzPoolRemoveSlot(p,i);
+            continue;
+        }
+        s->in_use = 1;
+        p->number_idle--;
+        file = s->file;
+        break;
+    }
+    unzPoolUnlock(p);
+    if (file != NULL)
+    {
+        unzGoToFirstFile(file);
+        return file;
+    }
+
+    /* a new one, opened outside the lock */
+    if (p->has_filefunc)
+        file = unzOpen3_64(path,&p->filefunc,p->flags);
+    if (file == NULL)
+        file = unzOpen3_64(path,NULL,p->flags);
+    if (file == NULL)
+        return NULL;
+    slot.file = file;
+    slot.path = (char*)ALLOC(strlen(path)+1);
+    if (slot.path == NULL)
+    {
+        unzClose(file);
+        return NULL;
+    }
+    strcpy(slot.path,path);
+    slot.in_use = 1;
+
+    unzPoolLock(p);
+    if (p->number_slot == p->size_slots)
+    {
+        int size_slots = p->size_slots == 0 ? 8 : p->size_slots*2;
+        unz_pool_slot* slots = (unz_pool_slot*)realloc(p->slots,size_slots*sizeof(unz_pool_slot));
+        if (slots == NULL)
+        {
+            unzPoolUnlock(p);
+            unzClose(file);
+            TRYFREE(slot.path);
+            return NULL;
+        }
+        p->slots = slots;
+        p->size_slots = size_slots;
+    }
+    p->slots[p->number_slot++] = slot;
+    unzPoolUnlock(p);
+    return file;
+}
+
+extern int ZEXPORT unzPoolRelease (unzPool pool, unzFile file)
+{
+    unz_pool_s* p = (unz_pool_s*)pool;
+    int i;
+
+    if ((p == NULL) || (file == NULL))
+        return UNZ_PARAMERROR;
+
+    /* closing the current file keeps its buffer and inflate state in the unzFile */
+    unzCloseCurrentFile(file);
+
+    unzPoolLock(p);
+    for (i=0;i<p->number_slot;i++)
+        if (p->slots[i].in_use && (p->slots[i].file == file))
+            break;
+    if (i == p->number_slot)
+    {
+        unzPoolUnlock(p);
+        return UNZ_PARAMERROR;
+    }
+    p->slots[i].in_use = 0;
+    p->slots[i].released = ++p->clock;
+    p->number_idle++;
+
+    /* close the zipfiles released the longest ago beyond max_idle */
+    while (p->number_idle > p->max_idle)
+    {
+        int oldest = -1;
+        for (i=0;i<p->number_slot;i++)
+            if (!p->slots[i].in_use &&
+                ((oldest < 0) || (p->slots[i].released < p->slots[oldest].released)))
+                oldest = i;
+        unzPoolRemoveSlot(p,oldest);
+    }
+    unzPoolUnlock(p);
+    return UNZ_OK;
+}
+
+extern int ZEXPORT unzPoolDestroy (unzPool pool)
+{
+    unz_pool_s* p = (unz_pool_s*)pool;
+    int i;
+
+    if (p == NULL)
+        return UNZ_PARAMERROR;
+    unzPoolLock(p);
+    for (i=0;i<p->number_slot;i++)
+        if (p->slots[i].in_use)
+        {
+            unzPoolUnlock(p);
+            return UNZ_PARAMERROR;
+        }
+    while (p->number_slot > 0)
+        unzPoolRemoveSlot(p,p->number_slot-1);
+    unzPoolUnlock(p);
+
+#ifdef _WIN32
+    DeleteCriticalSection(&p->lock);
+#else
+    pthread_mutex_destroy(&p->lock);
+#endif
+    TRYFREE(p->slots);
+    TRYFREE(p);
+    return UNZ_OK;
+}
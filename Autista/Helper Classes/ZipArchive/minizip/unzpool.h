@@ -0,0 +1,64 @@
+/*
+  unzpool.h -- a pool of opened zipfiles for Minizip, so opening the same
+  zipfile again reuses its parsed central directory, its index of file names
+  and the read buffer and inflate state of its last file read
+  License: Same as ZLIB (www.gzip.org)
+*/
+
+#ifndef _unz_pool_H
+#define _unz_pool_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef _ZLIB_H
+#include "zlib.h"
+#endif
+
+#include "unzip.h"
+
+typedef voidp unzPool;
+
+extern unzPool ZEXPORT unzPoolCreate OF((int max_idle,
+                                         zlib_filefunc64_def* pzlib_filefunc_def,
+                                         int flags));
+/*
+  Create a pool keeping up to max_idle zipfiles opened while nobody uses them.
+  Zipfiles are opened with unzOpen3_64, with pzlib_filefunc_def and flags
+    (UNZ_OPEN_INDEX is useful here); if they can't be opened with
+    pzlib_filefunc_def (a file that can't be mapped, for example), they are
+    opened with the default functions.
+  A pool can be used from several threads at once.
+  return NULL if there is not enough memory.
+*/
+
+extern unzFile ZEXPORT unzPoolOpen OF((unzPool pool, const char* path));
+/*
+  Get an unzFile on the zipfile at path: one of the pool that was opened on
+    the same file and released since, if the file has not been modified,
+    or a newly opened one. Its first file is the current file.
+  The unzFile must be given back with unzPoolRelease, not closed with unzClose.
+  return NULL if the zipfile can't be opened.
+*/
+
+extern int ZEXPORT unzPoolRelease OF((unzPool pool, unzFile file));
+/*
+  Give back an unzFile got from unzPoolOpen. The file opened in it with
+    unzOpenCurrentFile, if any, is closed. The zipfile stays opened in the
+    pool, and the zipfiles released the longest ago are closed beyond max_idle.
+  return UNZ_OK, or UNZ_PARAMERROR if file doesn't come from the pool.
+*/
+
+extern int ZEXPORT unzPoolDestroy OF((unzPool pool));
+/*
+  Close the zipfiles of the pool and free it. The unzFiles got from the
+    pool must all have been released.
+  return UNZ_OK, or UNZ_PARAMERROR if some are still in use.
+*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _unz_pool_H */
@@ -28,6 +28,8 @@
 #include <time.h>
 #include "zlib.h"
 #include "zip.h"
+#include "fastcrc.h"
+#include "zipaes.h"
 
 #ifdef STDC
 #  include <stddef.h>
@@ -51,7 +53,12 @@
 #endif
 
 #ifndef Z_BUFSIZE
-#define Z_BUFSIZE (64*1024) //(16384)
+#define Z_BUFSIZE (256*1024) //(16384)
+#endif
+
+/* the write buffer size is rounded up to a multiple of Z_BUFALIGN */
+#ifndef Z_BUFALIGN
+#define Z_BUFALIGN (4096)
 #endif
 
 #ifndef Z_MAXFILENAMEINZIP
@@ -98,33 +105,28 @@
 const char zip_copyright[] =" zip 1.01 Copyright 1998-2004 Gilles Vollant - http://www.winimage.com/zLibDll";
 
 
-#define SIZEDATA_INDATABLOCK (4096-(4*4))
+#define SIZEDATA_INCENTRALDIR (64*1024) /* first allocation of the central dir */
 
 #define LOCALHEADERMAGIC    (0x04034b50)
 #define CENTRALHEADERMAGIC  (0x02014b50)
 #define ENDHEADERMAGIC      (0x06054b50)
 #define ZIP64ENDHEADERMAGIC      (0x6064b50)
 #define ZIP64ENDLOCHEADERMAGIC   (0x7064b50)
+#define DATADESCRIPTORMAGIC      (0x08074b50)
 
 #define FLAG_LOCALHEADER_OFFSET (0x06)
 #define CRC_LOCALHEADER_OFFSET  (0x0e)
 
 #define SIZECENTRALHEADER (0x2e) /* 46 */
 
-typedef struct linkedlist_datablock_internal_s
-{
-  struct linkedlist_datablock_internal_s* next_datablock;
-  uLong  avail_in_this_block;
-  uLong  filled_in_this_block;
-  uLong  unused; /* for future use and alignement */
-  unsigned char data[SIZEDATA_INDATABLOCK];
-} linkedlist_datablock_internal;
-
-typedef struct linkedlist_data_s
+/* the central dir in construction, in one buffer growing geometrically, so
+   that adding a file costs no allocation and the whole of it is written at once */
+typedef struct centraldir_data_s
 {
-    linkedlist_datablock_internal* first_block;
-    linkedlist_datablock_internal* last_block;
-} linkedlist_data;
+    unsigned char* data;
+    ZPOS64_T size;            /* bytes of records */
+    ZPOS64_T size_alloc;      /* bytes allocated */
+} centraldir_data;
 
 
 typedef struct
@@ -147,7 +149,8 @@ typedef struct
 
     int  method;                /* compression method of file currenty wr.*/
     int  raw;                   /* 1 for directly writing raw data */
-    Byte buffered_data[Z_BUFSIZE];/* buffer contain compressed data to be writ*/
+    Byte* buffered_data;        /* buffer contain compressed data to be writ*/
+    uInt size_buffered_data;    /* size of buffered_data, Z_BUFSIZE by default */
     uLong dosDate;
     uLong crc32;
     int  encrypt;
@@ -157,16 +160,18 @@ typedef struct
     ZPOS64_T totalUncompressedData;
 #ifndef NOCRYPT
     unsigned long keys[3];     /* keys defining the pseudo-random sequence */
-    const unsigned long* pcrc_32_tab;
+    const z_crc_t* pcrc_32_tab;
     int crypt_header_size;
+    zipaes_ctx aes_ctx;
 #endif
+    int aes;                   /* strength of the WinZip AES encryption, 0 for the traditional one */
 } curfile64_info;
 
 typedef struct
 {
     zlib_filefunc64_32_def z_filefunc;
     voidpf filestream;        /* io structore of the zipfile */
-    linkedlist_data central_dir;/* datablock with central dir in construction*/
+    centraldir_data central_dir;/* central dir in construction*/
     int  in_opened_file_inzip;  /* 1 if a file in the zip is currently writ.*/
     curfile64_info ci;            /* info on the file curretly writing */
 
@@ -174,6 +179,10 @@ typedef struct
     ZPOS64_T add_position_when_writting_offset;
     ZPOS64_T number_entry;
 
+    int streamed;               /* 1 if opened with APPEND_STATUS_STREAM */
+    zlib_filefunc64_32_def z_filefunc_sink; /* the functions of the stream written to, when streamed */
+    ZPOS64_T pos_stream;        /* bytes written to the stream, when streamed */
+
 #ifndef NO_ADDFILEINEXISTINGZIP
     char *globalcomment;
 #endif
@@ -186,95 +195,39 @@ typedef struct
 #include "crypt.h"
 #endif
 
-local linkedlist_datablock_internal* allocate_new_datablock()
-{
-    linkedlist_datablock_internal* ldi;
-    ldi = (linkedlist_datablock_internal*)
-                 ALLOC(sizeof(linkedlist_datablock_internal));
-    if (ldi!=NULL)
-    {
-        ldi->next_datablock = NULL ;
-        ldi->filled_in_this_block = 0 ;
-        ldi->avail_in_this_block = SIZEDATA_INDATABLOCK ;
-    }
-    return ldi;
-}
-
-local void free_datablock(linkedlist_datablock_internal* ldi)
-{
-    while (ldi!=NULL)
-    {
-        linkedlist_datablock_internal* ldinext = ldi->next_datablock;
-        TRYFREE(ldi);
-        ldi = ldinext;
-    }
-}
-
-local void init_linkedlist(linkedlist_data* ll)
+local void init_centraldir(centraldir_data* cd)
 {
-    ll->first_block = ll->last_block = NULL;
+    cd->data = NULL;
+    cd->size = cd->size_alloc = 0;
 }
 
-local void free_linkedlist(linkedlist_data* ll)
+local void free_centraldir(centraldir_data* cd)
 {
-    free_datablock(ll->first_block);
-    ll->first_block = ll->last_block = NULL;
+    TRYFREE(cd->data);
+    init_centraldir(cd);
 }
 
-
-local int add_data_in_datablock(linkedlist_data* ll, const void* buf, uLong len)
+/* make room for len more bytes after the records, returned; NULL if out of memory */
+local unsigned char* reserve_in_centraldir(centraldir_data* cd, ZPOS64_T len)
 {
-    linkedlist_datablock_internal* ldi;
-    const unsigned char* from_copy;
-
-    if (ll==NULL)
-        return ZIP_INTERNALERROR;
-
-    if (ll->last_block == NULL)
+    if (cd->size + len > cd->size_alloc)
     {
-        ll->first_block = ll->last_block = allocate_new_datablock();
-        if (ll->first_block == NULL)
-            return ZIP_INTERNALERROR;
+        ZPOS64_T size_alloc = (cd->size_alloc == 0) ? SIZEDATA_INCENTRALDIR : cd->size_alloc;
+        unsigned char* data;
+        while (size_alloc < cd->size + len)
+            size_alloc *= 2;
+        if (size_alloc != (size_t)size_alloc)
+            return NULL;
+        data = (unsigned char*)realloc(cd->data, (size_t)size_alloc);
+        if (data == NULL)
+            return NULL;
+        cd->data = data;
+        cd->size_alloc = size_alloc;
     }
-
-    ldi = ll->last_block;
-    from_copy = (unsigned char*)buf;
-
-    while (len>0)
-    {
-        uInt copy_this;
-        uInt i;
-        unsigned char* to_copy;
-
-        if (ldi->avail_in_this_block==0)
-        {
-            ldi->next_datablock = allocate_new_datablock();
-            if (ldi->next_datablock == NULL)
-                return ZIP_INTERNALERROR;
-            ldi = ldi->next_datablock ;
-            ll->last_block = ldi;
-        }
-
-        if (ldi->avail_in_this_block < len)
-            copy_this = (uInt)ldi->avail_in_this_block;
-        else
-            copy_this = (uInt)len;
-
-        to_copy = &(ldi->data[ldi->filled_in_this_block]);
-
-        for (i=0;i<copy_this;i++)
-            *(to_copy+i)=*(from_copy+i);
-
-        ldi->filled_in_this_block += copy_this;
-        ldi->avail_in_this_block -= copy_this;
-        from_copy += copy_this ;
-        len -= copy_this;
-    }
-    return ZIP_OK;
+    return cd->data + cd->size;
 }
 
 
-
 /****************************************************************************/
 
 #ifndef NO_ADDFILEINEXISTINGZIP
@@ -809,28 +762,24 @@ int LoadCentralDirectoryRecord(zip64_internal* pziinit)
   byte_before_the_zipfile = central_pos - (offset_central_dir+size_central_dir);
   pziinit->add_position_when_writting_offset = byte_before_the_zipfile;
 
+  // the records are read straight into the central dir in construction
+  if ((err==ZIP_OK) && (size_central_dir>0))
   {
-    ZPOS64_T size_central_dir_to_read = size_central_dir;
-    size_t buf_size = SIZEDATA_INDATABLOCK;
-    void* buf_read = (void*)ALLOC(buf_size);
-    if (ZSEEK64(pziinit->z_filefunc, pziinit->filestream, offset_central_dir + byte_before_the_zipfile, ZLIB_FILEFUNC_SEEK_SET) != 0)
+    unsigned char* buf_read = reserve_in_centraldir(&pziinit->central_dir, size_central_dir);
+    if (buf_read == NULL)
+      err=ZIP_INTERNALERROR;
+    else if (ZSEEK64(pziinit->z_filefunc, pziinit->filestream, offset_central_dir + byte_before_the_zipfile, ZLIB_FILEFUNC_SEEK_SET) != 0)
       err=ZIP_ERRNO;
 
-    while ((size_central_dir_to_read>0) && (err==ZIP_OK))
+    while ((size_central_dir>0) && (err==ZIP_OK))
     {
-      ZPOS64_T read_this = SIZEDATA_INDATABLOCK;
-      if (read_this > size_central_dir_to_read)
-        read_this = size_central_dir_to_read;
-
-      if (ZREAD64(pziinit->z_filefunc, pziinit->filestream,buf_read,(uLong)read_this) != read_this)
+      uLong read_this = (size_central_dir > 0x40000000) ? 0x40000000 : (uLong)size_central_dir;
+      if (ZREAD64(pziinit->z_filefunc, pziinit->filestream,buf_read,read_this) != read_this)
         err=ZIP_ERRNO;
-
-      if (err==ZIP_OK)
-        err = add_data_in_datablock(&pziinit->central_dir,buf_read, (uLong)read_this);
-
-      size_central_dir_to_read-=read_this;
+      buf_read += read_this;
+      pziinit->central_dir.size += read_this;
+      size_central_dir -= read_this;
     }
-    TRYFREE(buf_read);
   }
   pziinit->begin_pos = byte_before_the_zipfile;
   pziinit->number_entry = number_entry_CD;
@@ -846,6 +795,76 @@ int LoadCentralDirectoryRecord(zip64_internal* pziinit)
 
 
 /************************************************************/
+/*
+  A streamed zipfile is written through these functions, which count the bytes
+  written to tell the position, and only "seek" where the stream already is.
+*/
+local uLong ZCALLBACK zip64stream_read_file_func OF((voidpf opaque, voidpf stream, void* buf, uLong size));
+local uLong ZCALLBACK zip64stream_read_file_func (voidpf opaque, voidpf stream, void* buf, uLong size)
+{
+    (void)opaque;
+    (void)stream;
+    (void)buf;
+    (void)size;
+    return 0;
+}
+
+local uLong ZCALLBACK zip64stream_write_file_func OF((voidpf opaque, voidpf stream, const void* buf, uLong size));
+local uLong ZCALLBACK zip64stream_write_file_func (voidpf opaque, voidpf stream, const void* buf, uLong size)
+{
+    zip64_internal* zi = (zip64_internal*)opaque;
+    uLong written = ZWRITE64(zi->z_filefunc_sink,stream,buf,size);
+    zi->pos_stream += written;
+    return written;
+}
+
+local ZPOS64_T ZCALLBACK zip64stream_tell64_file_func OF((voidpf opaque, voidpf stream));
+local ZPOS64_T ZCALLBACK zip64stream_tell64_file_func (voidpf opaque, voidpf stream)
+{
+    (void)stream;
+    return ((zip64_internal*)opaque)->pos_stream;
+}
+
+local long ZCALLBACK zip64stream_seek64_file_func OF((voidpf opaque, voidpf stream, ZPOS64_T offset, int origin));
+local long ZCALLBACK zip64stream_seek64_file_func (voidpf opaque, voidpf stream, ZPOS64_T offset, int origin)
+{
+    zip64_internal* zi = (zip64_internal*)opaque;
+    ZPOS64_T pos = offset;
+    (void)stream;
+    if (origin != ZLIB_FILEFUNC_SEEK_SET)
+        pos += zi->pos_stream;
+    return (pos == zi->pos_stream) ? 0 : -1;
+}
+
+local int ZCALLBACK zip64stream_close_file_func OF((voidpf opaque, voidpf stream));
+local int ZCALLBACK zip64stream_close_file_func (voidpf opaque, voidpf stream)
+{
+    return ZCLOSE64(((zip64_internal*)opaque)->z_filefunc_sink,stream);
+}
+
+local int ZCALLBACK zip64stream_error_file_func OF((voidpf opaque, voidpf stream));
+local int ZCALLBACK zip64stream_error_file_func (voidpf opaque, voidpf stream)
+{
+    return ZERROR64(((zip64_internal*)opaque)->z_filefunc_sink,stream);
+}
+
+local void zip64stream_fill_filefunc OF((zip64_internal* zi));
+local void zip64stream_fill_filefunc (zip64_internal* zi)
+{
+    zi->z_filefunc_sink = zi->z_filefunc;
+    zi->z_filefunc.zfile_func64.zopen64_file = NULL;
+    zi->z_filefunc.zfile_func64.zread_file = zip64stream_read_file_func;
+    zi->z_filefunc.zfile_func64.zwrite_file = zip64stream_write_file_func;
+    zi->z_filefunc.zfile_func64.ztell64_file = zip64stream_tell64_file_func;
+    zi->z_filefunc.zfile_func64.zseek64_file = zip64stream_seek64_file_func;
+    zi->z_filefunc.zfile_func64.zclose_file = zip64stream_close_file_func;
+    zi->z_filefunc.zfile_func64.zerror_file = zip64stream_error_file_func;
+    zi->z_filefunc.zfile_func64.opaque = (voidpf)zi;
+    zi->z_filefunc.zopen32_file = NULL;
+    zi->z_filefunc.ztell32_file = NULL;
+    zi->z_filefunc.zseek32_file = NULL;
+}
+
 extern zipFile ZEXPORT zipOpen3 (const void *pathname, int append, zipcharpc* globalcomment, zlib_filefunc64_32_def* pzlib_filefunc64_32_def)
 {
     zip64_internal ziinit;
@@ -859,7 +878,12 @@ extern zipFile ZEXPORT zipOpen3 (const void *pathname, int append, zipcharpc* gl
     else
         ziinit.z_filefunc = *pzlib_filefunc64_32_def;
 
-    ziinit.filestream = ZOPEN64(ziinit.z_filefunc,
+    if (append == APPEND_STATUS_STREAM)
+        ziinit.filestream = ZOPEN64(ziinit.z_filefunc,
+                  pathname,
+                  (ZLIB_FILEFUNC_MODE_WRITE | ZLIB_FILEFUNC_MODE_CREATE));
+    else
+        ziinit.filestream = ZOPEN64(ziinit.z_filefunc,
                   pathname,
                   (append == APPEND_STATUS_CREATE) ?
                   (ZLIB_FILEFUNC_MODE_READ | ZLIB_FILEFUNC_MODE_WRITE | ZLIB_FILEFUNC_MODE_CREATE) :
@@ -871,12 +895,20 @@ extern zipFile ZEXPORT zipOpen3 (const void *pathname, int append, zipcharpc* gl
     if (append == APPEND_STATUS_CREATEAFTER)
         ZSEEK64(ziinit.z_filefunc,ziinit.filestream,0,SEEK_END);
 
-    ziinit.begin_pos = ZTELL64(ziinit.z_filefunc,ziinit.filestream);
+    /* a stream may not tell where it is, the zipfile starts where it was opened */
+    ziinit.streamed = (append == APPEND_STATUS_STREAM);
+    ziinit.pos_stream = 0;
+    if (ziinit.streamed)
+        ziinit.begin_pos = 0;
+    else
+        ziinit.begin_pos = ZTELL64(ziinit.z_filefunc,ziinit.filestream);
     ziinit.in_opened_file_inzip = 0;
     ziinit.ci.stream_initialised = 0;
+    ziinit.ci.buffered_data = NULL;
+    ziinit.ci.size_buffered_data = Z_BUFSIZE;
     ziinit.number_entry = 0;
     ziinit.add_position_when_writting_offset = 0;
-    init_linkedlist(&(ziinit.central_dir));
+    init_centraldir(&(ziinit.central_dir));
 
 
 
@@ -907,12 +939,15 @@ extern zipFile ZEXPORT zipOpen3 (const void *pathname, int append, zipcharpc* gl
 #    ifndef NO_ADDFILEINEXISTINGZIP
         TRYFREE(ziinit.globalcomment);
 #    endif /* !NO_ADDFILEINEXISTINGZIP*/
+        free_centraldir(&(ziinit.central_dir));
         TRYFREE(zi);
         return NULL;
     }
     else
     {
         *zi = ziinit;
+        if (zi->streamed)
+            zip64stream_fill_filefunc(zi);
         return (zipFile)zi;
     }
 }
@@ -955,6 +990,19 @@ extern zipFile ZEXPORT zipOpen64 (const void* pathname, int append)
     return zipOpen3(pathname,append,NULL,NULL);
 }
 
+/* the WinZip AES extra field, telling the strength of the encryption and the
+   real compression method. AE-2 is used, storing no crc32. */
+local void zip64local_AesExtraField_inmemory OF((char* buf, int strength, int method));
+local void zip64local_AesExtraField_inmemory(char* buf, int strength, int method)
+{
+  zip64local_putValue_inmemory(buf, (uLong)ZIPAES_EXTRA_ID, 2);
+  zip64local_putValue_inmemory(buf+2, (uLong)ZIPAES_EXTRA_SIZE, 2);
+  zip64local_putValue_inmemory(buf+4, (uLong)ZIPAES_AE2, 2);
+  zip64local_putValue_inmemory(buf+6, (uLong)ZIPAES_VENDOR_ID, 2);
+  zip64local_putValue_inmemory(buf+8, (uLong)strength, 1);
+  zip64local_putValue_inmemory(buf+9, (uLong)method, 2);
+}
+
 int Write_LocalFileHeader(zip64_internal* zi, const char* filename, uInt size_extrafield_local, const void* extrafield_local)
 {
   /* write the local header */
@@ -966,7 +1014,9 @@ int Write_LocalFileHeader(zip64_internal* zi, const char* filename, uInt size_ex
 
   if (err==ZIP_OK)
   {
-    if(zi->ci.zip64)
+    if((zi->ci.aes) || (zi->ci.method==ZIPAES_METHOD))
+      err = zip64local_putValue(&zi->z_filefunc,zi->filestream,(uLong)51,2);/* version needed to extract */
+    else if(zi->ci.zip64)
       err = zip64local_putValue(&zi->z_filefunc,zi->filestream,(uLong)45,2);/* version needed to extract */
     else
       err = zip64local_putValue(&zi->z_filefunc,zi->filestream,(uLong)20,2);/* version needed to extract */
@@ -976,7 +1026,7 @@ int Write_LocalFileHeader(zip64_internal* zi, const char* filename, uInt size_ex
     err = zip64local_putValue(&zi->z_filefunc,zi->filestream,(uLong)zi->ci.flag,2);
 
   if (err==ZIP_OK)
-    err = zip64local_putValue(&zi->z_filefunc,zi->filestream,(uLong)zi->ci.method,2);
+    err = zip64local_putValue(&zi->z_filefunc,zi->filestream,(uLong)(zi->ci.aes ? ZIPAES_METHOD : zi->ci.method),2);
 
   if (err==ZIP_OK)
     err = zip64local_putValue(&zi->z_filefunc,zi->filestream,(uLong)zi->ci.dosDate,4);
@@ -1007,6 +1057,11 @@ int Write_LocalFileHeader(zip64_internal* zi, const char* filename, uInt size_ex
     size_extrafield += 20;
   }
 
+  if(zi->ci.aes)
+  {
+    size_extrafield += 4 + ZIPAES_EXTRA_SIZE;
+  }
+
   if (err==ZIP_OK)
     err = zip64local_putValue(&zi->z_filefunc,zi->filestream,(uLong)size_extrafield,2);
 
@@ -1041,6 +1096,14 @@ int Write_LocalFileHeader(zip64_internal* zi, const char* filename, uInt size_ex
       err = zip64local_putValue(&zi->z_filefunc, zi->filestream, (ZPOS64_T)CompressedSize,8);
   }
 
+  if ((err==ZIP_OK) && (zi->ci.aes))
+  {
+      char extra[4 + ZIPAES_EXTRA_SIZE];
+      zip64local_AesExtraField_inmemory(extra, zi->ci.aes, zi->ci.method);
+      if (ZWRITE64(zi->z_filefunc, zi->filestream, extra, sizeof(extra)) != sizeof(extra))
+        err = ZIP_ERRNO;
+  }
+
   return err;
 }
 
@@ -1052,17 +1115,18 @@ int Write_LocalFileHeader(zip64_internal* zi, const char* filename, uInt size_ex
  It is not done here because then we need to realloc a new buffer since parameters are 'const' and I want to minimize
  unnecessary allocations.
  */
-extern int ZEXPORT zipOpenNewFileInZip4_64 (zipFile file, const char* filename, const zip_fileinfo* zipfi,
+extern int ZEXPORT zipOpenNewFileInZip5 (zipFile file, const char* filename, const zip_fileinfo* zipfi,
                                          const void* extrafield_local, uInt size_extrafield_local,
                                          const void* extrafield_global, uInt size_extrafield_global,
                                          const char* comment, int method, int level, int raw,
                                          int windowBits,int memLevel, int strategy,
                                          const char* password, uLong crcForCrypting,
-                                         uLong versionMadeBy, uLong flagBase, int zip64)
+                                         uLong versionMadeBy, uLong flagBase, int zip64, int aes)
 {
     zip64_internal* zi;
     uInt size_filename;
     uInt size_comment;
+    uInt size_aesextra;
     uInt i;
     int err = ZIP_OK;
 
@@ -1074,14 +1138,20 @@ extern int ZEXPORT zipOpenNewFileInZip4_64 (zipFile file, const char* filename,
     if (file == NULL)
         return ZIP_PARAMERROR;
 
+    /* data already encrypted with AES can only be written raw, with its extra field */
 #ifdef HAVE_BZIP2
-    if ((method!=0) && (method!=Z_DEFLATED) && (method!=Z_BZIP2ED))
+    if ((method!=0) && (method!=Z_DEFLATED) && (method!=Z_BZIP2ED) && ((method!=ZIPAES_METHOD) || (!raw)))
       return ZIP_PARAMERROR;
 #else
-    if ((method!=0) && (method!=Z_DEFLATED))
+    if ((method!=0) && (method!=Z_DEFLATED) && ((method!=ZIPAES_METHOD) || (!raw)))
       return ZIP_PARAMERROR;
 #endif
 
+    if (password == NULL)
+        aes = 0;
+    if ((aes!=0) && ((aes<ZIPAES_128) || (aes>ZIPAES_256) || (method==ZIPAES_METHOD)))
+        return ZIP_PARAMERROR;
+
     zi = (zip64_internal*)file;
 
     if (zi->in_opened_file_inzip == 1)
@@ -1101,6 +1171,13 @@ extern int ZEXPORT zipOpenNewFileInZip4_64 (zipFile file, const char* filename,
 
     size_filename = (uInt)strlen(filename);
 
+    if (zi->ci.buffered_data == NULL)
+    {
+        zi->ci.buffered_data = (Byte*)ALLOC(zi->ci.size_buffered_data);
+        if (zi->ci.buffered_data == NULL)
+            return ZIP_INTERNALERROR;
+    }
+
     if (zipfi == NULL)
         zi->ci.dosDate = 0;
     else
@@ -1112,6 +1189,9 @@ extern int ZEXPORT zipOpenNewFileInZip4_64 (zipFile file, const char* filename,
     }
 
     zi->ci.flag = flagBase;
+    /* a streamed file can't be gone back to for its crc and sizes, they follow its data */
+    if (zi->streamed)
+      zi->ci.flag |= 8;
     if ((level==8) || (level==9))
       zi->ci.flag |= 2;
     if (level==2)
@@ -1123,30 +1203,37 @@ extern int ZEXPORT zipOpenNewFileInZip4_64 (zipFile file, const char* filename,
 
     zi->ci.crc32 = 0;
     zi->ci.method = method;
+    zi->ci.aes = aes;
     zi->ci.encrypt = 0;
     zi->ci.stream_initialised = 0;
     zi->ci.pos_in_buffered_data = 0;
     zi->ci.raw = raw;
     zi->ci.pos_local_header = ZTELL64(zi->z_filefunc,zi->filestream);
 
-    zi->ci.size_centralheader = SIZECENTRALHEADER + size_filename + size_extrafield_global + size_comment;
+    size_aesextra = aes ? 4 + ZIPAES_EXTRA_SIZE : 0;
+    zi->ci.size_centralheader = SIZECENTRALHEADER + size_filename + size_extrafield_global + size_aesextra + size_comment;
     zi->ci.size_centralExtraFree = 32; // Extra space we have reserved in case we need to add ZIP64 extra info data
 
-    zi->ci.central_header = (char*)ALLOC((uInt)zi->ci.size_centralheader + zi->ci.size_centralExtraFree);
+    // the header is built in place after the records of the central dir, which
+    // don't move until it is added to them when the file is closed.
+    zi->ci.central_header = (char*)reserve_in_centraldir(&zi->central_dir, zi->ci.size_centralheader + zi->ci.size_centralExtraFree);
+
+    if (zi->ci.central_header == NULL)
+        return ZIP_INTERNALERROR;
 
-    zi->ci.size_centralExtra = size_extrafield_global;
+    zi->ci.size_centralExtra = size_extrafield_global + size_aesextra;
     zip64local_putValue_inmemory(zi->ci.central_header,(uLong)CENTRALHEADERMAGIC,4);
     /* version info */
     zip64local_putValue_inmemory(zi->ci.central_header+4,(uLong)versionMadeBy,2);
-    zip64local_putValue_inmemory(zi->ci.central_header+6,(uLong)20,2);
+    zip64local_putValue_inmemory(zi->ci.central_header+6,(uLong)((aes || (method==ZIPAES_METHOD)) ? 51 : 20),2);
     zip64local_putValue_inmemory(zi->ci.central_header+8,(uLong)zi->ci.flag,2);
-    zip64local_putValue_inmemory(zi->ci.central_header+10,(uLong)zi->ci.method,2);
+    zip64local_putValue_inmemory(zi->ci.central_header+10,(uLong)(aes ? ZIPAES_METHOD : zi->ci.method),2);
     zip64local_putValue_inmemory(zi->ci.central_header+12,(uLong)zi->ci.dosDate,4);
     zip64local_putValue_inmemory(zi->ci.central_header+16,(uLong)0,4); /*crc*/
     zip64local_putValue_inmemory(zi->ci.central_header+20,(uLong)0,4); /*compr size*/
     zip64local_putValue_inmemory(zi->ci.central_header+24,(uLong)0,4); /*uncompr size*/
     zip64local_putValue_inmemory(zi->ci.central_header+28,(uLong)size_filename,2);
-    zip64local_putValue_inmemory(zi->ci.central_header+30,(uLong)size_extrafield_global,2);
+    zip64local_putValue_inmemory(zi->ci.central_header+30,(uLong)zi->ci.size_centralExtra,2);
     zip64local_putValue_inmemory(zi->ci.central_header+32,(uLong)size_comment,2);
     zip64local_putValue_inmemory(zi->ci.central_header+34,(uLong)0,2); /*disk nm start*/
 
@@ -1172,11 +1259,13 @@ extern int ZEXPORT zipOpenNewFileInZip4_64 (zipFile file, const char* filename,
         *(zi->ci.central_header+SIZECENTRALHEADER+size_filename+i) =
               *(((const char*)extrafield_global)+i);
 
+    if (aes)
+        zip64local_AesExtraField_inmemory(zi->ci.central_header+SIZECENTRALHEADER+size_filename+
+                                          size_extrafield_global, aes, method);
+
     for (i=0;i<size_comment;i++)
         *(zi->ci.central_header+SIZECENTRALHEADER+size_filename+
-              size_extrafield_global+i) = *(comment+i);
-    if (zi->ci.central_header == NULL)
-        return ZIP_INTERNALERROR;
+              size_extrafield_global+size_aesextra+i) = *(comment+i);
 
     zi->ci.zip64 = zip64;
     zi->ci.totalCompressedData = 0;
@@ -1187,7 +1276,7 @@ extern int ZEXPORT zipOpenNewFileInZip4_64 (zipFile file, const char* filename,
 
 #ifdef HAVE_BZIP2
     zi->ci.bstream.avail_in = (uInt)0;
-    zi->ci.bstream.avail_out = (uInt)Z_BUFSIZE;
+    zi->ci.bstream.avail_out = zi->ci.size_buffered_data;
     zi->ci.bstream.next_out = (char*)zi->ci.buffered_data;
     zi->ci.bstream.total_in_hi32 = 0;
     zi->ci.bstream.total_in_lo32 = 0;
@@ -1196,7 +1285,7 @@ extern int ZEXPORT zipOpenNewFileInZip4_64 (zipFile file, const char* filename,
 #endif
 
     zi->ci.stream.avail_in = (uInt)0;
-    zi->ci.stream.avail_out = (uInt)Z_BUFSIZE;
+    zi->ci.stream.avail_out = zi->ci.size_buffered_data;
     zi->ci.stream.next_out = zi->ci.buffered_data;
     zi->ci.stream.total_in = 0;
     zi->ci.stream.total_out = 0;
@@ -1240,7 +1329,25 @@ extern int ZEXPORT zipOpenNewFileInZip4_64 (zipFile file, const char* filename,
 
 #    ifndef NOCRYPT
     zi->ci.crypt_header_size = 0;
-    if ((err==Z_OK) && (password != NULL))
+    if ((err==Z_OK) && (password != NULL) && (aes))
+    {
+        /* a random salt, then the password verification value */
+        unsigned char bufHead[ZIPAES_MAX_SALT_LEN + ZIPAES_VERIFY_LEN];
+        unsigned int sizeSalt = ZIPAES_SALT_LEN(aes);
+        zi->ci.encrypt = 1;
+
+        if (zipaes_random(bufHead,sizeSalt) != 0)
+            err = ZIP_INTERNALERROR;
+        else if (zipaes_init(&zi->ci.aes_ctx,aes,password,bufHead,bufHead+sizeSalt) != 0)
+            err = ZIP_PARAMERROR;
+        else
+        {
+            zi->ci.crypt_header_size = ZIPAES_HEADER_LEN(aes);
+            if (ZWRITE64(zi->z_filefunc,zi->filestream,bufHead,zi->ci.crypt_header_size) != (uLong)zi->ci.crypt_header_size)
+                err = ZIP_ERRNO;
+        }
+    }
+    else if ((err==Z_OK) && (password != NULL))
     {
         unsigned char bufHead[RAND_HEAD_LEN];
         unsigned int sizeHead;
@@ -1248,6 +1355,11 @@ extern int ZEXPORT zipOpenNewFileInZip4_64 (zipFile file, const char* filename,
         zi->ci.pcrc_32_tab = get_crc_table();
         /*init_keys(password,zi->ci.keys,zi->ci.pcrc_32_tab);*/
 
+        /* with a data descriptor the crc is not known yet, so the header is
+           checked against the high byte of the time instead */
+        if (zi->ci.flag & 8)
+            crcForCrypting = (uLong)(zi->ci.dosDate << 16);
+
         sizeHead=crypthead(password,bufHead,RAND_HEAD_LEN,zi->ci.keys,zi->ci.pcrc_32_tab,crcForCrypting);
         zi->ci.crypt_header_size = sizeHead;
 
@@ -1261,6 +1373,22 @@ extern int ZEXPORT zipOpenNewFileInZip4_64 (zipFile file, const char* filename,
     return err;
 }
 
+extern int ZEXPORT zipOpenNewFileInZip4_64 (zipFile file, const char* filename, const zip_fileinfo* zipfi,
+                                         const void* extrafield_local, uInt size_extrafield_local,
+                                         const void* extrafield_global, uInt size_extrafield_global,
+                                         const char* comment, int method, int level, int raw,
+                                         int windowBits,int memLevel, int strategy,
+                                         const char* password, uLong crcForCrypting,
+                                         uLong versionMadeBy, uLong flagBase, int zip64)
+{
+    return zipOpenNewFileInZip5 (file, filename, zipfi,
+                                 extrafield_local, size_extrafield_local,
+                                 extrafield_global, size_extrafield_global,
+                                 comment, method, level, raw,
+                                 windowBits, memLevel, strategy,
+                                 password, crcForCrypting, versionMadeBy, flagBase, zip64, 0);
+}
+
 extern int ZEXPORT zipOpenNewFileInZip4 (zipFile file, const char* filename, const zip_fileinfo* zipfi,
                                          const void* extrafield_local, uInt size_extrafield_local,
                                          const void* extrafield_global, uInt size_extrafield_global,
@@ -1366,10 +1494,15 @@ local int zip64FlushWriteBuffer(zip64_internal* zi)
     if (zi->ci.encrypt != 0)
     {
 #ifndef NOCRYPT
-        uInt i;
-        int t;
-        for (i=0;i<zi->ci.pos_in_buffered_data;i++)
-            zi->ci.buffered_data[i] = zencode(zi->ci.keys, zi->ci.pcrc_32_tab, zi->ci.buffered_data[i],t);
+        if (zi->ci.aes)
+            zipaes_encrypt(&zi->ci.aes_ctx, zi->ci.buffered_data, zi->ci.pos_in_buffered_data);
+        else
+        {
+            uInt i;
+            int t;
+            for (i=0;i<zi->ci.pos_in_buffered_data;i++)
+                zi->ci.buffered_data[i] = zencode(zi->ci.keys, zi->ci.pcrc_32_tab, zi->ci.buffered_data[i],t);
+        }
 #endif
     }
 
@@ -1410,7 +1543,10 @@ extern int ZEXPORT zipWriteInFileInZip (zipFile file,const void* buf,unsigned in
     if (zi->in_opened_file_inzip == 0)
         return ZIP_PARAMERROR;
 
-    zi->ci.crc32 = crc32(zi->ci.crc32,buf,(uInt)len);
+    /* in raw mode the caller already knows the crc of the uncompressed data,
+       and passes it to zipCloseFileInZipRaw */
+    if (!zi->ci.raw)
+        zi->ci.crc32 = fastcrc32(zi->ci.crc32,buf,(uInt)len);
 
 #ifdef HAVE_BZIP2
     if(zi->ci.method == Z_BZIP2ED && (!zi->ci.raw))
@@ -1425,7 +1561,7 @@ extern int ZEXPORT zipWriteInFileInZip (zipFile file,const void* buf,unsigned in
         {
           if (zip64FlushWriteBuffer(zi) == ZIP_ERRNO)
             err = ZIP_ERRNO;
-          zi->ci.bstream.avail_out = (uInt)Z_BUFSIZE;
+          zi->ci.bstream.avail_out = zi->ci.size_buffered_data;
           zi->ci.bstream.next_out = (char*)zi->ci.buffered_data;
         }
 
@@ -1458,7 +1594,7 @@ extern int ZEXPORT zipWriteInFileInZip (zipFile file,const void* buf,unsigned in
           {
               if (zip64FlushWriteBuffer(zi) == ZIP_ERRNO)
                   err = ZIP_ERRNO;
-              zi->ci.stream.avail_out = (uInt)Z_BUFSIZE;
+              zi->ci.stream.avail_out = zi->ci.size_buffered_data;
               zi->ci.stream.next_out = zi->ci.buffered_data;
           }
 
@@ -1478,17 +1614,28 @@ extern int ZEXPORT zipWriteInFileInZip (zipFile file,const void* buf,unsigned in
 
               zi->ci.pos_in_buffered_data += (uInt)(zi->ci.stream.total_out - uTotalOutBefore) ;
           }
+          else if ((zi->ci.pos_in_buffered_data == 0) && (zi->ci.encrypt == 0) &&
+                   (zi->ci.stream.avail_in >= zi->ci.size_buffered_data))
+          {
+              /* the buffer is empty and would only be filled to be written at once:
+                 write the caller's data as it is, without copying it */
+              uInt write_this = zi->ci.stream.avail_in;
+              if (ZWRITE64(zi->z_filefunc,zi->filestream,zi->ci.stream.next_in,write_this) != write_this)
+                  err = ZIP_ERRNO;
+              zi->ci.totalCompressedData += write_this;
+              zi->ci.totalUncompressedData += write_this;
+              zi->ci.stream.avail_in -= write_this;
+              zi->ci.stream.next_in += write_this;
+          }
           else
           {
-              uInt copy_this,i;
+              uInt copy_this;
               if (zi->ci.stream.avail_in < zi->ci.stream.avail_out)
                   copy_this = zi->ci.stream.avail_in;
               else
                   copy_this = zi->ci.stream.avail_out;
 
-              for (i = 0; i < copy_this; i++)
-                  *(((char*)zi->ci.stream.next_out)+i) =
-                      *(((const char*)zi->ci.stream.next_in)+i);
+              memcpy(zi->ci.stream.next_out, zi->ci.stream.next_in, copy_this);
               {
                   zi->ci.stream.avail_in -= copy_this;
                   zi->ci.stream.avail_out-= copy_this;
@@ -1535,7 +1682,7 @@ extern int ZEXPORT zipCloseFileInZipRaw64 (zipFile file, ZPOS64_T uncompressed_s
                                 {
                                         if (zip64FlushWriteBuffer(zi) == ZIP_ERRNO)
                                                 err = ZIP_ERRNO;
-                                        zi->ci.stream.avail_out = (uInt)Z_BUFSIZE;
+                                        zi->ci.stream.avail_out = zi->ci.size_buffered_data;
                                         zi->ci.stream.next_out = zi->ci.buffered_data;
                                 }
                                 uTotalOutBefore = zi->ci.stream.total_out;
@@ -1554,7 +1701,7 @@ extern int ZEXPORT zipCloseFileInZipRaw64 (zipFile file, ZPOS64_T uncompressed_s
         {
           if (zip64FlushWriteBuffer(zi) == ZIP_ERRNO)
             err = ZIP_ERRNO;
-          zi->ci.bstream.avail_out = (uInt)Z_BUFSIZE;
+          zi->ci.bstream.avail_out = zi->ci.size_buffered_data;
           zi->ci.bstream.next_out = (char*)zi->ci.buffered_data;
         }
         uTotalOutBefore = zi->ci.bstream.total_out_lo32;
@@ -1605,15 +1752,52 @@ extern int ZEXPORT zipCloseFileInZipRaw64 (zipFile file, ZPOS64_T uncompressed_s
 
 #    ifndef NOCRYPT
     compressed_size += zi->ci.crypt_header_size;
+
+    /* AES encrypted data is followed by its authentication code, and AE-2
+       stores no crc32 */
+    if ((err==ZIP_OK) && (zi->ci.aes))
+    {
+        unsigned char mac[ZIPAES_MAC_LEN];
+        zipaes_finish(&zi->ci.aes_ctx,mac);
+        if (ZWRITE64(zi->z_filefunc,zi->filestream,mac,ZIPAES_MAC_LEN) != ZIPAES_MAC_LEN)
+            err = ZIP_ERRNO;
+        compressed_size += ZIPAES_MAC_LEN;
+        crc32 = 0;
+    }
 #    endif
 
+    // the data is followed by a data descriptor when bit 3 of the flag is set
+    if ((err==ZIP_OK) && (zi->ci.flag & 8))
+    {
+        err = zip64local_putValue(&zi->z_filefunc,zi->filestream,(uLong)DATADESCRIPTORMAGIC,4);
+
+        if (err==ZIP_OK)
+            err = zip64local_putValue(&zi->z_filefunc,zi->filestream,crc32,4);
+
+        if (zi->ci.zip64)
+        {
+          if (err==ZIP_OK)
+              err = zip64local_putValue(&zi->z_filefunc,zi->filestream,compressed_size,8);
+          if (err==ZIP_OK)
+              err = zip64local_putValue(&zi->z_filefunc,zi->filestream,uncompressed_size,8);
+        }
+        else
+        {
+          if (err==ZIP_OK)
+              err = zip64local_putValue(&zi->z_filefunc,zi->filestream,compressed_size,4);
+          if (err==ZIP_OK)
+              err = zip64local_putValue(&zi->z_filefunc,zi->filestream,uncompressed_size,4);
+        }
+    }
+
     // update Current Item crc and sizes,
     if(compressed_size >= 0xffffffff || uncompressed_size >= 0xffffffff || zi->ci.pos_local_header >= 0xffffffff)
     {
       /*version Made by*/
       zip64local_putValue_inmemory(zi->ci.central_header+4,(uLong)45,2);
-      /*version needed*/
-      zip64local_putValue_inmemory(zi->ci.central_header+6,(uLong)45,2);
+      /*version needed, AES needs a later one*/
+      if (!zi->ci.aes && (zi->ci.method != ZIPAES_METHOD))
+        zip64local_putValue_inmemory(zi->ci.central_header+6,(uLong)45,2);
 
     }
 
@@ -1694,11 +1878,11 @@ extern int ZEXPORT zipCloseFileInZipRaw64 (zipFile file, ZPOS64_T uncompressed_s
     }
 
     if (err==ZIP_OK)
-        err = add_data_in_datablock(&zi->central_dir, zi->ci.central_header, (uLong)zi->ci.size_centralheader);
+        zi->central_dir.size += zi->ci.size_centralheader;
 
-    free(zi->ci.central_header);
+    zi->ci.central_header = NULL;
 
-    if (err==ZIP_OK)
+    if ((err==ZIP_OK) && (!zi->streamed))
     {
         // Update the LocalFileHeader with the new values.
 
@@ -1903,23 +2087,24 @@ extern int ZEXPORT zipClose (zipFile file, const char* global_comment)
 
     if (err==ZIP_OK)
     {
-        linkedlist_datablock_internal* ldi = zi->central_dir.first_block;
-        while (ldi!=NULL)
+        // the whole central dir is written at once
+        const unsigned char* data = zi->central_dir.data;
+        ZPOS64_T size_left = zi->central_dir.size;
+        while ((err==ZIP_OK) && (size_left>0))
         {
-            if ((err==ZIP_OK) && (ldi->filled_in_this_block>0))
-            {
-                if (ZWRITE64(zi->z_filefunc,zi->filestream, ldi->data, ldi->filled_in_this_block) != ldi->filled_in_this_block)
-                    err = ZIP_ERRNO;
-            }
-
-            size_centraldir += ldi->filled_in_this_block;
-            ldi = ldi->next_datablock;
+            uLong write_this = (size_left > 0x40000000) ? 0x40000000 : (uLong)size_left;
+            if (ZWRITE64(zi->z_filefunc,zi->filestream, data, write_this) != write_this)
+                err = ZIP_ERRNO;
+            data += write_this;
+            size_left -= write_this;
         }
+        size_centraldir = (uLong)zi->central_dir.size;
     }
-    free_linkedlist(&(zi->central_dir));
+    free_centraldir(&(zi->central_dir));
 
+    // the zip64 record also holds the number of entries when there are too many for the end record
     pos = centraldir_pos_inzip - zi->add_position_when_writting_offset;
-    if(pos >= 0xffffffff)
+    if(pos >= 0xffffffff || zi->number_entry >= 0xFFFF)
     {
       ZPOS64_T Zip64EOCDpos = ZTELL64(zi->z_filefunc,zi->filestream);
       Write_Zip64EndOfCentralDirectoryRecord(zi, size_centraldir, centraldir_pos_inzip);
@@ -1940,11 +2125,38 @@ extern int ZEXPORT zipClose (zipFile file, const char* global_comment)
 #ifndef NO_ADDFILEINEXISTINGZIP
     TRYFREE(zi->globalcomment);
 #endif
+    TRYFREE(zi->ci.buffered_data);
     TRYFREE(zi);
 
     return err;
 }
 
+extern int ZEXPORT zipSetBufferSize (zipFile file, uLong size)
+{
+    zip64_internal* zi;
+
+    if (file == NULL)
+        return ZIP_PARAMERROR;
+    zi = (zip64_internal*)file;
+
+    if (zi->in_opened_file_inzip == 1)
+        return ZIP_PARAMERROR;
+
+    if (size == 0)
+        size = Z_BUFSIZE;
+    if (size > 0x40000000)
+        size = 0x40000000;
+    size = (size + Z_BUFALIGN - 1) & ~((uLong)Z_BUFALIGN - 1);
+
+    if (size != zi->ci.size_buffered_data)
+    {
+        TRYFREE(zi->ci.buffered_data);
+        zi->ci.buffered_data = NULL;
+        zi->ci.size_buffered_data = (uInt)size;
+    }
+    return ZIP_OK;
+}
+
 extern int ZEXPORT zipRemoveExtraInfoBlock (char* pData, int* dataLen, short sHeader)
 {
   char* p = pData;
@@ -1952,7 +2164,7 @@ extern int ZEXPORT zipRemoveExtraInfoBlock (char* pData, int* dataLen, short sHe
   char* pNewHeader;
   char* pTmp;
   short header;
-  short dataSize;
+  int dataSize;
 
   int retVal = ZIP_OK;
 
@@ -1960,12 +2172,22 @@ extern int ZEXPORT zipRemoveExtraInfoBlock (char* pData, int* dataLen, short sHe
     return ZIP_PARAMERROR;
 
   pNewHeader = (char*)ALLOC(*dataLen);
+  if (pNewHeader == NULL)
+    return ZIP_INTERNALERROR;
   pTmp = pNewHeader;
 
   while(p < (pData + *dataLen))
   {
-    header = *(short*)p;
-    dataSize = *(((short*)p)+1);
+    int left = (int)((pData + *dataLen) - p);
+    dataSize = (left >= 4) ? (((unsigned char)p[2]) | (((unsigned char)p[3]) << 8)) : 0;
+    if (left < dataSize + 4)
+    {
+      // a block cut short, as copied from a damaged archive, is kept as it is.
+      memcpy(pTmp, p, left);
+      size += left;
+      break;
+    }
+    header = (short)(((unsigned char)p[0]) | (((unsigned char)p[1]) << 8));
 
     if( header == sHeader ) // Header found.
     {
@@ -1975,6 +2197,7 @@ extern int ZEXPORT zipRemoveExtraInfoBlock (char* pData, int* dataLen, short sHe
     {
       // Extra Info block should not be removed, So copy it to the temp buffer.
       memcpy(pTmp, p, dataSize + 4);
+      pTmp += dataSize + 4;
       p += dataSize + 4;
       size += dataSize + 4;
     }
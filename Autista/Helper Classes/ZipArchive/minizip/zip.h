@@ -112,6 +112,7 @@ typedef const char* zipcharpc;
 #define APPEND_STATUS_CREATE        (0)
 #define APPEND_STATUS_CREATEAFTER   (1)
 #define APPEND_STATUS_ADDINZIP      (2)
+#define APPEND_STATUS_STREAM        (3)
 
 extern zipFile ZEXPORT zipOpen OF((const char *pathname, int append));
 extern zipFile ZEXPORT zipOpen64 OF((const void *pathname, int append));
@@ -124,6 +125,11 @@ extern zipFile ZEXPORT zipOpen64 OF((const void *pathname, int append));
          (useful if the file contain a self extractor code)
      if the file pathname exist and append==APPEND_STATUS_ADDINZIP, we will
        add files in existing zip (be sure you don't add file that doesn't exist)
+     if append==APPEND_STATUS_STREAM, the zip is written from front to back
+       without ever seeking or reading, so pathname may be a pipe, or the
+       functions given to zipOpen2_64 may write to a socket or an upload.
+       The crc and sizes of each file follow its data in a data descriptor
+       (bit 3 of the flag), and only its central directory is kept in memory.
      If the zipfile cannot be opened, the return value is NULL.
      Else, the return value is a zipFile Handle, usable with other function
        of this zip package.
@@ -301,6 +307,39 @@ extern int ZEXPORT zipOpenNewFileInZip4_64 OF((zipFile file,
   Same than zipOpenNewFileInZip4, except
     versionMadeBy : value for Version made by field
     flag : value for flag field (compression level info will be added)
+           if bit 3 (0x08) is set, the crc and sizes are also written in a data
+           descriptor after the data, and crcForCrypting is not needed for crypting
+ */
+
+extern int ZEXPORT zipOpenNewFileInZip5 OF((zipFile file,
+                                            const char* filename,
+                                            const zip_fileinfo* zipfi,
+                                            const void* extrafield_local,
+                                            uInt size_extrafield_local,
+                                            const void* extrafield_global,
+                                            uInt size_extrafield_global,
+                                            const char* comment,
+                                            int method,
+                                            int level,
+                                            int raw,
+                                            int windowBits,
+                                            int memLevel,
+                                            int strategy,
+                                            const char* password,
+                                            uLong crcForCrypting,
+                                            uLong versionMadeBy,
+                                            uLong flagBase,
+                                            int zip64,
+                                            int aes
+                                            ));
+/*
+  Same than zipOpenNewFileInZip4_64, except
+    aes : with a password, 0 for the traditional PKWARE encryption, or the
+          strength of a WinZip AES encryption (ZIPAES_128, ZIPAES_192 or
+          ZIPAES_256 of zipaes.h). AES encrypted files are written as AE-2,
+          without crc, and crcForCrypting is not needed.
+    A file encrypted with AES can be copied raw, with method ZIPAES_METHOD
+      and its AES extra field in extrafield_local and extrafield_global.
  */
 
 
@@ -336,6 +375,17 @@ extern int ZEXPORT zipClose OF((zipFile file,
   Close the zipfile
 */
 
+extern int ZEXPORT zipSetBufferSize OF((zipFile file, uLong size));
+/*
+  Set the size of the buffer the compressed data of a file in the zipfile is
+    gathered in before it is written, Z_BUFSIZE (256 KB) by default.
+  size is rounded up to a multiple of 4 KB; 0 restores the default.
+  Stored data of at least this size given to zipWriteInFileInZip is written
+    directly, without being copied in the buffer (unless it is crypted).
+  It can't be called while a file in the zipfile is opened.
+  return ZIP_OK if no error, ZIP_PARAMERROR otherwise.
+*/
+
 
 extern int ZEXPORT zipRemoveExtraInfoBlock OF((char* pData, int* dataLen, short sHeader));
 /*
@@ -0,0 +1,510 @@
+/*
+  zipaes.c -- WinZip AES encryption (AE-1 and AE-2) for Minizip: the keys
+  derived from the password with PBKDF2-HMAC-SHA1, AES in counter mode and
+  an HMAC-SHA1 authentication code of the encrypted data
+  License: Same as ZLIB (www.gzip.org)
+
+  The format is described in http://www.winzip.com/aes_info.htm. The counter
+  is 8 bytes little-endian followed by 8 zero bytes, and starts at 1.
+
+  On Apple systems the HMAC and PBKDF2 come from CommonCrypto, which uses the
+  SHA-1 hardware of the processor. Elsewhere SHA-1 is computed here, with the
+  x86-64 SHA instructions when the processor has them.
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#  include <windows.h>
+#  include <wincrypt.h>
+#endif
+
+#include "zlib.h"
+#include "zipaes.h"
+
+#ifdef ZIPAES_HAVE_COMMONCRYPTO
+#  include <CommonCrypto/CommonKeyDerivation.h>
+#endif
+
+#if !defined(ZIPAES_HAVE_COMMONCRYPTO) && (defined(__x86_64__) || defined(_M_X64)) && \
+    (defined(__GNUC__) || defined(__clang__))
+#  define ZIPAES_HAVE_SHANI
+#  include <cpuid.h>
+#  include <immintrin.h>
+#  ifndef bit_SHA
+#    define bit_SHA (1 << 29)
+#  endif
+#endif
+
+#ifndef local
+#  define local static
+#endif
+
+
+#ifdef ZIPAES_HAVE_COMMONCRYPTO
+
+/***********************************************************************
+ * HMAC-SHA1 and PBKDF2 with CommonCrypto
+ */
+
+local void zipaes_hmac_init(zipaes_hmac_ctx* ctx, const unsigned char* key, uInt size_key)
+{
+    CCHmacInit(ctx,kCCHmacAlgSHA1,key,size_key);
+}
+
+local void zipaes_hmac_update(zipaes_hmac_ctx* ctx, const unsigned char* buf, uInt len)
+{
+    CCHmacUpdate(ctx,buf,len);
+}
+
+local void zipaes_hmac_final(const zipaes_hmac_ctx* ctx, unsigned char* digest)
+{
+    zipaes_hmac_ctx c = *ctx;
+    CCHmacFinal(&c,digest);
+}
+
+extern void ZEXPORT zipaes_pbkdf2 (const unsigned char* password, uInt size_password,
+                                   const unsigned char* salt, uInt size_salt,
+                                   uInt iterations, unsigned char* key, uInt size_key)
+{
+    CCKeyDerivationPBKDF(kCCPBKDF2,(const char*)password,size_password,salt,size_salt,
+                         kCCPRFHmacAlgSHA1,iterations,key,size_key);
+}
+
+#else /* !ZIPAES_HAVE_COMMONCRYPTO */
+
+/***********************************************************************
+ * SHA-1
+ */
+
+#define ZIPAES_ROL(x,n) (((x) << (n)) | ((x) >> (32 - (n))))
+
+local void zipaes_sha1_portable(unsigned int* h, const unsigned char* data, uInt blocks)
+{
+    unsigned int w[80];
+    unsigned int a, b, c, d, e, t;
+    int i;
+
+    while (blocks-- > 0)
+    {
+        for (i=0;i<16;i++)
+            w[i] = ((unsigned int)data[4*i] << 24) | ((unsigned int)data[4*i+1] << 16) |
+                   ((unsigned int)data[4*i+2] << 8) | (unsigned int)data[4*i+3];
+        for (i=16;i<80;i++)
+        {
+            t = w[i-3] ^ w[i-8] ^ w[i-14] ^ w[i-16];
+            w[i] = ZIPAES_ROL(t,1);
+        }
+
+        a = h[0]; b = h[1]; c = h[2]; d = h[3]; e = h[4];
+        for (i=0;i<20;i++)
+        {
+            t = ZIPAES_ROL(a,5) + (d ^ (b & (c ^ d))) + e + 0x5a827999U + w[i];
+            e = d; d = c; c = ZIPAES_ROL(b,30); b = a; a = t;
+        }
+        for (;i<40;i++)
+        {
+            t = ZIPAES_ROL(a,5) + (b ^ c ^ d) + e + 0x6ed9eba1U + w[i];
+            e = d; d = c; c = ZIPAES_ROL(b,30); b = a; a = t;
+        }
+        for (;i<60;i++)
+        {
+            t = ZIPAES_ROL(a,5) + ((b & c) | (d & (b | c))) + e + 0x8f1bbcdcU + w[i];
+            e = d; d = c; c = ZIPAES_ROL(b,30); b = a; a = t;
+        }
+        for (;i<80;i++)
+        {
+            t = ZIPAES_ROL(a,5) + (b ^ c ^ d) + e + 0xca62c1d6U + w[i];
+            e = d; d = c; c = ZIPAES_ROL(b,30); b = a; a = t;
+        }
+        h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e;
+        data += 64;
+    }
+}
+
+#ifdef ZIPAES_HAVE_SHANI
+
+local int zipaes_shani_supported()
+{
+    unsigned int eax, ebx, ecx, edx;
+    if (__get_cpuid_max(0,NULL) < 7)
+        return 0;
+    __cpuid_count(7,0,eax,ebx,ecx,edx);
+    return (ebx & bit_SHA) != 0;
+}
+
+/* four rounds: the next e from the message words m, then sha1rnds4 with the
+   round function f. ea holds the e of these rounds, eb gets the next one. */
+#define ZIPAES_SHANI_ROUNDS(ea,eb,m,f) \
+    ea = _mm_sha1nexte_epu32(ea,m); \
+    eb = abcd; \
+    abcd = _mm_sha1rnds4_epu32(abcd,ea,f)
+
+/* the message schedule of the rounds with words m1, done four words ahead */
+#define ZIPAES_SHANI_SCHEDULE(m0,m1,m2,m3) \
+    m0 = _mm_sha1msg1_epu32(m0,m1); \
+    m3 = _mm_xor_si128(m3,m1); \
+    m2 = _mm_sha1msg2_epu32(m2,m1)
+
+__attribute__((target("sha,sse4.1")))
+local void zipaes_shani_compress(unsigned int* h, const unsigned char* data, uInt blocks)
+{
+    const __m128i reverse = _mm_set_epi64x(0x0001020304050607LL,0x08090a0b0c0d0e0fLL);
+    __m128i abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)h),0x1b);
+    __m128i e0 = _mm_set_epi32((int)h[4],0,0,0);
+
+    while (blocks-- > 0)
+    {
+        __m128i abcd_start = abcd, e_start = e0, e1;
+        __m128i m0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)data),reverse);
+        __m128i m1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 16)),reverse);
+        __m128i m2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 32)),reverse);
+        __m128i m3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 48)),reverse);
+
+        /* rounds 0 to 19 */
+        e0 = _mm_add_epi32(e0,m0);
+        e1 = abcd;
+        abcd = _mm_sha1rnds4_epu32(abcd,e0,0);
+        ZIPAES_SHANI_ROUNDS(e1,e0,m1,0); m0 = _mm_sha1msg1_epu32(m0,m1);
+        ZIPAES_SHANI_ROUNDS(e0,e1,m2,0); m1 = _mm_sha1msg1_epu32(m1,m2); m0 = _mm_xor_si128(m0,m2);
+        ZIPAES_SHANI_ROUNDS(e1,e0,m3,0); ZIPAES_SHANI_SCHEDULE(m2,m3,m0,m1);
+        ZIPAES_SHANI_ROUNDS(e0,e1,m0,0); ZIPAES_SHANI_SCHEDULE(m3,m0,m1,m2);
+        /* rounds 20 to 39 */
+        ZIPAES_SHANI_ROUNDS(e1,e0,m1,1); ZIPAES_SHANI_SCHEDULE(m0,m1,m2,m3);
+        ZIPAES_SHANI_ROUNDS(e0,e1,m2,1); ZIPAES_SHANI_SCHEDULE(m1,m2,m3,m0);
+        ZIPAES_SHANI_ROUNDS(e1,e0,m3,1); ZIPAES_SHANI_SCHEDULE(m2,m3,m0,m1);
+        ZIPAES_SHANI_ROUNDS(e0,e1,m0,1); ZIPAES_SHANI_SCHEDULE(m3,m0,m1,m2);
+        ZIPAES_SHANI_ROUNDS(e1,e0,m1,1); ZIPAES_SHANI_SCHEDULE(m0,m1,m2,m3);
+        /* rounds 40 to 59 */
+        ZIPAES_SHANI_ROUNDS(e0,e1,m2,2); ZIPAES_SHANI_SCHEDULE(m1,m2,m3,m0);
+        ZIPAES_SHANI_ROUNDS(e1,e0,m3,2); ZIPAES_SHANI_SCHEDULE(m2,m3,m0,m1);
+        ZIPAES_SHANI_ROUNDS(e0,e1,m0,2); ZIPAES_SHANI_SCHEDULE(m3,m0,m1,m2);
+        ZIPAES_SHANI_ROUNDS(e1,e0,m1,2); ZIPAES_SHANI_SCHEDULE(m0,m1,m2,m3);
+        ZIPAES_SHANI_ROUNDS(e0,e1,m2,2); ZIPAES_SHANI_SCHEDULE(m1,m2,m3,m0);
+        /* rounds 60 to 79 */
+        ZIPAES_SHANI_ROUNDS(e1,e0,m3,3); ZIPAES_SHANI_SCHEDULE(m2,m3,m0,m1);
+        ZIPAES_SHANI_ROUNDS(e0,e1,m0,3); ZIPAES_SHANI_SCHEDULE(m3,m0,m1,m2);
+        ZIPAES_SHANI_ROUNDS(e1,e0,m1,3); m3 = _mm_xor_si128(m3,m1); m2 = _mm_sha1msg2_epu32(m2,m1);
+        ZIPAES_SHANI_ROUNDS(e0,e1,m2,3); m3 = _mm_sha1msg2_epu32(m3,m2);
+        ZIPAES_SHANI_ROUNDS(e1,e0,m3,3);
+
+        e0 = _mm_sha1nexte_epu32(e0,e_start);
+        abcd = _mm_add_epi32(abcd,abcd_start);
+        data += 64;
+    }
+
+    _mm_storeu_si128((__m128i*)h,_mm_shuffle_epi32(abcd,0x1b));
+    h[4] = (unsigned int)_mm_extract_epi32(e0,3);
+}
+
+/* 1 if the SHA instructions are used, -1 before the first use. Threads racing
+   on the first use all store the same value. */
+local int zipaes_use_shani = -1;
+
+#endif /* ZIPAES_HAVE_SHANI */
+
+local void zipaes_sha1_compress(unsigned int* h, const unsigned char* data, uInt blocks)
+{
+#ifdef ZIPAES_HAVE_SHANI
+    if (zipaes_use_shani < 0)
+        zipaes_use_shani = zipaes_shani_supported();
+    if (zipaes_use_shani)
+    {
+        zipaes_shani_compress(h,data,blocks);
+        return;
+    }
+#endif
+    zipaes_sha1_portable(h,data,blocks);
+}
+
+local void zipaes_sha1_init(zipaes_sha1_ctx* ctx)
+{
+    ctx->h[0] = 0x67452301U;
+    ctx->h[1] = 0xefcdab89U;
+    ctx->h[2] = 0x98badcfeU;
+    ctx->h[3] = 0x10325476U;
+    ctx->h[4] = 0xc3d2e1f0U;
+    ctx->size_block = 0;
+    ctx->length = 0;
+}
+
+local void zipaes_sha1_update(zipaes_sha1_ctx* ctx, const unsigned char* buf, uInt len)
+{
+    ctx->length += len;
+    if (ctx->size_block > 0)
+    {
+        uInt copy = 64 - ctx->size_block;
+        if (copy > len)
+            copy = len;
+        memcpy(ctx->block + ctx->size_block,buf,copy);
+        ctx->size_block += copy;
+        buf += copy;
+        len -= copy;
+        if (ctx->size_block < 64)
+            return;
+        zipaes_sha1_compress(ctx->h,ctx->block,1);
+        ctx->size_block = 0;
+    }
+    if (len >= 64)
+    {
+        zipaes_sha1_compress(ctx->h,buf,len / 64);
+        buf += len & ~63U;
+        len &= 63;
+    }
+    if (len > 0)
+    {
+        memcpy(ctx->block,buf,len);
+        ctx->size_block = len;
+    }
+}
+
+local void zipaes_sha1_final(zipaes_sha1_ctx* ctx, unsigned char* digest)
+{
+    ZPOS64_T bits = ctx->length * 8;
+    int i;
+
+    ctx->block[ctx->size_block++] = 0x80;
+    if (ctx->size_block > 56)
+    {
+        memset(ctx->block + ctx->size_block,0,64 - ctx->size_block);
+        zipaes_sha1_compress(ctx->h,ctx->block,1);
+        ctx->size_block = 0;
+    }
+    memset(ctx->block + ctx->size_block,0,56 - ctx->size_block);
+    for (i=0;i<8;i++)
+        ctx->block[56+i] = (unsigned char)(bits >> (56 - 8*i));
+    zipaes_sha1_compress(ctx->h,ctx->block,1);
+    for (i=0;i<20;i++)
+        digest[i] = (unsigned char)(ctx->h[i/4] >> (24 - 8*(i%4)));
+}
+
+
+/***********************************************************************
+ * HMAC-SHA1 and PBKDF2
+ */
+
+local void zipaes_hmac_init(zipaes_hmac_ctx* ctx, const unsigned char* key, uInt size_key)
+{
+    unsigned char pad[64];
+    unsigned char digest[20];
+    uInt i;
+
+    if (size_key > 64)
+    {
+        zipaes_sha1_init(&ctx->inner);
+        zipaes_sha1_update(&ctx->inner,key,size_key);
+        zipaes_sha1_final(&ctx->inner,digest);
+        key = digest;
+        size_key = 20;
+    }
+
+    memset(pad,0x36,sizeof(pad));
+    for (i=0;i<size_key;i++)
+        pad[i] ^= key[i];
+    zipaes_sha1_init(&ctx->inner);
+    zipaes_sha1_update(&ctx->inner,pad,64);
+
+    memset(pad,0x5c,sizeof(pad));
+    for (i=0;i<size_key;i++)
+        pad[i] ^= key[i];
+    zipaes_sha1_init(&ctx->outer);
+    zipaes_sha1_update(&ctx->outer,pad,64);
+}
+
+local void zipaes_hmac_update(zipaes_hmac_ctx* ctx, const unsigned char* buf, uInt len)
+{
+    zipaes_sha1_update(&ctx->inner,buf,len);
+}
+
+local void zipaes_hmac_final(const zipaes_hmac_ctx* ctx, unsigned char* digest)
+{
+    zipaes_hmac_ctx c = *ctx;
+    zipaes_sha1_final(&c.inner,digest);
+    zipaes_sha1_update(&c.outer,digest,20);
+    zipaes_sha1_final(&c.outer,digest);
+}
+
+/* each iteration hashes a 20 bytes digest with the inner and the outer keyed
+   states, one block each: the blocks are padded once, and compressed directly */
+extern void ZEXPORT zipaes_pbkdf2 (const unsigned char* password, uInt size_password,
+                                   const unsigned char* salt, uInt size_salt,
+                                   uInt iterations, unsigned char* key, uInt size_key)
+{
+    zipaes_hmac_ctx hmac;
+    unsigned char block[64];
+    unsigned int count;
+    uInt i, j;
+
+    zipaes_hmac_init(&hmac,password,size_password);
+
+    /* 20 bytes of message after the 64 bytes of key pad */
+    memset(block,0,sizeof(block));
+    block[20] = 0x80;
+    block[62] = (unsigned char)(((64 + 20) * 8) >> 8);
+    block[63] = (unsigned char)((64 + 20) * 8);
+
+    for (count=1;size_key>0;count++)
+    {
+        zipaes_hmac_ctx c = hmac;
+        unsigned char u[20], t[20];
+        unsigned char number[4];
+        uInt copy = size_key < 20 ? size_key : 20;
+
+        number[0] = (unsigned char)(count >> 24);
+        number[1] = (unsigned char)(count >> 16);
+        number[2] = (unsigned char)(count >> 8);
+        number[3] = (unsigned char)count;
+        zipaes_sha1_update(&c.inner,salt,size_salt);
+        zipaes_sha1_update(&c.inner,number,4);
+        zipaes_hmac_final(&c,u);
+        memcpy(t,u,20);
+
+        for (i=1;i<iterations;i++)
+        {
+            unsigned int h[5];
+            memcpy(block,u,20);
+            memcpy(h,hmac.inner.h,sizeof(h));
+            zipaes_sha1_compress(h,block,1);
+            for (j=0;j<20;j++)
+                block[j] = (unsigned char)(h[j/4] >> (24 - 8*(j%4)));
+            memcpy(h,hmac.outer.h,sizeof(h));
+            zipaes_sha1_compress(h,block,1);
+            for (j=0;j<20;j++)
+            {
+                u[j] = (unsigned char)(h[j/4] >> (24 - 8*(j%4)));
+                t[j] ^= u[j];
+            }
+        }
+
+        memcpy(key,t,copy);
+        key += copy;
+        size_key -= copy;
+    }
+}
+
+#endif /* ZIPAES_HAVE_COMMONCRYPTO */
+
+
+/***********************************************************************
+ * the encryption of a file
+ */
+
+extern int ZEXPORT zipaes_init (zipaes_ctx* ctx, int strength, const char* password,
+                                const unsigned char* salt, unsigned char* verify)
+{
+    unsigned char keys[2 * 32 + ZIPAES_VERIFY_LEN];
+    uInt size_key;
+
+    if ((strength < ZIPAES_128) || (strength > ZIPAES_256))
+        return -1;
+    size_key = ZIPAES_KEY_LEN(strength);
+
+    /* the AES key, the HMAC key, then the password verification value */
+    zipaes_pbkdf2((const unsigned char*)password,(uInt)strlen(password),
+                  salt,ZIPAES_SALT_LEN(strength),ZIPAES_ITERATIONS,
+                  keys,2 * size_key + ZIPAES_VERIFY_LEN);
+    fastaes_set_key(&ctx->key,keys,size_key * 8);
+    zipaes_hmac_init(&ctx->mac_start,keys + size_key,size_key);
+    memcpy(verify,keys + 2 * size_key,ZIPAES_VERIFY_LEN);
+    memset(keys,0,sizeof(keys));
+
+    ctx->mac = ctx->mac_start;
+    ctx->pos = 0;
+    ctx->pos_stream = 0;
+    ctx->size_stream = 0;
+    return 0;
+}
+
+/* xor buf with the key stream from ctx->pos, encrypting the counters of
+   ZIPAES_STREAM_BLOCKS blocks at a time. The counter is little-endian, which
+   CommonCrypto's counter mode can't do, so the counters are encrypted as
+   blocks. The xor goes a word at a time, memcpy keeping it aligned. */
+local void zipaes_ctr(zipaes_ctx* ctx, unsigned char* buf, uInt len)
+{
+    while (len > 0)
+    {
+        uInt offset, copy, i;
+
+        if ((ctx->size_stream == 0) ||
+            (ctx->pos < ctx->pos_stream) ||
+            (ctx->pos >= ctx->pos_stream + (ZPOS64_T)ctx->size_stream))
+        {
+            ZPOS64_T counter = ctx->pos / FASTAES_BLOCK_SIZE + 1;
+            int block, k;
+
+            memset(ctx->stream,0,sizeof(ctx->stream));
+            for (block=0;block<ZIPAES_STREAM_BLOCKS;block++,counter++)
+                for (k=0;k<8;k++)
+                    ctx->stream[block * FASTAES_BLOCK_SIZE + k] = (unsigned char)(counter >> (8*k));
+            fastaes_encrypt(&ctx->key,ctx->stream,ctx->stream,ZIPAES_STREAM_BLOCKS);
+            ctx->pos_stream = ctx->pos - ctx->pos % FASTAES_BLOCK_SIZE;
+            ctx->size_stream = (int)sizeof(ctx->stream);
+        }
+
+        offset = (uInt)(ctx->pos - ctx->pos_stream);
+        copy = (uInt)ctx->size_stream - offset;
+        if (copy > len)
+            copy = len;
+        for (i=0;i+sizeof(size_t)<=copy;i+=sizeof(size_t))
+        {
+            size_t b, k;
+            memcpy(&b,buf + i,sizeof(b));
+            memcpy(&k,ctx->stream + offset + i,sizeof(k));
+            b ^= k;
+            memcpy(buf + i,&b,sizeof(b));
+        }
+        for (;i<copy;i++)
+            buf[i] ^= ctx->stream[offset + i];
+        ctx->pos += copy;
+        buf += copy;
+        len -= copy;
+    }
+}
+
+extern void ZEXPORT zipaes_encrypt (zipaes_ctx* ctx, unsigned char* buf, uInt len)
+{
+    zipaes_ctr(ctx,buf,len);
+    zipaes_hmac_update(&ctx->mac,buf,len);
+}
+
+extern void ZEXPORT zipaes_decrypt (zipaes_ctx* ctx, unsigned char* buf, uInt len)
+{
+    zipaes_hmac_update(&ctx->mac,buf,len);
+    zipaes_ctr(ctx,buf,len);
+}
+
+extern void ZEXPORT zipaes_seek (zipaes_ctx* ctx, ZPOS64_T pos)
+{
+    if (pos == 0)
+        ctx->mac = ctx->mac_start;
+    ctx->pos = pos;
+}
+
+extern void ZEXPORT zipaes_finish (zipaes_ctx* ctx, unsigned char* mac)
+{
+    unsigned char digest[20];
+    zipaes_hmac_final(&ctx->mac,digest);
+    memcpy(mac,digest,ZIPAES_MAC_LEN);
+}
+
+extern int ZEXPORT zipaes_random (unsigned char* buf, uInt len)
+{
+#ifdef _WIN32
+    HCRYPTPROV provider;
+    int ok;
+    if (!CryptAcquireContext(&provider,NULL,NULL,PROV_RSA_FULL,CRYPT_VERIFYCONTEXT | CRYPT_SILENT))
+        return -1;
+    ok = CryptGenRandom(provider,len,buf);
+    CryptReleaseContext(provider,0);
+    return ok ? 0 : -1;
+#else
+    FILE* f = fopen("/dev/urandom","rb");
+    size_t read;
+    if (f == NULL)
+        return -1;
+    read = fread(buf,1,len,f);
+    fclose(f);
+    return read == len ? 0 : -1;
+#endif
+}
@@ -0,0 +1,139 @@
+/*
+  zipaes.h -- WinZip AES encryption (AE-1 and AE-2) for Minizip: the keys
+  derived from the password with PBKDF2-HMAC-SHA1, AES in counter mode and
+  an HMAC-SHA1 authentication code of the encrypted data
+  License: Same as ZLIB (www.gzip.org)
+
+  An encrypted file has the compression method ZIPAES_METHOD and an extra
+  field ZIPAES_EXTRA_ID holding the real compression method. Its data is the
+  salt, the password verification value, the encrypted data, and the
+  authentication code. AE-2 files store no crc32, the code checks them.
+*/
+
+#ifndef _zipaes_H
+#define _zipaes_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef _ZLIB_H
+#include "zlib.h"
+#endif
+
+#ifndef _ZLIBIOAPI64_H
+#include "ioapi.h"
+#endif
+
+#include "fastaes.h"
+
+#if defined(__APPLE__) && !defined(NOCOMMONCRYPTO)
+#  define ZIPAES_HAVE_COMMONCRYPTO
+#  include <CommonCrypto/CommonHMAC.h>
+#endif
+
+#define ZIPAES_METHOD           (99)
+#define ZIPAES_EXTRA_ID         (0x9901)
+#define ZIPAES_EXTRA_SIZE       (7)     /* size of the data of the extra field */
+#define ZIPAES_VENDOR_ID        (0x4541)    /* "AE" */
+
+/* the versions */
+#define ZIPAES_AE1              (1)     /* the crc32 is stored and checked */
+#define ZIPAES_AE2              (2)     /* the crc32 is not stored */
+
+/* the key strengths */
+#define ZIPAES_128              (1)
+#define ZIPAES_192              (2)
+#define ZIPAES_256              (3)
+
+#define ZIPAES_KEY_LEN(strength)    (8 + 8*(strength))
+#define ZIPAES_SALT_LEN(strength)   (4 + 4*(strength))
+#define ZIPAES_MAX_SALT_LEN     (16)
+#define ZIPAES_VERIFY_LEN       (2)
+#define ZIPAES_MAC_LEN          (10)
+#define ZIPAES_HEADER_LEN(strength) (ZIPAES_SALT_LEN(strength) + ZIPAES_VERIFY_LEN)
+#define ZIPAES_OVERHEAD(strength)   (ZIPAES_HEADER_LEN(strength) + ZIPAES_MAC_LEN)
+#define ZIPAES_ITERATIONS       (1000)
+
+#define ZIPAES_STREAM_BLOCKS    (64)    /* key stream blocks encrypted at once */
+
+#ifdef ZIPAES_HAVE_COMMONCRYPTO
+
+/* a plain struct, copied to restart the code like the portable one */
+typedef CCHmacContext zipaes_hmac_ctx;
+
+#else
+
+typedef struct
+{
+    unsigned int h[5];
+    unsigned char block[64];
+    uInt size_block;
+    ZPOS64_T length;
+} zipaes_sha1_ctx;
+
+typedef struct
+{
+    zipaes_sha1_ctx inner;
+    zipaes_sha1_ctx outer;
+} zipaes_hmac_ctx;
+
+#endif /* ZIPAES_HAVE_COMMONCRYPTO */
+
+typedef struct
+{
+    fastaes_key key;
+    zipaes_hmac_ctx mac_start;  /* keyed, before any data, to restart */
+    zipaes_hmac_ctx mac;
+    ZPOS64_T pos;               /* position in the encrypted data */
+    ZPOS64_T pos_stream;        /* position of the key stream, a multiple of 16 */
+    int size_stream;            /* bytes of the key stream, 0 if none yet */
+    unsigned char stream[ZIPAES_STREAM_BLOCKS * FASTAES_BLOCK_SIZE];
+} zipaes_ctx;
+
+extern int ZEXPORT zipaes_init OF((zipaes_ctx* ctx, int strength, const char* password,
+                                   const unsigned char* salt, unsigned char* verify));
+/*
+  Derive the keys of a file from password and its salt of
+    ZIPAES_SALT_LEN(strength) bytes, and store its ZIPAES_VERIFY_LEN bytes of
+    password verification value in verify.
+  return 0, or -1 if strength is not valid.
+*/
+
+extern void ZEXPORT zipaes_encrypt OF((zipaes_ctx* ctx, unsigned char* buf, uInt len));
+extern void ZEXPORT zipaes_decrypt OF((zipaes_ctx* ctx, unsigned char* buf, uInt len));
+/*
+  Encrypt or decrypt the next len bytes of data of the file in place, adding
+    the encrypted bytes to the authentication code.
+*/
+
+extern void ZEXPORT zipaes_seek OF((zipaes_ctx* ctx, ZPOS64_T pos));
+/*
+  Go to the position pos in the encrypted data. Going back to 0 restarts the
+    authentication code, which is of no use after going anywhere else.
+*/
+
+extern void ZEXPORT zipaes_finish OF((zipaes_ctx* ctx, unsigned char* mac));
+/*
+  Store in mac the ZIPAES_MAC_LEN bytes of authentication code of the data
+    encrypted or decrypted since the start.
+*/
+
+extern int ZEXPORT zipaes_random OF((unsigned char* buf, uInt len));
+/*
+  Fill buf with len bytes from the random generator of the system, for salts.
+  return 0, or -1 if the generator can't be used.
+*/
+
+extern void ZEXPORT zipaes_pbkdf2 OF((const unsigned char* password, uInt size_password,
+                                      const unsigned char* salt, uInt size_salt,
+                                      uInt iterations, unsigned char* key, uInt size_key));
+/*
+  Derive size_key bytes of key from password and salt with PBKDF2-HMAC-SHA1.
+*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _zipaes_H */
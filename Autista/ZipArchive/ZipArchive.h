@@ -1,109 +0,0 @@
-/**
-//    Copyright (C) 2010-2012 Matt Connolly, Edward Patel, et al
-//
-//    Permission is hereby granted, free of charge, to any person obtaining a copy of this
-//    software and associated documentation files (the "Software"), to deal in the Software
-//    without restriction, including without limitation the rights to use, copy, modify,
-//    merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
-//    permit persons to whom the Software is furnished to do so, subject to the following
-//    conditions:
-//
-//    The above copyright notice and this permission notice shall be included in all
-//    copies or substantial portions of the Software.
-//
-//    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
-//    INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
-//    PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
-//    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
-//    OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
-//    SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
-*/
-
-#include "minizip/zip.h"
-#include "minizip/unzip.h"
-
-
-/**
- a block that is called from UnzipFileTo:overwrite:withProgressBlock: where the percentage of
- files processed (as an integer from 0 to 100), the number of files processed so far and the
- total number of files in the archive is called after each file is processed.
- */
-typedef void(^ZipArchiveProgressUpdateBlock)(int percentage, int filesProcessed, int numFiles);
-	
-/**
-    @protocol
-    @discussion  methods for a delegate to receive error notifications and control overwriting of files
-*/
-
-@protocol ZipArchiveDelegate <NSObject>
-@optional
-
-/**
-    @brief   Delegate method to be notified of errors
-    
-    ZipArchive calls this selector on the delegate when errors are encountered.
-    
-    @param      msg     a string describing the error.
-    @result     void
-*/
-
--(void) ErrorMessage:(NSString*) msg;
-
-/**
-    @brief   Delegate method to determine if a file should be replaced
-    
-    When an zip file is being expanded and a file is about to be replaced, this selector
-    is called on the delegate to notify that file is about to be replaced. The delegate method
-    should return YES to overwrite the file, or NO to skip it.
- 
-    @param      file - path to the file to be overwritten.
-    @result     a BOOL - YES to replace, NO to skip
-*/
-
--(BOOL) OverWriteOperation:(NSString*) file;
-
-@end
-
-/**
-    @class
-    @brief      An object that can create zip files and expand existing ones.
-    This class provides methods to create a zip file (optionally with a password) and
-    add files to that zip archive. 
-                 
-    It also provides methods to expand an existing archive file (optionally with a password),
-    and extract the files.
-*/
-
-@interface ZipArchive : NSObject {
-@private
-	zipFile		_zipFile;
-	unzFile		_unzFile;
-	
-    int         _numFiles;
-	NSString*   _password;
-	id			_delegate;
-    ZipArchiveProgressUpdateBlock _progressBlock;
-    
-    NSArray*    _unzippedFiles;
-}
-
-/** a delegate object conforming to ZipArchiveDelegate protocol */
-@property (nonatomic, retain) id<ZipArchiveDelegate> delegate;
-@property (nonatomic, readonly) int numFiles;
-@property (nonatomic, copy) ZipArchiveProgressUpdateBlock progressBlock;
-
-/** an array of files that were successfully expanded. Available after calling UnzipFileTo:overWrite: */
-@property (nonatomic, readonly) NSArray* unzippedFiles;
-
--(BOOL) CreateZipFile2:(NSString*) zipFile;
--(BOOL) CreateZipFile2:(NSString*) zipFile Password:(NSString*) password;
--(BOOL) addFileToZip:(NSString*) file newname:(NSString*) newname;
--(BOOL) CloseZipFile2;
-
--(BOOL) UnzipOpenFile:(NSString*) zipFile;
--(BOOL) UnzipOpenFile:(NSString*) zipFile Password:(NSString*) password;
--(BOOL) UnzipFileTo:(NSString*) path overWrite:(BOOL) overwrite;
--(BOOL) UnzipCloseFile;
--(NSArray*) getZipFileContents;     // list the contents of the zip archive. must be called after UnzipOpenFile
-
-@end
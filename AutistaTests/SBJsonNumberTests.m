@@ -0,0 +1,135 @@
+//
+//  SBJsonNumberTests.m
+//  AutistaTests
+//  Autista is a tablet application to help autistic children with speech
+//  difficulties develop manual motor and oral motor skills.
+//
+//  Copyright (C) 2014 The Groden Center, Inc.
+//
+//  This Source Code Form is subject to the terms of the Mozilla Public
+//  License, v. 2.0. If a copy of the MPL was not distributed with this
+//  file, You can obtain one at http://mozilla.org/MPL/2.0/.
+//
+
+#import "SBJsonNumberTests.h"
+#import "SBJson.h"
+#include <math.h>
+
+@implementation SBJsonNumberTests
+
+- (NSNumber *)numberWithJson:(NSString *)json
+{
+    NSArray *array = [[[SBJsonParser alloc] init] objectWithString:[NSString stringWithFormat:@"[%@]", json]];
+    STAssertTrue([array count] == 1, @"%@ parses", json);
+    return [array lastObject];
+}
+
+- (void)checkDouble:(double)value ofJson:(NSString *)json
+{
+    NSNumber *number = [self numberWithJson:json];
+    STAssertFalse([number isKindOfClass:[NSDecimalNumber class]], @"%@ is a double", json);
+    STAssertTrue(strcmp([number objCType], @encode(double)) == 0, @"%@ is a double", json);
+    STAssertTrue([number doubleValue] == value, @"%@ is %.17g, not %.17g", json, value, [number doubleValue]);
+}
+
+- (void)checkDecimal:(NSString *)decimal ofJson:(NSString *)json
+{
+    NSNumber *number = [self numberWithJson:json];
+    STAssertTrue([number isKindOfClass:[NSDecimalNumber class]], @"%@ stays decimal", json);
+    STAssertEqualObjects([number stringValue], decimal, @"%@ keeps its digits", json);
+}
+
+- (void)testMantissaAtTwoToThe53
+{
+    [self checkDouble:9007199254740992.0 ofJson:@"9007199254740992e0"];
+    [self checkDouble:9007199254740992.0 ofJson:@"9007199254740992.0"];
+    [self checkDouble:-9007199254740992.0 ofJson:@"-9007199254740992e0"];
+    [self checkDouble:4503599627370497.5 ofJson:@"4503599627370497.5"];
+
+    // No double has this value
+    [self checkDecimal:@"9007199254740993" ofJson:@"9007199254740993e0"];
+    [self checkDecimal:@"-9007199254740993" ofJson:@"-9007199254740993.0"];
+
+    // Integers stay exact
+    STAssertTrue([[self numberWithJson:@"9007199254740993"] longLongValue] == 9007199254740993LL, @"integer above 2^53");
+}
+
+- (void)testExponentsAroundTwentyTwo
+{
+    // Powers of ten up to 1e22 are exact, so they're used directly
+    [self checkDouble:1e22 ofJson:@"1e22"];
+    [self checkDouble:1e23 ofJson:@"1e23"];
+    [self checkDouble:1e-22 ofJson:@"1e-22"];
+    [self checkDouble:1e-23 ofJson:@"1e-23"];
+    [self checkDouble:4.5e22 ofJson:@"4.5e22"];
+    [self checkDouble:4.5e23 ofJson:@"4.5e23"];
+    [self checkDouble:123456789e-22 ofJson:@"123456789e-22"];
+    [self checkDouble:123456789e-23 ofJson:@"123456789e-23"];
+    [self checkDouble:-7e22 ofJson:@"-7E+22"];
+    [self checkDouble:-7e23 ofJson:@"-7E+23"];
+}
+
+- (void)testManyDigits
+{
+    [self checkDouble:0.1 + 0.2 ofJson:@"0.30000000000000004"];
+    [self checkDouble:3.141592653589793 ofJson:@"3.141592653589793"];
+
+    // More digits than a double keeps
+    [self checkDecimal:@"1.23456789012345678" ofJson:@"1.23456789012345678"];
+    [self checkDecimal:@"123456789012345678" ofJson:@"123456789012345678e0"];
+    [self checkDecimal:@"12345678901234567890.5" ofJson:@"12345678901234567890.5"];
+    [self checkDecimal:@"12345678901234567890" ofJson:@"12345678901234567890"];
+}
+
+- (void)testNegativeZero
+{
+    NSArray *inputs = [NSArray arrayWithObjects:@"-0.0", @"-0e5", @"-0.000", @"-0E-3", nil];
+    for (NSString *json in inputs) {
+        NSNumber *number = [self numberWithJson:json];
+        STAssertTrue([number doubleValue] == 0.0, @"%@ is zero", json);
+        STAssertTrue(signbit([number doubleValue]), @"%@ keeps its sign", json);
+    }
+    STAssertFalse(signbit([[self numberWithJson:@"0.0"] doubleValue]), @"positive zero");
+
+    // An integer has no negative zero
+    NSNumber *zero = [self numberWithJson:@"-0"];
+    STAssertTrue([zero longLongValue] == 0, @"-0 is zero");
+    STAssertEqualObjects(zero, [NSNumber numberWithInt:0], @"-0 is plain zero");
+}
+
+- (void)testSmallIntegers
+{
+    // Parsed integers from 0 to 255 share one instance each
+    STAssertTrue([self numberWithJson:@"0"] == [self numberWithJson:@"0"], @"0 is cached");
+    STAssertTrue([self numberWithJson:@"255"] == [self numberWithJson:@"255"], @"255 is cached");
+    STAssertTrue([[self numberWithJson:@"0"] longLongValue] == 0, @"0");
+    STAssertTrue([[self numberWithJson:@"255"] longLongValue] == 255, @"255");
+    STAssertTrue([[self numberWithJson:@"-1"] longLongValue] == -1, @"-1");
+    STAssertTrue([[self numberWithJson:@"256"] longLongValue] == 256, @"256");
+    STAssertTrue([[self numberWithJson:@"-255"] longLongValue] == -255, @"-255");
+
+    NSArray *array = [[[SBJsonParser alloc] init] objectWithString:@"[-1,0,1,254,255,256]"];
+    long long expected[] = { -1, 0, 1, 254, 255, 256 };
+    for (NSUInteger i = 0; i < [array count]; i++)
+        STAssertTrue([[array objectAtIndex:i] longLongValue] == expected[i], @"%lld", expected[i]);
+    STAssertEqualObjects([[[SBJsonWriter alloc] init] stringWithObject:array], @"[-1,0,1,254,255,256]", @"written back");
+}
+
+- (void)testWriterRoundTrip
+{
+    double values[] = { 0.1, 1.0 / 3, 0.1 + 0.2, M_PI, 2.0 / 3 * 1e100, 1e-100 / 3, 123456.789, 1e22, 1e23 };
+    SBJsonWriter *writer = [[SBJsonWriter alloc] init];
+    for (size_t i = 0; i < sizeof values / sizeof *values; i++) {
+        NSString *json = [writer stringWithObject:[NSArray arrayWithObject:[NSNumber numberWithDouble:values[i]]]];
+        NSNumber *number = [[[[SBJsonParser alloc] init] objectWithString:json] lastObject];
+        STAssertFalse([number isKindOfClass:[NSDecimalNumber class]], @"%@ reads back as a double", json);
+        STAssertTrue([number doubleValue] == values[i], @"%@ reads back as %.17g", json, values[i]);
+    }
+
+    // The fewest digits that read back the same
+    STAssertEqualObjects([writer stringWithObject:[NSArray arrayWithObject:[NSNumber numberWithDouble:0.1]]], @"[0.1]", @"15 digits");
+    STAssertEqualObjects([writer stringWithObject:[NSArray arrayWithObject:[NSNumber numberWithDouble:1.0 / 3]]], @"[0.3333333333333333]", @"16 digits");
+    STAssertEqualObjects([writer stringWithObject:[NSArray arrayWithObject:[NSNumber numberWithDouble:0.1 + 0.2]]], @"[0.30000000000000004]", @"17 digits");
+}
+
+@end
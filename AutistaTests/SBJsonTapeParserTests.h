@@ -0,0 +1,18 @@
+//
+//  SBJsonTapeParserTests.h
+//  AutistaTests
+//  Autista is a tablet application to help autistic children with speech
+//  difficulties develop manual motor and oral motor skills.
+//
+//  Copyright (C) 2014 The Groden Center, Inc.
+//
+//  This Source Code Form is subject to the terms of the Mozilla Public
+//  License, v. 2.0. If a copy of the MPL was not distributed with this
+//  file, You can obtain one at http://mozilla.org/MPL/2.0/.
+//
+
+#import <SenTestingKit/SenTestingKit.h>
+
+@interface SBJsonTapeParserTests : SenTestCase
+
+@end
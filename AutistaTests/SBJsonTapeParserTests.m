@@ -0,0 +1,188 @@
+//
+//  SBJsonTapeParserTests.m
+//  AutistaTests
+//  Autista is a tablet application to help autistic children with speech
+//  difficulties develop manual motor and oral motor skills.
+//
+//  Copyright (C) 2014 The Groden Center, Inc.
+//
+//  This Source Code Form is subject to the terms of the Mozilla Public
+//  License, v. 2.0. If a copy of the MPL was not distributed with this
+//  file, You can obtain one at http://mozilla.org/MPL/2.0/.
+//
+
+#import "SBJsonTapeParserTests.h"
+#import "SBJson.h"
+#include <math.h>
+
+@implementation SBJsonTapeParserTests
+
+- (id)tapeObject:(NSString *)json
+{
+    return [[[SBJsonTapeParser alloc] init] objectWithString:json];
+}
+
+- (id)parsedObject:(NSString *)json
+{
+    return [[[SBJsonParser alloc] init] objectWithString:json];
+}
+
+- (void)testNestedContainers
+{
+    NSString *json = @"{\"a\":[1,{\"b\":[true,false,null]},\"x\",[]],\"c\":{\"d\":{},\"e\":[[[\"deep\"]]]}}";
+    NSDictionary *dict = [self tapeObject:json];
+    STAssertNotNil(dict, @"nested containers parse");
+    STAssertTrue([dict isKindOfClass:[NSDictionary class]], @"outer object is a dictionary");
+    STAssertEqualObjects(dict, [self parsedObject:json], @"same values as SBJsonParser");
+
+    NSArray *a = [dict objectForKey:@"a"];
+    STAssertTrue([a isKindOfClass:[NSArray class]], @"array value is an array");
+    STAssertTrue([a count] == 4, @"array has its 4 values");
+    STAssertEqualObjects([[a objectAtIndex:1] objectForKey:@"b"], ([NSArray arrayWithObjects:[NSNumber numberWithBool:YES], [NSNumber numberWithBool:NO], [NSNull null], nil]), @"literals decode");
+    STAssertTrue([[a objectAtIndex:3] count] == 0, @"empty array");
+    STAssertTrue([[[dict objectForKey:@"c"] objectForKey:@"d"] count] == 0, @"empty object");
+    STAssertEqualObjects([[[[[dict objectForKey:@"c"] objectForKey:@"e"] objectAtIndex:0] objectAtIndex:0] objectAtIndex:0], @"deep", @"deepest value");
+    STAssertThrows([a objectAtIndex:4], @"index beyond bounds raises");
+
+    NSString *deep = [[@"" stringByPaddingToLength:33 withString:@"[" startingAtIndex:0] stringByAppendingString:[@"" stringByPaddingToLength:33 withString:@"]" startingAtIndex:0]];
+    STAssertNil([self tapeObject:deep], @"input deeper than maxDepth fails");
+    STAssertNotNil([self tapeObject:[deep substringWithRange:NSMakeRange(1, 64)]], @"input as deep as maxDepth parses");
+}
+
+- (void)testDuplicateKeysCountedOnce
+{
+    NSDictionary *dict = [self tapeObject:@"{\"a\":1,\"b\":2,\"a\":3}"];
+    STAssertTrue([dict count] == 2, @"each key is counted once");
+    STAssertEqualObjects([dict objectForKey:@"a"], [NSNumber numberWithInt:3], @"the last value wins");
+    STAssertEqualObjects([[dict allKeys] sortedArrayUsingSelector:@selector(compare:)], ([NSArray arrayWithObjects:@"a", @"b", nil]), @"each key is enumerated once");
+    STAssertEqualObjects(dict, [self parsedObject:@"{\"a\":1,\"b\":2,\"a\":3}"], @"same as SBJsonParser");
+
+    // More keys than are searched linearly, so they are looked up in a dictionary
+    NSMutableString *json = [NSMutableString stringWithString:@"{"];
+    for (int i = 0; i < 12; i++)
+        [json appendFormat:@"\"k%d\":%d,", i, i];
+    [json appendString:@"\"k0\":99,\"k5\":\"five\"}"];
+    dict = [self tapeObject:json];
+    STAssertTrue([dict count] == 12, @"each key is counted once");
+    STAssertTrue([[dict allKeys] count] == 12, @"each key is enumerated once");
+    STAssertEqualObjects([dict objectForKey:@"k0"], [NSNumber numberWithInt:99], @"the last value wins");
+    STAssertEqualObjects([dict objectForKey:@"k5"], @"five", @"the last value wins");
+    STAssertEqualObjects([dict objectForKey:@"k11"], [NSNumber numberWithInt:11], @"other keys keep their value");
+    STAssertEqualObjects(dict, [self parsedObject:json], @"same as SBJsonParser");
+}
+
+- (void)testStringEscapes
+{
+    NSArray *array = [self tapeObject:@"[\"plain\",\"tab\\t\",\"quote\\\"\",\"slash\\\\\\/\",\"e\\u00e9\",\"pair\\ud83d\\ude00\",\"caf\u00e9\",\"\"]"];
+    STAssertNotNil(array, @"strings parse");
+    STAssertEqualObjects([array objectAtIndex:0], @"plain", @"string without escapes");
+    STAssertEqualObjects([array objectAtIndex:1], @"tab\t", @"escaped tab");
+    STAssertEqualObjects([array objectAtIndex:2], @"quote\"", @"escaped quote");
+    STAssertEqualObjects([array objectAtIndex:3], @"slash\\/", @"escaped slashes");
+    STAssertEqualObjects([array objectAtIndex:4], @"e\u00e9", @"unicode escape");
+    STAssertEqualObjects([array objectAtIndex:5], @"pair\U0001F600", @"surrogate pair");
+    STAssertEqualObjects([array objectAtIndex:6], @"caf\u00e9", @"UTF-8 left in the input");
+    STAssertEqualObjects([array objectAtIndex:7], @"", @"empty string");
+
+    NSDictionary *dict = [self tapeObject:@"{\"k\\n\":1,\"caf\u00e9\":2}"];
+    STAssertEqualObjects([dict objectForKey:@"k\n"], [NSNumber numberWithInt:1], @"key with an escape");
+    STAssertEqualObjects([dict objectForKey:@"caf\u00e9"], [NSNumber numberWithInt:2], @"UTF-8 key");
+    STAssertNil([dict objectForKey:@"k"], @"no partial match");
+}
+
+- (void)testNumbers
+{
+    NSString *json = @"[0,-1,255,256,-0.0,1.5,1e22,-9223372036854775808,12345678901234567890,0.1]";
+    NSArray *array = [self tapeObject:json];
+    STAssertEqualObjects(array, [self parsedObject:json], @"same numbers as SBJsonParser");
+    STAssertTrue([[array objectAtIndex:1] longLongValue] == -1, @"negative integer");
+    STAssertTrue(signbit([[array objectAtIndex:4] doubleValue]), @"negative zero keeps its sign");
+    STAssertTrue([[array objectAtIndex:7] longLongValue] == LLONG_MIN, @"smallest long long");
+    STAssertTrue([[array objectAtIndex:8] isKindOfClass:[NSDecimalNumber class]], @"integer beyond long long stays decimal");
+    STAssertTrue([[array objectAtIndex:9] doubleValue] == 0.1, @"nearest double");
+}
+
+- (void)testInvalidInput
+{
+    NSArray *inputs = [NSArray arrayWithObjects:
+                       @"",
+                       @"[",
+                       @"{\"a\":[1,2",
+                       @"[\"unterminated",
+                       @"[1,]",
+                       @"{\"a\" 1}",
+                       @"{1:2}",
+                       @"[01]",
+                       @"[1.]",
+                       @"[-]",
+                       @"[\"\\x\"]",
+                       @"[\"\\ud83d\"]",
+                       @"[tru]",
+                       @"[1] [2]",
+                       @"\"bare string\"",
+                       nil];
+    for (NSString *input in inputs) {
+        SBJsonTapeParser *parser = [[SBJsonTapeParser alloc] init];
+        STAssertNil([parser objectWithString:input], @"%@ fails", input);
+        STAssertNotNil(parser.error, @"%@ reports an error", input);
+    }
+
+    SBJsonTapeParser *parser = [[SBJsonTapeParser alloc] init];
+    STAssertNil([parser objectWithData:nil], @"nil input fails");
+    STAssertEqualObjects(parser.error, @"Input was 'nil'", @"nil input error");
+
+    char broken[] = { '[', '"', (char)0xC3, '"', ']' };
+    STAssertNil([parser objectWithData:[NSData dataWithBytes:broken length:sizeof broken]], @"broken UTF-8 fails");
+}
+
+- (void)testConcurrentFirstAccess
+{
+    NSMutableString *json = [NSMutableString stringWithString:@"["];
+    for (int i = 0; i < 200; i++) {
+        [json appendString:i ? @",{" : @"{"];
+        for (int k = 0; k < 12; k++)
+            [json appendFormat:@"%@\"k%d\":[%d,\"v%d\"]", k ? @"," : @"", k, i, k];
+        [json appendString:@",\"k0\":\"last\"}"];
+    }
+    [json appendString:@"]"];
+
+    // Fresh collections each round, so every thread races to fill the caches
+    for (int round = 0; round < 20; round++) {
+        NSArray *array = [self tapeObject:json];
+        NSUInteger threads = 8;
+        NSMutableArray *seen = [NSMutableArray arrayWithCapacity:threads];
+        for (NSUInteger t = 0; t < threads; t++)
+            [seen addObject:[NSNull null]];
+
+        dispatch_apply(threads, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t t) {
+            NSMutableArray *values = [NSMutableArray arrayWithCapacity:[array count] * 3];
+            for (NSUInteger i = 0; i < [array count]; i++) {
+                NSDictionary *item = [array objectAtIndex:(i + t * 25) % [array count]];
+                [values addObject:item];
+                [values addObject:[item objectForKey:t % 2 ? @"k7" : @"k0"]];
+                [values addObject:[NSNumber numberWithUnsignedInteger:[item count]]];
+            }
+            @synchronized(seen) {
+                [seen replaceObjectAtIndex:t withObject:values];
+            }
+        });
+
+        for (NSUInteger t = 0; t < threads; t++) {
+            NSArray *values = [seen objectAtIndex:t];
+            for (NSUInteger i = 0; i < [array count]; i++) {
+                NSUInteger index = (i + t * 25) % [array count];
+                STAssertTrue([values objectAtIndex:3 * i] == [array objectAtIndex:index], @"every thread gets the same cached object");
+                STAssertTrue([[values objectAtIndex:3 * i + 2] unsignedIntegerValue] == 12, @"every thread counts each key once");
+                id value = [values objectAtIndex:3 * i + 1];
+                if (t % 2) {
+                    STAssertTrue(value == [[array objectAtIndex:index] objectForKey:@"k7"], @"every thread gets the same cached value");
+                    STAssertTrue([[value objectAtIndex:0] unsignedIntegerValue] == index, @"the value of its object");
+                } else {
+                    STAssertEqualObjects(value, @"last", @"the last value wins");
+                }
+            }
+        }
+    }
+}
+
+@end
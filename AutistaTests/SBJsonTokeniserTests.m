@@ -0,0 +1,228 @@
+//
+//  SBJsonTokeniserTests.m
+//  AutistaTests
+//  Autista is a tablet application to help autistic children with speech
+//  difficulties develop manual motor and oral motor skills.
+//
+//  Copyright (C) 2014 The Groden Center, Inc.
+//
+//  This Source Code Form is subject to the terms of the Mozilla Public
+//  License, v. 2.0. If a copy of the MPL was not distributed with this
+//  file, You can obtain one at http://mozilla.org/MPL/2.0/.
+//
+
+#import "SBJsonTokeniserTests.h"
+#import "SBJson.h"
+#import "SBJsonStreamParserAccumulator.h"
+#import "SBJsonTokeniser.h"
+#import "SBJsonUTF8Stream.h"
+
+// Where the stream's scans should stop, looking at a byte at a time
+
+static BOOL SBIsSpace(unsigned char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static BOOL SBIsStringEnd(unsigned char c) {
+    return c == '"' || c == '\\' || c < 0x20;
+}
+
+static NSUInteger SBNextNonspace(const unsigned char *bytes, NSUInteger length, NSUInteger from) {
+    while (from < length && SBIsSpace(bytes[from]))
+        from++;
+    return from;
+}
+
+static NSUInteger SBNextStringEnd(const unsigned char *bytes, NSUInteger length, NSUInteger from) {
+    while (from < length && !SBIsStringEnd(bytes[from]))
+        from++;
+    return from;
+}
+
+// Mostly filler, with any byte now and then
+static void SBFill(unsigned char *bytes, NSUInteger length, unsigned seed, const unsigned char filler[4]) {
+    for (NSUInteger i = 0; i < length; i++) {
+        seed = seed * 1103515245u + 12345u;
+        unsigned r = seed >> 8;
+        bytes[i] = r % 16 ? filler[r / 16 % 4] : (unsigned char)(r / 64);
+    }
+}
+
+@implementation SBJsonTokeniserTests
+
+- (SBJsonUTF8Stream *)streamWithBytes:(const unsigned char *)bytes length:(NSUInteger)length
+{
+    SBJsonUTF8Stream *stream = [[SBJsonUTF8Stream alloc] init];
+    [stream appendData:[NSData dataWithBytes:bytes length:length]];
+    return stream;
+}
+
+- (void)checkScansOf:(const unsigned char *)bytes length:(NSUInteger)length from:(NSUInteger)from
+{
+    SBJsonUTF8Stream *stream = [self streamWithBytes:bytes length:length];
+    stream.index = from;
+    [stream skipWhitespace];
+    STAssertTrue(stream.index == SBNextNonspace(bytes, length, from), @"whitespace from %lu of %lu bytes", (unsigned long)from, (unsigned long)length);
+
+    stream = [self streamWithBytes:bytes length:length];
+    stream.index = from;
+    NSRange range;
+    NSUInteger end = SBNextStringEnd(bytes, length, from);
+    if (end < length) {
+        STAssertTrue([stream getStringFragmentRange:&range], @"string end from %lu of %lu bytes", (unsigned long)from, (unsigned long)length);
+        STAssertTrue(range.location == from && NSMaxRange(range) == end, @"string fragment from %lu of %lu bytes", (unsigned long)from, (unsigned long)length);
+    } else {
+        STAssertFalse([stream getStringFragmentRange:&range], @"no string end from %lu of %lu bytes", (unsigned long)from, (unsigned long)length);
+        STAssertTrue(stream.index == length, @"scanned to the end from %lu of %lu bytes", (unsigned long)from, (unsigned long)length);
+    }
+}
+
+- (void)testClassifyEveryByte
+{
+    // 127 bytes: one indexed block, then vectors, then the last few bytes one by one
+    unsigned char bytes[127];
+    for (int c = 0; c < 256; c++) {
+        for (NSUInteger p = 0; p < sizeof bytes; p++) {
+            memset(bytes, ' ', sizeof bytes);
+            bytes[p] = (unsigned char)c;
+            [self checkScansOf:bytes length:sizeof bytes from:0];
+
+            memset(bytes, 'a', sizeof bytes);
+            bytes[p] = (unsigned char)c;
+            [self checkScansOf:bytes length:sizeof bytes from:0];
+        }
+    }
+}
+
+- (void)testTailScanLengths
+{
+    static const unsigned char spaces[4] = { ' ', '\t', '\r', '\n' };
+    static const unsigned char letters[4] = { 'a', 'Z', 0xC3, 0xA9 };
+    unsigned char bytes[128];
+    for (NSUInteger length = 0; length <= sizeof bytes; length++) {
+        for (unsigned seed = 0; seed < 4; seed++) {
+            SBFill(bytes, length, seed, spaces);
+            for (NSUInteger from = 0; from <= length; from++)
+                [self checkScansOf:bytes length:length from:from];
+
+            SBFill(bytes, length, seed, letters);
+            for (NSUInteger from = 0; from <= length; from++)
+                [self checkScansOf:bytes length:length from:from];
+        }
+    }
+}
+
+- (void)testFragmentResumesAfterAppendData
+{
+    SBJsonUTF8Stream *stream = [[SBJsonUTF8Stream alloc] init];
+    [stream appendData:[[@"" stringByPaddingToLength:70 withString:@"a" startingAtIndex:0] dataUsingEncoding:NSUTF8StringEncoding]];
+    NSRange range;
+    STAssertFalse([stream getStringFragmentRange:&range], @"no end in the first chunk");
+    STAssertTrue(stream.index == 70, @"scanned the first chunk");
+
+    stream.index = 0;
+    [stream appendData:[[[@"" stringByPaddingToLength:70 withString:@"b" startingAtIndex:0] stringByAppendingString:@"\""] dataUsingEncoding:NSUTF8StringEncoding]];
+    STAssertTrue([stream getStringFragmentRange:&range], @"end in the second chunk");
+    STAssertTrue(range.location == 0 && range.length == 140, @"fragment spans both chunks");
+
+    // Rewinding to the start of the string as the tokeniser does, so the
+    // parsed blocks before it are discarded when the next chunk comes
+    stream = [[SBJsonUTF8Stream alloc] init];
+    NSMutableData *data = [NSMutableData dataWithLength:300];
+    memset([data mutableBytes], ' ', 200);
+    memset((char *)[data mutableBytes] + 200, 'a', 100);
+    [stream appendData:data];
+    stream.index = 200;
+    STAssertFalse([stream getStringFragmentRange:&range], @"no end in the first chunk");
+
+    stream.index = 200;
+    [stream appendData:[@"bbb\\\"" dataUsingEncoding:NSUTF8StringEncoding]];
+    NSUInteger start = stream.index;
+    STAssertTrue(start < 200, @"parsed blocks are discarded");
+    STAssertTrue([stream getStringFragmentRange:&range], @"end in the second chunk");
+    STAssertTrue(range.location == start && range.length == 103, @"fragment stops at the escape");
+    STAssertEqualObjects([stream stringWithRange:range], [[@"" stringByPaddingToLength:100 withString:@"a" startingAtIndex:0] stringByAppendingString:@"bbb"], @"fragment bytes");
+}
+
+- (NSArray *)tokensOfChunks:(NSArray *)chunks ranges:(BOOL)ranges
+{
+    SBJsonTokeniser *tokeniser = [[SBJsonTokeniser alloc] init];
+    NSMutableArray *tokens = [NSMutableArray array];
+    NSUInteger next = 0;
+    for (;;) {
+        NSObject *token = nil;
+        NSRange range = NSMakeRange(NSNotFound, 0);
+        sbjson_token_t tok = ranges ? [tokeniser getToken:&token range:&range] : [tokeniser getToken:&token];
+        if (tok == sbjson_token_eof) {
+            if (next == [chunks count])
+                break;
+            [tokeniser appendData:[chunks objectAtIndex:next++]];
+            continue;
+        }
+        if (tok == sbjson_token_error)
+            return nil;
+        if (tok == sbjson_token_string && !token)
+            token = [tokeniser.stream stringWithRange:range];
+        [tokens addObject:tok == sbjson_token_string ? token : [NSNumber numberWithInt:tok]];
+    }
+    return tokens;
+}
+
+- (void)testStringsAcrossBlockAndChunkBoundaries
+{
+    NSString *value = @"tab\t \"quoted\" back\\slash caf\u00e9 \U0001F600 end";
+    NSString *escaped = @"tab\\t \\\"quoted\\\" back\\\\slash caf\\u00e9 \\ud83d\\ude00 end";
+    NSString *plain = @"plain text that runs on past a whole block of sixty four bytes, caf\u00e9, to its end";
+    NSArray *expected = [NSArray arrayWithObjects:
+                         [NSNumber numberWithInt:sbjson_token_array_start],
+                         value,
+                         [NSNumber numberWithInt:sbjson_token_separator],
+                         plain,
+                         [NSNumber numberWithInt:sbjson_token_array_end],
+                         nil];
+
+    // Move the strings across the 64 byte blocks, and cut the data everywhere
+    for (NSUInteger pad = 0; pad < 80; pad++) {
+        NSString *json = [NSString stringWithFormat:@"[%@\"%@\",\"%@\"]", [@"" stringByPaddingToLength:pad withString:@" " startingAtIndex:0], escaped, plain];
+        NSData *data = [json dataUsingEncoding:NSUTF8StringEncoding];
+        STAssertEqualObjects([self tokensOfChunks:[NSArray arrayWithObject:data] ranges:NO], expected, @"padding %lu", (unsigned long)pad);
+        STAssertEqualObjects([self tokensOfChunks:[NSArray arrayWithObject:data] ranges:YES], expected, @"padding %lu, with ranges", (unsigned long)pad);
+
+        for (NSUInteger cut = 0; cut <= [data length]; cut++) {
+            NSArray *chunks = [NSArray arrayWithObjects:
+                               [data subdataWithRange:NSMakeRange(0, cut)],
+                               [data subdataWithRange:NSMakeRange(cut, [data length] - cut)],
+                               nil];
+            STAssertEqualObjects([self tokensOfChunks:chunks ranges:NO], expected, @"padding %lu, cut at %lu", (unsigned long)pad, (unsigned long)cut);
+            STAssertEqualObjects([self tokensOfChunks:chunks ranges:YES], expected, @"padding %lu, cut at %lu, with ranges", (unsigned long)pad, (unsigned long)cut);
+        }
+    }
+}
+
+- (void)testChunkedParsing
+{
+    NSMutableString *json = [NSMutableString stringWithString:@"[\n"];
+    for (int i = 0; i < 300; i++)
+        [json appendFormat:@"%@  {\"id\": %d, \"name\": \"item \\\"%d\\\"\", \"tags\": [\"a\", \"b\"], \"value\": %d.5}", i ? @",\n" : @"", i, i, i];
+    [json appendString:@"\n]"];
+    NSData *data = [json dataUsingEncoding:NSUTF8StringEncoding];
+    id expected = [[[SBJsonParser alloc] init] objectWithData:data];
+    STAssertTrue([expected count] == 300, @"parses in one go");
+
+    NSUInteger sizes[] = { 1, 2, 3, 7, 63, 64, 65, 100, 1000 };
+    for (size_t s = 0; s < sizeof sizes / sizeof *sizes; s++) {
+        SBJsonStreamParserAccumulator *accumulator = [[SBJsonStreamParserAccumulator alloc] init];
+        SBJsonStreamParserAdapter *adapter = [[SBJsonStreamParserAdapter alloc] init];
+        adapter.delegate = accumulator;
+        SBJsonStreamParser *parser = [[SBJsonStreamParser alloc] init];
+        parser.delegate = adapter;
+
+        SBJsonStreamParserStatus status = SBJsonStreamParserWaitingForData;
+        for (NSUInteger at = 0; at < [data length] && status == SBJsonStreamParserWaitingForData; at += sizes[s])
+            status = [parser parse:[data subdataWithRange:NSMakeRange(at, MIN(sizes[s], [data length] - at))]];
+        STAssertTrue(status == SBJsonStreamParserComplete, @"chunks of %lu: %@", (unsigned long)sizes[s], parser.error);
+        STAssertEqualObjects(accumulator.value, expected, @"chunks of %lu", (unsigned long)sizes[s]);
+    }
+}
+
+@end